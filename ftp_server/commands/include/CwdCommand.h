@@ -2,6 +2,7 @@
 #define CWDCOMMAND_H
 
 #include "Command.h"
+#include "Coroutine.h"
 #include <string>
 
 /**
@@ -34,6 +35,20 @@ public:
             ThreadPool& threadPool) override;
 
 private:
+    /**
+     * @brief 在元数据线程池中打开目录，回到 Reactor 线程后切换工作目录并回复。
+     *
+     * 协程不引用 CwdCommand 本身，会话关闭时可安全销毁。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param path 已解析的目标目录。
+     * @param clientStream_ 用于与客户端通信的套接字流。
+     */
+    static Task<void> change_directory(
+            Session& session,
+            ResolvedPath path,
+            ACE_SOCK_Stream& clientStream_);
+
     /**
      * @brief 展开波浪符 (~) 为用户的主目录。
      *
@@ -0,0 +1,33 @@
+#ifndef FEATCOMMAND_H
+#define FEATCOMMAND_H
+
+#include "Command.h"
+
+/**
+ * @class FeatCommand
+ * @brief 处理 FTP FEAT（功能列表）命令的类。
+ *
+ * 按 RFC 2389 列出服务器支持的扩展命令，客户端据此决定是否使用 MLSD/MLST 等。
+ * FEAT 可以在登录前发送。
+ */
+class FeatCommand: public Command
+{
+public:
+    /**
+     * @brief 执行 FEAT 命令，返回多行的扩展功能列表。
+     *
+     * @param session 当前 FTP 客户端会话状态（在此实现中未使用）。
+     * @param name FTP 命令名称（在此实现中未使用）。
+     * @param params FTP 命令的参数（在此实现中未使用）。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 管理并发任务的线程池（在此实现中未使用）。
+     */
+    void execute(
+            Session& session,
+            const std::string& name,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool) override;
+};
+
+#endif // FEATCOMMAND_H
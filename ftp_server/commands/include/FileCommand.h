@@ -1,11 +1,19 @@
 #ifndef FILECOMMAND_H
 #define FILECOMMAND_H
 
+#include "BlockMode.h"
+#include "ChangeIndex.h"
+#include "ChangeWatcher.h"
 #include "Command.h"
+#include "Coroutine.h"
+#include "DirectoryListing.h"
+#include "FileCopy.h"
 #include "Session.h"
 #include "ThreadPool.h"
 #include <ace/SOCK_Acceptor.h>
 #include <ace/SOCK_Stream.h>
+#include <functional>
+#include <optional>
 
 /**
  * @class FileCommand
@@ -14,6 +22,18 @@
  * FileCommand 类负责处理文件操作相关的 FTP 命令，如 PASV、STOR、RETR、LIST 等。
  * 它支持被动模式和各种传输模式（如 ASCII
  * 和二进制模式），并使用线程池来管理并发任务。
+ *
+ * STOR/RETR/LIST 传输以协程形式运行在会话所属的 Reactor 线程上：等待数据连接、
+ * 网络读写时挂起，阻塞的磁盘操作卸载到线程池，完成后回到 Reactor 线程继续。
+ * 每个会话同一时刻最多一个传输协程，由 `transfer_` 持有。
+ * 目录读取与 MKD/RMD/DELE/SIZE/MLST 等元数据操作在专用的 `MetadataExecutor` 中执行，
+ * 不占用 Reactor 线程，也不与传输争用线程池。
+ * 所有路径由会话的 `PathResolver` 解析，文件操作经由 `FileSystem` 执行，
+ * 不直接访问本地文件系统。
+ *
+ * 传输协程经由 `open_data()`、`recv_data()`、`send_data()`、`finish_data()` 使用数据
+ * 连接：流模式下以关闭连接表示文件结束；块模式（MODE B）下按块收发，以 EOF 块
+ * 表示文件结束，连接保持打开，之后的传输无需再次 PASV 与建立连接。
  */
 class FileCommand: public Command
 {
@@ -23,6 +43,11 @@ public:
      */
     explicit FileCommand();
 
+    /**
+     * @brief 析构函数，取消尚未完成的传输协程并关闭数据连接。
+     */
+    ~FileCommand();
+
     /**
      * @brief 执行给定的 FTP 命令。
      *
@@ -69,51 +94,375 @@ public:
     /**
      * @brief 处理 STOR 命令，将客户端上传的文件存储在服务器上。
      *
-     * 该方法通过线程池处理文件上传操作，并根据传输模式（ASCII 或
-     * Binary）进行处理。
+     * 该方法启动 STOR 传输协程，磁盘写入通过线程池完成。
      *
      * @param session 当前 FTP 客户端会话状态。
      * @param params FTP 命令的参数，指定存储文件的路径。
+     * @param restart REST 给出的重启位置，为 0 时从头上传。
      * @param clientStream_ 与客户端通信的流。
      * @param threadPool 管理并发任务的线程池。
      */
     void handle_stor(
             Session& session,
             const std::string& params,
+            off_t restart,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief STOR 传输协程：接受数据连接，接收数据并写入文件。
+     *
+     * 续传时直接写入目标文件：截断到重启位置后从该处继续写入，不使用原子上传的
+     * 临时文件，也不计算摘要。块模式下客户端发送的重启标记在其之前的数据写入后
+     * 以 110 回复确认。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param path 存储文件的路径（已在会话根目录内解析）。
+     * @param restart 重启位置，为 0 时从头上传。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 执行磁盘写入的线程池。
+     */
+    Task<void> stor_transfer(
+            Session& session,
+            ResolvedPath path,
+            off_t restart,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief io_uring 版本的 STOR 传输协程。
+     *
+     * 接收与写盘通过会话所属 Reactor 的 io_uring 批量提交；第一块数据到达后
+     * 以链接的 OPENAT2→WRITE_FIXED 打开目标文件。注册缓冲区或文件槽位不足时
+     * 回退到 `stor_transfer()`。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param path 存储文件的路径（已在会话根目录内解析）。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 回退路径使用的线程池。
+     */
+    Task<void> stor_transfer_uring(
+            Session& session,
+            ResolvedPath path,
             ACE_SOCK_Stream& clientStream_,
             ThreadPool& threadPool);
 
     /**
      * @brief 处理 RETR 命令，将服务器上的文件发送到客户端。
      *
-     * 该方法通过线程池处理文件下载操作，并根据传输模式（ASCII 或
-     * Binary）进行处理。
+     * 该方法启动 RETR 传输协程，磁盘读取通过线程池完成。
      *
      * @param session 当前 FTP 客户端会话状态。
      * @param params FTP 命令的参数，指定要下载的文件路径。
+     * @param restart REST 给出的重启位置，为 0 时从头下载。
      * @param clientStream_ 与客户端通信的流。
      * @param threadPool 管理并发任务的线程池。
      */
     void handle_retr(
             Session& session,
             const std::string& params,
+            off_t restart,
             ACE_SOCK_Stream& clientStream_,
             ThreadPool& threadPool);
 
     /**
-     * @brief 处理 LIST 命令，列出服务器端当前目录的文件和目录。
+     * @brief RETR 传输协程：接受数据连接，读取文件并发送。
      *
-     * 该方法通过线程池处理 LIST 命令，列出当前工作目录的文件和子目录。
+     * 从重启位置开始发送；块模式下大文件每发送 RESTART_MARK_INTERVAL 字节插入一个
+     * 以文件偏移为内容的重启标记，连接中断后客户端以 REST 该偏移继续下载。
      *
      * @param session 当前 FTP 客户端会话状态。
+     * @param path 要下载的文件路径（已在会话根目录内解析）。
+     * @param restart 重启位置，为 0 时从头下载。
      * @param clientStream_ 与客户端通信的流。
-     * @param threadPool 管理并发任务的线程池。
+     * @param threadPool 执行磁盘读取的线程池。
+     */
+    Task<void> retr_transfer(
+            Session& session,
+            ResolvedPath path,
+            off_t restart,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief io_uring 版本的 RETR 传输协程。
+     *
+     * 一次提交完成 OPENAT2→READ_FIXED（链接）和 STATX，之后每块以链接的
+     * SEND→READ_FIXED 发送并回填同一缓冲区，另一缓冲区的读取与发送并行。
+     * STATX 无法把符号链接限制在根目录内，限制了根目录的会话使用 `retr_transfer()`。
+     * 注册缓冲区或文件槽位不足时回退到 `retr_transfer()`。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param path 要下载的文件路径（已在会话根目录内解析）。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 回退路径使用的线程池。
+     */
+    Task<void> retr_transfer_uring(
+            Session& session,
+            ResolvedPath path,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 处理 LIST/MLSD 命令，通过数据连接发送目录列表。
+     *
+     * 目录由 getdents64/statx 在线程池中分批读取并格式化，边读边发送，
+     * 不再 fork `ls`。路径相对于会话的工作目录；LIST 识别以 '-' 开头的选项中的
+     * `-a`（显示以 '.' 开头的目录项）和 `-R`（递归列出，格式同 `ls -lR`），其余忽略。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param name 命令名称（LIST 或 MLSD）。
+     * @param params 要列出的路径，为空时列出工作目录。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 执行目录读取的线程池。
      */
     void handle_list(
             Session& session,
+            const std::string& name,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 处理 SITE 命令的扩展子命令。
+     *
+     * - `SITE TREE <depth> [path]`：递归列表（MLSD 格式，名称为相对路径），
+     *   depth 为最多列出的层数，0 表示不限；
+     * - `SITE LIST|MLSD <cursor> <count> [path]`：分页列表，从游标处起最多发送
+     *   count 条，226 回复中给出下一页的游标（`cursor=<n>`，读完时为
+     *   `cursor=end`）。游标是文件系统提供的目录位置，服务器不保存分页状态，
+     *   两页之间目录被修改也不会重复或遗漏未变化的条目；
+     * - `SITE CHANGES <time> [-R] [path]`：列出目录下（-R 时包括子目录）
+     *   变更时间不早于 time（UTC，MDTM 格式，可带小数秒）的条目，MLSD 格式，
+     *   名称为相对路径，已删除的条目为 `type=deleted`。由 `ChangeIndex` 增量维护，
+     *   226 回复给出服务器当前时间（`now=<time>`），作为下次查询的起始时间；
+     *   无法保证删除完整时另加 `deletions=incomplete`；
+     * - `SITE WATCH [-R] [path]`：订阅目录下（-R 时包括子目录）的变更，由
+     *   `ChangeWatcher` 合并后在控制连接上推送，每批为一个多行 211 回复
+     *   （`211-Changes under <dir>:`，每行 ` created|modified|deleted <相对路径>`，
+     *   以 `211 End` 结束），溢出时为一行 `211 ... overflowed`，应以 SITE CHANGES
+     *   重新同步。命令或传输等待最终回复期间（如 150 与 226 之间）通知被暂缓，
+     *   在最终回复之后发送，不会被当作其他命令的回复；
+     *   每个会话同时只有一个订阅，`SITE UNWATCH` 或关闭会话时取消；
+     * - `SITE COPY <from> <to>`：在服务器上复制文件（路径含空格时加双引号），
+     *   由 `FileCopy` 在传输线程池中分段执行，数据不经过客户端。复制超过一秒时
+     *   每秒回复一行 `150 Copying <to>: <已复制> of <大小> bytes`，
+     *   完成时回复 `250 Copied <大小> bytes to <to> (<方式>)`；
+     * - `SITE SIGNATURE <blocksize> <path>`：经数据连接发送文件的块签名
+     *   （`DeltaSignature`），blocksize 为 0 时按文件大小选择；
+     * - `SITE PATCH <path>`：经数据连接接收增量（`DeltaPatcher` 的格式），
+     *   以现有文件为基准生成新文件，校验通过后原子地替换；
+     * - `SITE DELTA <path>`：先接收客户端文件的签名（客户端关闭写方向为止），
+     *   再发送把客户端文件变为服务器文件的增量。
+     *   签名与增量都在传输线程池中分段计算；
+     * - `SITE TAR [-z] <path|glob> ...`：把多个文件经一个数据连接作为一个 tar
+     *   流发送（-z 时以 gzip 压缩），目录递归包含，最后一个分量可含通配符
+     *   （`*`、`?`、`[...]`）。成员名为相对于工作目录的路径，符号链接等
+     *   其他类型跳过。完成时回复 `226 Archive sent; <n> files`，另给出
+     *   发送前已被删除而跳过、读取期间被修改的文件数；
+     * - `SITE UNTAR [-z] [dir]`：经一个数据连接接收 tar 流（-z 时为 gzip），
+     *   解出到 dir（默认为工作目录，须已存在）。成员名开头的 '/' 被去掉，
+     *   含 ".." 的成员与链接、设备等其他类型跳过；文件按 STOR 的方式提交
+     *   （原子上传、落盘），保留修改时间，不经过去重存储。完成时回复
+     *   `226 Extracted <n> files, <m> directories`。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param params 子命令及其参数。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 执行目录读取的线程池。
+     * @param transferPool 执行复制、签名、增量与归档读写的传输线程池。
+     */
+    void handle_site(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool,
+            ThreadPool& transferPool);
+
+    /**
+     * @brief SITE COPY 协程：打开、分段复制并报告进度，最后提交并回复。
+     *
+     * 协程不引用 FileCommand 本身，会话关闭时可安全销毁（临时文件随之删除）。
+     */
+    static Task<void> copy_command(
+            ACE_Reactor* reactor,
+            std::shared_ptr<FileCopy> copy,
+            std::string target,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 检查被动模式已就绪且没有进行中的传输，否则回复 425。
+     */
+    bool begin_transfer(ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 启动传输协程，由 `transfer_` 持有。
+     *
+     * 传输的最终回复（226 或错误）发出之前暂缓会话的异步通知。
+     */
+    void start_transfer(Session& session, Task<void> transfer);
+
+    /**
+     * @brief 等待传输完成后恢复发送会话的异步通知。
+     */
+    Task<void> run_transfer(Session& session, Task<void> transfer);
+
+    /**
+     * @brief SITE SIGNATURE 协程：接受数据连接，分段计算并发送块签名。
+     *
+     * @param blockSize 块大小，0 表示按文件大小选择。
+     */
+    Task<void> signature_transfer(
+            Session& session,
+            ResolvedPath path,
+            size_t blockSize,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief SITE PATCH 协程：接收增量并应用到现有文件，结果写入临时文件，
+     * 结束行校验通过且基准文件未被修改时经由 `UploadCommitter` 替换原文件。
+     */
+    Task<void> patch_transfer(
+            Session& session,
+            ResolvedPath path,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief SITE DELTA 协程：接收客户端的签名，分段编码并发送增量。
+     */
+    Task<void> delta_transfer(
+            Session& session,
+            ResolvedPath path,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief SITE TAR 协程：展开参数，在传输线程池中并行预读文件，按顺序发送归档。
+     *
+     * 小文件合并为一个读取任务，大文件分段读取；同时预读的任务数与字节数
+     * 有上限，发送慢时预读随之暂停。
+     *
+     * @param sources 参数，已解析（含通配符的分量保持原样）。
+     * @param compress 是否以 gzip 压缩。
+     */
+    Task<void> archive_transfer(
+            Session& session,
+            std::vector<ResolvedPath> sources,
+            bool compress,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief SITE UNTAR 协程：接收并解析 tar 流，在传输线程池中并行创建、写入文件。
+     *
+     * 小文件与目录合并为一个写入任务，大文件分段写入（各段可并行，最后写完的
+     * 任务提交文件）；同时写入的任务数与数据量有上限，达到时暂停接收，
+     * 由 TCP 流量控制让客户端等待。同一路径在归档中再次出现时，先等待之前的
+     * 写入全部完成。
+     *
+     * @param dir 解出到的目录。
+     * @param compressed 是否为 gzip 压缩的 tar。
+     */
+    Task<void> extract_transfer(
+            Session& session,
+            ResolvedPath dir,
+            bool compressed,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 检查数据连接并启动目录列表协程。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param request 列表请求，路径已解析。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 执行目录读取的线程池。
+     */
+    void start_listing(
+            Session& session,
+            const ListingRequest& request,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 目录列表协程：接受数据连接，双缓冲地读取目录项并发送。
+     *
+     * 列表缓存命中时直接从内存发送；未命中的完整列表读完后放入缓存。
+     * 分页列表不经过缓存。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param request 列表请求。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 执行目录读取的线程池。
+     */
+    Task<void> list_transfer(
+            Session& session,
+            ListingRequest request,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 递归列表：线程池并行读取多个目录，按开始读取的顺序依次发送。
+     *
+     * 待读目录按广度优先排队，同时最多读取 TREE_PARALLELISM 个目录；
+     * 大目录分批读取，后续批次紧接着发送，每个目录的条目保持连续。
+     * 不跟随指向目录的符号链接，无法读取的子目录跳过。
+     *
+     * @param reactor 会话所属的 Reactor。
+     * @param root 已打开的根目录。
+     * @param request 列表请求。
+     * @param threadPool 执行目录读取的线程池。
+     * @return 完成时应发送的回复。
+     */
+    Task<std::string> send_tree(
+            ACE_Reactor* reactor,
+            std::shared_ptr<DirectoryReader> root,
+            ListingRequest request,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 检查数据连接并启动变更列表协程。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param query 变更查询，路径已解析。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 执行索引查询的线程池。
+     */
+    void start_changes(
+            Session& session,
+            const ChangeQuery& query,
             ACE_SOCK_Stream& clientStream_,
             ThreadPool& threadPool);
 
+    /**
+     * @brief 变更列表协程：接受数据连接，双缓冲地分批读取变更并发送。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param query 变更查询。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 执行索引查询的线程池。
+     */
+    Task<void> changes_transfer(
+            Session& session,
+            ChangeQuery query,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+
+    /**
+     * @brief 处理 MLST 命令，在控制连接上返回单个路径的事实。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param params 要查询的路径，为空时为工作目录。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void handle_mlst(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
+
     /**
      * @brief 处理 MKD 命令，在服务器端创建新目录。
      *
@@ -129,26 +478,102 @@ public:
     /**
      * @brief 处理 RMD 命令，删除服务器端的目录。
      *
+     * @param session 当前 FTP 客户端会话状态。
      * @param params FTP 命令的参数，指定要删除的目录路径。
      * @param clientStream_ 与客户端通信的流。
      */
-    void handle_rmd(const std::string& params, ACE_SOCK_Stream& clientStream_);
+    void handle_rmd(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 处理 RNFR 命令：确认源路径存在，回复 350 后等待 RNTO。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param params 要改名的文件或目录。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void handle_rnfr(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 处理 RNTO 命令：把 RNFR 给出的路径改名（目标存在时原子地替换）。
+     *
+     * 前一个命令不是成功的 RNFR 时回复 503。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param params 新路径。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void handle_rnto(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
 
     /**
      * @brief 处理 DELE 命令，删除服务器端的文件。
      *
+     * @param session 当前 FTP 客户端会话状态。
      * @param params FTP 命令的参数，指定要删除的文件路径。
      * @param clientStream_ 与客户端通信的流。
      */
-    void handle_dele(const std::string& params, ACE_SOCK_Stream& clientStream_);
+    void handle_dele(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
 
     /**
      * @brief 处理 SIZE 命令，获取服务器端文件的大小。
      *
+     * 元数据经由 `MetadataCache` 获取，命中时不访问文件系统。
+     *
+     * @param session 当前 FTP 客户端会话状态。
      * @param params FTP 命令的参数，指定要查询的文件路径。
      * @param clientStream_ 与客户端通信的流。
      */
-    void handle_size(const std::string& params, ACE_SOCK_Stream& clientStream_);
+    void handle_size(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 处理 MDTM 命令，返回文件的修改时间（UTC，YYYYMMDDHHMMSS）。
+     *
+     * 与 SIZE 一样经由 `MetadataCache` 获取元数据。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param params FTP 命令的参数，指定要查询的文件路径。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void handle_mdtm(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 在元数据线程池中执行元数据操作，回到 Reactor 线程后发送它生成的回复。
+     *
+     * 操作完成前会话暂停读取控制连接，后续命令按顺序处理；线程池拒绝时回复 450/421。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param clientStream_ 与客户端通信的流。
+     * @param op 元数据操作，只能捕获值，返回要发送的回复。
+     */
+    static void run_metadata(
+            Session& session,
+            ACE_SOCK_Stream& clientStream_,
+            std::function<std::string()> op);
+
+    /**
+     * @brief 元数据命令协程，不引用 FileCommand，会话关闭时可安全销毁。
+     */
+    static Task<void> metadata_command(
+            ACE_Reactor* reactor,
+            ACE_SOCK_Stream& clientStream_,
+            std::function<std::string()> op);
 
     /**
      * @brief 处理 EPSV 命令，进入扩展被动模式。
@@ -159,6 +584,37 @@ public:
      */
     void handle_epsv(ACE_SOCK_Stream& clientStream_);
 
+    /**
+     * @brief 处理 MODE 命令，选择流模式（S）或块模式（B）。
+     *
+     * 切换模式时关闭保持着的数据连接；传输进行中不能切换。
+     *
+     * @param params 模式代码。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void handle_mode(const std::string& params, ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 处理 REST 命令，记录紧随其后的 RETR/STOR 的重启位置。
+     *
+     * 重启位置为十进制的文件偏移（块模式下即重启标记的内容或 110 回复中的位置）。
+     *
+     * @param params 重启位置。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void handle_rest(const std::string& params, ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 处理线程池拒绝传输任务的情况。
+     *
+     * 线程池已关闭时回复 421，队列已满时回复 450，并清除被动模式状态，
+     * 使客户端能够感知背压而不是无限等待数据连接。
+     *
+     * @param threadPool 拒绝任务的线程池。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void reject_transfer(ThreadPool& threadPool, ACE_SOCK_Stream& clientStream_);
+
     /**
      * @brief 清除被动模式状态。
      *
@@ -167,17 +623,77 @@ public:
     void clear_passive_mode();
 
     /**
-     * @brief 检查指定文件是否存在。
+     * @brief 为一次传输准备数据连接：块模式下已有连接时直接复用，否则等待客户端连接。
+     *
+     * @param reactor 会话所属的 Reactor。
+     * @param receiving 本次传输是否从客户端接收数据，结束时据此判断连接能否复用。
+     * @return 成功返回 0，失败返回 -1。
+     */
+    Task<int> open_data(ACE_Reactor* reactor, bool receiving);
+
+    /**
+     * @brief 从数据连接接收文件数据，块模式下去掉块头部并收集重启标记。
+     *
+     * @return 接收的字节数，文件结束（流模式下对端关闭）返回 0，出错返回 -1。
+     */
+    Task<ssize_t> recv_data(ACE_Reactor* reactor, char* buffer, size_t size);
+
+    /**
+     * @brief 发送全部数据，块模式下切分为数据块（头部与数据一次系统调用发出）。
+     *
+     * @return 成功返回 size，出错返回 -1。
+     */
+    Task<ssize_t> send_data(ACE_Reactor* reactor, const char* data, size_t size);
+
+    /**
+     * @brief 块模式下发送以 offset 为内容的重启标记。
+     *
+     * @return 成功返回 true。
+     */
+    Task<bool> send_restart_marker(ACE_Reactor* reactor, off_t offset);
+
+    /**
+     * @brief 以 110 回复确认写入位置不超过 written 的重启标记。
+     *
+     * @param start 本次接收的数据在文件中的起始位置。
+     * @param written 已写入文件的位置。
+     * @param clientStream_ 与客户端通信的流。
+     */
+    void acknowledge_markers(off_t start, off_t written, ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 结束传输：块模式下成功时先发送 EOF 块，再发送回复并释放数据连接。
      *
-     * @param fileName 要检查的文件路径。
-     * @return 如果文件存在返回 true，否则返回 false。
+     * 发送 EOF 块失败时回复改为 426。
+     *
+     * @param reactor 会话所属的 Reactor。
+     * @param clientStream_ 与客户端通信的流。
+     * @param response 传输结果的回复。
+     */
+    Task<void> finish_data(
+            ACE_Reactor* reactor,
+            ACE_SOCK_Stream& clientStream_,
+            std::string response);
+
+    /**
+     * @brief 释放数据连接：块模式下连接停在文件之间时保持打开供下一次传输使用，
+     * 否则（流模式、收发了一半）与 `clear_passive_mode()` 相同。
      */
-    bool file_exists(const std::string& fileName);
+    void release_data();
 
     // 数据连接相关
     ACE_SOCK_Acceptor dataAcceptor_; ///< 用于被动连接的监听器
     ACE_SOCK_Stream dataStream_;     ///< 客户端的数据连接流
     bool passive_mode_ = false;      ///< 标记是否启用了被动模式
+    bool blockMode_ = false;         ///< MODE B：数据连接在传输之间保持打开
+    bool receiving_ = false;         ///< 当前传输从客户端接收数据
+    bool sending_ = false;           ///< 块模式下已发送数据而尚未发送 EOF 块
+    BlockReader blockReader_;        ///< 块模式下接收数据的解析状态
+    off_t restart_ = 0;              ///< REST 给出的重启位置，只用于下一个命令
+    Task<void> transfer_;            ///< 当前会话正在进行的传输协程
+    std::shared_ptr<WatchSink> watch_; ///< SITE WATCH 的通知出口
+    /// RNFR 确认存在的源路径，由元数据线程填写，RNTO 或其他命令时清除
+    std::shared_ptr<std::optional<ResolvedPath> > renameFrom_;
 };
 
 #endif // FILECOMMAND_H
@@ -0,0 +1,78 @@
+#ifndef HASHCOMMAND_H
+#define HASHCOMMAND_H
+
+#include "Command.h"
+#include "Coroutine.h"
+#include "FileHash.h"
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @class HashCommand
+ * @brief 处理校验命令 HASH、XCRC、XMD5、XSHA256 及 OPTS HASH。
+ *
+ * 客户端无需重新下载即可校验服务器上的文件：
+ * - `HASH <path>`：使用 `OPTS HASH <算法>` 选择的算法（默认 SHA-256），
+ *   回复 `213 <算法> <起点>-<终点> <摘要> <path>`（终点为最后一个字节）；
+ * - `XCRC|XMD5|XSHA256 <path>` 或 `XCRC|XMD5|XSHA256 "<path>" [start [end]]`：
+ *   回复 `250 <摘要>`，区间为 [start, end)，省略时到文件末尾；
+ * - `OPTS HASH [算法]`：查询或选择 HASH 的算法（CRC32、CRC32C、MD5、SHA-1、
+ *   SHA-256、SHA-512）。
+ *
+ * 文件在传输线程池中分段读取并计算，每段一个任务，不会长时间占住线程池；
+ * 大文件按页缓存策略丢弃读过的页。结果由 `HashCache` 缓存，文件未修改时
+ * 重复校验不再读取文件。计算期间暂停读取控制连接，与其他命令保持顺序。
+ */
+class HashCommand: public Command
+{
+public:
+    /**
+     * @brief 执行校验命令。
+     *
+     * @param session 当前 FTP 客户端会话状态。
+     * @param name 命令名称（HASH、XCRC、XMD5、XSHA256 或 OPTS）。
+     * @param params 命令参数。
+     * @param clientStream_ 与客户端通信的流。
+     * @param threadPool 读取文件并计算摘要的线程池。
+     */
+    void execute(
+            Session& session,
+            const std::string& name,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool) override;
+
+private:
+    /**
+     * @brief 一次校验请求。
+     */
+    struct HashRequest
+    {
+        ResolvedPath path;                               ///< 要校验的文件
+        HashAlgorithm algorithm = HashAlgorithm::SHA256; ///< 算法
+        off_t start = 0;                                 ///< 区间起点
+        off_t end = -1;                                  ///< 区间终点（不含），-1 为文件末尾
+        bool hash = false;                               ///< 是否按 HASH 的格式回复
+    };
+
+    /**
+     * @brief 处理 OPTS 命令，目前只支持 OPTS HASH。
+     */
+    void handle_opts(
+            Session& session,
+            const std::string& params,
+            ACE_SOCK_Stream& clientStream_);
+
+    /**
+     * @brief 校验协程：打开文件并查找缓存，未命中时分段计算，最后回复。
+     *
+     * 协程不引用 HashCommand 本身，会话关闭时可安全销毁。
+     */
+    static Task<void> checksum(
+            ACE_Reactor* reactor,
+            HashRequest request,
+            ACE_SOCK_Stream& clientStream_,
+            ThreadPool& threadPool);
+};
+
+#endif // HASHCOMMAND_H
@@ -1,8 +1,8 @@
 #include "CwdCommand.h"
+#include "MetadataExecutor.h"
 #include <iostream>
-#include <ace/OS.h> // For ACE_OS::chdir, ACE_OS::getcwd, ACE_OS::realpath
+#include <cerrno>
 #include <cstring>  // For string operations
-#include <sys/stat.h>
 #include <pwd.h>
 #include <unistd.h>
 
@@ -11,6 +11,8 @@
  *
  * 该方法实现了更改当前会话工作目录的逻辑。如果提供的路径无效，向客户端返回错误消息。
  * 如果路径有效，会将工作目录更改为新目录，并发送确认响应给客户端。
+ * 不调用 chdir，其他会话的工作目录不受影响；目录在元数据线程池中打开，
+ * 慢速存储不会阻塞 Reactor 线程。
  */
 void CwdCommand::execute(
         Session& session,
@@ -34,59 +36,47 @@ void CwdCommand::execute(
         return;
     }
 
-    // 获取当前工作目录
-    char currentDir[1024];
-    if (ACE_OS::getcwd(currentDir, sizeof(currentDir)) == nullptr) {
-        std::string response =
-                "550 Failed to get current working directory.\r\n";
-        clientStream_.send(response.c_str(), response.size());
-        return;
-    }
-
-    std::string fullPath;
-
-    // 处理相对路径和绝对路径
-    if (newPath == "..") {
-        // 处理上层目录
-        fullPath = std::string(currentDir) + "/..";
-    } else if (newPath[0] != '/') {
-        // 相对路径
-        fullPath = std::string(currentDir) + "/" + newPath;
-    } else {
-        // 绝对路径
-        fullPath = newPath;
-    }
+    // 只改变本会话的工作目录，路径在会话根目录内解析；
+    // 目录在元数据线程上打开，期间不读取后续命令
+    ResolvedPath path = session.get_path_resolver().resolve(newPath);
+    session.run_command(change_directory(session, path, clientStream_));
+}
 
-    // 使用 realpath 来解析实际路径
-    char resolvedPath[1024];
-    if (ACE_OS::realpath(fullPath.c_str(), resolvedPath) == nullptr) {
-        std::string response =
-                "550 Failed to resolve path: \"" + fullPath + "\".\r\n";
-        clientStream_.send(response.c_str(), response.size());
-        return;
+Task<void> CwdCommand::change_directory(
+        Session& session,
+        ResolvedPath path,
+        ACE_SOCK_Stream& clientStream_)
+{
+    typedef std::pair<int, std::shared_ptr<const DirectoryHandle> > Opened;
+    MetadataExecutor& executor = MetadataExecutor::instance();
+    auto opening = executor.submit(session.get_reactor(), [path] {
+        Opened opened;
+        opened.first = path.open_directory(opened.second);
+        return opened;
+    });
+    std::optional<Opened> opened = co_await opening;
+    if (!opened) {
+        reply_busy(clientStream_, executor.pool());
+        co_return;
     }
 
-    // 检查路径是否存在并且是目录
-    struct stat info;
-    if (stat(resolvedPath, &info) != 0 || !(info.st_mode & S_IFDIR)) {
+    int rc = opened->first;
+    if (rc == -ENOENT || rc == -ENOTDIR) {
         std::string response =
                 "550 Directory does not exist or is not a directory: \"" +
-                std::string(resolvedPath) + "\".\r\n";
+                path.path() + "\".\r\n";
         clientStream_.send(response.c_str(), response.size());
-        return;
-    }
-
-    // 尝试改变工作目录
-    if (ACE_OS::chdir(resolvedPath) == -1) {
+    } else if (rc != 0) {
         // 失败时返回550错误
-        std::string response = "550 Failed to change directory to \"" +
-                               std::string(resolvedPath) + "\".\r\n";
+        std::string response =
+                "550 Failed to change directory to \"" + path.path() + "\".\r\n";
         clientStream_.send(response.c_str(), response.size());
     } else {
         // 成功时返回250响应
+        PathResolver& resolver = session.get_path_resolver();
+        resolver.enter(std::move(opened->second));
         std::string response = "250 Directory successfully changed to \"" +
-                               std::string(resolvedPath) + "\".\r\n";
-        session.set_working_directory(resolvedPath);
+                               resolver.cwd() + "\".\r\n";
         clientStream_.send(response.c_str(), response.size());
     }
 }
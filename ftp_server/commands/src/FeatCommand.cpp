@@ -0,0 +1,39 @@
+#include "FeatCommand.h"
+
+void FeatCommand::execute(
+        Session& session,
+        const std::string& /*name*/,
+        const std::string& /*params*/,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& /*threadPool*/)
+{
+    // HASH 后列出支持的算法，* 表示当前选择的算法
+    std::string hash = " HASH";
+    char separator = ' ';
+    for (HashAlgorithm algorithm :
+         {HashAlgorithm::CRC32, HashAlgorithm::CRC32C, HashAlgorithm::MD5,
+          HashAlgorithm::SHA1, HashAlgorithm::SHA256, HashAlgorithm::SHA512}) {
+        hash += separator;
+        hash += hash_algorithm_name(algorithm);
+        if (algorithm == session.get_hash_algorithm()) {
+            hash += '*';
+        }
+        separator = ';';
+    }
+
+    // 每个功能一行，以空格开头（RFC 2389）；MLST 后列出支持的事实，* 表示默认返回
+    std::string response =
+            "211-Features:\r\n"
+            " EPSV\r\n" +
+            hash + "\r\n"
+            " MDTM\r\n"
+            " MLST type*;size*;modify*;perm*;unix.mode*;unix.uid*;unix.gid*;\r\n"
+            " PASV\r\n"
+            " REST STREAM\r\n"
+            " SIZE\r\n"
+            " XCRC\r\n"
+            " XMD5\r\n"
+            " XSHA256\r\n"
+            "211 End\r\n";
+    clientStream_.send(response.c_str(), response.size());
+}
@@ -1,28 +1,744 @@
 #include "FileCommand.h"
+#include "ChangeIndex.h"
+#include "ChangeWatcher.h"
+#include "CpuAffinity.h"
+#include "DedupStore.h"
+#include "DirectoryListing.h"
+#include "FileCache.h"
+#include "HashCache.h"
+#include "IoUring.h"
+#include "ListingCache.h"
+#include "MetadataCache.h"
+#include "MetadataExecutor.h"
+#include "PageCache.h"
+#include "ReactorAwaiters.h"
+#include "RsyncDelta.h"
+#include "TarArchive.h"
+#include "UploadCommitter.h"
 #include <ace/Log_Msg.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <random>
+#include <deque>
 #include <list>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 #include <sys/stat.h>
 #include <ace/Message_Block.h>
 #include <dirent.h>
+#include <fnmatch.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 
 // 定义每个传输块的大小
-const size_t CHUNK_SIZE = 65536;          // 64KB
-const size_t SMALL_FILE_THRESHOLD = 8192; // 小文件的阈值，8KB
+const size_t CHUNK_SIZE = 65536; // 64KB
+
+// 递归列表同时读取的目录数
+const size_t TREE_PARALLELISM = 4;
+
+// 变更列表每批读取的条目数
+const size_t CHANGES_BATCH = 1024;
+
+// SITE COPY 报告进度的间隔
+const std::chrono::seconds COPY_PROGRESS_INTERVAL(1);
+
+// 签名与增量每个线程池任务处理的文件字节数
+const size_t DELTA_STEP = 4 * 1024 * 1024;
+
+// SITE PATCH 每次接收的增量字节数
+const size_t PATCH_CHUNK = 256 * 1024;
+
+// SITE DELTA 接收的签名的大小上限
+const size_t SIGNATURE_MAX = 64 * 1024 * 1024;
+
+// SITE TAR/UNTAR 每个读写任务的字节数上限，更大的文件分段处理
+const size_t ARCHIVE_PIECE = 1024 * 1024;
+
+// SITE TAR/UNTAR 每个读写任务最多合并的小文件数
+const size_t ARCHIVE_BATCH_FILES = 64;
+
+// SITE TAR 同时预读的任务数与字节数
+const size_t ARCHIVE_PREFETCH = 8;
+const size_t ARCHIVE_PREFETCH_BYTES = 8 * 1024 * 1024;
+
+// SITE TAR 每次压缩、发送的字节数
+const size_t ARCHIVE_FLUSH = 256 * 1024;
+
+// SITE TAR 一次最多归档的成员数
+const size_t ARCHIVE_MEMBERS_MAX = 200000;
+
+// SITE TAR -z 的压缩级别（优先速度）
+const int ARCHIVE_GZIP_LEVEL = 1;
+
+// SITE UNTAR 每次接收的字节数
+const size_t EXTRACT_RECV = 256 * 1024;
+
+// SITE UNTAR 同时写入的任务数与数据字节数
+const size_t EXTRACT_PARALLEL = 8;
+const size_t EXTRACT_PENDING_BYTES = 16 * 1024 * 1024;
+
+// 块模式下 RETR 插入重启标记的间隔
+const off_t RESTART_MARK_INTERVAL = 16 * 1024 * 1024;
+
+/**
+ * @brief 原子上传的临时文件：提交前被销毁（传输失败或会话关闭）时删除。
+ */
+struct UploadTemporary
+{
+    std::optional<ResolvedPath> path; ///< 已创建的临时文件
+
+    ~UploadTemporary()
+    {
+        if (path) {
+            path->unlink();
+        }
+    }
+};
+
+/**
+ * @brief 传输协程与线程池任务共享的文件状态。
+ *
+ * 线程池任务只捕获该状态的共享指针，不引用协程帧；会话关闭导致协程被销毁时，
+ * 仍在执行的磁盘操作结束后由最后一个持有者关闭文件并归还缓冲区。
+ * 缓冲区取自 Reactor 线程的空闲表，位于该 Reactor 所在的 NUMA 节点。
+ */
+struct FileTransferState
+{
+    int fd = -1;               ///< 文件描述符
+    size_t size = 0;           ///< 文件大小（RETR）
+    char* buffers[2] = {};     ///< 双缓冲，每块 CHUNK_SIZE 字节（按页对齐）
+    std::shared_ptr<LocalBufferPool> pool; ///< 缓冲区所属的空闲表
+    CacheWindow cache;         ///< 大文件的页缓存策略
+    std::shared_ptr<const std::string> content; ///< 小文件的完整内容（RETR）
+    std::unique_ptr<Hasher> hasher; ///< 边接收边计算的摘要（STOR）
+    UploadTemporary temporary;      ///< 原子上传的临时文件（STOR）
+    std::unique_ptr<DedupWriter> dedup;        ///< 去重上传（STOR）
+    std::unique_ptr<ManifestReader> manifest;  ///< 去重文件的清单（RETR）
+
+    bool allocate()
+    {
+        pool = LocalBufferPool::current(CHUNK_SIZE);
+        buffers[0] = pool->acquire();
+        buffers[1] = pool->acquire();
+        return buffers[0] != nullptr && buffers[1] != nullptr;
+    }
+
+    ~FileTransferState()
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+        if (pool) {
+            pool->release(buffers[0]);
+            pool->release(buffers[1]);
+        }
+    }
+};
+
+/**
+ * @brief 签名与增量读取的文件：普通文件直接 pread，去重文件经由清单读取。
+ */
+struct DeltaSource
+{
+    int fd = -1;            ///< 文件
+    off_t size = 0;         ///< 逻辑大小
+    mode_t mode = 0644;     ///< 权限，SITE PATCH 的结果沿用
+    FileIdentity identity;  ///< 打开时的版本
+    std::unique_ptr<ManifestReader> manifest; ///< 去重文件的清单
+
+    ~DeltaSource()
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
+    // 打开并记录版本：成功返回 0，失败返回 -errno（不是普通文件时为 -EISDIR）
+    int open(const ResolvedPath& path)
+    {
+        fd = path.open(O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            int rc = fd;
+            fd = -1;
+            return rc;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            return -errno;
+        }
+        if (!S_ISREG(st.st_mode)) {
+            return -EISDIR;
+        }
+        identity = FileIdentity::from_stat(st);
+        size = st.st_size;
+        mode = st.st_mode & 0777;
+        if (DedupStore::instance().enabled()) {
+            auto reader = std::make_unique<ManifestReader>();
+            int rc = reader->open(fd);
+            if (rc < 0) {
+                return rc;
+            }
+            if (rc == 1) {
+                manifest = std::move(reader);
+            }
+        }
+        return 0;
+    }
+
+    ssize_t read(char* buffer, size_t length, off_t offset)
+    {
+        return manifest ? manifest->pread(buffer, length, offset)
+                        : pread(fd, buffer, length, offset);
+    }
+
+    // 读满 length 字节（文件末尾除外），失败返回 -errno，被截断时为 -ESTALE
+    ssize_t read_fully(char* buffer, size_t length, off_t offset)
+    {
+        size_t filled = 0;
+        while (filled < length) {
+            ssize_t n = read(buffer + filled, length - filled, offset + filled);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                return -errno;
+            }
+            if (n == 0) {
+                return -ESTALE;
+            }
+            filled += n;
+        }
+        return static_cast<ssize_t>(filled);
+    }
+
+    // 打开以来文件是否未被修改
+    bool unchanged() const
+    {
+        struct stat st;
+        return fstat(fd, &st) == 0 &&
+               identity.same_version(FileIdentity::from_stat(st));
+    }
+};
+
+/**
+ * @brief SITE SIGNATURE/DELTA 协程与线程池任务共享的状态。
+ */
+struct DeltaState
+{
+    DeltaSource source;                     ///< 读取的文件
+    size_t blockSize = 0;                   ///< 签名的块大小
+    off_t offset = 0;                       ///< 已处理到的位置
+    std::vector<char> buffer;               ///< 读取缓冲
+    std::string signatureText;              ///< SITE DELTA：客户端发送的签名
+    DeltaSignature signature;               ///< SITE DELTA：解析后的签名
+    std::unique_ptr<DeltaEncoder> encoder;  ///< SITE DELTA：增量编码
+};
+
+/**
+ * @brief SITE PATCH 协程与线程池任务共享的状态。
+ */
+struct PatchState
+{
+    DeltaSource source;                    ///< 基准文件
+    UploadTemporary temporary;             ///< 结果写入的临时文件
+    int fd = -1;                           ///< 临时文件
+    std::unique_ptr<DeltaPatcher> patcher; ///< 应用增量
+    std::vector<char> buffers[2];          ///< 双缓冲
+
+    ~PatchState()
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+};
+
+/**
+ * @brief SITE TAR 归档中的一个成员。
+ */
+struct ArchiveEntry
+{
+    ResolvedPath path; ///< 文件或目录
+    TarMember member;  ///< 展开参数时的元数据
+};
+
+/**
+ * @brief SITE TAR 协程与线程池任务共享的状态。
+ */
+struct ArchiveState
+{
+    std::vector<ArchiveEntry> entries; ///< 展开后的成员，开始发送后只读
+    std::unique_ptr<GzipStream> gzip;  ///< -z 时的压缩状态
+};
+
+/**
+ * @brief SITE TAR 的一个读取任务：若干个完整的小文件，或一个大文件的一段。
+ */
+struct ArchiveJob
+{
+    size_t begin = 0;  ///< 第一个成员
+    size_t end = 0;    ///< 最后一个成员之后
+    off_t offset = 0;  ///< 大文件：段的偏移
+    size_t length = 0; ///< 读取的数据字节数
+};
+
+/**
+ * @brief SITE TAR 读取任务的结果。
+ */
+struct ArchiveBatch
+{
+    std::string data;   ///< 头部、数据与补齐
+    size_t files = 0;   ///< 开始发送的文件数
+    size_t skipped = 0; ///< 无法打开而跳过的文件数
+    size_t changed = 0; ///< 读取期间大小改变的文件数（以零补齐或截断）
+};
+
+/**
+ * @brief SITE UNTAR 正在解出的一个文件，由写入其各段的任务共享。
+ */
+struct ExtractFile
+{
+    ResolvedPath target;           ///< 目标文件
+    TarMember member;              ///< 成员的元数据
+    std::mutex mutex;              ///< 保护打开与 error
+    int fd = -1;                   ///< 第一段写入时打开
+    int error = 0;                 ///< 第一个错误（-errno）
+    ResolvedPath written;          ///< 写入的文件（原子上传时为临时文件）
+    UploadTemporary temporary;     ///< 提交前被销毁时删除的临时文件
+    std::atomic<size_t> pieces{1}; ///< 尚未写完的段数，最后写完的任务提交文件
+
+    ~ExtractFile()
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+};
+
+/**
+ * @brief SITE UNTAR 写入任务中的一项：创建目录，或写入文件的一段。
+ */
+struct ExtractOp
+{
+    std::shared_ptr<ExtractFile> file; ///< 文件，创建目录时为空
+    ResolvedPath directory;            ///< 创建的目录
+    mode_t mode = 0755;                ///< 目录的权限
+    off_t offset = 0;                  ///< 段在文件中的偏移
+    size_t begin = 0;                  ///< 段在任务数据中的起点
+    size_t length = 0;                 ///< 段的长度
+};
+
+/**
+ * @brief SITE UNTAR 的一个写入任务：若干个小文件与目录，或一个大文件的一段。
+ */
+struct ExtractBatch
+{
+    std::string data;               ///< 各段的数据
+    std::vector<ExtractOp> ops;     ///< 依次执行的操作
+    std::vector<std::string> names; ///< 本任务开始写入的文件，用于检测重名
+};
+
+/**
+ * @brief SITE UNTAR 写入任务的统计。
+ */
+struct ExtractResult
+{
+    size_t files = 0;       ///< 写完并提交的文件数
+    size_t directories = 0; ///< 创建（或已存在）的目录数
+    size_t failed = 0;      ///< 失败的文件与目录数
+    int error = 0;          ///< 第一个错误（-errno）
+};
+
+/**
+ * @brief SITE UNTAR 提交给线程池的写入任务，只在 Reactor 线程上使用。
+ */
+struct ExtractPipeline
+{
+    typedef std::shared_ptr<ExtractBatch> BatchPtr;
+    typedef std::unique_ptr<Offload<ExtractResult> > WritePtr;
+
+    std::deque<std::pair<BatchPtr, WritePtr> > running; ///< 按提交的顺序
+    std::unordered_map<std::string, size_t> writing;    ///< 写入中的文件（虚拟路径）
+    size_t pending = 0;    ///< 写入中的数据字节数
+    ExtractResult total;   ///< 已完成任务的统计
+    bool rejected = false; ///< 线程池拒绝了任务
+};
+
+/**
+ * @brief io_uring 传输占用的固定文件槽位，协程结束或被销毁时异步关闭并归还。
+ */
+struct UringFileSlot
+{
+    IoUring* ring;
+    int slot;
+
+    UringFileSlot(IoUring* ring, int slot): ring(ring), slot(slot) {}
+    UringFileSlot(const UringFileSlot&) = delete;
+    UringFileSlot& operator=(const UringFileSlot&) = delete;
+
+    ~UringFileSlot()
+    {
+        if (slot != -1) {
+            ring->release_file_slot(slot);
+        }
+    }
+};
+
+/**
+ * @brief 目录列表协程与线程池任务共享的状态。
+ */
+struct ListingState
+{
+    DirectoryReader reader;                     ///< 目录读取
+    std::shared_ptr<const std::string> cached;  ///< 缓存命中的完整列表
+    ListingCache::Ticket ticket;                ///< 可缓存时读取开始的目录版本
+    std::string rendered;                       ///< 可缓存时累积的完整列表
+    size_t remaining = 0;                       ///< 分页：本页剩余的条目数
+};
+
+/**
+ * @brief 递归列表中的一个目录。
+ */
+struct TreeDirectory
+{
+    std::shared_ptr<DirectoryReader> reader; ///< 读取器，未打开或已读完时为空
+    std::string relative;                    ///< 相对于列表根目录的路径
+    int depth = 1;                           ///< 层数，根目录为 1
+    bool started = false;                    ///< 是否已读取过
+};
+
+/**
+ * @brief 递归列表中一个目录的一批结果。
+ */
+struct TreeBatch
+{
+    int rc = 0;                       ///< 目录还有更多内容时为 1
+    std::string out;                  ///< 格式化后的行
+    std::vector<std::string> subdirs; ///< 本批读到的子目录
+};
+
+// 在指定偏移写入全部数据
+static bool write_all(int fd, const char* data, size_t size, off_t offset)
+{
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+// 读取一块并按页缓存策略丢弃已读窗口；O_DIRECT 被拒绝时改用缓冲读取
+static ssize_t read_chunk(
+        FileTransferState& state,
+        char* buffer,
+        size_t size,
+        off_t offset)
+{
+    if (state.manifest) {
+        return state.manifest->pread(buffer, size, offset);
+    }
+    ssize_t bytesRead = pread(state.fd, buffer, size, offset);
+    if (bytesRead == -1 && errno == EINVAL && state.cache.direct()) {
+        state.cache.fall_back_to_fadvise(state.fd);
+        bytesRead = pread(state.fd, buffer, size, offset);
+    }
+    if (bytesRead > 0) {
+        CacheWindow::apply_drop(
+                state.fd, state.cache.advance_read(offset + bytesRead));
+    }
+    return bytesRead;
+}
+
+// 把小文件整体读入内存；读取前后版本一致且大小合适时放入缓存
+static std::string read_small_file(
+        FileTransferState& state,
+        const struct stat& before)
+{
+    auto content = std::make_shared<std::string>(state.size, '\0');
+    size_t filled = 0;
+    while (filled < state.size) {
+        char* buffer = content->data() + filled;
+        ssize_t bytesRead = state.manifest
+                ? state.manifest->pread(buffer, state.size - filled, filled)
+                : pread(state.fd, buffer, state.size - filled, filled);
+        if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return "451 Failed to read file.\r\n";
+        }
+        filled += bytesRead;
+    }
+
+    FileCache& fileCache = FileCache::instance();
+    struct stat after;
+    if (fileCache.cacheable(state.size) && fstat(state.fd, &after) == 0) {
+        FileIdentity identity = FileIdentity::from_stat(before);
+        if (identity.same_version(FileIdentity::from_stat(after))) {
+            fileCache.insert(identity, content);
+        }
+    }
+    state.content = std::move(content);
+    return std::string();
+}
+
+// 解析 MDTM 格式的 UTC 时间 YYYYMMDDHHMMSS[.F...] 为纳秒
+static bool parse_timestamp(const std::string& text, int64_t& nanos)
+{
+    if (text.size() < 14 ||
+        !std::all_of(text.begin(), text.begin() + 14, ::isdigit)) {
+        return false;
+    }
+    struct tm tm = {};
+    tm.tm_year = std::stoi(text.substr(0, 4)) - 1900;
+    tm.tm_mon = std::stoi(text.substr(4, 2)) - 1;
+    tm.tm_mday = std::stoi(text.substr(6, 2));
+    tm.tm_hour = std::stoi(text.substr(8, 2));
+    tm.tm_min = std::stoi(text.substr(10, 2));
+    tm.tm_sec = std::stoi(text.substr(12, 2));
+    if (tm.tm_mon < 0 || tm.tm_mon > 11 || tm.tm_mday < 1 || tm.tm_mday > 31 ||
+        tm.tm_hour > 23 || tm.tm_min > 59 || tm.tm_sec > 60) {
+        return false;
+    }
+
+    // 小数秒最多取到纳秒
+    int64_t fraction = 0;
+    if (text.size() > 14) {
+        if (text[14] != '.' || text.size() == 15 ||
+            !std::all_of(text.begin() + 15, text.end(), ::isdigit)) {
+            return false;
+        }
+        std::string digits = text.substr(15, 9);
+        digits.resize(9, '0');
+        fraction = std::stoll(digits);
+    }
+    nanos = static_cast<int64_t>(timegm(&tm)) * 1000000000LL + fraction;
+    return true;
+}
+
+// 把纳秒格式化为 MDTM 格式的 UTC 时间，带 9 位小数秒
+static std::string format_timestamp(int64_t nanos)
+{
+    time_t seconds = static_cast<time_t>(nanos / 1000000000LL);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    char buf[32];
+    size_t len = strftime(buf, sizeof(buf), "%Y%m%d%H%M%S", &tm);
+    snprintf(buf + len, sizeof(buf) - len, ".%09lld",
+             static_cast<long long>(nanos % 1000000000LL));
+    return buf;
+}
+
+// 去掉参数前的选项（如 -R），返回是否带有该选项
+static bool take_option(std::string& args, const std::string& option)
+{
+    if (args != option && args.compare(0, option.size() + 1, option + " ") != 0) {
+        return false;
+    }
+    size_t next = args.find_first_not_of(' ', option.size());
+    args = next == std::string::npos ? std::string() : args.substr(next);
+    return true;
+}
+
+// 去掉路径参数前的 -R 选项，返回是否带有该选项
+static bool take_recursive_option(std::string& path)
+{
+    return take_option(path, "-R");
+}
+
+// 取出一个路径参数（含空格时用双引号），rest 为剩余部分
+static bool take_path_argument(std::string& rest, std::string& path)
+{
+    size_t end;
+    if (!rest.empty() && rest[0] == '"') {
+        end = rest.find('"', 1);
+        if (end == std::string::npos || end == 1) {
+            return false;
+        }
+        path = rest.substr(1, end - 1);
+        ++end;
+    } else {
+        end = rest.find(' ');
+        path = rest.substr(0, end);
+    }
+    size_t next = end == std::string::npos ? end : rest.find_first_not_of(' ', end);
+    rest = next == std::string::npos ? std::string() : rest.substr(next);
+    return !path.empty();
+}
+
+// 写入一块并按页缓存策略回写；last 为最后一块时启动剩余区间的回写
+static bool write_chunk(
+        FileTransferState& state,
+        const char* data,
+        size_t size,
+        off_t offset,
+        bool last)
+{
+    if (state.dedup) {
+        // 去重上传：数据保存到分块存储，文件本身在结束时只写清单
+        int rc = state.dedup->write(data, size);
+        if (rc != 0) {
+            errno = -rc;
+            return false;
+        }
+        if (state.hasher) {
+            state.hasher->update(data, size);
+        }
+        return true;
+    }
+    state.cache.apply_before_write(state.fd, offset, size);
+    bool written = write_all(state.fd, data, size, offset);
+    if (!written && errno == EINVAL && state.cache.direct()) {
+        state.cache.fall_back_to_fadvise(state.fd);
+        written = write_all(state.fd, data, size, offset);
+    }
+    if (!written) {
+        return false;
+    }
+    // 各块按顺序写入，写入的同时计算摘要，校验时无需再读一遍文件
+    if (state.hasher) {
+        state.hasher->update(data, size);
+    }
+    off_t end = offset + static_cast<off_t>(size);
+    CacheWindow::apply_write_behind(state.fd, state.cache.advance_write(end));
+    if (last) {
+        CacheWindow::apply_finish(state.fd, state.cache.finish_write(end));
+    }
+    return true;
+}
+
+/**
+ * @brief 把上传时计算的摘要插入校验缓存，之后的 HASH 等命令直接命中。
+ *
+ * fd 为 -1 时按路径打开（io_uring 路径的固定文件无法 fstat）；
+ * 文件大小与写入的字节数不一致说明已被其他写入者修改，不插入。
+ */
+static void seed_upload_digest(
+        int fd,
+        const ResolvedPath& path,
+        off_t size,
+        HashAlgorithm algorithm,
+        const std::string& digest)
+{
+    int opened = -1;
+    if (fd == -1) {
+        opened = path.open(O_RDONLY | O_CLOEXEC);
+        if (opened < 0) {
+            return;
+        }
+        fd = opened;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size == size) {
+        HashCache::instance().seed(
+                fd, FileIdentity::from_stat(st), algorithm, digest);
+    }
+    if (opened != -1) {
+        close(opened);
+    }
+}
+
+// 附带上传摘要的 226 回复
+static std::string upload_digest_response(
+        HashAlgorithm algorithm,
+        const std::string& digest)
+{
+    return std::string("226 Transfer complete; ") +
+           hash_algorithm_name(algorithm) + "=" + digest + "\r\n";
+}
+
+/**
+ * @brief io_uring 传输的页缓存窗口：把 CacheWindow 计算出的区间提交为
+ * FADVISE/SYNC_FILE_RANGE 操作。
+ *
+ * 固定文件无法切换 O_DIRECT，DIRECT 模式按 FADVISE 处理。
+ * 提交新一组操作前先等待上一组完成，写入时脏页不超过两个窗口。
+ */
+struct UringCacheWindow
+{
+    IoUring* ring;
+    int slot;
+    CacheWindow window;
+    std::vector<UringOp> pending;
+
+    UringCacheWindow(IoUring* ring, int slot): ring(ring), slot(slot)
+    {
+        window.fall_back_to_fadvise();
+    }
+
+    // 等待上一组操作完成，页缓存建议失败不影响传输
+    Task<void> settle()
+    {
+        for (UringOp& op : pending) {
+            int result = co_await op;
+            (void)result;
+        }
+        pending.clear();
+    }
+
+    void advise_sequential()
+    {
+        pending.push_back(ring->fadvise(slot, 0, 0, POSIX_FADV_SEQUENTIAL));
+    }
+
+    void drop(const CacheRange& range)
+    {
+        pending.push_back(ring->fadvise(
+                slot, range.offset, range.length, POSIX_FADV_DONTNEED));
+    }
+
+    void write_behind(const CacheWindow::WriteBehind& action)
+    {
+        pending.push_back(ring->sync_file_range(
+                slot, action.start.offset, action.start.length,
+                SYNC_FILE_RANGE_WRITE));
+        if (!action.drop.empty()) {
+            // 等待上一窗口落盘后再丢弃，两个操作链接顺序执行
+            pending.push_back(ring->sync_file_range(
+                    slot, action.drop.offset, action.drop.length,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER,
+                    true));
+            drop(action.drop);
+        }
+    }
+
+    void finish(const CacheRange& range)
+    {
+        pending.push_back(ring->sync_file_range(
+                slot, range.offset, range.length, SYNC_FILE_RANGE_WRITE));
+        drop(range);
+    }
+};
 
 // 构造函数
 FileCommand::FileCommand(): dataAcceptor_(), dataStream_() {}
 
-// 检查文件是否存在
-bool FileCommand::file_exists(const std::string& fileName)
+// 析构函数：先销毁挂起的传输协程（从 Reactor 注销），再关闭数据连接，取消变更订阅
+FileCommand::~FileCommand()
 {
-    struct stat buffer;
-    return (stat(fileName.c_str(), &buffer) == 0);
+    transfer_.reset();
+    clear_passive_mode();
+    if (watch_) {
+        ChangeWatcher::instance().unsubscribe(watch_);
+        watch_->detach();
+    }
 }
 
 void FileCommand::execute(
@@ -35,31 +751,62 @@ void FileCommand::execute(
     if (!require_login(session)) {
         return;
     }
+    // RNTO 必须紧跟 RNFR
+    if (name != "RNTO") {
+        renameFrom_.reset();
+    }
+    // REST 只作用于紧随其后的 RETR/STOR
+    off_t restart = std::exchange(restart_, 0);
     if (name == "PASV") {
         handle_pasv(session, clientStream_);
     } else if (name == "TYPE") {
         handle_type(session, params, clientStream_);
     } else if (name == "STOR") {
-        handle_stor(session, params, clientStream_, threadPool);
+        handle_stor(session, params, restart, clientStream_, threadPool);
     } else if (name == "RETR") {
-        handle_retr(session, params, clientStream_, threadPool);
-    } else if (name == "LIST") {
-        handle_list(session, clientStream_, threadPool);
+        handle_retr(session, params, restart, clientStream_, threadPool);
+    } else if (name == "LIST" || name == "MLSD") {
+        handle_list(session, name, params, clientStream_,
+                    MetadataExecutor::instance().pool());
+    } else if (name == "MLST") {
+        handle_mlst(session, params, clientStream_);
+    } else if (name == "SITE") {
+        handle_site(session, params, clientStream_,
+                    MetadataExecutor::instance().pool(), threadPool);
     } else if (name == "MKD") {
         handle_mkd(session, params, clientStream_);
     } else if (name == "RMD") {
-        handle_rmd(params, clientStream_);
+        handle_rmd(session, params, clientStream_);
     } else if (name == "DELE") {
-        handle_dele(params, clientStream_);
+        handle_dele(session, params, clientStream_);
+    } else if (name == "RNFR") {
+        handle_rnfr(session, params, clientStream_);
+    } else if (name == "RNTO") {
+        handle_rnto(session, params, clientStream_);
     } else if (name == "SIZE") {
-        handle_size(params, clientStream_);
+        handle_size(session, params, clientStream_);
+    } else if (name == "MDTM") {
+        handle_mdtm(session, params, clientStream_);
     } else if (name == "EPSV") {
         handle_epsv(clientStream_);
+    } else if (name == "MODE") {
+        handle_mode(params, clientStream_);
+    } else if (name == "REST") {
+        handle_rest(params, clientStream_);
     }
 }
 
 void FileCommand::handle_pasv(Session& session, ACE_SOCK_Stream& clientStream_)
 {
+    // 传输进行中时数据连接仍在使用，不能另开监听端口
+    if (transfer_.active()) {
+        std::string response = "425 Data connection already in use.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+    // 关闭上一次的监听端口和（块模式下保持着的）数据连接
+    clear_passive_mode();
+
     constexpr int kmax_retries_size = 5; // 最大重试次数
     std::random_device dev;
     std::mt19937 gen(dev());
@@ -176,6 +923,7 @@ void FileCommand::handle_type(
 void FileCommand::handle_stor(
         Session& session,
         const std::string& params,
+        off_t restart,
         ACE_SOCK_Stream& clientStream_,
         ThreadPool& threadPool)
 {
@@ -184,231 +932,2622 @@ void FileCommand::handle_stor(
         clientStream_.send(response.c_str(), response.size());
         return;
     }
+    if (transfer_.active()) {
+        std::string response = "425 Data connection already in use.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
 
-    // 使用线程池处理文件存储任务
-    threadPool.enqueue([this, &session, params, &clientStream_] {
-        // 等待客户端连接到被动模式的数据端口
-        if (dataAcceptor_.accept(dataStream_) == -1) {
-            std::string response = "425 Could not open data connection.\r\n";
-            clientStream_.send(response.c_str(), response.size());
-            return;
-        }
+    // 在会话的 Reactor 上以协程方式执行传输：等待数据连接和网络数据时挂起，
+    // 磁盘写入卸载到线程池（或提交到 io_uring），整个过程不独占任何线程
+    // io_uring 按路径打开文件，只用于本地文件系统；去重上传在线程池中分块。
+    // 块模式与续传只由线程池路径处理
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    if (restart > 0 && path.native() && DedupStore::instance().enabled()) {
+        std::string response = "554 Restart not supported for deduplicated files.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+    IoUring* uring = session.get_io_uring();
+    Task<void> transfer;
+    if (uring != nullptr && uring->is_open() && path.native() &&
+        !DedupStore::instance().enabled() && !blockMode_ && restart == 0) {
+        transfer = stor_transfer_uring(
+                session, path, clientStream_, threadPool);
+    } else {
+        transfer = stor_transfer(
+                session, path, restart, clientStream_, threadPool);
+    }
+    start_transfer(session, std::move(transfer));
+}
+
+Task<void> FileCommand::stor_transfer(
+        Session& session,
+        ResolvedPath path,
+        off_t restart,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
 
-        // 发送 150 响应，通知客户端数据连接已准备好
-        std::string response150 = "150 Opening data connection.\r\n";
-        clientStream_.send(response150.c_str(), response150.size());
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, true);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
 
-        std::string fileName = params;
+    // 发送 150 响应，通知客户端数据连接已准备好
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
 
-        // 接收数据并将其存储到临时缓冲区
-        const size_t bufferSize = 65536; // 64KB buffer
-        char buffer[bufferSize];
-        ssize_t bytesReceived = 0;
-        size_t totalBytesReceived = 0;
+    std::shared_ptr<FileTransferState> state =
+            std::make_shared<FileTransferState>();
+    if (!state->allocate()) {
+        std::string response = "451 Insufficient memory for transfer.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        release_data();
+        co_return;
+    }
 
-        std::vector<char> fileData;
+    // 续传只收到文件的后一部分，不计算摘要
+    std::optional<HashAlgorithm> algorithm;
+    if (restart == 0) {
+        algorithm = HashCache::instance().upload_algorithm();
+    }
+    if (algorithm) {
+        state->hasher = std::make_unique<Hasher>(*algorithm);
+    }
 
-        // 循环接收数据，直到客户端关闭连接
-        while ((bytesReceived = dataStream_.recv(buffer, bufferSize)) > 0) {
-            totalBytesReceived += bytesReceived;
-            fileData.insert(fileData.end(), buffer, buffer + bytesReceived);
-        }
+    // 原子上传写入同一目录中的临时文件，226 之前改名为目标文件；
+    // 续传需要已上传的部分，直接写入目标文件
+    UploadCommitter& committer = UploadCommitter::instance();
+    bool atomic = committer.atomic() && restart == 0;
+    ResolvedPath written = atomic ? UploadCommitter::temporary_path(path) : path;
 
-        // 如果数据量小于 SMALL_FILE_THRESHOLD，则直接写入文件
-        if (totalBytesReceived <= SMALL_FILE_THRESHOLD) {
-            // 打开文件以进行写入
-            std::ofstream outputFile(fileName, std::ios::binary);
-            if (!outputFile.is_open()) {
-                std::string response = "550 Failed to open file for writing.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                return;
-            }
+    // 去重上传：数据切分保存到分块存储，需要持久化时分块也落盘
+    if (DedupStore::instance().enabled() && path.native()) {
+        state->dedup = std::make_unique<DedupWriter>(
+                committer.durability() != UploadDurability::NONE);
+    }
 
-            // 直接将数据写入文件
-            outputFile.write(fileData.data(), totalBytesReceived);
-            if (outputFile.fail()) {
-                std::string response = "550 Failed to write to file.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                outputFile.close();
-                return;
+    // 双缓冲：接收下一块数据的同时，线程池写入上一块
+    std::string response = "226 Transfer complete.\r\n";
+    bool complete = false;
+    std::optional<Offload<bool> > writing;
+    off_t offset = restart;
+    int current = 0;
+    while (true) {
+        // 尽量填满一个缓冲区再写盘，减少小块写入
+        size_t filled = 0;
+        ssize_t bytesReceived = 0;
+        while (filled < CHUNK_SIZE) {
+            Task<ssize_t> receiving = recv_data(
+                    reactor, state->buffers[current] + filled,
+                    CHUNK_SIZE - filled);
+            bytesReceived = co_await std::move(receiving);
+            if (bytesReceived <= 0) {
+                break;
             }
+            filled += bytesReceived;
+        }
+        if (bytesReceived == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
 
-            outputFile.close();
-        } else {
-            // 如果是大文件，则使用 mmap 方式进行写入
-            int fd = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
-            if (fd == -1) {
-                std::string response = "550 Failed to open file for writing.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                return;
+        // 收到第一块数据（或空上传结束）后才在线程池中打开（截断）目标文件，
+        // 与原先先收完数据再写文件的行为一致。打开是本次传输的准入点，
+        // 之后的写入等任务以 ADMITTED 提交，高峰期不会在中途被拒绝
+        if (state->fd == -1) {
+            auto opening = offload(
+                    reactor, threadPool, [state, written, atomic, restart] {
+                        int flags = atomic ? O_EXCL : restart > 0 ? 0 : O_TRUNC;
+                        int fd = written.open(O_WRONLY | O_CREAT | flags, 0644);
+                        if (fd < 0) {
+                            return fd;
+                        }
+                        state->fd = fd;
+                        if (atomic) {
+                            state->temporary.path = written;
+                        }
+                        // 续传：丢弃重启位置之后的内容，从重启位置继续写入
+                        if (restart > 0) {
+                            struct stat fileStat;
+                            if (fstat(fd, &fileStat) == -1) {
+                                return -errno;
+                            }
+                            if (fileStat.st_size < restart) {
+                                return -ESPIPE;
+                            }
+                            if (ftruncate(fd, restart) == -1) {
+                                return -errno;
+                            }
+                        }
+                        return 0;
+                    });
+            std::optional<int> opened = co_await opening;
+            if (!opened) {
+                reject_transfer(threadPool, clientStream_);
+                co_return;
             }
-
-            // 将文件扩展到总接收数据大小
-            if (ftruncate(fd, totalBytesReceived) == -1) {
-                std::string response = "550 Failed to resize file.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                close(fd);
-                return;
+            if (*opened != 0) {
+                response = *opened == -ESPIPE
+                                   ? "554 Restart position beyond end of file.\r\n"
+                                   : "550 Failed to open file for writing.\r\n";
+                break;
             }
+        }
 
-            // 使用 mmap 将文件映射到内存
-            void* fileMappedData = mmap(NULL, totalBytesReceived, PROT_WRITE, MAP_SHARED, fd, 0);
-            if (fileMappedData == MAP_FAILED) {
-                std::string response = "550 Failed to mmap file.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                close(fd);
-                return;
+        // 等待上一块写入完成，才能复用其缓冲区
+        if (writing) {
+            std::optional<bool> written = co_await *writing;
+            writing.reset();
+            if (!written || !*written) {
+                response = "451 Failed to write to file.\r\n";
+                break;
+            }
+            acknowledge_markers(restart, offset, clientStream_);
+        }
+        if (filled == 0) {
+            // 客户端关闭数据连接，接收完毕。大小为整块倍数的上传在写最后一块时
+            // 还不知道已到末尾，在这里启动剩余区间的回写
+            CacheRange rest = state->cache.finish_write(offset);
+            if (!rest.empty()) {
+                auto finishing = offload(reactor, threadPool, [state, rest] {
+                    CacheWindow::apply_finish(state->fd, rest);
+                    return true;
+                }, ThreadPool::ADMITTED);
+                std::optional<bool> finished = co_await finishing;
+                (void)finished;
             }
+            complete = true;
+            break;
+        }
 
-            // 将数据拷贝到 mmap 映射的内存中
-            memcpy(fileMappedData, fileData.data(), totalBytesReceived);
+        char* chunk = state->buffers[current];
+        bool last = bytesReceived == 0;
+        writing.emplace(
+                reactor, threadPool,
+                [state, chunk, filled, offset, last] {
+                    return write_chunk(*state, chunk, filled, offset, last);
+                },
+                ThreadPool::ADMITTED);
+        writing->start();
+        offset += filled;
+        current = 1 - current;
 
-            // 解除 mmap 映射
-            munmap(fileMappedData, totalBytesReceived);
+        if (bytesReceived == 0) {
+            // 已读到 EOF：等待最后一块写完
+            std::optional<bool> written = co_await *writing;
+            writing.reset();
+            if (!written || !*written) {
+                response = "451 Failed to write to file.\r\n";
+            } else {
+                acknowledge_markers(restart, offset, clientStream_);
+                complete = true;
+            }
+            break;
+        }
+    }
 
-            // 关闭文件
-            close(fd);
+    // 保存剩余的分块并写入清单
+    if (complete && state->dedup) {
+        auto storing = offload(reactor, threadPool, [state] {
+            return state->dedup->finish(state->fd);
+        }, ThreadPool::ADMITTED);
+        std::optional<int> stored = co_await storing;
+        if (!stored) {
+            response = "451 Server busy, upload not stored.\r\n";
+        } else if (*stored != 0) {
+            response = "451 Failed to store file: " +
+                       std::string(strerror(-*stored)) + "\r\n";
         }
+        complete = stored && *stored == 0;
+    }
 
-        // 发送传输完成的响应
-        std::string response = "226 Transfer complete.\r\n";
-        clientStream_.send(response.c_str(), response.size());
+    // 落盘并（原子上传时）改名，失败时临时文件随状态一起删除
+    if (complete && committer.enabled()) {
+        auto committing = offload(reactor, threadPool, [state, written, path] {
+            return UploadCommitter::instance().commit(state->fd, written, path);
+        }, ThreadPool::ADMITTED);
+        std::optional<int> committed = co_await committing;
+        if (!committed) {
+            response = "451 Server busy, upload not committed.\r\n";
+        } else if (*committed != 0) {
+            response = "451 Failed to commit file: " +
+                       std::string(strerror(-*committed)) + "\r\n";
+        } else {
+            state->temporary.path.reset();
+        }
+        complete = committed && *committed == 0;
+    }
 
-        // 清理被动模式资源
-        clear_passive_mode();
-    });
-}
+    // 文件已被写入（即使传输失败），回复前使元数据缓存失效
+    if (state->fd != -1) {
+        MetadataCache::instance().invalidate(path);
+    }
 
+    // 在 226 回复中附上摘要，并在回复前插入校验缓存
+    if (complete && state->hasher) {
+        std::string digest = state->hasher->finish();
+        auto seeding = offload(
+                reactor, threadPool,
+                [state, path, offset, algorithm, digest] {
+                    seed_upload_digest(
+                            state->fd, path, offset, *algorithm, digest);
+                    return true;
+                },
+                ThreadPool::ADMITTED);
+        std::optional<bool> seeded = co_await seeding;
+        (void)seeded;
+        response = upload_digest_response(*algorithm, digest);
+    }
 
-//处理RETR
-void FileCommand::handle_retr(
+    // 发送传输结果并释放数据连接
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
+
+Task<void> FileCommand::stor_transfer_uring(
         Session& session,
-        const std::string& params,
+        ResolvedPath path,
         ACE_SOCK_Stream& clientStream_,
         ThreadPool& threadPool)
 {
-    if (!passive_mode_) {
-        std::string response = "425 Use PASV first.\r\n";
+    IoUring* uring = session.get_io_uring();
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 每个传输占用两个注册缓冲区和一个固定文件槽位，不足时回退到线程池路径
+    std::shared_ptr<IoUring::Buffer> buffers[2] = {
+            uring->acquire_buffer(), uring->acquire_buffer()};
+    UringFileSlot file(uring, uring->acquire_file_slot());
+    if (!buffers[0] || !buffers[1] || file.slot == -1) {
+        Task<void> fallback =
+                stor_transfer(session, path, 0, clientStream_, threadPool);
+        co_await std::move(fallback);
+        co_return;
+    }
+
+    // 等待客户端连接到被动模式的数据端口（io_uring 路径只用于流模式）
+    Task<int> accepting = open_data(reactor, true);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
         clientStream_.send(response.c_str(), response.size());
-        return;
+        clear_passive_mode();
+        co_return;
     }
+    // io_uring 的 RECV 需要阻塞套接字，由内核在数据到达时完成
+    dataStream_.disable(ACE_NONBLOCK);
 
-    // 使用线程池处理文件检索任务
-    threadPool.enqueue([this, &session, params, &clientStream_] {
-        // 等待客户端连接到被动模式的数据端口
-        if (dataAcceptor_.accept(dataStream_) == -1) {
-            std::string response = "425 Could not open data connection.\r\n";
-            clientStream_.send(response.c_str(), response.size());
-            return;
-        }
+    // 发送 150 响应，通知客户端数据连接已准备好
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
 
-        std::string fileName = params;
-        if (!file_exists(fileName)) {
-            std::string response = "550 File not found.\r\n";
-            clientStream_.send(response.c_str(), response.size());
-            return;
+    std::optional<HashAlgorithm> algorithm =
+            HashCache::instance().upload_algorithm();
+    std::shared_ptr<Hasher> hasher;
+    if (algorithm) {
+        hasher = std::make_shared<Hasher>(*algorithm);
+    }
+
+    // 原子上传写入同一目录中的临时文件，226 之前改名为目标文件
+    UploadCommitter& committer = UploadCommitter::instance();
+    bool atomic = committer.atomic();
+    ResolvedPath written = atomic ? UploadCommitter::temporary_path(path) : path;
+    UploadTemporary temporary;
+
+    // 双缓冲：一个缓冲区写盘的同时另一个接收数据，两个操作一次提交。
+    // 摘要在线程池中按块顺序计算，不占用 Reactor 线程
+    std::string response = "226 Transfer complete.\r\n";
+    bool complete = false;
+    ACE_HANDLE data = dataStream_.get_handle();
+    size_t chunk = uring->buffer_size();
+    UringOp receiving = uring->recv(data, buffers[0], chunk);
+    UringOp writing;
+    int writingSize = 0;
+    std::optional<Offload<bool> > hashing;
+    UringCacheWindow cache(uring, file.slot);
+    bool opened = false;
+    off_t offset = 0;
+    int current = 0;
+    while (true) {
+        int received = co_await receiving;
+
+        // 等待上一块写入完成，才能复用其缓冲区接收
+        if (writing.valid()) {
+            int written = co_await writing;
+            writing = UringOp();
+            if (written != writingSize) {
+                response = "451 Failed to write to file.\r\n";
+                break;
+            }
+
+            // 大文件按窗口启动回写并丢弃已落盘的页
+            CacheWindow::WriteBehind behind =
+                    cache.window.advance_write(offset);
+            if (!behind.start.empty()) {
+                Task<void> settling = cache.settle();
+                co_await std::move(settling);
+                cache.write_behind(behind);
+            }
+        }
+        // 上一块的摘要计算完成后才能复用其缓冲区，也保证各块按顺序计算
+        if (hashing) {
+            std::optional<bool> hashed = co_await *hashing;
+            hashing.reset();
+            if (!hashed) {
+                response = "451 Server busy, upload not hashed.\r\n";
+                break;
+            }
+        }
+        if (received < 0) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+
+        // 第一块数据到达（或空上传结束）后才打开（截断）目标文件，
+        // OPENAT2 与第一块的写入链接，在内核中顺序执行
+        UringOp opening;
+        if (!opened) {
+            opening = uring->openat(
+                    file.slot, written,
+                    O_WRONLY | O_CREAT | (atomic ? O_EXCL : O_TRUNC), 0644,
+                    received > 0);
+        }
+        if (received > 0) {
+            writing = uring->write_fixed(
+                    file.slot, buffers[current], received, offset);
+            writingSize = received;
+            receiving = uring->recv(data, buffers[1 - current], chunk);
+            // 内核写盘和接收的同时在线程池中计算这一块的摘要
+            if (hasher) {
+                std::shared_ptr<IoUring::Buffer> buffer = buffers[current];
+                hashing.emplace(
+                        reactor, threadPool,
+                        [hasher, buffer, received] {
+                            hasher->update(buffer->data, received);
+                            return true;
+                        },
+                        ThreadPool::ADMITTED);
+                hashing->start();
+            }
+        }
+        if (!opened) {
+            int openResult = co_await opening;
+            if (openResult < 0) {
+                response = "550 Failed to open file for writing.\r\n";
+                break;
+            }
+            opened = true;
+            if (atomic) {
+                temporary.path = written;
+            }
+        }
+        if (received == 0) {
+            // 客户端关闭数据连接，接收完毕，启动剩余区间的回写
+            CacheRange rest = cache.window.finish_write(offset);
+            if (!rest.empty()) {
+                cache.finish(rest);
+            }
+            complete = true;
+            break;
+        }
+        offset += received;
+        current = 1 - current;
+    }
+    Task<void> settling = cache.settle();
+    co_await std::move(settling);
+
+    // 落盘并（原子上传时）改名，固定文件没有普通 fd，按路径打开
+    if (complete && committer.enabled()) {
+        auto committing = offload(reactor, threadPool, [written, path] {
+            return UploadCommitter::instance().commit(-1, written, path);
+        }, ThreadPool::ADMITTED);
+        std::optional<int> committed = co_await committing;
+        if (!committed) {
+            response = "451 Server busy, upload not committed.\r\n";
+        } else if (*committed != 0) {
+            response = "451 Failed to commit file: " +
+                       std::string(strerror(-*committed)) + "\r\n";
+        } else {
+            temporary.path.reset();
+        }
+        complete = committed && *committed == 0;
+    }
+
+    // 文件已被写入（即使传输失败），回复前使元数据缓存失效
+    if (opened) {
+        MetadataCache::instance().invalidate(path);
+    }
+
+    // 在 226 回复中附上摘要，并在回复前插入校验缓存
+    if (complete && hasher) {
+        std::string digest = hasher->finish();
+        auto seeding = offload(
+                reactor, threadPool,
+                [path, offset, algorithm, digest] {
+                    seed_upload_digest(-1, path, offset, *algorithm, digest);
+                    return true;
+                },
+                ThreadPool::ADMITTED);
+        std::optional<bool> seeded = co_await seeding;
+        (void)seeded;
+        response = upload_digest_response(*algorithm, digest);
+    }
+
+    // 发送传输结果
+    clientStream_.send(response.c_str(), response.size());
+
+    // 清理被动模式资源
+    clear_passive_mode();
+}
+
+//处理RETR
+void FileCommand::handle_retr(
+        Session& session,
+        const std::string& params,
+        off_t restart,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    if (!passive_mode_) {
+        std::string response = "425 Use PASV first.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+    if (transfer_.active()) {
+        std::string response = "425 Data connection already in use.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+
+    // 在会话的 Reactor 上以协程方式执行传输：磁盘读取卸载到线程池（或提交到
+    // io_uring），发送缓冲区满时挂起，整个过程不独占任何线程。
+    // STATX 不能限制符号链接，限制了根目录的会话只使用线程池路径；
+    // 去重文件需要按清单读取分块，块模式与续传同样只使用线程池路径
+    PathResolver& resolver = session.get_path_resolver();
+    ResolvedPath path = resolver.resolve(params);
+    IoUring* uring = session.get_io_uring();
+    Task<void> transfer;
+    if (uring != nullptr && uring->is_open() && path.native() &&
+        !resolver.confined() && !DedupStore::instance().enabled() &&
+        !blockMode_ && restart == 0) {
+        transfer = retr_transfer_uring(
+                session, path, clientStream_, threadPool);
+    } else {
+        transfer = retr_transfer(
+                session, path, restart, clientStream_, threadPool);
+    }
+    start_transfer(session, std::move(transfer));
+}
+
+Task<void> FileCommand::retr_transfer(
+        Session& session,
+        ResolvedPath path,
+        off_t restart,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, false);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+
+    // 在线程池中一次完成查找缓存或打开、获取大小：缓存命中时只需一次 stat，
+    // 小文件整体读入内存（可缓存时放入缓存），都只需一次线程切换。
+    // 打开是本次传输的准入点，之后的预读以 ADMITTED 提交
+    std::shared_ptr<FileTransferState> state =
+            std::make_shared<FileTransferState>();
+    auto opening = offload(reactor, threadPool, [state, path] {
+        FileCache& fileCache = FileCache::instance();
+        struct statx stx;
+        if (fileCache.enabled() && path.stat(stx) == 0 &&
+            S_ISREG(stx.stx_mode)) {
+            state->content = fileCache.lookup(FileIdentity::from_statx(stx));
+            if (state->content) {
+                state->size = state->content->size();
+                return std::string();
+            }
+        }
+
+        int fd = path.open(O_RDONLY);
+        if (fd < 0) {
+            return std::string(
+                    fd == -ENOENT ? "550 File not found.\r\n"
+                                  : "550 Failed to open file.\r\n");
+        }
+        state->fd = fd;
+        struct stat fileStat;
+        if (fstat(state->fd, &fileStat) == -1) {
+            return std::string("550 Failed to get file size.\r\n");
+        }
+        state->size = fileStat.st_size;
+        if (DedupStore::instance().enabled()) {
+            auto manifest = std::make_unique<ManifestReader>();
+            int rc = manifest->open(state->fd);
+            if (rc < 0) {
+                return std::string("451 Failed to read file.\r\n");
+            }
+            if (rc == 1) {
+                state->manifest = std::move(manifest);
+            }
+        }
+        if (state->size <= CHUNK_SIZE || fileCache.cacheable(state->size)) {
+            return read_small_file(*state, fileStat);
+        }
+
+        // 大文件按页缓存策略打开，之后由传输循环分块读取；
+        // 去重文件从分块读取，文件本身只有清单
+        if (!state->manifest) {
+            state->cache.engage(state->size);
+            state->cache.apply_open(state->fd);
+        }
+        return std::string();
+    });
+    std::optional<std::string> opened = co_await opening;
+    if (!opened) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
+    }
+    if (opened->empty() && static_cast<size_t>(restart) > state->size) {
+        *opened = "554 Restart position beyond end of file.\r\n";
+    }
+    if (!opened->empty()) {
+        clientStream_.send(opened->c_str(), opened->size());
+        release_data();
+        co_return;
+    }
+
+    // 大文件从 Reactor 线程的空闲表取得双缓冲（位于本地 NUMA 节点）
+    if (!state->content && !state->allocate()) {
+        std::string response = "451 Insufficient memory for transfer.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        release_data();
+        co_return;
+    }
+
+    // 发送 150 响应，通知客户端即将开始文件传输
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    std::string response = "226 Transfer complete.\r\n";
+    if (state->content) {
+        // 小文件或缓存命中：直接从内存发送
+        Task<ssize_t> sending = send_data(
+                reactor, state->content->data() + restart,
+                state->content->size() - restart);
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+        }
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+
+    // 双缓冲：发送当前块的同时，线程池预读下一块
+    std::optional<Offload<ssize_t> > reading;
+    reading.emplace(reactor, threadPool, [state, restart] {
+        return read_chunk(*state, state->buffers[0], CHUNK_SIZE, restart);
+    }, ThreadPool::ADMITTED);
+    reading->start();
+    ssize_t bytesRead = 0;
+    off_t offset = restart;
+    off_t mark = restart + RESTART_MARK_INTERVAL;
+    int current = 0;
+    while (static_cast<size_t>(offset) < state->size) {
+        if (reading) {
+            std::optional<ssize_t> result = co_await *reading;
+            reading.reset();
+            if (!result) {
+                response = "451 Transfer aborted: server busy.\r\n";
+                break;
+            }
+            bytesRead = *result;
+        }
+        if (bytesRead <= 0) {
+            response = "451 Failed to read file.\r\n";
+            break;
+        }
+
+        // 预读下一块
+        off_t nextOffset = offset + bytesRead;
+        if (static_cast<size_t>(nextOffset) < state->size) {
+            char* next = state->buffers[1 - current];
+            reading.emplace(reactor, threadPool, [state, next, nextOffset] {
+                return read_chunk(*state, next, CHUNK_SIZE, nextOffset);
+            }, ThreadPool::ADMITTED);
+            reading->start();
+        }
+
+        // 从内存中发送当前块
+        Task<ssize_t> sending =
+                send_data(reactor, state->buffers[current], bytesRead);
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+
+        // 块模式下定期插入重启标记，标记之前的数据都已交给对方
+        if (blockMode_ && nextOffset >= mark &&
+            static_cast<size_t>(nextOffset) < state->size) {
+            Task<bool> marking = send_restart_marker(reactor, nextOffset);
+            bool marked = co_await std::move(marking);
+            if (!marked) {
+                response = "426 Transfer aborted: Connection closed.\r\n";
+                break;
+            }
+            mark = nextOffset + RESTART_MARK_INTERVAL;
+        }
+
+        offset = nextOffset;
+        current = 1 - current;
+    }
+
+    // 发送传输结果并释放数据连接
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
+
+Task<void> FileCommand::retr_transfer_uring(
+        Session& session,
+        ResolvedPath path,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    IoUring* uring = session.get_io_uring();
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 每个传输占用两个注册缓冲区和一个固定文件槽位，不足时回退到线程池路径
+    std::shared_ptr<IoUring::Buffer> buffers[2] = {
+            uring->acquire_buffer(), uring->acquire_buffer()};
+    UringFileSlot file(uring, uring->acquire_file_slot());
+    if (!buffers[0] || !buffers[1] || file.slot == -1) {
+        Task<void> fallback =
+                retr_transfer(session, path, 0, clientStream_, threadPool);
+        co_await std::move(fallback);
+        co_return;
+    }
+
+    // 等待客户端连接到被动模式的数据端口（io_uring 路径只用于流模式）
+    Task<int> accepting = open_data(reactor, false);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+    // io_uring 的 SEND 需要阻塞套接字，由内核在发送缓冲区可用时完成
+    dataStream_.disable(ACE_NONBLOCK);
+
+    // 开启小文件缓存时先等待 STATX 查找缓存，命中则不再打开文件直接从内存发送
+    size_t chunk = uring->buffer_size();
+    FileCache& fileCache = FileCache::instance();
+    UringOp stating = uring->statx(path);
+    if (fileCache.enabled()) {
+        int statResult = co_await stating;
+        std::shared_ptr<const std::string> cached;
+        if (statResult == 0 && S_ISREG(stating.statx_result().stx_mode)) {
+            cached = fileCache.lookup(
+                    FileIdentity::from_statx(stating.statx_result()));
+        }
+        if (cached) {
+            std::string response150 = "150 Opening data connection.\r\n";
+            clientStream_.send(response150.c_str(), response150.size());
+
+            // 缓存内容包装为发送缓冲区，发送完成前保持存活
+            std::shared_ptr<IoUring::Buffer> memory(
+                    new IoUring::Buffer{
+                            const_cast<char*>(cached->data()), cached->size(),
+                            -1},
+                    [cached](IoUring::Buffer* buffer) { delete buffer; });
+            UringOp sending = uring->send(
+                    dataStream_.get_handle(), memory, cached->size());
+            int sent = co_await sending;
+            std::string response =
+                    sent == static_cast<int>(cached->size())
+                            ? "226 Transfer complete.\r\n"
+                            : "426 Transfer aborted: Connection closed.\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            clear_passive_mode();
+            co_return;
+        }
+    }
+
+    // 一次提交：打开到固定槽位并链接读取第一块（未开启缓存时与 STATX 同批提交）
+    UringOp opening = uring->openat(file.slot, path, O_RDONLY, 0, true);
+    UringOp reading = uring->read_fixed(file.slot, buffers[0], chunk, 0);
+    int openResult = co_await opening;
+    int readResult = co_await reading;
+    int statResult = co_await stating;
+    std::string error;
+    if (openResult == -ENOENT) {
+        error = "550 File not found.\r\n";
+    } else if (openResult < 0) {
+        error = "550 Failed to open file.\r\n";
+    } else if (statResult < 0) {
+        error = "550 Failed to get file size.\r\n";
+    }
+    if (!error.empty()) {
+        clientStream_.send(error.c_str(), error.size());
+        clear_passive_mode();
+        co_return;
+    }
+    size_t size = stating.statx_result().stx_size;
+
+    // 第一块即为完整内容的小文件放入缓存
+    if (size <= chunk && readResult == static_cast<int>(size) &&
+        fileCache.cacheable(size)) {
+        fileCache.insert(
+                FileIdentity::from_statx(stating.statx_result()),
+                std::make_shared<const std::string>(buffers[0]->data, size));
+    }
+
+    // 大文件声明顺序访问，传输中按窗口丢弃已发送的页
+    UringCacheWindow cache(uring, file.slot);
+    if (cache.window.engage(size)) {
+        cache.advise_sequential();
+    }
+
+    // 发送 150 响应，通知客户端即将开始文件传输
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    // 第二块的读取与第一块的发送并行；之后每块发送完成后由内核链接回填
+    // 同一缓冲区（隔一块），发送始终按顺序串行
+    std::string response = "226 Transfer complete.\r\n";
+    ACE_HANDLE data = dataStream_.get_handle();
+    UringOp prefetch;
+    if (chunk < size) {
+        prefetch = uring->read_fixed(file.slot, buffers[1], chunk, chunk);
+    }
+    off_t offset = 0;
+    int current = 0;
+    while (static_cast<size_t>(offset) < size) {
+        int expected = static_cast<int>(std::min(chunk, size - offset));
+        if (readResult < expected) {
+            response = "451 Failed to read file.\r\n";
+            break;
+        }
+
+        off_t refillOffset = offset + 2 * static_cast<off_t>(chunk);
+        bool refill = static_cast<size_t>(refillOffset) < size;
+        UringOp sending = uring->send(data, buffers[current], expected, refill);
+        UringOp refilling;
+        if (refill) {
+            refilling = uring->read_fixed(
+                    file.slot, buffers[current], chunk, refillOffset);
+        }
+        int sent = co_await sending;
+        if (sent != expected) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+
+        offset += expected;
+        CacheRange sentRange = cache.window.advance_read(offset);
+        if (!sentRange.empty()) {
+            Task<void> settling = cache.settle();
+            co_await std::move(settling);
+            cache.drop(sentRange);
+        }
+        if (static_cast<size_t>(offset) < size) {
+            readResult = co_await prefetch;
+        }
+        prefetch = std::move(refilling);
+        current = 1 - current;
+    }
+    Task<void> settling = cache.settle();
+    co_await std::move(settling);
+
+    // 发送传输结果
+    clientStream_.send(response.c_str(), response.size());
+
+    // 关闭数据连接
+    clear_passive_mode();
+}
+
+// 处理 LIST/MLSD 命令
+void FileCommand::handle_list(
+        Session& session,
+        const std::string& name,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    // LIST 的 ls 风格选项（如 -la）只识别 -a 和 -R，其余忽略
+    ListingRequest request;
+    request.format = name == "MLSD" ? ListFormat::MLSD : ListFormat::LIST;
+    std::string path = params;
+    while (request.format == ListFormat::LIST && !path.empty() &&
+           path[0] == '-') {
+        size_t end = path.find(' ');
+        std::string options = path.substr(0, end);
+        request.hidden = request.hidden ||
+                         options.find('a') != std::string::npos;
+        request.recursive = request.recursive ||
+                            options.find('R') != std::string::npos;
+        size_t next = path.find_first_not_of(' ', end);
+        path = next == std::string::npos ? std::string() : path.substr(next);
+    }
+    request.path = session.get_path_resolver().resolve(path);
+    start_listing(session, request, clientStream_, threadPool);
+}
+
+// 处理 SITE 命令
+void FileCommand::handle_site(
+        Session& session,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool,
+        ThreadPool& transferPool)
+{
+    std::istringstream args(params);
+    std::string sub;
+    args >> sub;
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+
+    if (sub == "TREE") {
+        // SITE TREE <depth> [path]
+        ListingRequest request;
+        request.format = ListFormat::MLSD;
+        request.recursive = true;
+        if (!(args >> request.depth) || request.depth < 0) {
+            std::string response = "501 Usage: SITE TREE <depth> [path]\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        std::string path;
+        std::getline(args >> std::ws, path);
+        request.path = session.get_path_resolver().resolve(path);
+        start_listing(session, request, clientStream_, threadPool);
+        return;
+    }
+    if (sub == "LIST" || sub == "MLSD") {
+        // SITE LIST|MLSD <cursor> <count> [path]
+        ListingRequest request;
+        request.format = sub == "MLSD" ? ListFormat::MLSD : ListFormat::LIST;
+        request.paged = true;
+        long long cursor = -1;
+        long long count = 0;
+        if (!(args >> cursor >> count) || cursor < 0 || count <= 0) {
+            std::string response =
+                    "501 Usage: SITE " + sub + " <cursor> <count> [path]\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        std::string path;
+        std::getline(args >> std::ws, path);
+        request.cursor = static_cast<off_t>(cursor);
+        request.count = static_cast<size_t>(count);
+        request.path = session.get_path_resolver().resolve(path);
+        start_listing(session, request, clientStream_, threadPool);
+        return;
+    }
+
+    if (sub == "CHANGES") {
+        // SITE CHANGES <time> [-R] [path]
+        ChangeQuery query;
+        std::string stamp;
+        if (!(args >> stamp) || !parse_timestamp(stamp, query.since)) {
+            std::string response =
+                    "501 Usage: SITE CHANGES <YYYYMMDDHHMMSS[.sss]> [-R] [path]\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        std::string path;
+        std::getline(args >> std::ws, path);
+        query.recursive = take_recursive_option(path);
+        query.dir = session.get_path_resolver().resolve(path);
+        start_changes(session, query, clientStream_, threadPool);
+        return;
+    }
+
+    if (sub == "WATCH") {
+        // SITE WATCH [-R] [path]
+        std::string path;
+        std::getline(args >> std::ws, path);
+        bool recursive = take_recursive_option(path);
+        ResolvedPath dir = session.get_path_resolver().resolve(path);
+        std::string response;
+        if (watch_ && watch_->active()) {
+            response = "503 Already watching; send SITE UNWATCH first.\r\n";
+        } else if (!ChangeWatcher::instance().enabled() || !dir.native()) {
+            response = "504 SITE WATCH not available.\r\n";
+        }
+        if (!response.empty()) {
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        watch_ = std::make_shared<WatchSink>(
+                session.get_reactor(), clientStream_, dir.path());
+        session.set_notices(watch_);
+        std::shared_ptr<WatchSink> sink = watch_;
+        run_metadata(session, clientStream_, [dir, recursive, sink] {
+            int rc = ChangeWatcher::instance().subscribe(dir, recursive, sink);
+            if (rc == -ENOSPC) {
+                return std::string("450 Too many directories to watch.\r\n");
+            }
+            if (rc == -EEXIST) {
+                return std::string(
+                        "550 Directory is already watched under another path.\r\n");
+            }
+            if (rc != 0) {
+                return "550 Failed to watch directory: " +
+                       std::string(strerror(-rc)) + "\r\n";
+            }
+            return "200 Watching " + dir.path() +
+                   (recursive ? " recursively.\r\n" : ".\r\n");
+        });
+        return;
+    }
+    if (sub == "UNWATCH") {
+        std::string response = "503 Not watching.\r\n";
+        if (watch_ && watch_->active()) {
+            ChangeWatcher::instance().unsubscribe(watch_);
+            watch_->detach();
+            watch_.reset();
+            session.set_notices(nullptr);
+            response = "200 Watch ended.\r\n";
+        }
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+
+    if (sub == "COPY") {
+        // SITE COPY <from> <to>
+        std::string rest;
+        std::getline(args >> std::ws, rest);
+        std::string from;
+        std::string to;
+        if (!take_path_argument(rest, from) || !take_path_argument(rest, to) ||
+            !rest.empty()) {
+            std::string response = "501 Usage: SITE COPY <from> <to>\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        PathResolver& resolver = session.get_path_resolver();
+        ResolvedPath target = resolver.resolve(to);
+        std::shared_ptr<FileCopy> copy =
+                std::make_shared<FileCopy>(resolver.resolve(from), target);
+        session.run_command(copy_command(
+                session.get_reactor(), copy, target.path(), clientStream_,
+                transferPool));
+        return;
+    }
+
+    if (sub == "SIGNATURE") {
+        // SITE SIGNATURE <blocksize> <path>
+        long long blockSize = -1;
+        std::string path;
+        if (!(args >> blockSize) ||
+            (blockSize != 0 &&
+             (blockSize < static_cast<long long>(DeltaSignature::MIN_BLOCK) ||
+              blockSize > static_cast<long long>(DeltaSignature::MAX_BLOCK))) ||
+            !std::getline(args >> std::ws, path) || path.empty()) {
+            std::string response = "501 Usage: SITE SIGNATURE <blocksize|0> <path>\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        if (begin_transfer(clientStream_)) {
+            Task<void> transfer = signature_transfer(
+                    session, session.get_path_resolver().resolve(path),
+                    static_cast<size_t>(blockSize), clientStream_, transferPool);
+            start_transfer(session, std::move(transfer));
+        }
+        return;
+    }
+    if (sub == "PATCH" || sub == "DELTA") {
+        // SITE PATCH <path>、SITE DELTA <path>
+        std::string path;
+        std::getline(args >> std::ws, path);
+        if (path.empty()) {
+            std::string response = "501 Usage: SITE " + sub + " <path>\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        if (begin_transfer(clientStream_)) {
+            ResolvedPath resolved = session.get_path_resolver().resolve(path);
+            Task<void> transfer = sub == "PATCH"
+                    ? patch_transfer(session, resolved, clientStream_, transferPool)
+                    : delta_transfer(session, resolved, clientStream_, transferPool);
+            start_transfer(session, std::move(transfer));
+        }
+        return;
+    }
+
+    if (sub == "TAR") {
+        // SITE TAR [-z] <path|glob> ...
+        std::string rest;
+        std::getline(args >> std::ws, rest);
+        bool compress = take_option(rest, "-z");
+        std::vector<ResolvedPath> sources;
+        std::string path;
+        while (take_path_argument(rest, path)) {
+            sources.push_back(session.get_path_resolver().resolve(path));
+        }
+        if (sources.empty() || !rest.empty()) {
+            std::string response = "501 Usage: SITE TAR [-z] <path|glob> ...\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+        if (begin_transfer(clientStream_)) {
+            Task<void> transfer = archive_transfer(
+                    session, std::move(sources), compress, clientStream_,
+                    transferPool);
+            start_transfer(session, std::move(transfer));
+        }
+        return;
+    }
+
+    if (sub == "UNTAR") {
+        // SITE UNTAR [-z] [dir]
+        std::string rest;
+        std::getline(args >> std::ws, rest);
+        bool compressed = take_option(rest, "-z");
+        if (begin_transfer(clientStream_)) {
+            Task<void> transfer = extract_transfer(
+                    session, session.get_path_resolver().resolve(rest), compressed,
+                    clientStream_, transferPool);
+            start_transfer(session, std::move(transfer));
+        }
+        return;
+    }
+
+    std::string response = "504 SITE " + sub + " not implemented.\r\n";
+    clientStream_.send(response.c_str(), response.size());
+}
+
+void FileCommand::start_transfer(Session& session, Task<void> transfer)
+{
+    session.begin_reply();
+    transfer_ = run_transfer(session, std::move(transfer));
+    transfer_.start();
+}
+
+Task<void> FileCommand::run_transfer(Session& session, Task<void> transfer)
+{
+    co_await std::move(transfer);
+    session.end_reply();
+}
+
+bool FileCommand::begin_transfer(ACE_SOCK_Stream& clientStream_)
+{
+    std::string response;
+    if (!passive_mode_) {
+        response = "425 Use PASV first.\r\n";
+    } else if (transfer_.active()) {
+        response = "425 Data connection already in use.\r\n";
+    }
+    if (!response.empty()) {
+        clientStream_.send(response.c_str(), response.size());
+        return false;
+    }
+    return true;
+}
+
+// 打开文件失败时的回复
+static std::string open_failure_response(int rc)
+{
+    if (rc == -ENOENT || rc == -ENOTDIR) {
+        return "550 File not found.\r\n";
+    }
+    if (rc == -EISDIR) {
+        return "550 Not a regular file.\r\n";
+    }
+    return "550 Failed to open file.\r\n";
+}
+
+Task<void> FileCommand::signature_transfer(
+        Session& session,
+        ResolvedPath path,
+        size_t blockSize,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, false);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+
+    std::shared_ptr<DeltaState> state = std::make_shared<DeltaState>();
+    state->blockSize = blockSize;
+    auto opening = offload(reactor, threadPool, [state, path] {
+        int rc = state->source.open(path);
+        if (rc == 0 && state->blockSize == 0) {
+            state->blockSize = DeltaSignature::default_block_size(state->source.size);
+        }
+        return rc;
+    });
+    std::optional<int> opened = co_await opening;
+    if (!opened) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
+    }
+    if (*opened != 0) {
+        std::string response = open_failure_response(*opened);
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    // 每个线程池任务读取整数个块并计算签名，最后确认文件未被修改
+    typedef std::pair<int, std::string> Batch;
+    auto read_batch = [state] {
+        DeltaSource& source = state->source;
+        Batch batch;
+        if (state->offset == 0) {
+            batch.second = DeltaSignature::header(state->blockSize, source.size);
+        }
+        size_t step = std::max<size_t>(1, DELTA_STEP / state->blockSize) *
+                      state->blockSize;
+        size_t want = static_cast<size_t>(
+                std::min<off_t>(step, source.size - state->offset));
+        state->buffer.resize(step);
+        ssize_t n = source.read_fully(state->buffer.data(), want, state->offset);
+        if (n < 0) {
+            batch.first = static_cast<int>(n);
+            return batch;
+        }
+        DeltaSignature::append_blocks(
+                state->buffer.data(), want, state->blockSize, batch.second);
+        state->offset += want;
+        batch.first = state->offset < source.size ? 1
+                      : source.unchanged()         ? 0
+                                                   : -ESTALE;
+        return batch;
+    };
+
+    // 双缓冲：发送当前批次的同时，线程池计算下一批
+    std::string response;
+    std::optional<Offload<Batch> > reading;
+    reading.emplace(reactor, threadPool, read_batch, ThreadPool::ADMITTED);
+    reading->start();
+    while (true) {
+        std::optional<Batch> batch = co_await *reading;
+        reading.reset();
+        if (!batch) {
+            response = "451 Transfer aborted: server busy.\r\n";
+            break;
+        }
+        if (batch->first < 0) {
+            response = batch->first == -ESTALE
+                               ? "451 File changed while computing signature.\r\n"
+                               : "451 Failed to read file.\r\n";
+            break;
+        }
+        if (batch->first > 0) {
+            reading.emplace(
+                    reactor, threadPool, read_batch, ThreadPool::ADMITTED);
+            reading->start();
+        }
+        Task<ssize_t> sending = send_data(
+                reactor, batch->second.data(), batch->second.size());
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+        if (batch->first == 0) {
+            response = "226 Signature sent; block size " +
+                       std::to_string(state->blockSize) + ".\r\n";
+            break;
+        }
+    }
+
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
+
+Task<void> FileCommand::patch_transfer(
+        Session& session,
+        ResolvedPath path,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, true);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+
+    // 打开基准文件，结果写入同一目录中的临时文件，完成后原子地替换
+    std::shared_ptr<PatchState> state = std::make_shared<PatchState>();
+    auto opening = offload(reactor, threadPool, [state, path] {
+        int rc = state->source.open(path);
+        if (rc != 0) {
+            return rc;
+        }
+        ResolvedPath temporary = UploadCommitter::temporary_path(path);
+        int fd = temporary.open(
+                O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, state->source.mode);
+        if (fd < 0) {
+            return fd;
+        }
+        state->fd = fd;
+        state->temporary.path = temporary;
+        DeltaSource* source = &state->source;
+        state->patcher = std::make_unique<DeltaPatcher>(
+                [source](char* buffer, size_t size, off_t offset) {
+                    return source->read(buffer, size, offset);
+                },
+                source->size, fd);
+        return 0;
+    });
+    std::optional<int> opened = co_await opening;
+    if (!opened) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
+    }
+    if (*opened != 0) {
+        std::string response = open_failure_response(*opened);
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    // 双缓冲：接收下一段增量的同时，线程池应用上一段
+    state->buffers[0].resize(PATCH_CHUNK);
+    state->buffers[1].resize(PATCH_CHUNK);
+    std::optional<Offload<int> > applying;
+    std::optional<int> rc = 0;
+    std::string response;
+    int current = 0;
+    while (true) {
+        Task<ssize_t> receiving = recv_data(
+                reactor, state->buffers[current].data(), PATCH_CHUNK);
+        ssize_t bytesReceived = co_await std::move(receiving);
+        if (applying) {
+            rc = co_await *applying;
+            applying.reset();
+        }
+        if (bytesReceived == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+        if (!rc || *rc != 0 || bytesReceived == 0) {
+            break;
+        }
+        char* chunk = state->buffers[current].data();
+        size_t size = static_cast<size_t>(bytesReceived);
+        applying.emplace(reactor, threadPool, [state, chunk, size] {
+            return state->patcher->feed(chunk, size);
+        }, ThreadPool::ADMITTED);
+        applying->start();
+        current = 1 - current;
+    }
+
+    // 确认结果与增量的结束行一致、基准文件未被修改，再落盘并替换
+    if (response.empty() && rc && *rc == 0) {
+        auto committing = offload(reactor, threadPool, [state, path] {
+            int result = state->patcher->finish();
+            if (result == 0 && !state->source.unchanged()) {
+                result = -ESTALE;
+            }
+            if (result == 0) {
+                result = UploadCommitter::instance().commit(
+                        state->fd, *state->temporary.path, path);
+            }
+            if (result == 0) {
+                state->temporary.path.reset();
+            }
+            return result;
+        }, ThreadPool::ADMITTED);
+        rc = co_await committing;
+        if (rc && *rc == 0) {
+            MetadataCache::instance().invalidate(path);
+        }
+    }
+    if (!response.empty()) {
+        // 数据连接中断，临时文件随状态一起删除
+    } else if (!rc) {
+        response = "451 Server busy, file not patched.\r\n";
+    } else if (*rc == -EBADMSG) {
+        response = "451 Invalid delta; file not patched.\r\n";
+    } else if (*rc == -ESTALE) {
+        response = "451 File changed while patching; file not patched.\r\n";
+    } else if (*rc != 0) {
+        response = "451 Patch failed: " + std::string(strerror(-*rc)) + "\r\n";
+    } else {
+        response = "226 Patched " + std::to_string(state->patcher->size()) +
+                   " bytes (" + std::to_string(state->patcher->reused()) +
+                   " reused).\r\n";
+    }
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
+
+Task<void> FileCommand::delta_transfer(
+        Session& session,
+        ResolvedPath path,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, true);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+
+    std::shared_ptr<DeltaState> state = std::make_shared<DeltaState>();
+    auto opening = offload(reactor, threadPool, [state, path] {
+        return state->source.open(path);
+    });
+    std::optional<int> opened = co_await opening;
+    if (!opened) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
+    }
+    if (*opened != 0) {
+        std::string response = open_failure_response(*opened);
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    // 先接收客户端的签名，直到客户端关闭写方向
+    std::string response;
+    char buffer[CHUNK_SIZE];
+    while (true) {
+        Task<ssize_t> receiving = recv_data(
+                reactor, buffer, sizeof(buffer));
+        ssize_t bytesReceived = co_await std::move(receiving);
+        if (bytesReceived == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+        if (bytesReceived == 0) {
+            break;
+        }
+        state->signatureText.append(buffer, bytesReceived);
+        if (state->signatureText.size() > SIGNATURE_MAX) {
+            response = "552 Signature too large.\r\n";
+            break;
+        }
+    }
+
+    // 每个线程池任务读取一段文件并编码，第一个任务解析签名
+    typedef std::pair<int, std::string> Batch;
+    auto encode_batch = [state] {
+        DeltaSource& source = state->source;
+        Batch batch;
+        if (!state->encoder) {
+            if (state->signature.parse(state->signatureText) != 0) {
+                batch.first = -EINVAL;
+                return batch;
+            }
+            state->signatureText.clear();
+            state->encoder = std::make_unique<DeltaEncoder>(state->signature);
+            state->buffer.resize(DELTA_STEP);
+        }
+        size_t want = static_cast<size_t>(
+                std::min<off_t>(DELTA_STEP, source.size - state->offset));
+        ssize_t n = source.read_fully(state->buffer.data(), want, state->offset);
+        if (n < 0) {
+            batch.first = static_cast<int>(n);
+            return batch;
+        }
+        state->encoder->update(state->buffer.data(), want, batch.second);
+        state->offset += want;
+        if (state->offset < source.size) {
+            batch.first = 1;
+        } else if (!source.unchanged()) {
+            batch.first = -ESTALE;
+        } else {
+            state->encoder->finish(batch.second);
+        }
+        return batch;
+    };
+
+    // 双缓冲：发送当前批次的同时，线程池编码下一批
+    std::optional<Offload<Batch> > encoding;
+    if (response.empty()) {
+        encoding.emplace(
+                reactor, threadPool, encode_batch, ThreadPool::ADMITTED);
+        encoding->start();
+    }
+    while (encoding) {
+        std::optional<Batch> batch = co_await *encoding;
+        encoding.reset();
+        if (!batch) {
+            response = "451 Transfer aborted: server busy.\r\n";
+            break;
+        }
+        if (batch->first == -EINVAL) {
+            response = "501 Invalid signature.\r\n";
+            break;
+        }
+        if (batch->first < 0) {
+            response = batch->first == -ESTALE
+                               ? "451 File changed while computing delta.\r\n"
+                               : "451 Failed to read file.\r\n";
+            break;
+        }
+        if (batch->first > 0) {
+            encoding.emplace(
+                    reactor, threadPool, encode_batch, ThreadPool::ADMITTED);
+            encoding->start();
+        }
+        Task<ssize_t> sending = send_data(
+                reactor, batch->second.data(), batch->second.size());
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+        if (batch->first == 0) {
+            response = "226 Delta sent; " +
+                       std::to_string(state->encoder->matched()) + " of " +
+                       std::to_string(state->source.size) +
+                       " bytes reused.\r\n";
+        }
+    }
+
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
+
+// SITE TAR 的成员名：工作目录之下为相对于工作目录的路径，否则为相对于根目录的路径
+static std::string archive_name(const ResolvedPath& path)
+{
+    const std::string& relative = path.cwd_relative().empty() ? path.root_relative()
+                                                              : path.cwd_relative();
+    return relative == "." ? std::string() : relative;
+}
+
+// 列出目录的条目（不跟随符号链接），按名称排序
+static int list_archive_directory(
+        const ResolvedPath& dir,
+        std::vector<DirectoryEntry>& entries)
+{
+    int rc = dir.read_directory(0, entries);
+    if (rc == -EOPNOTSUPP) {
+        // 本地文件系统
+        int fd = dir.open(O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return fd;
+        }
+        DIR* stream = fdopendir(fd);
+        if (stream == nullptr) {
+            rc = -errno;
+            close(fd);
+            return rc;
+        }
+        rc = 0;
+        while (struct dirent* entry = readdir(stream)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            DirectoryEntry child;
+            child.name = entry->d_name;
+            if (statx(fd, entry->d_name, AT_SYMLINK_NOFOLLOW, STATX_BASIC_STATS,
+                      &child.stx) == 0) {
+                entries.push_back(std::move(child));
+            }
+        }
+        closedir(stream);
+    }
+    if (rc == 0) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const DirectoryEntry& a, const DirectoryEntry& b) {
+                      return a.name < b.name;
+                  });
+    }
+    return rc;
+}
+
+// 把文件或目录（递归其内容）加入归档，符号链接等其他类型跳过
+static int add_archive_path(
+        const ResolvedPath& path,
+        const struct statx& stx,
+        const std::string& name,
+        std::vector<ArchiveEntry>& entries)
+{
+    bool directory = S_ISDIR(stx.stx_mode);
+    if (!directory && !S_ISREG(stx.stx_mode)) {
+        return 0;
+    }
+    if (entries.size() >= ARCHIVE_MEMBERS_MAX) {
+        return -E2BIG;
+    }
+    ArchiveEntry entry;
+    entry.path = path;
+    entry.member.name = name;
+    entry.member.type = directory ? TarMember::DIRECTORY : TarMember::REGULAR;
+    entry.member.mode = stx.stx_mode & 07777;
+    entry.member.uid = stx.stx_uid;
+    entry.member.gid = stx.stx_gid;
+    entry.member.size = directory ? 0 : static_cast<off_t>(stx.stx_size);
+    entry.member.mtime = stx.stx_mtime.tv_sec;
+    if (!directory) {
+        entries.push_back(std::move(entry));
+        return 0;
+    }
+    if (!name.empty()) {
+        entries.push_back(std::move(entry)); // 工作目录本身不作为成员
+    }
+
+    std::vector<DirectoryEntry> children;
+    if (list_archive_directory(path, children) != 0) {
+        return 0; // 无法读取的子目录只包含目录本身
+    }
+    for (const DirectoryEntry& child : children) {
+        int rc = add_archive_path(
+                path.child(child.name), child.stx,
+                name.empty() ? child.name : name + "/" + child.name, entries);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+// 展开 SITE TAR 的参数，最后一个分量含通配符时匹配父目录中的条目
+static int expand_archive(
+        const std::vector<ResolvedPath>& sources,
+        std::vector<ArchiveEntry>& entries)
+{
+    for (const ResolvedPath& source : sources) {
+        std::string pattern = source.name();
+        int rc = 0;
+        if (pattern.find_first_of("*?[") == std::string::npos) {
+            struct statx stx;
+            rc = source.stat(stx);
+            if (rc == 0) {
+                rc = add_archive_path(source, stx, archive_name(source), entries);
+            }
+            if (rc != 0) {
+                return rc;
+            }
+            continue;
+        }
+
+        ResolvedPath dir = source.parent();
+        std::vector<DirectoryEntry> children;
+        rc = list_archive_directory(dir, children);
+        if (rc != 0) {
+            return rc;
+        }
+        std::string prefix = archive_name(dir);
+        for (const DirectoryEntry& child : children) {
+            if (fnmatch(pattern.c_str(), child.name.c_str(), FNM_PERIOD) != 0) {
+                continue;
+            }
+            rc = add_archive_path(
+                    dir.child(child.name), child.stx,
+                    prefix.empty() ? child.name : prefix + "/" + child.name, entries);
+            if (rc != 0) {
+                return rc;
+            }
+        }
+    }
+    return 0;
+}
+
+// 执行 SITE TAR 的一个读取任务：第一段前加头部，最后一段后补齐到块边界。
+// 头部中的大小是展开时的大小，文件之后变短时以零补齐、变长时截断（与 tar 相同）
+static ArchiveBatch read_archive(const ArchiveState& state, const ArchiveJob& job)
+{
+    ArchiveBatch batch;
+    for (size_t i = job.begin; i < job.end; ++i) {
+        const TarMember& member = state.entries[i].member;
+        if (member.type == TarMember::DIRECTORY) {
+            batch.data += TarArchive::header(member);
+            continue;
+        }
+        bool piece = member.size > static_cast<off_t>(ARCHIVE_PIECE);
+        off_t offset = piece ? job.offset : 0;
+        size_t length = piece ? job.length : static_cast<size_t>(member.size);
+
+        DeltaSource source;
+        int rc = source.open(state.entries[i].path);
+        if (rc != 0 && offset == 0) {
+            ++batch.skipped; // 已被删除或替换为目录，头部尚未发送
+            continue;
+        }
+        if (offset == 0) {
+            batch.data += TarArchive::header(member);
+            ++batch.files;
+        }
+        size_t start = batch.data.size();
+        batch.data.resize(start + length);
+        size_t filled = 0;
+        while (rc == 0 && filled < length) {
+            ssize_t n = source.read(&batch.data[start + filled], length - filled,
+                                    offset + filled);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            filled += n;
+        }
+        if (offset + static_cast<off_t>(length) == member.size) {
+            // 每个文件只在最后一段计数
+            if (rc != 0 || filled < length || source.size != member.size) {
+                ++batch.changed;
+            }
+            batch.data.append(TarArchive::padding(member.size), '\0');
+        }
+    }
+    return batch;
+}
+
+Task<void> FileCommand::archive_transfer(
+        Session& session,
+        std::vector<ResolvedPath> sources,
+        bool compress,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, false);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+
+    // 在线程池中展开参数，发送 150 之前确定成员
+    std::shared_ptr<ArchiveState> state = std::make_shared<ArchiveState>();
+    auto expanding = offload(reactor, threadPool, [state, sources] {
+        return expand_archive(sources, state->entries);
+    });
+    std::optional<int> expanded = co_await expanding;
+    if (!expanded) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
+    }
+    std::string response;
+    if (*expanded == -E2BIG) {
+        response = "552 Too many files; at most " +
+                   std::to_string(ARCHIVE_MEMBERS_MAX) + " per archive.\r\n";
+    } else if (*expanded != 0) {
+        response = open_failure_response(*expanded);
+    } else if (state->entries.empty()) {
+        response = "550 No files matched.\r\n";
+    }
+    if (!response.empty()) {
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+    if (compress) {
+        state->gzip = std::make_unique<GzipStream>(ARCHIVE_GZIP_LEVEL);
+    }
+
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    typedef std::unique_ptr<Offload<ArchiveBatch> > ReadPtr;
+    const std::vector<ArchiveEntry>& entries = state->entries;
+    std::deque<std::pair<ArchiveJob, ReadPtr> > running;
+    size_t next = 0;          // 下一个未读取的成员
+    off_t nextOffset = 0;     // 大文件：下一段的偏移
+    size_t prefetched = 0;    // 预读中的数据字节数
+    size_t dropped = entries.size(); // 第一段被跳过的大文件
+    size_t files = 0;
+    size_t skipped = 0;
+    size_t changed = 0;
+    std::string out;
+    bool done = false;
+    while (!done) {
+        // 预读：小文件合并为一个任务，大文件分段；同时运行的任务数与字节数有上限
+        while (next < entries.size() && running.size() < ARCHIVE_PREFETCH &&
+               (running.empty() || prefetched < ARCHIVE_PREFETCH_BYTES)) {
+            ArchiveJob job;
+            job.begin = next;
+            off_t size = entries[next].member.size;
+            if (size > static_cast<off_t>(ARCHIVE_PIECE)) {
+                job.end = next + 1;
+                job.offset = nextOffset;
+                job.length = static_cast<size_t>(
+                        std::min<off_t>(ARCHIVE_PIECE, size - nextOffset));
+                nextOffset += job.length;
+                if (nextOffset == size) {
+                    ++next;
+                    nextOffset = 0;
+                }
+            } else {
+                job.end = next;
+                while (job.end < entries.size() &&
+                       job.end - job.begin < ARCHIVE_BATCH_FILES) {
+                    size_t length = static_cast<size_t>(entries[job.end].member.size);
+                    if (length > ARCHIVE_PIECE ||
+                        (job.end > job.begin && job.length + length > ARCHIVE_PIECE)) {
+                        break;
+                    }
+                    job.length += length;
+                    ++job.end;
+                }
+                next = job.end;
+            }
+            ReadPtr op = std::make_unique<Offload<ArchiveBatch> >(
+                    reactor, threadPool,
+                    [state, job] { return read_archive(*state, job); },
+                    ThreadPool::ADMITTED);
+            op->start();
+            prefetched += job.length;
+            running.emplace_back(job, std::move(op));
+        }
+
+        if (running.empty()) {
+            out += TarArchive::trailer();
+            done = true;
+        } else {
+            // 按提交的顺序等待，成员顺序与线程池的调度无关
+            ArchiveJob job = running.front().first;
+            ReadPtr op = std::move(running.front().second);
+            running.pop_front();
+            std::optional<ArchiveBatch> batch = co_await *op;
+            op.reset();
+            prefetched -= job.length;
+            if (!batch) {
+                response = "451 Transfer aborted: server busy.\r\n";
+                break;
+            }
+            if (job.offset > 0 && job.begin == dropped) {
+                continue;
+            }
+            if (job.offset == 0 && batch->skipped > 0) {
+                dropped = job.begin;
+            }
+            files += batch->files;
+            skipped += batch->skipped;
+            changed += batch->changed;
+            out += batch->data;
+            if (out.size() < ARCHIVE_FLUSH) {
+                continue;
+            }
+        }
+
+        // 压缩必须按顺序进行，在线程池中依次执行，期间预读继续
+        if (state->gzip) {
+            std::shared_ptr<std::string> plain =
+                    std::make_shared<std::string>(std::move(out));
+            auto compressing = offload(reactor, threadPool, [state, plain, done] {
+                std::string packed;
+                state->gzip->write(plain->data(), plain->size(), packed);
+                if (done) {
+                    state->gzip->finish(packed);
+                }
+                return packed;
+            }, ThreadPool::ADMITTED);
+            std::optional<std::string> packed = co_await compressing;
+            if (!packed) {
+                response = "451 Transfer aborted: server busy.\r\n";
+                break;
+            }
+            out = std::move(*packed);
+            if (out.empty()) {
+                continue; // 数据留在压缩器中
+            }
+        }
+        Task<ssize_t> sending = send_data(
+                reactor, out.data(), out.size());
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+        out.clear();
+    }
+
+    if (response.empty()) {
+        response = "226 Archive sent; " + std::to_string(files) + " files";
+        if (skipped > 0) {
+            response += ", " + std::to_string(skipped) + " skipped";
+        }
+        if (changed > 0) {
+            response += ", " + std::to_string(changed) + " changed while reading";
+        }
+        response += ".\r\n";
+    }
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
+
+// SITE UNTAR 的成员路径：忽略开头的 '/' 与 "." 分量，含 ".." 或为空时返回 false
+static bool extract_path(const ResolvedPath& base, const std::string& name, ResolvedPath& path)
+{
+    path = base;
+    bool found = false;
+    size_t pos = 0;
+    while (pos <= name.size()) {
+        size_t end = name.find('/', pos);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        std::string part = name.substr(pos, end - pos);
+        if (part == "..") {
+            return false;
+        }
+        if (!part.empty() && part != ".") {
+            path = path.child(part);
+            found = true;
+        }
+        pos = end + 1;
+    }
+    return found;
+}
+
+// 创建目录，缺少的上级目录一并创建；已存在时成功
+static int make_directories(const ResolvedPath& dir, mode_t mode)
+{
+    int rc = dir.mkdir(mode);
+    if (rc == -ENOENT && !dir.is_root()) {
+        rc = make_directories(dir.parent(), 0755);
+        if (rc == 0) {
+            rc = dir.mkdir(mode);
+        }
+    }
+    return rc == -EEXIST ? 0 : rc;
+}
+
+// 打开解出的文件（原子上传时为临时文件），上级目录不存在时先创建
+static int open_extract_file(ExtractFile& file)
+{
+    bool atomic = UploadCommitter::instance().atomic();
+    ResolvedPath written = atomic ? UploadCommitter::temporary_path(file.target)
+                                  : file.target;
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (atomic ? O_EXCL : O_TRUNC);
+    mode_t mode = file.member.mode & 0777;
+    int fd = written.open(flags, mode);
+    if (fd == -ENOENT) {
+        make_directories(file.target.parent(), 0755);
+        fd = written.open(flags, mode);
+    }
+    if (fd < 0) {
+        return fd;
+    }
+    file.fd = fd;
+    file.written = written;
+    if (atomic) {
+        file.temporary.path = written;
+    }
+    return 0;
+}
+
+// 写入文件的一段，第一个执行的段打开文件
+static void write_extract_piece(
+        ExtractFile& file,
+        const char* data,
+        size_t length,
+        off_t offset)
+{
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(file.mutex);
+        if (file.fd == -1 && file.error == 0) {
+            file.error = open_extract_file(file);
+        }
+        if (file.error != 0) {
+            return;
+        }
+        fd = file.fd;
+    }
+    if (!write_all(fd, data, length, offset)) {
+        std::lock_guard<std::mutex> lock(file.mutex);
+        if (file.error == 0) {
+            file.error = -errno;
+        }
+    }
+}
+
+// 所有段写完后设置修改时间并提交（落盘、原子改名）
+static int finish_extract_file(ExtractFile& file)
+{
+    std::lock_guard<std::mutex> lock(file.mutex);
+    int rc = file.error;
+    if (rc == 0) {
+        struct timespec times[2] = {{0, UTIME_OMIT}, {file.member.mtime, 0}};
+        futimens(file.fd, times);
+        UploadCommitter& committer = UploadCommitter::instance();
+        if (committer.enabled()) {
+            rc = committer.commit(file.fd, file.written, file.target);
+        }
+        if (rc == 0) {
+            file.temporary.path.reset();
+        }
+    }
+    if (file.fd != -1) {
+        MetadataCache::instance().invalidate(file.target);
+    }
+    return rc;
+}
+
+// 执行 SITE UNTAR 的一个写入任务
+static ExtractResult run_extract(const ExtractBatch& batch)
+{
+    ExtractResult result;
+    auto account = [&result](int rc, size_t& counter) {
+        if (rc == 0) {
+            ++counter;
+            return;
+        }
+        ++result.failed;
+        if (result.error == 0) {
+            result.error = rc;
+        }
+    };
+    for (const ExtractOp& op : batch.ops) {
+        if (!op.file) {
+            int rc = make_directories(op.directory, op.mode);
+            MetadataCache::instance().invalidate(op.directory);
+            account(rc, result.directories);
+            continue;
+        }
+        write_extract_piece(*op.file, batch.data.data() + op.begin, op.length, op.offset);
+        if (op.file->pieces.fetch_sub(1) == 1) {
+            account(finish_extract_file(*op.file), result.files);
+        }
+    }
+    return result;
+}
+
+// 按提交的顺序等待 SITE UNTAR 的写入任务，直到任务数与数据量低于上限（all 时全部完成）
+static Task<void> wait_extract(ExtractPipeline& pipeline, bool all)
+{
+    while (!pipeline.running.empty() &&
+           (all || pipeline.running.size() >= EXTRACT_PARALLEL ||
+            pipeline.pending >= EXTRACT_PENDING_BYTES)) {
+        ExtractPipeline::BatchPtr batch = pipeline.running.front().first;
+        ExtractPipeline::WritePtr op = std::move(pipeline.running.front().second);
+        pipeline.running.pop_front();
+        std::optional<ExtractResult> result = co_await *op;
+        op.reset();
+        pipeline.pending -= batch->data.size();
+        for (const std::string& name : batch->names) {
+            auto found = pipeline.writing.find(name);
+            if (--found->second == 0) {
+                pipeline.writing.erase(found);
+            }
+        }
+        if (!result) {
+            pipeline.rejected = true;
+            continue;
+        }
+        ExtractResult& total = pipeline.total;
+        total.files += result->files;
+        total.directories += result->directories;
+        total.failed += result->failed;
+        if (total.error == 0) {
+            total.error = result->error;
+        }
+    }
+}
+
+Task<void> FileCommand::extract_transfer(
+        Session& session,
+        ResolvedPath dir,
+        bool compressed,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, true);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+
+    // 目标目录须已存在
+    auto checking = offload(reactor, threadPool, [dir] {
+        struct statx stx;
+        int rc = dir.stat(stx);
+        return rc == 0 && !S_ISDIR(stx.stx_mode) ? -ENOTDIR : rc;
+    });
+    std::optional<int> checked = co_await checking;
+    if (!checked) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
+    }
+    if (*checked != 0) {
+        std::string response = *checked == -ENOTDIR ? "550 Not a directory.\r\n"
+                                                    : "550 Directory not found.\r\n";
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+
+    std::string response150 = "150 Opening data connection.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    ExtractPipeline pipeline;
+    ExtractPipeline::BatchPtr batch = std::make_shared<ExtractBatch>();
+    // 把当前批次提交到线程池
+    auto submit = [&pipeline, &batch, reactor, &threadPool] {
+        if (batch->ops.empty()) {
+            return;
+        }
+        ExtractPipeline::BatchPtr submitted = std::move(batch);
+        batch = std::make_shared<ExtractBatch>();
+        ExtractPipeline::WritePtr op = std::make_unique<Offload<ExtractResult> >(
+                reactor, threadPool,
+                [submitted] { return run_extract(*submitted); },
+                ThreadPool::ADMITTED);
+        op->start();
+        pipeline.pending += submitted->data.size();
+        pipeline.running.emplace_back(submitted, std::move(op));
+    };
+
+    std::shared_ptr<GunzipStream> gunzip;
+    if (compressed) {
+        gunzip = std::make_shared<GunzipStream>();
+    }
+    TarReader reader;
+    std::shared_ptr<ExtractFile> current; // 正在接收数据的文件
+    off_t currentOffset = 0;              // 当前文件已接收的字节数
+    bool pieceOpen = false;               // 批次的最后一项是当前文件未满的一段
+    size_t skipped = 0;
+    bool ended = false;
+    int inflating = 0; // 解压器中还有未解压的输入
+    std::vector<char> buffer(EXTRACT_RECV);
+    std::string plain;
+    std::string response;
+    while (response.empty() && !pipeline.rejected) {
+        const char* input = buffer.data();
+        size_t inputSize = 0;
+        if (inflating == 0) {
+            Task<ssize_t> receiving = recv_data(
+                    reactor, buffer.data(), buffer.size());
+            ssize_t bytesReceived = co_await std::move(receiving);
+            if (bytesReceived == -1) {
+                response = "426 Transfer aborted: Connection closed.\r\n";
+                break;
+            }
+            if (bytesReceived == 0) {
+                break;
+            }
+            if (ended) {
+                continue; // 归档结尾之后的数据丢弃
+            }
+            inputSize = static_cast<size_t>(bytesReceived);
+            if (gunzip) {
+                gunzip->write(buffer.data(), inputSize);
+                inflating = 1;
+            }
+        }
+        if (inflating != 0) {
+            // 解压必须按顺序进行，每次输出有上限，在线程池中依次执行
+            auto decompressing = offload(reactor, threadPool, [gunzip] {
+                std::pair<int, std::string> output;
+                output.first = gunzip->read(output.second, ARCHIVE_PIECE);
+                return output;
+            }, ThreadPool::ADMITTED);
+            std::optional<std::pair<int, std::string> > output = co_await decompressing;
+            if (!output) {
+                response = "451 Transfer aborted: server busy.\r\n";
+                break;
+            }
+            if (output->first < 0) {
+                response = "451 Invalid compressed data.\r\n";
+                break;
+            }
+            inflating = output->first;
+            plain = std::move(output->second);
+            input = plain.data();
+            inputSize = plain.size();
+        }
+
+        // 解析：小文件与目录合并为一个任务，大文件按 ARCHIVE_PIECE 分段
+        reader.feed(input, inputSize);
+        while (response.empty() && !pipeline.rejected) {
+            const char* data = nullptr;
+            size_t size = 0;
+            TarReader::Item item = reader.next(data, size);
+            if (item == TarReader::MORE) {
+                break;
+            }
+            if (item == TarReader::END) {
+                ended = true;
+                inflating = 0;
+                break;
+            }
+            if (item == TarReader::INVALID) {
+                response = "451 Invalid archive.\r\n";
+                break;
+            }
+            if (item == TarReader::HEADER) {
+                const TarMember& member = reader.member();
+                current.reset();
+                ResolvedPath path;
+                if (!extract_path(dir, member.name, path) ||
+                    (member.type != TarMember::REGULAR &&
+                     member.type != TarMember::DIRECTORY)) {
+                    ++skipped; // 越出目标目录的路径、链接与设备等
+                    continue;
+                }
+                if (member.type == TarMember::DIRECTORY) {
+                    ExtractOp op;
+                    op.directory = path;
+                    op.mode = (member.mode & 0777) | 0700;
+                    batch->ops.push_back(std::move(op));
+                } else {
+                    if (pipeline.writing.count(path.path()) != 0) {
+                        // 同名文件还在写入：等待全部写完，归档中后出现的覆盖先出现的
+                        submit();
+                        Task<void> waiting = wait_extract(pipeline, true);
+                        co_await std::move(waiting);
+                    }
+                    current = std::make_shared<ExtractFile>();
+                    current->target = path;
+                    current->member = member;
+                    current->pieces = static_cast<size_t>(std::max<off_t>(
+                            1, (member.size + ARCHIVE_PIECE - 1) / ARCHIVE_PIECE));
+                    currentOffset = 0;
+                    ++pipeline.writing[path.path()];
+                    batch->names.push_back(path.path());
+                    if (member.size == 0) {
+                        ExtractOp op;
+                        op.file = std::move(current);
+                        op.begin = batch->data.size();
+                        batch->ops.push_back(std::move(op));
+                    }
+                }
+            } else if (current) {
+                // 数据追加到当前文件的段中，段满时结束
+                while (size > 0) {
+                    if (!pieceOpen) {
+                        ExtractOp op;
+                        op.file = current;
+                        op.offset = currentOffset;
+                        op.begin = batch->data.size();
+                        batch->ops.push_back(std::move(op));
+                        pieceOpen = true;
+                    }
+                    size_t room = ARCHIVE_PIECE - currentOffset % ARCHIVE_PIECE;
+                    size_t n = std::min(size, room);
+                    batch->data.append(data, n);
+                    batch->ops.back().length += n;
+                    currentOffset += n;
+                    data += n;
+                    size -= n;
+                    if (n == room || currentOffset == current->member.size) {
+                        pieceOpen = false;
+                    }
+                    if (currentOffset == current->member.size) {
+                        current.reset();
+                        break;
+                    }
+                    if (!pieceOpen) {
+                        submit();
+                        Task<void> waiting = wait_extract(pipeline, false);
+                        co_await std::move(waiting);
+                    }
+                }
+            }
+
+            // 段与段之间：批次够大时提交，任务数或数据量达到上限时等待
+            if (!pieceOpen && (batch->data.size() >= ARCHIVE_PIECE ||
+                               batch->ops.size() >= ARCHIVE_BATCH_FILES)) {
+                submit();
+                Task<void> waiting = wait_extract(pipeline, false);
+                co_await std::move(waiting);
+            }
+        }
+    }
+
+    // 提交剩余的批次，等待全部写完；被截断的文件缺少段，不会提交
+    if (response.empty() && !pipeline.rejected) {
+        submit();
+        Task<void> waiting = wait_extract(pipeline, true);
+        co_await std::move(waiting);
+    }
+
+    const ExtractResult& total = pipeline.total;
+    std::string counts = std::to_string(total.files) + " files, " +
+                         std::to_string(total.directories) + " directories";
+    if (pipeline.rejected) {
+        response = "451 Transfer aborted: server busy.\r\n";
+    } else if (!response.empty()) {
+        // 传输中断或归档损坏，已写完的文件保留
+    } else if (!reader.complete()) {
+        response = "451 Archive truncated; extracted " + counts + ".\r\n";
+    } else if (total.failed > 0) {
+        response = "451 Extracted " + counts + "; " + std::to_string(total.failed) +
+                   " failed: " + strerror(-total.error) + "\r\n";
+    } else {
+        response = "226 Extracted " + counts;
+        if (skipped > 0) {
+            response += ", " + std::to_string(skipped) + " skipped";
+        }
+        response += ".\r\n";
+    }
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
+
+Task<void> FileCommand::copy_command(
+        ACE_Reactor* reactor,
+        std::shared_ptr<FileCopy> copy,
+        std::string target,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    Offload<int> opening(reactor, threadPool, [copy] { return copy->open(); });
+    std::optional<int> rc = co_await opening;
+    auto reported = std::chrono::steady_clock::now();
+    while (rc && *rc == 1) {
+        // 长时间的复制每秒报告一次进度（预备回复）
+        auto now = std::chrono::steady_clock::now();
+        if (now - reported >= COPY_PROGRESS_INTERVAL) {
+            reported = now;
+            std::string progress = "150 Copying " + target + ": " +
+                                   std::to_string(copy->copied()) + " of " +
+                                   std::to_string(copy->size()) + " bytes\r\n";
+            clientStream_.send(progress.c_str(), progress.size());
+        }
+        Offload<int> copying(
+                reactor, threadPool, [copy] { return copy->step(); },
+                ThreadPool::ADMITTED);
+        rc = co_await copying;
+    }
+    if (rc && *rc == 0) {
+        Offload<int> committing(
+                reactor, threadPool, [copy] { return copy->commit(); },
+                ThreadPool::ADMITTED);
+        rc = co_await committing;
+        if (rc && *rc == 0) {
+            MetadataCache::instance().invalidate(copy->target());
         }
+    }
+    if (!rc) {
+        reply_busy(clientStream_, threadPool);
+        co_return;
+    }
 
-        // 打开文件并获取文件大小
-        int fd = open(fileName.c_str(), O_RDONLY);
-        if (fd == -1) {
-            std::string response = "550 Failed to open file.\r\n";
-            clientStream_.send(response.c_str(), response.size());
-            return;
+    std::string response;
+    if (*rc == -ENOENT || *rc == -ENOTDIR) {
+        response = "550 File not found.\r\n";
+    } else if (*rc == -EISDIR) {
+        response = "550 Not a regular file.\r\n";
+    } else if (*rc == -ESTALE) {
+        response = "451 Source changed while copying.\r\n";
+    } else if (*rc < 0) {
+        response = "550 Copy failed: " + std::string(strerror(-*rc)) + "\r\n";
+    } else {
+        response = "250 Copied " + std::to_string(copy->size()) + " bytes to " +
+                   target + " (" + copy_method_name(copy->method()) + ").\r\n";
+    }
+    clientStream_.send(response.c_str(), response.size());
+}
+
+void FileCommand::start_listing(
+        Session& session,
+        const ListingRequest& request,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    if (!passive_mode_) {
+        std::string response = "425 Use PASV first.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+    if (transfer_.active()) {
+        std::string response = "425 Data connection already in use.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+
+    Task<void> transfer =
+            list_transfer(session, request, clientStream_, threadPool);
+    start_transfer(session, std::move(transfer));
+}
+
+Task<void> FileCommand::list_transfer(
+        Session& session,
+        ListingRequest request,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
+
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, false);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        clear_passive_mode();
+        co_return;
+    }
+
+    // 在线程池中查找列表缓存或打开目录，失败时在 150 之前回复
+    std::shared_ptr<ListingState> state = std::make_shared<ListingState>();
+    state->remaining = request.count;
+    auto opening = offload(reactor, threadPool, [state, request] {
+        ListingCache& listingCache = ListingCache::instance();
+        bool cacheable = listingCache.enabled() && !request.paged &&
+                         !request.recursive && request.path.native();
+        if (cacheable) {
+            state->cached = listingCache.lookup(
+                    request.path, request.format, request.hidden);
+            if (state->cached) {
+                return 0;
+            }
+        }
+        int rc = state->reader.open(
+                request.path, request.format, request.hidden);
+        if (rc == 0 && request.cursor > 0) {
+            rc = state->reader.seek(request.cursor);
         }
+        if (rc == 0 && cacheable && state->reader.fd() != -1) {
+            // 读取目录前建立监视，读取期间的修改使本次结果不被缓存
+            state->ticket = listingCache.watch(state->reader.fd());
+        }
+        return rc;
+    });
+    std::optional<int> opened = co_await opening;
+    if (!opened) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
+    }
+    if (*opened != 0) {
+        std::string response = *opened == -ENOTDIR
+                                       ? "501 Not a directory.\r\n"
+                                       : "550 Could not open directory.\r\n";
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
 
-        struct stat fileStat;
-        if (fstat(fd, &fileStat) == -1) {
-            std::string response = "550 Failed to get file size.\r\n";
-            clientStream_.send(response.c_str(), response.size());
-            close(fd);
-            return;
+    // 发送 150 响应，通知客户端即将开始传输目录列表
+    std::string response150 = "150 Here comes the directory listing.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
+
+    std::string response = "226 Directory send OK.\r\n";
+    if (state->cached) {
+        // 缓存命中：直接从内存发送
+        Task<ssize_t> sending = send_data(
+                reactor, state->cached->data(),
+                state->cached->size());
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
         }
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+
+    if (request.recursive && state->reader.directory()) {
+        // 与 state 共享所有权的根目录读取器
+        Task<std::string> tree = send_tree(
+                reactor, std::shared_ptr<DirectoryReader>(state, &state->reader),
+                request, threadPool);
+        response = co_await std::move(tree);
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
 
-        size_t fileSize = fileStat.st_size;
+    // 双缓冲：发送当前批次的同时，线程池读取并格式化下一批目录项；
+    // 可缓存时同时累积完整列表，读完后放入缓存
+    typedef std::pair<int, std::string> Batch;
+    auto read_batch = [state, request] {
+        Batch batch;
+        batch.second.reserve(CHUNK_SIZE + 512);
+        batch.first = state->reader.read(
+                batch.second, CHUNK_SIZE,
+                request.paged ? &state->remaining : nullptr);
+        if (!state->ticket.valid()) {
+            return batch;
+        }
+        ListingCache& listingCache = ListingCache::instance();
+        if (batch.first < 0 || state->rendered.size() + batch.second.size() >
+                                       listingCache.max_listing()) {
+            state->ticket = ListingCache::Ticket();
+            state->rendered.clear();
+            return batch;
+        }
+        state->rendered += batch.second;
+        if (batch.first == 0) {
+            listingCache.insert(
+                    state->ticket, request.format, request.hidden,
+                    std::make_shared<const std::string>(
+                            std::move(state->rendered)));
+        }
+        return batch;
+    };
+    std::optional<Offload<Batch> > reading;
+    reading.emplace(reactor, threadPool, read_batch, ThreadPool::ADMITTED);
+    reading->start();
 
-        // 发送 150 响应，通知客户端即将开始文件传输
-        std::string response150 = "150 Opening data connection.\r\n";
-        clientStream_.send(response150.c_str(), response150.size());
+    bool more = false;
+    while (reading) {
+        std::optional<Batch> batch = co_await *reading;
+        reading.reset();
+        if (!batch) {
+            response = "451 Transfer aborted: server busy.\r\n";
+            break;
+        }
+        if (batch->first < 0) {
+            response = "451 Failed to read directory.\r\n";
+            break;
+        }
+        // 分页列表达到本页条目数后停止，剩余部分由下一页的游标继续
+        more = batch->first > 0;
+        if (more && (!request.paged || state->remaining > 0)) {
+            reading.emplace(
+                    reactor, threadPool, read_batch, ThreadPool::ADMITTED);
+            reading->start();
+        }
+        if (batch->second.empty()) {
+            continue;
+        }
+        Task<ssize_t> sending = send_data(
+                reactor, batch->second.data(),
+                batch->second.size());
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+            break;
+        }
+    }
+    if (request.paged && response[0] == '2') {
+        response = "226 Directory send OK; cursor=" +
+                   (more ? std::to_string(state->reader.position())
+                         : std::string("end")) +
+                   "\r\n";
+    }
 
-        ssize_t bytesSent = 0;
+    // 发送完成响应并释放数据连接
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
 
-        if (fileSize <= SMALL_FILE_THRESHOLD) {
-            // 对于小文件，直接读取整个文件到内存并一次性发送
-            char* fileData = new char[fileSize];
-            if (read(fd, fileData, fileSize) !=
-                static_cast<ssize_t>(fileSize)) {
-                std::string response = "550 Failed to read file.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                delete[] fileData;
-                close(fd);
-                return;
-            }
+Task<std::string> FileCommand::send_tree(
+        ACE_Reactor* reactor,
+        std::shared_ptr<DirectoryReader> root,
+        ListingRequest request,
+        ThreadPool& threadPool)
+{
+    typedef std::shared_ptr<TreeDirectory> DirectoryPtr;
+    typedef std::unique_ptr<Offload<TreeBatch> > ReadPtr;
 
-            bytesSent = dataStream_.send_n(fileData, fileSize);
-            delete[] fileData;
-            if (bytesSent == -1) {
-                std::string response =
-                        "426 Transfer aborted: Connection closed.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                close(fd);
-                return;
-            }
-        } else {
-            // 对于大文件，使用 mmap 和分块传输
-            void* fileData =
-                    mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
-            if (fileData == MAP_FAILED) {
-                std::string response = "550 Failed to mmap file.\r\n";
-                clientStream_.send(response.c_str(), response.size());
-                close(fd);
-                return;
-            }
-
-            size_t offset = 0;
-            while (offset < fileSize) {
-                size_t bytesToSend = std::min(CHUNK_SIZE, fileSize - offset);
-
-                // 从内存中发送当前块
-                bytesSent = dataStream_.send_n(
-                        (char*)fileData + offset, bytesToSend);
-                if (bytesSent == -1) {
-                    std::string response =
-                            "426 Transfer aborted: Connection closed.\r\n";
-                    clientStream_.send(response.c_str(), response.size());
-                    munmap(fileData, fileSize);
-                    close(fd);
-                    return;
-                }
+    // 在线程池中打开（首次）并读取目录的下一批条目
+    auto start_read = [reactor, &threadPool, &request](DirectoryPtr dir) {
+        ReadPtr op = std::make_unique<Offload<TreeBatch> >(
+                reactor, threadPool, [dir, request] {
+                    TreeBatch batch;
+                    if (!dir->started) {
+                        dir->started = true;
+                        if (!dir->reader) {
+                            dir->reader = std::make_shared<DirectoryReader>();
+                            if (dir->reader->open(
+                                        request.path.child(dir->relative),
+                                        request.format, request.hidden) != 0) {
+                                dir->reader.reset();
+                                return batch; // 无法读取的子目录跳过
+                            }
+                        }
+                        dir->reader->set_recursive(dir->relative);
+                        if (request.format == ListFormat::LIST) {
+                            // 与 ls -lR 相同，每个目录前输出其路径
+                            batch.out = dir->relative.empty()
+                                                ? ".:\r\n"
+                                                : "\r\n./" + dir->relative + ":\r\n";
+                        }
+                    }
+                    batch.rc = dir->reader->read(batch.out, CHUNK_SIZE);
+                    batch.subdirs = dir->reader->take_subdirectories();
+                    if (batch.rc <= 0) {
+                        dir->reader.reset(); // 读完立即关闭目录
+                        batch.rc = 0;
+                    }
+                    return batch;
+                },
+                ThreadPool::ADMITTED);
+        op->start();
+        return op;
+    };
 
-                offset += bytesToSend;
-            }
+    DirectoryPtr top = std::make_shared<TreeDirectory>();
+    top->reader = std::move(root);
+    std::deque<DirectoryPtr> pending{top};
+    std::deque<std::pair<DirectoryPtr, ReadPtr> > running;
 
-            // 释放 mmap 的内存映射
-            munmap(fileData, fileSize);
+    while (!pending.empty() || !running.empty()) {
+        while (running.size() < TREE_PARALLELISM && !pending.empty()) {
+            running.emplace_back(pending.front(), start_read(pending.front()));
+            pending.pop_front();
         }
 
-        // 检查传输是否成功完成
-        if (bytesSent != -1) {
-            std::string response = "226 Transfer complete.\r\n";
-            clientStream_.send(response.c_str(), response.size());
-        } else {
-            std::string response = "426 Transfer aborted due to error.\r\n";
-            clientStream_.send(response.c_str(), response.size());
+        // 按开始读取的顺序等待，输出顺序与线程池的调度无关
+        DirectoryPtr dir = running.front().first;
+        ReadPtr op = std::move(running.front().second);
+        running.pop_front();
+        std::optional<TreeBatch> batch = co_await *op;
+        op.reset();
+        if (!batch) {
+            co_return std::string("451 Transfer aborted: server busy.\r\n");
         }
 
-        // 关闭文件描述符
-        close(fd);
+        // 同一目录的后续批次排在最前，目录的条目保持连续
+        if (batch->rc > 0) {
+            running.emplace_front(dir, start_read(dir));
+        }
+        if (request.depth == 0 || dir->depth < request.depth) {
+            for (std::string& name : batch->subdirs) {
+                DirectoryPtr child = std::make_shared<TreeDirectory>();
+                child->relative = dir->relative.empty()
+                                          ? name
+                                          : dir->relative + "/" + name;
+                child->depth = dir->depth + 1;
+                pending.push_back(std::move(child));
+            }
+        }
 
-        // 关闭数据连接
-        dataStream_.close();
-        clear_passive_mode();
-    });
+        if (batch->out.empty()) {
+            continue;
+        }
+        Task<ssize_t> sending = send_data(
+                reactor, batch->out.data(), batch->out.size());
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            co_return std::string(
+                    "426 Transfer aborted: Connection closed.\r\n");
+        }
+    }
+    co_return std::string("226 Directory send OK.\r\n");
 }
 
-// 处理 LIST 命令
-void FileCommand::handle_list(
+void FileCommand::start_changes(
         Session& session,
+        const ChangeQuery& query,
         ACE_SOCK_Stream& clientStream_,
         ThreadPool& threadPool)
 {
@@ -417,45 +3556,125 @@ void FileCommand::handle_list(
         clientStream_.send(response.c_str(), response.size());
         return;
     }
+    if (transfer_.active()) {
+        std::string response = "425 Data connection already in use.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
 
-    // 使用线程池处理 LIST 命令
-    // threadPool.enqueue([this, &session, &clientStream_] {
-    // 等待客户端连接到被动模式的数据端口
-    dataAcceptor_.accept(dataStream_);
-
-    // 发送 150 响应，通知客户端即将开始传输目录列表
-    std::string response150 = "150 Here comes the directory listing.\r\n";
-    clientStream_.send(response150.c_str(), response150.size());
+    Task<void> transfer =
+            changes_transfer(session, query, clientStream_, threadPool);
+    start_transfer(session, std::move(transfer));
+}
 
-    // 获取当前工作目录
-    std::string currentDir = session.get_working_directory();
-    std::ostringstream dirList;
+Task<void> FileCommand::changes_transfer(
+        Session& session,
+        ChangeQuery query,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = session.get_reactor();
 
-    // 使用系统调用列出目录内容
-    FILE* pipe = popen(("LANG=en_US.UTF-8 ls -ln " + currentDir).c_str(), "r");
-    if (!pipe) {
-        std::string response = "550 Could not open directory.\r\n";
+    // 等待客户端连接到被动模式的数据端口（块模式下复用已有连接）
+    Task<int> accepting = open_data(reactor, false);
+    int accepted = co_await std::move(accepting);
+    if (accepted == -1) {
+        std::string response = "425 Could not open data connection.\r\n";
         clientStream_.send(response.c_str(), response.size());
-        return;
+        clear_passive_mode();
+        co_return;
     }
 
-    char buffer[256];
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        dirList << buffer;
+    // 双缓冲：发送当前批次的同时，线程池读取下一批；第一批失败时在 150 之前回复
+    typedef std::pair<int, std::string> Batch;
+    std::shared_ptr<ChangeQuery> state =
+            std::make_shared<ChangeQuery>(std::move(query));
+    auto read_batch = [state] {
+        Batch batch;
+        batch.first = ChangeIndex::instance().read(
+                *state, batch.second, CHANGES_BATCH);
+        return batch;
+    };
+    std::optional<Offload<Batch> > reading;
+    reading.emplace(reactor, threadPool, read_batch);
+    reading->start();
+    std::optional<Batch> batch = co_await *reading;
+    reading.reset();
+    if (!batch) {
+        reject_transfer(threadPool, clientStream_);
+        co_return;
     }
-    pclose(pipe);
+    if (batch->first < 0) {
+        std::string response = batch->first == -ENOTDIR
+                                        ? "501 Not a directory.\r\n"
+                                        : "550 Could not open directory.\r\n";
+        Task<void> finishing = finish_data(reactor, clientStream_, response);
+        co_await std::move(finishing);
+        co_return;
+    }
+
+    std::string response150 = "150 Here comes the change list.\r\n";
+    clientStream_.send(response150.c_str(), response150.size());
 
-    // 发送目录列表
-    std::string listResponse = dirList.str();
-    dataStream_.send(listResponse.c_str(), listResponse.size());
+    std::string response;
+    while (true) {
+        bool more = batch->first > 0;
+        if (more) {
+            reading.emplace(
+                    reactor, threadPool, read_batch, ThreadPool::ADMITTED);
+            reading->start();
+        }
+        if (!batch->second.empty()) {
+            Task<ssize_t> sending = send_data(
+                    reactor, batch->second.data(),
+                    batch->second.size());
+            ssize_t bytesSent = co_await std::move(sending);
+            if (bytesSent == -1) {
+                response = "426 Transfer aborted: Connection closed.\r\n";
+                break;
+            }
+        }
+        if (!more) {
+            break;
+        }
+        std::optional<Batch> next = co_await *reading;
+        reading.reset();
+        if (!next) {
+            response = "451 Transfer aborted: server busy.\r\n";
+            break;
+        }
+        if (next->first < 0) {
+            response = "451 Failed to read directory.\r\n";
+            break;
+        }
+        batch = std::move(next);
+    }
+    if (response.empty()) {
+        response = "226 Changes sent; now=" + format_timestamp(state->now) +
+                   (state->deletions ? "" : "; deletions=incomplete") + "\r\n";
+    }
 
-    // 发送完成响应 226
-    std::string response226 = "226 Directory send OK.\r\n";
-    clientStream_.send(response226.c_str(), response226.size());
+    // 发送完成响应并释放数据连接
+    Task<void> finishing = finish_data(reactor, clientStream_, response);
+    co_await std::move(finishing);
+}
 
-    // 清除被动模式状态
-    clear_passive_mode();
-    // });
+// 处理 MLST 命令
+void FileCommand::handle_mlst(
+        Session& session,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_)
+{
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    std::string name = params.empty() ? session.get_working_directory() : params;
+    run_metadata(session, clientStream_, [path, name] {
+        struct statx stx;
+        if (path.stat(stx) != 0 && path.stat(stx, false) != 0) {
+            return std::string("550 File not found.\r\n");
+        }
+        return "250- Listing " + name + "\r\n " + format_facts(stx) +
+               path.path() + "\r\n250 End\r\n";
+    });
 }
 
 // 处理 MKD 命令
@@ -471,79 +3690,179 @@ void FileCommand::handle_mkd(
         return;
     }
 
-    // 获取当前工作目录
-    std::string currentDir =
-            session.get_working_directory(); // 确保 Session 类有这个方法
-    std::string newDirPath =
-            currentDir + "/" + params; // 组合当前目录和新目录名称
-
-    // 检查目录是否已经存在
-    if (file_exists(newDirPath)) {
-        std::string response = "550 Directory already exists.\r\n";
-        clientStream_.send(response.c_str(), response.size());
-        return;
-    }
-
-    // 创建目录
-    if (mkdir(newDirPath.c_str(), 0755) == 0) {
-        std::string response = "257 Directory created.\r\n";
-        clientStream_.send(response.c_str(), response.size());
-    } else {
-        // 获取错误信息
-        std::string errorMessage = strerror(errno);
-        std::string response =
-                "550 Failed to create directory: " + errorMessage + "\r\n";
-        clientStream_.send(response.c_str(), response.size());
-    }
+    // 在会话的工作目录下创建目录，已存在时 mkdirat 返回 EEXIST
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    run_metadata(session, clientStream_, [path] {
+        int rc = path.mkdir(0755);
+        if (rc == 0) {
+            MetadataCache::instance().invalidate(path);
+        }
+        if (rc == -EEXIST) {
+            return std::string("550 Directory already exists.\r\n");
+        }
+        if (rc != 0) {
+            return "550 Failed to create directory: " +
+                   std::string(strerror(-rc)) + "\r\n";
+        }
+        return std::string("257 Directory created.\r\n");
+    });
 }
 
 // 处理 RMD 命令
 void FileCommand::handle_rmd(
+        Session& session,
         const std::string& params,
         ACE_SOCK_Stream& clientStream_)
 {
-    if (rmdir(params.c_str()) == 0) {
-        std::string response = "250 Directory deleted.\r\n";
-        clientStream_.send(response.c_str(), response.size());
-    } else {
-        std::string response = "550 Failed to remove directory.\r\n";
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    run_metadata(session, clientStream_, [path] {
+        if (path.rmdir() != 0) {
+            return std::string("550 Failed to remove directory.\r\n");
+        }
+        MetadataCache::instance().invalidate_tree(path);
+        return std::string("250 Directory deleted.\r\n");
+    });
+}
+
+// 处理 RNFR 命令
+void FileCommand::handle_rnfr(
+        Session& session,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_)
+{
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    std::shared_ptr<std::optional<ResolvedPath> > from =
+            std::make_shared<std::optional<ResolvedPath> >();
+    renameFrom_ = from;
+    // 控制连接在回复前暂停读取，RNTO 只会在 from 填写之后处理
+    run_metadata(session, clientStream_, [path, from] {
+        struct statx stx;
+        if (path.is_root() || path.stat(stx, false) != 0) {
+            return std::string("550 File not found.\r\n");
+        }
+        *from = path;
+        return std::string("350 Ready for RNTO.\r\n");
+    });
+}
+
+// 处理 RNTO 命令
+void FileCommand::handle_rnto(
+        Session& session,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_)
+{
+    std::shared_ptr<std::optional<ResolvedPath> > from = std::move(renameFrom_);
+    renameFrom_.reset();
+    if (!from || !*from) {
+        std::string response = "503 Bad sequence of commands.\r\n";
         clientStream_.send(response.c_str(), response.size());
+        return;
     }
+    ResolvedPath source = **from;
+    ResolvedPath target = session.get_path_resolver().resolve(params);
+    run_metadata(session, clientStream_, [source, target] {
+        int rc = source.rename(target);
+        if (rc != 0) {
+            return "550 Rename failed: " + std::string(strerror(-rc)) + "\r\n";
+        }
+        // 改名的可能是目录，目标也可能替换了原有的空目录
+        MetadataCache::instance().invalidate_tree(source);
+        MetadataCache::instance().invalidate_tree(target);
+        return std::string("250 Rename successful.\r\n");
+    });
 }
 
 // 处理 DELE 命令
 void FileCommand::handle_dele(
+        Session& session,
         const std::string& params,
         ACE_SOCK_Stream& clientStream_)
 {
-    if (remove(params.c_str()) == 0) {
-        std::string response = "250 File deleted.\r\n";
-        clientStream_.send(response.c_str(), response.size());
-    } else {
-        std::string response = "550 Failed to delete file.\r\n";
-        clientStream_.send(response.c_str(), response.size());
-    }
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    run_metadata(session, clientStream_, [path] {
+        if (path.unlink() != 0) {
+            return std::string("550 Failed to delete file.\r\n");
+        }
+        MetadataCache::instance().invalidate(path);
+        return std::string("250 File deleted.\r\n");
+    });
 }
 
 // 处理 SIZE 命令
 void FileCommand::handle_size(
+        Session& session,
         const std::string& params,
         ACE_SOCK_Stream& clientStream_)
 {
-    struct stat buffer;
-    if (stat(params.c_str(), &buffer) == 0) {
-        std::ostringstream response;
-        response << "213 " << buffer.st_size << "\r\n"; // 返回文件大小
-        clientStream_.send(response.str().c_str(), response.str().size());
-    } else {
-        std::string response = "550 File not found.\r\n";
-        clientStream_.send(response.c_str(), response.size());
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    run_metadata(session, clientStream_, [path] {
+        struct statx stx;
+        if (MetadataCache::instance().stat(path, stx) != 0) {
+            return std::string("550 File not found.\r\n");
+        }
+        return "213 " + std::to_string(stx.stx_size) + "\r\n"; // 返回文件大小
+    });
+}
+
+// 处理 MDTM 命令
+void FileCommand::handle_mdtm(
+        Session& session,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_)
+{
+    ResolvedPath path = session.get_path_resolver().resolve(params);
+    run_metadata(session, clientStream_, [path] {
+        struct statx stx;
+        if (MetadataCache::instance().stat(path, stx) != 0) {
+            return std::string("550 File not found.\r\n");
+        }
+        // RFC 3659：UTC 时间 YYYYMMDDHHMMSS
+        time_t mtime = static_cast<time_t>(stx.stx_mtime.tv_sec);
+        struct tm tm;
+        char stamp[32];
+        gmtime_r(&mtime, &tm);
+        strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &tm);
+        return "213 " + std::string(stamp) + "\r\n";
+    });
+}
+
+// 元数据命令：在元数据线程上执行并生成回复，期间暂停读取控制连接
+void FileCommand::run_metadata(
+        Session& session,
+        ACE_SOCK_Stream& clientStream_,
+        std::function<std::string()> op)
+{
+    session.run_command(metadata_command(
+            session.get_reactor(), clientStream_, std::move(op)));
+}
+
+Task<void> FileCommand::metadata_command(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& clientStream_,
+        std::function<std::string()> op)
+{
+    MetadataExecutor& executor = MetadataExecutor::instance();
+    auto running = executor.submit(reactor, std::move(op));
+    std::optional<std::string> response = co_await running;
+    if (!response) {
+        reply_busy(clientStream_, executor.pool());
+        co_return;
     }
+    clientStream_.send(response->c_str(), response->size());
 }
 
 // 处理 EPSV 命令
 void FileCommand::handle_epsv(ACE_SOCK_Stream& clientStream_)
 {
+    // 传输进行中时数据连接仍在使用，不能另开监听端口
+    if (transfer_.active()) {
+        std::string response = "425 Data connection already in use.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+    // 关闭上一次的监听端口和（块模式下保持着的）数据连接
+    clear_passive_mode();
+
     // 绑定到一个随机端口并监听
     ACE_INET_Addr serverAddr(
             (u_short)0, "127.0.0.1"); // 使用 127.0.0.1 作为本地地址，端口为 0
@@ -573,6 +3892,66 @@ void FileCommand::handle_epsv(ACE_SOCK_Stream& clientStream_)
     passive_mode_ = true; // 标记被动模式
 }
 
+// 处理 MODE 命令
+void FileCommand::handle_mode(const std::string& params, ACE_SOCK_Stream& clientStream_)
+{
+    std::string response;
+    if (params != "S" && params != "B") {
+        response = "504 Unsupported mode. Supported modes are S (stream) and B (block).\r\n";
+    } else if (transfer_.active()) {
+        response = "503 Cannot change mode during a transfer.\r\n";
+    } else {
+        bool block = params == "B";
+        // 两种模式的文件结束方式不同，切换时关闭保持着的数据连接，监听端口保留
+        if (block != blockMode_ && dataStream_.get_handle() != ACE_INVALID_HANDLE) {
+            dataStream_.close();
+        }
+        blockMode_ = block;
+        response = "200 Mode set to " + params + ".\r\n";
+    }
+    clientStream_.send(response.c_str(), response.size());
+}
+
+// 处理 REST 命令
+void FileCommand::handle_rest(const std::string& params, ACE_SOCK_Stream& clientStream_)
+{
+    std::string response;
+    if (params.empty() || params.size() > 18 ||
+        params.find_first_not_of("0123456789") != std::string::npos) {
+        response = "501 Invalid restart position.\r\n";
+    } else {
+        restart_ = std::stoll(params);
+        response = "350 Restarting at " + std::to_string(restart_) +
+                   ". Send STOR or RETR to initiate transfer.\r\n";
+    }
+    clientStream_.send(response.c_str(), response.size());
+}
+
+// 线程池拒绝传输任务时通知客户端，避免客户端无限等待
+void FileCommand::reject_transfer(
+        ThreadPool& threadPool,
+        ACE_SOCK_Stream& clientStream_)
+{
+    std::string response;
+    if (!threadPool.is_open()) {
+        response = "421 Service not available, server shutting down.\r\n";
+    } else {
+        response =
+                "450 Server busy, transfer not started. Try again later.\r\n";
+    }
+    clientStream_.send(response.c_str(), response.size());
+
+    ACE_DEBUG(
+            (LM_DEBUG,
+             ACE_TEXT("(%P|%t) Transfer rejected by thread pool (%d rejected "
+                      "so far, %d threads)\n"),
+             static_cast<int>(threadPool.rejected_count()),
+             static_cast<int>(threadPool.thread_count())));
+
+    // 释放本次被动模式占用的端口，客户端需重新 PASV
+    clear_passive_mode();
+}
+
 // 完成后清理被动模式的资源
 void FileCommand::clear_passive_mode()
 {
@@ -584,3 +3963,134 @@ void FileCommand::clear_passive_mode()
     }
     passive_mode_ = false; // 清除被动模式标志
 }
+
+Task<int> FileCommand::open_data(ACE_Reactor* reactor, bool receiving)
+{
+    receiving_ = receiving;
+    sending_ = false;
+    blockReader_.reset();
+    if (blockMode_ && dataStream_.get_handle() != ACE_INVALID_HANDLE) {
+        co_return 0; // 复用上一次传输留下的连接
+    }
+
+    Task<int> accepting = async_accept(reactor, dataAcceptor_, dataStream_);
+    int accepted = co_await std::move(accepting);
+    if (accepted == 0 && blockMode_) {
+        // 块模式下连接不关闭，结尾的 EOF 块不能等 Nagle 攒满一个报文段
+        int one = 1;
+        setsockopt(dataStream_.get_handle(), IPPROTO_TCP, TCP_NODELAY, &one,
+                   sizeof(one));
+    }
+    co_return accepted;
+}
+
+Task<ssize_t> FileCommand::recv_data(ACE_Reactor* reactor, char* buffer, size_t size)
+{
+    if (!blockMode_) {
+        Task<ssize_t> receiving = async_recv(reactor, dataStream_, buffer, size);
+        ssize_t bytesReceived = co_await std::move(receiving);
+        co_return bytesReceived;
+    }
+
+    // 每次最多接收到当前块的结尾，不会读入下一个文件；
+    // 数据直接收到 buffer，头部与重启标记收到小缓冲区
+    char control[512];
+    while (!blockReader_.ended()) {
+        bool data = blockReader_.in_data();
+        char* target = data ? buffer : control;
+        size_t wanted = std::min(blockReader_.wanted(), data ? size : sizeof(control));
+        Task<ssize_t> receiving = async_recv(reactor, dataStream_, target, wanted);
+        ssize_t bytesReceived = co_await std::move(receiving);
+        // 块模式下在 EOF 块之前关闭连接即为传输中断
+        if (bytesReceived <= 0 || blockReader_.feed(target, bytesReceived) != 0) {
+            co_return -1;
+        }
+        if (data) {
+            co_return bytesReceived;
+        }
+    }
+    co_return 0;
+}
+
+Task<ssize_t> FileCommand::send_data(
+        ACE_Reactor* reactor,
+        const char* data,
+        size_t size)
+{
+    if (!blockMode_) {
+        Task<ssize_t> sending = async_send_all(reactor, dataStream_, data, size);
+        ssize_t bytesSent = co_await std::move(sending);
+        co_return bytesSent;
+    }
+    if (size == 0) {
+        co_return 0;
+    }
+
+    // 头部与数据交替排列，一次 sendmsg 发出，不复制数据
+    std::string headers;
+    std::vector<iovec> iov;
+    BlockMode::frame(data, size, headers, iov);
+    sending_ = true;
+    Task<ssize_t> sending =
+            async_sendv_all(reactor, dataStream_, iov.data(), iov.size());
+    ssize_t bytesSent = co_await std::move(sending);
+    co_return bytesSent == -1 ? -1 : static_cast<ssize_t>(size);
+}
+
+Task<bool> FileCommand::send_restart_marker(ACE_Reactor* reactor, off_t offset)
+{
+    std::string block = BlockMode::marker(offset);
+    sending_ = true;
+    Task<ssize_t> sending =
+            async_send_all(reactor, dataStream_, block.data(), block.size());
+    ssize_t bytesSent = co_await std::move(sending);
+    co_return bytesSent != -1;
+}
+
+// 块模式下客户端的重启标记：其之前的数据写入文件后回复 "110 MARK 标记 = 文件偏移"，
+// 客户端之后可以 REST 该偏移续传
+void FileCommand::acknowledge_markers(
+        off_t start,
+        off_t written,
+        ACE_SOCK_Stream& clientStream_)
+{
+    std::string marker;
+    off_t position = 0;
+    while (blockReader_.take_marker(written - start, marker, position)) {
+        std::string response = "110 MARK " + marker + " = " +
+                               std::to_string(start + position) + "\r\n";
+        clientStream_.send(response.c_str(), response.size());
+    }
+}
+
+Task<void> FileCommand::finish_data(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& clientStream_,
+        std::string response)
+{
+    // 块模式下发送的文件（包括空文件）以 EOF 块结束，在回复之前发出
+    if (blockMode_ && dataStream_.get_handle() != ACE_INVALID_HANDLE &&
+        response[0] == '2' && (!receiving_ || sending_)) {
+        std::string block = BlockMode::end();
+        Task<ssize_t> sending =
+                async_send_all(reactor, dataStream_, block.data(), block.size());
+        ssize_t bytesSent = co_await std::move(sending);
+        if (bytesSent == -1) {
+            response = "426 Transfer aborted: Connection closed.\r\n";
+        } else {
+            sending_ = false;
+        }
+    }
+    clientStream_.send(response.c_str(), response.size());
+    release_data();
+}
+
+void FileCommand::release_data()
+{
+    // 没有发了一半的文件，要接收的文件也已读到 EOF 块
+    bool between = !sending_ && (!receiving_ || blockReader_.ended());
+    if (blockMode_ && between && dataStream_.get_handle() != ACE_INVALID_HANDLE) {
+        return;
+    }
+    clear_passive_mode();
+}
@@ -0,0 +1,288 @@
+#include "HashCommand.h"
+#include "DedupStore.h"
+#include "FileCache.h"
+#include "HashCache.h"
+#include "PageCache.h"
+#include "ReactorAwaiters.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// 每次 pread 的大小
+const size_t HASH_CHUNK = 1024 * 1024;
+// 每个线程池任务最多计算的字节数，计算大文件时不长时间占住线程
+const off_t HASH_STEP = 16 * 1024 * 1024;
+
+/**
+ * @brief 一次校验的计算状态，由线程池任务依次推进。
+ */
+struct HashJob
+{
+    explicit HashJob(HashAlgorithm algorithm)
+        : algorithm(algorithm), hasher(algorithm)
+    {
+    }
+
+    ~HashJob()
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
+    int fd = -1;              ///< 文件
+    FileIdentity identity;    ///< 打开时的版本
+    HashAlgorithm algorithm;  ///< 算法
+    off_t start = 0;          ///< 区间起点
+    off_t position = 0;       ///< 已计算到的位置
+    off_t end = 0;            ///< 区间终点（不含）
+    Hasher hasher;            ///< 摘要
+    CacheWindow window;       ///< 大文件的页缓存窗口
+    std::unique_ptr<ManifestReader> manifest; ///< 去重文件的清单
+    std::vector<char> buffer; ///< 读取缓冲
+    std::string digest;       ///< 结果
+};
+
+// 打开文件并查找缓存：需要计算返回 1，已得到结果返回 0，失败返回 -errno
+static int open_job(HashJob& job, const ResolvedPath& path, off_t end)
+{
+    job.fd = path.open(O_RDONLY | O_CLOEXEC);
+    if (job.fd < 0) {
+        int rc = job.fd;
+        job.fd = -1;
+        return rc;
+    }
+    struct stat st;
+    if (fstat(job.fd, &st) != 0) {
+        return -errno;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return -EISDIR;
+    }
+    job.identity = FileIdentity::from_stat(st);
+    if (DedupStore::instance().enabled()) {
+        auto manifest = std::make_unique<ManifestReader>();
+        int rc = manifest->open(job.fd);
+        if (rc < 0) {
+            return rc;
+        }
+        if (rc == 1) {
+            job.manifest = std::move(manifest);
+        }
+    }
+    job.end = end < 0 || end > st.st_size ? st.st_size : end;
+    if (job.start > job.end) {
+        return -EINVAL;
+    }
+    job.position = job.start;
+
+    job.digest = HashCache::instance().lookup(
+            job.fd, job.identity, job.algorithm, job.start, job.end - job.start);
+    if (!job.digest.empty()) {
+        return 0;
+    }
+    if (job.start == job.end) {
+        job.digest = job.hasher.finish();
+        return 0;
+    }
+    if (job.start == 0 && !job.manifest && job.window.engage(job.end)) {
+        job.window.fall_back_to_fadvise(); // 校验不需要 O_DIRECT 的对齐
+        job.window.apply_open(job.fd);
+    }
+    job.buffer.resize(HASH_CHUNK);
+    return 1;
+}
+
+// 计算下一段：还有剩余返回 1，完成返回 0，失败返回 -errno
+// （计算期间文件被修改时为 -ESTALE）
+static int hash_step(HashJob& job)
+{
+    off_t stop = std::min(job.end, job.position + HASH_STEP);
+    while (job.position < stop) {
+        size_t want = static_cast<size_t>(
+                std::min<off_t>(stop - job.position, job.buffer.size()));
+        ssize_t n = job.manifest
+                ? job.manifest->pread(job.buffer.data(), want, job.position)
+                : pread(job.fd, job.buffer.data(), want, job.position);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            return -ESTALE; // 文件被截断
+        }
+        job.hasher.update(job.buffer.data(), static_cast<size_t>(n));
+        job.position += n;
+        CacheWindow::apply_drop(job.fd, job.window.advance_read(job.position));
+    }
+    if (job.position < job.end) {
+        return 1;
+    }
+
+    job.digest = job.hasher.finish();
+    struct stat st;
+    if (fstat(job.fd, &st) != 0 ||
+        !job.identity.same_version(FileIdentity::from_stat(st))) {
+        return -ESTALE;
+    }
+    HashCache::instance().insert(
+            job.fd, job.identity, job.algorithm, job.start,
+            job.end - job.start, job.digest);
+    return 0;
+}
+
+// 解析 XCRC/XMD5/XSHA256 的参数：<path> 或 "<path>" [start [end]]
+static bool parse_range(
+        const std::string& params,
+        std::string& path,
+        off_t& start,
+        off_t& end)
+{
+    if (params.empty() || params[0] != '"') {
+        path = params;
+        return !path.empty();
+    }
+    size_t close = params.find('"', 1);
+    if (close == std::string::npos || close == 1) {
+        return false;
+    }
+    path = params.substr(1, close - 1);
+    std::istringstream args(params.substr(close + 1));
+    long long value = 0;
+    if (args >> value) {
+        start = static_cast<off_t>(value);
+        if (args >> value) {
+            end = static_cast<off_t>(value);
+        }
+    }
+    args.clear();
+    std::string rest;
+    if (args >> rest) {
+        return false; // 区间不是数字或多余的参数
+    }
+    return start >= 0 && (end < 0 || end >= start);
+}
+
+void HashCommand::execute(
+        Session& session,
+        const std::string& name,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    if (!require_login(session)) {
+        return;
+    }
+    if (name == "OPTS") {
+        handle_opts(session, params, clientStream_);
+        return;
+    }
+
+    HashRequest request;
+    std::string path = params;
+    if (name == "HASH") {
+        request.algorithm = session.get_hash_algorithm();
+        request.hash = true;
+    } else {
+        request.algorithm = name == "XCRC"  ? HashAlgorithm::CRC32
+                            : name == "XMD5" ? HashAlgorithm::MD5
+                                             : HashAlgorithm::SHA256;
+        if (!parse_range(params, path, request.start, request.end)) {
+            std::string response =
+                    "501 Usage: " + name + " <path> | \"<path>\" [start [end]]\r\n";
+            clientStream_.send(response.c_str(), response.size());
+            return;
+        }
+    }
+    if (path.empty()) {
+        std::string response = "501 Usage: " + name + " <path>\r\n";
+        clientStream_.send(response.c_str(), response.size());
+        return;
+    }
+    request.path = session.get_path_resolver().resolve(path);
+    session.run_command(checksum(
+            session.get_reactor(), request, clientStream_, threadPool));
+}
+
+void HashCommand::handle_opts(
+        Session& session,
+        const std::string& params,
+        ACE_SOCK_Stream& clientStream_)
+{
+    std::istringstream args(params);
+    std::string option;
+    std::string value;
+    args >> option >> value;
+    std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+
+    std::string response;
+    HashAlgorithm algorithm;
+    if (option != "HASH") {
+        response = "501 Option not understood.\r\n";
+    } else if (value.empty()) {
+        response = std::string("200 ") +
+                   hash_algorithm_name(session.get_hash_algorithm()) + "\r\n";
+    } else if (!parse_hash_algorithm(value, algorithm)) {
+        response = "504 Unknown algorithm.\r\n";
+    } else {
+        session.set_hash_algorithm(algorithm);
+        response = std::string("200 ") + hash_algorithm_name(algorithm) + "\r\n";
+    }
+    clientStream_.send(response.c_str(), response.size());
+}
+
+Task<void> HashCommand::checksum(
+        ACE_Reactor* reactor,
+        HashRequest request,
+        ACE_SOCK_Stream& clientStream_,
+        ThreadPool& threadPool)
+{
+    std::shared_ptr<HashJob> job = std::make_shared<HashJob>(request.algorithm);
+    job->start = request.start;
+
+    ResolvedPath path = request.path;
+    off_t end = request.end;
+    Offload<int> opening(reactor, threadPool, [job, path, end] {
+        return open_job(*job, path, end);
+    });
+    std::optional<int> rc = co_await opening;
+    while (rc && *rc == 1) {
+        Offload<int> hashing(
+                reactor, threadPool, [job] { return hash_step(*job); },
+                ThreadPool::ADMITTED);
+        rc = co_await hashing;
+    }
+    if (!rc) {
+        reply_busy(clientStream_, threadPool);
+        co_return;
+    }
+
+    std::string response;
+    if (*rc == -ENOENT || *rc == -ENOTDIR) {
+        response = "550 File not found.\r\n";
+    } else if (*rc == -EISDIR) {
+        response = "550 Not a regular file.\r\n";
+    } else if (*rc == -EINVAL) {
+        response = "501 Invalid range.\r\n";
+    } else if (*rc == -ESTALE) {
+        response = "451 File changed while computing checksum.\r\n";
+    } else if (*rc < 0) {
+        response = "451 Failed to read file: " + std::string(strerror(-*rc)) + "\r\n";
+    } else if (request.hash) {
+        off_t last = job->end > job->start ? job->end - 1 : job->start;
+        response = std::string("213 ") + hash_algorithm_name(request.algorithm) +
+                   " " + std::to_string(job->start) + "-" + std::to_string(last) +
+                   " " + job->digest + " " + request.path.path() + "\r\n";
+    } else {
+        response = "250 " + job->digest + "\r\n";
+    }
+    clientStream_.send(response.c_str(), response.size());
+}
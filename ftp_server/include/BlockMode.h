@@ -0,0 +1,129 @@
+#ifndef BLOCK_MODE_H
+#define BLOCK_MODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+/**
+ * @class BlockMode
+ * @brief FTP 块模式（MODE B，RFC 959 3.4.2）的编码。
+ *
+ * 每块为 3 字节头部（描述符、16 位大端的长度）加数据。文件以带 EOF 描述符的块
+ * 结束，因此数据连接不必关闭，可以留给下一次传输。重启标记是描述符为 RESTART
+ * 的块，内容为可打印字符，本服务器使用十进制的文件偏移。
+ */
+class BlockMode
+{
+public:
+    static constexpr uint8_t END_OF_RECORD = 0x80; ///< 记录结束
+    static constexpr uint8_t END_OF_FILE = 0x40;   ///< 文件结束
+    static constexpr uint8_t SUSPECT = 0x20;       ///< 数据可能有误
+    static constexpr uint8_t RESTART = 0x10;       ///< 重启标记
+    static constexpr size_t HEADER = 3;            ///< 头部长度
+    static constexpr size_t MAX_BLOCK = 65535;     ///< 一块最多的数据字节
+
+    /**
+     * @brief 写入一个头部（HEADER 字节）。
+     */
+    static void header(uint8_t descriptor, size_t count, char* out);
+
+    /**
+     * @brief 把 data 切分为数据块，头部与数据交替追加到 iov。
+     *
+     * 头部存放在 headers 中（替换其内容），发送完成前 headers 与 data 须保持有效。
+     */
+    static void frame(
+            const char* data,
+            size_t size,
+            std::string& headers,
+            std::vector<iovec>& iov);
+
+    /**
+     * @brief 文件结束块（不带数据）。
+     */
+    static std::string end();
+
+    /**
+     * @brief 以文件偏移为内容的重启标记块。
+     */
+    static std::string marker(off_t offset);
+};
+
+/**
+ * @class BlockReader
+ * @brief 块模式接收方的解析状态。
+ *
+ * 接收方每次最多接收 `wanted()` 个字节，因此不会读过文件结束块，
+ * 数据连接上的下一次传输不受影响；`in_data()` 时接收的字节就是文件数据，
+ * 可以直接收到目标缓冲区，送入 `feed()` 只用于计数。
+ */
+class BlockReader
+{
+public:
+    /**
+     * @brief 下一次最多接收的字节数，读到文件结束块后为 0。
+     */
+    size_t wanted() const;
+
+    /**
+     * @brief 是否正在接收数据块的内容。
+     */
+    bool in_data() const { return state_ == DATA; }
+
+    /**
+     * @brief 送入接收到的字节，不超过 `wanted()`。
+     *
+     * @return 成功返回 0，重启标记含不可打印字符时返回 -EBADMSG。
+     */
+    int feed(const char* data, size_t size);
+
+    /**
+     * @brief 是否已读到文件结束块。
+     */
+    bool ended() const { return state_ == ENDED; }
+
+    /**
+     * @brief 已接收的数据字节数（不含头部与重启标记）。
+     */
+    off_t received() const { return received_; }
+
+    /**
+     * @brief 取出最早的重启标记及其之前的数据字节数。
+     *
+     * @param limit 只取之前的数据不超过 limit 字节的标记。
+     * @return 没有这样的标记时返回 false。
+     */
+    bool take_marker(off_t limit, std::string& marker, off_t& position);
+
+    /**
+     * @brief 开始接收下一个文件。
+     */
+    void reset();
+
+private:
+    enum State
+    {
+        HEAD,   ///< 读取头部
+        DATA,   ///< 读取数据
+        MARKER, ///< 读取重启标记
+        ENDED   ///< 已读到文件结束块
+    };
+
+    void finish_block();
+
+    State state_ = HEAD;                ///< 解析状态
+    char head_[BlockMode::HEADER] = {}; ///< 跨分段的头部
+    size_t filled_ = 0;                 ///< head_ 中已有的字节
+    uint8_t descriptor_ = 0;            ///< 当前块的描述符
+    size_t remaining_ = 0;              ///< 当前块剩余的字节
+    std::string marker_;                ///< 正在读取的重启标记
+    off_t received_ = 0;                ///< 已接收的数据字节
+    std::deque<std::pair<std::string, off_t> > markers_; ///< 待取的重启标记
+};
+
+#endif // BLOCK_MODE_H
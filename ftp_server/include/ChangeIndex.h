@@ -0,0 +1,239 @@
+#ifndef CHANGE_INDEX_H
+#define CHANGE_INDEX_H
+
+#include "PathResolver.h"
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * @brief 一次变更列表查询（SITE CHANGES）及其读取位置。
+ *
+ * 结果按变更时间、路径排序，分批读取时下一批从上一批的最后一项之后开始。
+ */
+struct ChangeQuery
+{
+    ResolvedPath dir;       ///< 要查询的目录
+    bool recursive = false; ///< 是否包含子目录中的条目
+    int64_t since = 0;      ///< 起始时间（UTC 纳秒），列出变更时间不早于它的条目
+    int64_t changed = 0;    ///< 已输出的最后一项的变更时间
+    std::string last;       ///< 已输出的最后一项的路径，尚未输出时为空
+    bool deletions = true;  ///< 读取后设置：自 since 以来的删除是否都已报告
+    int64_t now = 0;        ///< 读取第一批时设置：作为下次查询的起始时间
+};
+
+/**
+ * @class ChangeIndex
+ * @brief 按变更时间排序的目录树索引，由 inotify 增量维护，供 SITE CHANGES 使用。
+ *
+ * 同步任务每轮 LIST 整棵树再与上次比较，只为找出少数变化的文件。索引在目录第一次
+ * 被查询时遍历一次，为其中每个目录建立 inotify 监视，之后的查询只读取排序索引中
+ * 起始时间之后的部分，代价与变化的条目数成正比，与树的大小无关。
+ * - 条目的变更时间取 mtime 与 ctime 中较晚者（改名会更新 ctime）；
+ *   移入或新建的目录下的条目按处理事件的时间记录，宁可多报不会漏报；
+ * - 删除和移出的条目以墓碑记录，列为 type=deleted；墓碑数量有上限，
+ *   起始时间早于索引建立或最早被丢弃的墓碑时无法保证删除完整；
+ * - 查询索引根目录之下的目录时复用该索引；索引数、监视数与条目数都有上限，
+ *   超出时淘汰最久未查询的索引，仍无法建立时（或非本地文件系统、inotify 不可用）
+ *   退回完整遍历，结果相同但不报告删除；
+ * - 事件队列溢出时丢弃全部索引，下次查询时重建。
+ *
+ * 方法会阻塞在文件系统上，应在元数据线程池中调用，内部以一把锁保护。
+ * 配置在启动时设置一次。
+ */
+class ChangeIndex
+{
+public:
+    /**
+     * @brief 索引统计。
+     */
+    struct Stats
+    {
+        uint64_t queries = 0;   ///< 查询次数（每次查询的第一批）
+        uint64_t builds = 0;    ///< 建立索引的次数
+        uint64_t fallbacks = 0; ///< 退回完整遍历的次数
+        uint64_t events = 0;    ///< 处理的 inotify 事件数
+        uint64_t overflows = 0; ///< 事件队列溢出次数
+        size_t roots = 0;       ///< 当前索引数
+        size_t watches = 0;     ///< 当前监视的目录数
+        size_t entries = 0;     ///< 当前条目数（含墓碑）
+    };
+
+    ChangeIndex() = default;
+    ~ChangeIndex();
+    ChangeIndex(const ChangeIndex&) = delete;
+    ChangeIndex& operator=(const ChangeIndex&) = delete;
+
+    /**
+     * @brief 获取全局索引实例。
+     */
+    static ChangeIndex& instance();
+
+    /**
+     * @brief 设置索引参数并丢弃全部索引。
+     *
+     * @param maxRoots 最多同时维护的索引数，0 表示关闭（总是完整遍历）。
+     * @param maxWatches 全部索引最多监视的目录数。
+     * @param maxEntries 全部索引最多的条目数。
+     * @param maxDeleted 每个索引最多保留的墓碑数。
+     * @return inotify 可用返回 true；不可用时关闭索引并返回 false。
+     */
+    bool configure(
+            size_t maxRoots,
+            size_t maxWatches,
+            size_t maxEntries,
+            size_t maxDeleted);
+
+    /**
+     * @brief 索引是否开启。
+     */
+    bool enabled() const { return inotifyFd_ != -1; }
+
+    /**
+     * @brief 读取下一批变更，每行为 MLSD 事实串加相对于查询目录的路径。
+     *
+     * @param query 查询及读取位置，读取后更新。
+     * @param out 输出缓冲，追加 "\r\n" 结尾的行。
+     * @param count 本批最多的条目数。
+     * @return 还有更多内容返回 1，已读完返回 0，出错返回 -errno
+     *         （不是目录时为 -ENOTDIR）。
+     */
+    int read(ChangeQuery& query, std::string& out, size_t count);
+
+    /**
+     * @brief 当前时间（UTC 纳秒），取自文件时间戳所用的粗粒度时钟：
+     * 此后发生的变更，其变更时间都不早于返回值。同一时钟周期内的变更会在
+     * 以它为起始时间的下次查询中再次列出。
+     */
+    static int64_t now();
+
+    /**
+     * @brief 获取统计数据。
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @brief 索引中的一个条目。
+     */
+    struct Node
+    {
+        int64_t changed = 0;    ///< 变更时间（纳秒）
+        bool deleted = false;   ///< 是否为墓碑
+        bool directory = false; ///< 是否为目录（不含指向目录的符号链接）
+        int wd = -1;            ///< 目录的 inotify 监视描述符，文件为 -1
+    };
+
+    /**
+     * @brief 一个被索引的目录树。
+     */
+    struct Root
+    {
+        ResolvedPath base;                            ///< 根目录
+        std::map<std::string, Node> nodes;            ///< 按虚拟路径排序的条目
+        std::set<std::pair<int64_t, std::string> > byTime; ///< 按变更时间排序
+        std::deque<std::pair<int64_t, std::string> > tombstones; ///< 按删除时间
+        int64_t deletionsFrom = 0; ///< 此时间之后的删除都有墓碑
+        int wd = -1;                                  ///< 根目录的监视描述符
+    };
+
+    typedef std::list<Root>::iterator RootIt;
+
+    /**
+     * @brief 一个监视描述符对应的索引和目录。
+     */
+    struct Watch
+    {
+        RootIt root;      ///< 所属索引
+        std::string path; ///< 目录的虚拟路径
+    };
+
+    /**
+     * @brief 查找覆盖目录的索引，必要时建立，调用方持有锁。
+     *
+     * @return 成功返回 0；无法建立索引返回 1（调用方退回完整遍历）；
+     *         目录无法打开返回 -errno。
+     */
+    int find_root(const ResolvedPath& dir, RootIt& root);
+
+    /**
+     * @brief 遍历已打开的目录，为其中每个目录建立监视并加入条目，调用方持有锁。
+     *
+     * @param floor 条目变更时间的下限（新移入的目录为当前时间，建立索引时为 0）。
+     * @return 成功返回 true；超出监视数或条目数上限返回 false。
+     */
+    bool index_tree(RootIt root, int dirfd, const std::string& path, int64_t floor);
+
+    /**
+     * @brief 读取并处理所有待处理的 inotify 事件，调用方持有锁。
+     */
+    void drain();
+
+    /**
+     * @brief 目录项被创建或修改后重新 stat 并更新，调用方持有锁。
+     */
+    void update(RootIt root, const std::string& path, bool created);
+
+    /**
+     * @brief 目录项被删除或移出后删除其条目（目录连同其下的条目与监视）
+     * 并记录墓碑，调用方持有锁。
+     */
+    void remove(RootIt root, const std::string& path);
+
+    /**
+     * @brief 删除目录下的全部条目并移除目录自身及其下的监视，调用方持有锁。
+     */
+    void erase_subtree(Root& root, const std::string& path);
+
+    /**
+     * @brief 插入或更新条目，目录的属性变化保留其监视，调用方持有锁。
+     */
+    void set_node(Root& root, const std::string& path, const Node& node);
+
+    /**
+     * @brief 移除一个监视，调用方持有锁。
+     */
+    void drop_watch(int wd);
+
+    /**
+     * @brief 丢弃一个索引并移除其全部监视，调用方持有锁。
+     */
+    void erase_root(RootIt root);
+
+    /**
+     * @brief 不使用索引：完整遍历目录并输出全部结果。
+     */
+    int walk(ChangeQuery& query, std::string& out);
+
+    /**
+     * @brief 输出一个条目（路径相对于查询目录），条目已消失时不输出。
+     */
+    static void append_change(
+            const ChangeQuery& query,
+            const std::string& path,
+            bool deleted,
+            std::string& out);
+
+    mutable std::mutex mutex_;
+    int inotifyFd_ = -1;                       ///< inotify 实例
+    size_t maxRoots_ = 0;                      ///< 最大索引数
+    size_t maxWatches_ = 0;                    ///< 最大监视数
+    size_t maxEntries_ = 0;                    ///< 最大条目数
+    size_t maxDeleted_ = 0;                    ///< 每个索引的最大墓碑数
+    size_t entries_ = 0;                       ///< 全部索引的条目数
+    std::list<Root> roots_;                    ///< 表头最近查询
+    std::unordered_map<int, Watch> watches_;   ///< 按监视描述符索引
+    uint64_t queries_ = 0;                     ///< 查询次数
+    uint64_t builds_ = 0;                      ///< 建立索引次数
+    uint64_t fallbacks_ = 0;                   ///< 完整遍历次数
+    uint64_t events_ = 0;                      ///< 事件数
+    uint64_t overflows_ = 0;                   ///< 溢出次数
+};
+
+#endif // CHANGE_INDEX_H
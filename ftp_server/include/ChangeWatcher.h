@@ -0,0 +1,260 @@
+#ifndef CHANGE_WATCHER_H
+#define CHANGE_WATCHER_H
+
+#include "PathResolver.h"
+#include <ace/Event_Handler.h>
+#include <ace/Reactor.h>
+#include <ace/SOCK_Stream.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * @class WatchSink
+ * @brief 一个会话的变更通知出口（SITE WATCH）。
+ *
+ * 监视线程把合并好的通知块追加到待发送缓冲，再通过 `notify()` 回到会话所属的
+ * Reactor 线程，在 `handle_exception()` 中写入控制连接。与 `OffloadState` 一样，
+ * 对象在通知送达前保持自身存活，会话关闭后迟到的通知只会被丢弃。
+ * 会话有命令或传输在等待回复时通知被暂缓（`hold(true)`），否则客户端会把它当作
+ * 那条命令的回复；最终回复发出后（`hold(false)`）再一并发送。
+ * 待发送内容超过上限（客户端长时间不读取或长时间暂缓）时替换为一条溢出通知。
+ */
+class WatchSink: public ACE_Event_Handler,
+                 public std::enable_shared_from_this<WatchSink>
+{
+public:
+    WatchSink(ACE_Reactor* reactor, ACE_SOCK_Stream& stream, std::string path);
+
+    /**
+     * @brief 追加一个通知块并唤醒 Reactor 线程，可在任意线程调用。
+     */
+    void post(const std::string& block);
+
+    /**
+     * @brief 停止写入控制连接，在 Reactor 线程中调用。
+     */
+    void detach() { stream_ = nullptr; }
+
+    /**
+     * @brief 暂缓或恢复发送，在 Reactor 线程中调用；恢复时发送暂缓的通知。
+     */
+    void hold(bool held);
+
+    /**
+     * @brief 订阅是否生效（订阅成功后到取消前）。
+     */
+    bool active() const { return active_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 在 Reactor 线程中发送待发送的通知。
+     */
+    int handle_exception(ACE_HANDLE fd) override;
+
+private:
+    friend class ChangeWatcher;
+
+    /**
+     * @brief 取出待发送的通知并写入控制连接，在 Reactor 线程中调用。
+     */
+    void deliver();
+
+    ACE_Reactor* reactor_;              ///< 会话所属的 Reactor
+    ACE_SOCK_Stream* stream_;           ///< 控制连接，会话关闭后为空
+    std::string path_;                  ///< 订阅的目录，用于溢出通知
+    std::mutex mutex_;                  ///< 保护待发送缓冲
+    std::string pending_;               ///< 待发送的通知
+    bool overflowed_ = false;           ///< 待发送缓冲已替换为溢出通知
+    bool notified_ = false;             ///< 已请求 Reactor 发送
+    bool held_ = false;                 ///< 暂缓发送（只在 Reactor 线程中访问）
+    std::atomic<bool> active_{false};   ///< 订阅是否生效
+    std::shared_ptr<WatchSink> self_;   ///< 通知送达前保持存活
+};
+
+/**
+ * @class ChangeWatcher
+ * @brief 供 SITE WATCH 使用的共享 inotify 监视器，向订阅的会话推送合并后的变更。
+ *
+ * 同步客户端用 SITE CHANGES 轮询时仍有轮询间隔的延迟；订阅后服务器在变化发生时
+ * 主动通知。全部会话共用一个 inotify 实例和一个监视线程，同一目录只建立一个监视，
+ * 由覆盖它的订阅共享。
+ * - 订阅覆盖目录的直接子项，递归订阅覆盖整棵树，之后新建或移入的子目录
+ *   也会被监视，其中已有的条目报告为 created；
+ * - 同一路径在一个批次内的多次事件合并为一条：新建后修改仍为 created，
+ *   新建后删除不报告，删除后新建为 modified；
+ * - 第一条事件之后等待一个批次间隔再推送，多条变化合为一个通知块；
+ *   一个批次内的路径数超过上限或 inotify 事件队列溢出时改为推送溢出通知，
+ *   客户端应以 SITE CHANGES 重新同步。
+ *
+ * 订阅会阻塞在文件系统上（遍历目录树），应在元数据线程池中调用；
+ * 取消订阅可在任意线程调用。配置在启动时设置一次。
+ */
+class ChangeWatcher
+{
+public:
+    /**
+     * @brief 监视统计。
+     */
+    struct Stats
+    {
+        uint64_t subscriptions = 0; ///< 累计订阅次数
+        uint64_t events = 0;        ///< 处理的 inotify 事件数
+        uint64_t batches = 0;       ///< 推送的通知块数
+        uint64_t overflows = 0;     ///< 推送的溢出通知数
+        size_t active = 0;          ///< 当前订阅数
+        size_t watches = 0;         ///< 当前监视的目录数
+    };
+
+    ChangeWatcher() = default;
+    ~ChangeWatcher();
+    ChangeWatcher(const ChangeWatcher&) = delete;
+    ChangeWatcher& operator=(const ChangeWatcher&) = delete;
+
+    /**
+     * @brief 获取全局监视器实例。
+     */
+    static ChangeWatcher& instance();
+
+    /**
+     * @brief 设置参数，取消全部订阅并（在开启时）启动监视线程。
+     *
+     * @param maxWatches 全部订阅最多监视的目录数，0 表示关闭。
+     * @param batchMillis 批次间隔（毫秒）。
+     * @param maxPending 一个订阅在一个批次内最多的路径数。
+     * @return inotify 可用返回 true；不可用时关闭并返回 false。
+     */
+    bool configure(size_t maxWatches, int batchMillis, size_t maxPending);
+
+    /**
+     * @brief 停止监视线程并取消全部订阅。
+     *
+     * 推送会通知订阅会话的 Reactor，须在 Reactor 停止之前调用。
+     */
+    void close();
+
+    /**
+     * @brief 监视器是否开启。
+     */
+    bool enabled() const { return inotifyFd_ != -1; }
+
+    /**
+     * @brief 订阅目录的变更。
+     *
+     * @param dir 要监视的目录（本地文件系统）。
+     * @param recursive 是否包括子目录。
+     * @param sink 通知出口，成功后标记为生效。
+     * @return 成功返回 0；目录无法打开返回 -errno（不是目录时为 -ENOTDIR）；
+     *         超出监视数上限返回 -ENOSPC；目录已以其他路径被监视返回 -EEXIST。
+     */
+    int subscribe(
+            const ResolvedPath& dir,
+            bool recursive,
+            const std::shared_ptr<WatchSink>& sink);
+
+    /**
+     * @brief 取消订阅并移除不再被任何订阅覆盖的监视。
+     */
+    void unsubscribe(const std::shared_ptr<WatchSink>& sink);
+
+    /**
+     * @brief 获取统计数据。
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @brief 变更类型，合并时按规则转换。
+     */
+    enum class Change
+    {
+        CREATED,
+        MODIFIED,
+        DELETED
+    };
+
+    /**
+     * @brief 一个订阅及其当前批次中尚未推送的变更。
+     */
+    struct Subscription
+    {
+        ResolvedPath dir;                        ///< 订阅的目录
+        bool recursive = false;                  ///< 是否包括子目录
+        std::shared_ptr<WatchSink> sink;         ///< 通知出口
+        std::map<std::string, Change> pending;   ///< 按虚拟路径合并的变更
+        bool overflowed = false;                 ///< 本批次已溢出
+    };
+
+    typedef std::list<Subscription>::iterator SubscriptionIt;
+
+    /**
+     * @brief 监视线程：等待事件，合并到订阅中，批次到期时推送。
+     */
+    void run();
+
+    /**
+     * @brief 读取并处理所有待处理的 inotify 事件，调用方持有锁。
+     */
+    void drain();
+
+    /**
+     * @brief 把一条变更合并到覆盖该路径的订阅中，调用方持有锁。
+     */
+    void record(const std::string& path, Change change);
+
+    /**
+     * @brief 推送全部订阅的待推送变更，调用方持有锁。
+     */
+    void flush();
+
+    /**
+     * @brief 为已打开的目录及（recursive 时）其下的子目录建立监视，调用方持有锁。
+     *
+     * @param report 是否把遍历到的条目记录为 created（新移入的目录）。
+     * @return 成功返回 0，失败返回 -ENOSPC 或 -EEXIST。
+     */
+    int watch_tree(int dirfd, const std::string& path, bool recursive, bool report);
+
+    /**
+     * @brief 目录是否被某个订阅覆盖（需要监视），调用方持有锁。
+     *
+     * @param recursiveOnly 只考虑递归订阅（判断新子目录是否需要监视）。
+     */
+    SubscriptionIt covering(const std::string& dir, bool recursiveOnly);
+
+    /**
+     * @brief 移除目录自身及其下的监视，调用方持有锁。
+     */
+    void drop_subtree(const std::string& dir);
+
+    /**
+     * @brief 移除不再被任何订阅覆盖的监视，调用方持有锁。
+     */
+    void prune();
+
+    mutable std::mutex mutex_;
+    int inotifyFd_ = -1;                          ///< inotify 实例
+    int wakeFd_ = -1;                             ///< 唤醒监视线程的 eventfd
+    std::thread thread_;                          ///< 监视线程
+    std::atomic<bool> stopping_{false};           ///< 监视线程应退出
+    size_t maxWatches_ = 0;                       ///< 最大监视数
+    std::chrono::milliseconds batch_{0};          ///< 批次间隔
+    size_t maxPending_ = 0;                       ///< 每批次的最大路径数
+    bool due_ = false;                            ///< 有待推送的变更
+    std::chrono::steady_clock::time_point deadline_; ///< 本批次的推送时间
+    std::list<Subscription> subscriptions_;       ///< 全部订阅
+    std::map<std::string, int> byPath_;           ///< 监视的目录到监视描述符
+    std::unordered_map<int, std::string> byWd_;   ///< 监视描述符到目录
+    uint64_t subscribed_ = 0;                     ///< 累计订阅次数
+    uint64_t events_ = 0;                         ///< 事件数
+    uint64_t batches_ = 0;                        ///< 通知块数
+    uint64_t overflows_ = 0;                      ///< 溢出通知数
+};
+
+#endif // CHANGE_WATCHER_H
@@ -27,11 +27,13 @@ public:
      * @param clientStream 用于与客户端通信的套接字流。
      * @param reactor 指向 Reactor 的指针，用于处理事件。
      * @param threadPool 线程池，用于管理并发任务。
+     * @param uring Reactor 的 io_uring 实例，为 nullptr 时传输使用线程池路径。
      */
     explicit ClientHandler(
             ACE_SOCK_Stream& clientStream,
             ACE_Reactor* reactor,
-            ThreadPool& threadPool);
+            ThreadPool& threadPool,
+            IoUring* uring = nullptr);
 
     /**
      * @brief 析构函数，清理资源。
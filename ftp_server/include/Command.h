@@ -72,6 +72,23 @@ protected:
         }
         return true;
     }
+
+    /**
+     * @brief 线程池拒绝操作时回复客户端。
+     *
+     * 线程池已关闭时回复 421，队列已满时回复 450，客户端稍后重试即可。
+     *
+     * @param clientStream_ 与客户端通信的流。
+     * @param pool 拒绝操作的线程池。
+     */
+    static void reply_busy(ACE_SOCK_Stream& clientStream_, const ThreadPool& pool)
+    {
+        std::string response =
+                pool.is_open()
+                        ? "450 Server busy. Try again later.\r\n"
+                        : "421 Service not available, server shutting down.\r\n";
+        clientStream_.send(response.c_str(), response.size());
+    }
 };
 
 #endif // COMMAND_H
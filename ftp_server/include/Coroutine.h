@@ -0,0 +1,194 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+template<typename T = void>
+class Task;
+
+namespace detail {
+
+/**
+ * @brief Task 协程 promise 的公共部分：惰性启动，结束时对称转移到等待者。
+ */
+struct TaskPromiseBase
+{
+    /**
+     * @brief 协程结束时恢复等待该 Task 的协程（若有）。
+     */
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation =
+                    handle.promise().continuation_;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { exception_ = std::current_exception(); }
+
+    std::coroutine_handle<> continuation_; ///< 等待该 Task 完成的协程
+    std::exception_ptr exception_;         ///< 协程内抛出的异常
+};
+
+template<typename T>
+struct TaskPromise: TaskPromiseBase
+{
+    Task<T> get_return_object();
+    void return_value(T value) { value_ = std::move(value); }
+
+    T result()
+    {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+        return std::move(*value_);
+    }
+
+    std::optional<T> value_; ///< 协程的返回值
+};
+
+template<>
+struct TaskPromise<void>: TaskPromiseBase
+{
+    Task<void> get_return_object();
+    void return_void() const noexcept {}
+
+    void result()
+    {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+};
+
+} // namespace detail
+
+/**
+ * @class Task
+ * @brief 惰性启动的协程任务类型。
+ *
+ * Task 在创建时不执行，被 `co_await` 或调用 `start()` 时才开始运行。
+ * 在另一个协程中 `co_await` 一个 Task 时，等待者在 Task 结束后通过对称转移恢复，
+ * 不会增加调用栈深度。Task 对象拥有协程帧，析构时销毁协程帧：
+ * 对于挂起在 Reactor 上的协程，帧内的等待对象会在析构时自动注销，
+ * 因此会话关闭时只需销毁 Task 即可取消正在进行的传输。
+ *
+ * 协程只应在其所属 Reactor 线程上恢复和销毁。
+ *
+ * 注意：GCC 12 对 if 条件中的 `co_await` 以及被 `co_await` 的临时 awaitable
+ * 存在代码生成缺陷（协程帧未初始化、临时对象重复析构），
+ * 应先把 awaitable 和 `co_await` 的结果存入具名局部变量再使用。
+ *
+ * @tparam T 协程返回值类型。
+ */
+template<typename T>
+class Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(handle_type handle): handle_(handle) {}
+    Task(Task&& other) noexcept: handle_(std::exchange(other.handle_, {})) {}
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    /**
+     * @brief 启动一个顶层协程，运行到第一个挂起点后返回。
+     */
+    void start()
+    {
+        if (handle_ && !handle_.done()) {
+            handle_.resume();
+        }
+    }
+
+    /**
+     * @brief 检查协程是否持有协程帧且尚未运行结束。
+     */
+    bool active() const { return handle_ && !handle_.done(); }
+
+    /**
+     * @brief 销毁协程帧（若有），取消尚未完成的协程。
+     */
+    void reset()
+    {
+        if (handle_) {
+            handle_.destroy();
+            handle_ = {};
+        }
+    }
+
+    /**
+     * @brief 在另一个协程中等待该 Task 完成并获取结果。
+     */
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            handle_type handle_;
+
+            bool await_ready() const noexcept
+            {
+                return !handle_ || handle_.done();
+            }
+
+            std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<> waiter) noexcept
+            {
+                handle_.promise().continuation_ = waiter;
+                return handle_;
+            }
+
+            T await_resume() { return handle_.promise().result(); }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    handle_type handle_; ///< 协程帧句柄
+};
+
+namespace detail {
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T> >::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(
+            std::coroutine_handle<TaskPromise<void> >::from_promise(*this));
+}
+
+} // namespace detail
+
+#endif // COROUTINE_H
@@ -0,0 +1,138 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+/**
+ * @class CpuAffinity
+ * @brief CPU 绑定与 NUMA 本地内存分配的工具类。
+ *
+ * 接收线程、各个 Reactor 线程和线程池线程可以分别绑定到配置的 CPU 上。
+ * 线程绑定之后，`alloc_local` 分配的内存位于该线程所在的 NUMA 节点；
+ * 传输缓冲区经由 `LocalBufferPool` 复用，避免 RETR/STOR 热路径上的跨节点内存访问。
+ * 所有接口在不支持的平台或调用失败时静默退化为普通行为。
+ */
+class CpuAffinity
+{
+public:
+    /**
+     * @brief 解析 CPU 列表字符串。
+     *
+     * 格式与 taskset/cpuset 一致，如 "0-3,8,10-11"。无法解析的部分会被忽略。
+     *
+     * @param spec CPU 列表字符串。
+     * @return CPU 编号列表，保持书写顺序。
+     */
+    static std::vector<int> parse_cpu_list(const std::string& spec);
+
+    /**
+     * @brief 将当前线程绑定到指定 CPU。
+     *
+     * @param cpu CPU 编号，小于 0 表示不绑定。
+     * @return 绑定成功返回 true。
+     */
+    static bool pin_current_thread(int cpu);
+
+    /**
+     * @brief 查询指定 CPU 所属的 NUMA 节点。
+     *
+     * @param cpu CPU 编号。
+     * @return NUMA 节点编号，无法确定时返回 -1。
+     */
+    static int numa_node_of_cpu(int cpu);
+
+    /**
+     * @brief 查询当前线程所在的 NUMA 节点。
+     *
+     * @return NUMA 节点编号，无法确定时返回 -1。
+     */
+    static int current_numa_node();
+
+    /**
+     * @brief 在当前线程所在的 NUMA 节点上分配内存。
+     *
+     * 使用 mmap 分配并通过 mbind 设置首选节点，随后立即由当前线程首次写入，
+     * 保证物理页落在本地节点。
+     *
+     * @param size 分配大小（字节）。
+     * @return 内存指针，失败时返回 nullptr。
+     */
+    static void* alloc_local(size_t size);
+
+    /**
+     * @brief 释放 `alloc_local` 分配的内存。
+     *
+     * @param ptr 内存指针。
+     * @param size 分配时的大小。
+     */
+    static void free_local(void* ptr, size_t size);
+};
+
+/**
+ * @class LocalBufferPool
+ * @brief 一个线程的 NUMA 本地传输缓冲区空闲表。
+ *
+ * 缓冲区由所属线程以 `alloc_local` 分配，归还后留在空闲表中供之后的传输复用，
+ * 每次传输不再需要 mmap、mbind、首次写入和 munmap。归还可以在任意线程进行
+ * （传输状态可能由线程池任务最后释放），缓冲区仍位于分配它的线程所在的节点。
+ * 空闲表最多保留 MAX_FREE 个缓冲区，多出的直接释放。
+ */
+class LocalBufferPool
+{
+public:
+    static constexpr size_t MAX_FREE = 32; ///< 空闲表最多保留的缓冲区数
+
+    /**
+     * @brief 构造函数。
+     *
+     * @param bufferSize 每个缓冲区的大小（字节）。
+     */
+    explicit LocalBufferPool(size_t bufferSize);
+
+    /**
+     * @brief 析构函数，释放空闲表中的缓冲区。
+     */
+    ~LocalBufferPool();
+
+    LocalBufferPool(const LocalBufferPool&) = delete;
+    LocalBufferPool& operator=(const LocalBufferPool&) = delete;
+
+    /**
+     * @brief 获取当前线程的空闲表，首次调用时创建。
+     *
+     * 持有者（如传输状态）可在线程退出后继续归还缓冲区。
+     *
+     * @param bufferSize 缓冲区大小，同一线程的调用须使用相同的大小。
+     */
+    static std::shared_ptr<LocalBufferPool> current(size_t bufferSize);
+
+    /**
+     * @brief 取出一个缓冲区，空闲表为空时在当前线程所在的节点上分配。
+     *
+     * @return 缓冲区指针，失败时返回 nullptr。
+     */
+    char* acquire();
+
+    /**
+     * @brief 归还 `acquire` 取出的缓冲区，可在任意线程调用。
+     *
+     * @param buffer 缓冲区指针，可为 nullptr。
+     */
+    void release(char* buffer);
+
+    /**
+     * @brief 空闲表中的缓冲区数。
+     */
+    size_t free_count() const;
+
+private:
+    size_t bufferSize_;        ///< 每个缓冲区的大小
+    mutable std::mutex mutex_; ///< 保护空闲表
+    std::vector<char*> free_;  ///< 空闲的缓冲区
+};
+
+#endif // CPU_AFFINITY_H
@@ -0,0 +1,225 @@
+#ifndef DEDUP_STORE_H
+#define DEDUP_STORE_H
+
+#include "FastCdc.h"
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @class DedupStore
+ * @brief 内容寻址的去重分块存储。
+ *
+ * 开启后 STOR 的数据以 FastCDC 切分，每个分块以 SHA-256 命名保存在
+ * `<目录>/<前 2 位>/<其余 62 位>` 中，相同内容只保存一次；上传的文件本身
+ * 只保存清单（manifest）：
+ * - 文件开头是清单文本，首行 "FTPDEDUP 1 <大小> <分块数>"，之后每行
+ *   "<sha256> <长度>"；文件截断（稀疏扩展）到逻辑大小，SIZE/MLST 等
+ *   元数据不变；
+ * - 扩展属性 `user.ftp_server.manifest` 记录清单文本的长度，作为标记；
+ * - RETR、HASH、SITE COPY 检查标记，以 `ManifestReader` 按清单读取分块。
+ *
+ * 小于最小分块的文件直接写入数据；目标文件系统不支持扩展属性时还原为
+ * 普通文件。分块不会被回收：没有清单引用的分块需要离线清理。
+ *
+ * 方法会访问文件系统，应在线程池中调用；配置在启动时设置一次。
+ */
+class DedupStore
+{
+public:
+    /**
+     * @brief 存储统计。
+     */
+    struct Stats
+    {
+        uint64_t chunksStored = 0; ///< 新保存的分块数
+        uint64_t chunksShared = 0; ///< 已存在、被去重的分块数
+        uint64_t bytesStored = 0;  ///< 新保存的字节数
+        uint64_t bytesShared = 0;  ///< 去重省下的字节数
+        uint64_t manifests = 0;    ///< 写入的清单数
+    };
+
+    DedupStore() = default;
+    ~DedupStore();
+    DedupStore(const DedupStore&) = delete;
+    DedupStore& operator=(const DedupStore&) = delete;
+
+    /**
+     * @brief 获取全局存储实例。
+     */
+    static DedupStore& instance();
+
+    /**
+     * @brief 设置分块目录（不存在时创建）与分块大小。
+     *
+     * @param directory 分块目录，空串关闭去重。
+     * @return 成功返回 0，失败返回 -errno（去重保持关闭）。
+     */
+    int configure(
+            const std::string& directory,
+            size_t minChunk,
+            size_t avgChunk,
+            size_t maxChunk);
+
+    /**
+     * @brief 是否开启去重。
+     */
+    bool enabled() const { return dirfd_ != -1; }
+
+    /**
+     * @brief 分块器。
+     */
+    const FastCdc& chunker() const { return chunker_; }
+
+    /**
+     * @brief 保存一个分块，已存在时只计数。
+     *
+     * @param digest 分块的 SHA-256。
+     * @param sync 新分块是否落盘（fdatasync）后再改名。
+     * @param created 返回是否新建了分块。
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int put(const std::string& digest, const char* data, size_t size, bool sync, bool& created);
+
+    /**
+     * @brief 以只读方式打开分块。
+     *
+     * @return 文件描述符，失败返回 -errno。
+     */
+    int open_chunk(const std::string& digest) const;
+
+    /**
+     * @brief 落盘分块子目录（新分块的目录项）。
+     *
+     * @param prefixes 子目录名（摘要的前 2 位）。
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int sync_directories(const std::set<std::string>& prefixes) const;
+
+    /**
+     * @brief 把清单写入文件：开头写清单文本，截断到逻辑大小，设置标记。
+     *
+     * @return 成功返回 0，失败返回 -errno（不支持扩展属性时为 -ENOTSUP）。
+     */
+    int write_manifest(int fd, const std::string& text, off_t size);
+
+    /**
+     * @brief 获取统计。
+     */
+    Stats stats() const;
+
+private:
+    int dirfd_ = -1;  ///< 分块目录（O_PATH）
+    FastCdc chunker_; ///< 分块器
+
+    std::atomic<uint64_t> chunksStored_{0};
+    std::atomic<uint64_t> chunksShared_{0};
+    std::atomic<uint64_t> bytesStored_{0};
+    std::atomic<uint64_t> bytesShared_{0};
+    std::atomic<uint64_t> manifests_{0};
+};
+
+/**
+ * @class DedupWriter
+ * @brief 一次 STOR 的去重写入：边接收边分块保存，结束时写清单。
+ *
+ * 数据先缓冲，凑满最大分块后才切分，切点与数据到达的节奏无关。
+ */
+class DedupWriter
+{
+public:
+    /**
+     * @param sync 新分块及其目录是否落盘（上传要求持久化时）。
+     */
+    explicit DedupWriter(bool sync);
+
+    /**
+     * @brief 追加数据，保存已完整的分块。
+     *
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int write(const char* data, size_t size);
+
+    /**
+     * @brief 保存剩余数据并把清单（或小文件的数据）写入 fd。
+     *
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int finish(int fd);
+
+    /**
+     * @brief 已写入的逻辑字节数。
+     */
+    off_t size() const { return size_; }
+
+private:
+    int store(const char* data, size_t size);
+
+    bool sync_;                   ///< 是否落盘
+    std::vector<char> pending_;   ///< 尚未分块的数据
+    std::string entries_;         ///< 清单的分块行
+    size_t count_ = 0;            ///< 分块数
+    off_t size_ = 0;              ///< 逻辑大小
+    std::set<std::string> touched_; ///< 新建了分块的子目录
+};
+
+/**
+ * @class ManifestReader
+ * @brief 按清单读取去重文件的内容。
+ */
+class ManifestReader
+{
+public:
+    ManifestReader() = default;
+    ~ManifestReader();
+    ManifestReader(const ManifestReader&) = delete;
+    ManifestReader& operator=(const ManifestReader&) = delete;
+
+    /**
+     * @brief 检查文件是否为清单并加载。
+     *
+     * @return 是清单返回 1，普通文件返回 0，失败返回 -errno（清单损坏为 -EIO）。
+     */
+    int open(int fd);
+
+    /**
+     * @brief 解析清单文本。
+     *
+     * @return 成功返回 0，格式错误返回 -EIO。
+     */
+    int load(const std::string& text);
+
+    /**
+     * @brief 与 pread 相同：读取逻辑偏移处的数据，失败返回 -1 并设置 errno。
+     */
+    ssize_t pread(char* buffer, size_t size, off_t offset);
+
+    /**
+     * @brief 逻辑大小。
+     */
+    off_t size() const { return size_; }
+
+    /**
+     * @brief 清单文本。
+     */
+    const std::string& text() const { return text_; }
+
+private:
+    struct Chunk
+    {
+        off_t offset;       ///< 逻辑偏移
+        size_t length;      ///< 长度
+        std::string digest; ///< SHA-256
+    };
+
+    std::vector<Chunk> chunks_; ///< 按偏移排列的分块
+    std::string text_;          ///< 清单文本
+    off_t size_ = 0;            ///< 逻辑大小
+    size_t current_ = 0;        ///< chunkFd_ 对应的分块
+    int chunkFd_ = -1;          ///< 当前打开的分块
+};
+
+#endif // DEDUP_STORE_H
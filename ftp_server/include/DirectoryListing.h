@@ -0,0 +1,193 @@
+#ifndef DIRECTORY_LISTING_H
+#define DIRECTORY_LISTING_H
+
+#include "PathResolver.h"
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+/**
+ * @brief 目录列表的输出格式。
+ */
+enum class ListFormat
+{
+    LIST, ///< LIST：与 `ls -ln` 相同的长格式
+    MLSD  ///< MLSD：RFC 3659 机器可读的事实列表
+};
+
+/**
+ * @brief 一次目录列表请求（LIST/MLSD 或 SITE 分页列表）。
+ */
+struct ListingRequest
+{
+    ResolvedPath path;                    ///< 要列出的目录（LIST 也可以是文件）
+    ListFormat format = ListFormat::LIST; ///< 输出格式
+    bool hidden = false;                  ///< LIST 是否包含以 '.' 开头的目录项
+    bool paged = false;                   ///< 是否为分页列表
+    off_t cursor = 0;                     ///< 分页：起始游标，0 表示目录开头
+    size_t count = 0;                     ///< 分页：本页最多的条目数
+    bool recursive = false;               ///< 是否递归列出子目录
+    int depth = 0;                        ///< 递归：最多列出的层数，0 表示不限
+};
+
+/**
+ * @class DirectoryReader
+ * @brief 用 getdents64/statx 逐批读取并格式化目录内容，取代 popen("ls")。
+ *
+ * `read()` 按需调用 getdents64，对每个目录项以目录 fd 为基准 statx，
+ * 直接格式化为列表行，调用方可边读边发送，大目录无需整体缓存在内存中。
+ * LIST 列出的是单个文件时只输出该文件一行；LIST 默认与 `ls -l` 一样跳过以 '.'
+ * 开头的目录项，MLSD 只跳过 "." 和 ".."。输出按目录中的存储顺序，不排序。
+ * 非本地文件系统的目录在打开时由 `FileSystem::read_directory()` 一次取得，
+ * 游标由文件系统定义。
+ * 方法会阻塞在文件系统上，应在线程池中调用。
+ */
+class DirectoryReader
+{
+public:
+    DirectoryReader();
+    ~DirectoryReader();
+    DirectoryReader(const DirectoryReader&) = delete;
+    DirectoryReader& operator=(const DirectoryReader&) = delete;
+
+    /**
+     * @brief 打开要列出的目录（LIST 也可以是单个文件）。
+     *
+     * @param path 目录或文件路径（在会话根目录内解析）。
+     * @param format 输出格式。
+     * @param hidden LIST 是否包含以 '.' 开头的目录项（`LIST -a`）。
+     * @return 成功返回 0，失败返回 -errno（MLSD 指定文件时为 -ENOTDIR）。
+     */
+    int open(const ResolvedPath& path, ListFormat format, bool hidden = false);
+
+    /**
+     * @brief 读取下一批目录项并追加格式化后的行。
+     *
+     * @param out 输出缓冲，追加 "\r\n" 结尾的行。
+     * @param limit 输出达到该长度后返回。
+     * @param remaining 不为空时为本次最多输出的条目数，每输出一条减一，减到 0 时返回。
+     * @return 还有更多内容返回 1，已读完返回 0，出错返回 -errno。
+     */
+    int read(std::string& out, size_t limit, size_t* remaining = nullptr);
+
+    /**
+     * @brief 从游标处继续读取目录（分页列表）。
+     *
+     * @param cursor 之前由 `position()` 返回的游标，0 表示目录开头。
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int seek(off_t cursor);
+
+    /**
+     * @brief 最后一个已处理目录项之后的游标（getdents64 的 d_off），
+     * 文件系统保证其在目录修改后仍可用于 `seek()`。
+     */
+    off_t position() const { return position_; }
+
+    /**
+     * @brief 递归列表：记录读到的子目录（不跟随符号链接），MLSD 名称前加相对路径。
+     *
+     * @param prefix 本目录相对于列表根目录的路径，根目录为空。
+     */
+    void set_recursive(const std::string& prefix);
+
+    /**
+     * @brief 取出自上次调用以来读到的子目录名称。
+     */
+    std::vector<std::string> take_subdirectories();
+
+    /**
+     * @brief 已打开的本地目录 fd，列出单个文件或非本地目录时为 -1。
+     */
+    int fd() const { return fd_; }
+
+    /**
+     * @brief 打开的是否为目录（而不是 LIST 的单个文件）。
+     */
+    bool directory() const { return file_.empty(); }
+
+private:
+    /**
+     * @brief 打开非本地文件系统的目录（或 LIST 的单个文件）。
+     */
+    int open_entries(const ResolvedPath& path);
+
+    /**
+     * @brief 从非本地目录的目录项中读取，参数与返回值同 `read()`。
+     */
+    int read_entries(std::string& out, size_t limit, size_t* remaining);
+
+    /**
+     * @brief 格式化一个本地目录项，条目已消失时不输出。
+     *
+     * @return 是否输出了该条目。
+     */
+    bool append_entry(std::string& out, const char* name);
+
+    /**
+     * @brief 按输出格式追加一行。
+     */
+    void append_line(
+            std::string& out,
+            int dirfd,
+            const char* path,
+            const char* name,
+            const struct statx& stx);
+
+    int fd_;                  ///< 目录 fd（单个文件时为 -1）
+    int fileFd_;              ///< 单个文件的 O_PATH fd（不跟随符号链接）
+    ListFormat format_;       ///< 输出格式
+    bool hidden_;             ///< 是否包含以 '.' 开头的目录项
+    std::string file_;        ///< 单个文件显示的路径
+    std::vector<char> dents_; ///< getdents64 缓冲区
+    size_t pos_;              ///< 缓冲区中下一个目录项的位置
+    size_t len_;              ///< 缓冲区中有效数据的长度
+    off_t position_;          ///< 最后一个已处理目录项之后的游标
+    bool recursive_;          ///< 是否记录子目录
+    std::string prefix_;      ///< MLSD 名称前缀（递归列表）
+    std::vector<std::string> subdirs_; ///< 读到的子目录名称
+    bool eof_;                ///< 目录已读完
+    bool snapshot_;           ///< 是否为非本地目录
+    ResolvedPath path_;       ///< 非本地目录的路径（seek 时重新读取）
+    std::vector<DirectoryEntry> entries_; ///< 非本地目录的目录项
+    size_t next_;             ///< 下一个要输出的目录项
+};
+
+/**
+ * @brief 获取路径的元数据。
+ *
+ * @param dirfd 相对路径的基准目录。
+ * @param path 路径，为空时获取 dirfd 自身。
+ * @param stx 输出的元数据。
+ * @param follow 是否跟随符号链接（LIST 显示链接本身，MLSD/MLST 显示目标）。
+ * @return 成功返回 0，失败返回 -errno。
+ */
+int stat_entry(
+        int dirfd,
+        const char* path,
+        struct statx& stx,
+        bool follow = false);
+
+/**
+ * @brief 按 `ls -ln` 格式生成一行（权限、链接数、uid、gid、大小、时间、名称）。
+ *
+ * @param dirfd 符号链接的基准目录。
+ * @param path 符号链接相对于 dirfd 的路径，为空时 dirfd 即链接本身。
+ * @param name 显示的名称。
+ * @param stx 元数据。
+ */
+std::string format_list_line(
+        int dirfd,
+        const char* path,
+        const char* name,
+        const struct statx& stx);
+
+/**
+ * @brief 按 RFC 3659 生成事实串（type、size、modify、perm、unix.mode 等），以 "; " 结尾，
+ * 不含名称。MLSD 每行为事实串加名称，MLST 的回复行前另加一个空格。
+ *
+ * @param stx 元数据（符号链接应先跟随到目标）。
+ */
+std::string format_facts(const struct statx& stx);
+
+#endif // DIRECTORY_LISTING_H
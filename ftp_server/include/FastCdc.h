@@ -0,0 +1,52 @@
+#ifndef FAST_CDC_H
+#define FAST_CDC_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class FastCdc
+ * @brief FastCDC 内容定义分块：按内容而不是固定偏移切分数据。
+ *
+ * 以 Gear 滚动哈希（每字节 `fp = (fp << 1) + GEAR[b]`）寻找切点，前 min 字节
+ * 不检查；到平均大小之前使用更多位的掩码（更难切），之后使用更少位的掩码
+ * （更容易切），即归一化分块，分块大小集中在平均值附近；到 max 时强制切分。
+ * 切点只取决于附近的内容，文件中间插入或删除数据时只有相邻的分块改变，
+ * 其余分块与原文件相同，可以去重。
+ */
+class FastCdc
+{
+public:
+    /**
+     * @brief 构造函数。
+     *
+     * @param minSize 最小分块。
+     * @param avgSize 平均分块（取不大于它的 2 的幂）。
+     * @param maxSize 最大分块。
+     */
+    FastCdc(size_t minSize = 16 * 1024,
+            size_t avgSize = 64 * 1024,
+            size_t maxSize = 256 * 1024);
+
+    /**
+     * @brief 从 data 开头切出下一个分块。
+     *
+     * @param data 尚未分块的数据。
+     * @param size 数据长度。
+     * @param eof 之后是否没有更多数据。
+     * @return 分块长度；数据不足 maxSize 且未到末尾时返回 0，表示需要更多数据。
+     */
+    size_t cut(const char* data, size_t size, bool eof) const;
+
+    size_t min_size() const { return min_; }
+    size_t max_size() const { return max_; }
+
+private:
+    size_t min_;    ///< 最小分块
+    size_t avg_;    ///< 平均分块
+    size_t max_;    ///< 最大分块
+    uint64_t maskS_; ///< 平均大小之前的掩码（更多位）
+    uint64_t maskL_; ///< 平均大小之后的掩码（更少位）
+};
+
+#endif // FAST_CDC_H
@@ -0,0 +1,165 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 文件的身份与版本：设备号/inode 标识文件，大小与 mtime/ctime 标识内容版本。
+ */
+struct FileIdentity
+{
+    dev_t dev = 0;              ///< 设备号
+    ino_t ino = 0;              ///< inode 号
+    off_t size = 0;             ///< 文件大小
+    struct timespec mtime = {}; ///< 内容修改时间
+    struct timespec ctime = {}; ///< 状态修改时间
+
+    static FileIdentity from_stat(const struct stat& st);
+    static FileIdentity from_statx(const struct statx& stx);
+
+    /**
+     * @brief 两次获取的元数据是否为同一文件的同一版本。
+     */
+    bool same_version(const FileIdentity& other) const;
+};
+
+/**
+ * @class FileCache
+ * @brief RETR 的小文件内存缓存。
+ *
+ * 配置分发等场景中同一批小文件被反复下载，命中时直接从内存发送，
+ * 省去每次的 open/fstat/read/close。
+ * - 以设备号/inode 为键，命中时用当前的大小和 mtime/ctime 校验，版本不符即丢弃；
+ * - 按键哈希分片，每个分片独立加锁并维护 LRU，各 Reactor/线程池线程并发访问互不阻塞；
+ * - 总字节预算平均分给各分片，超出时淘汰最久未使用的条目；
+ * - mtime 距当前不足 1 秒的文件不缓存（同一时间戳内可能仍在被修改）。
+ *
+ * 缓存内容以共享指针交给传输协程，被淘汰的条目在发送结束后才释放。
+ * 配置在启动时设置一次；预算为 0 时缓存关闭。
+ */
+class FileCache
+{
+public:
+    /**
+     * @brief 缓存统计。
+     */
+    struct Stats
+    {
+        uint64_t hits = 0;       ///< 命中次数
+        uint64_t misses = 0;     ///< 未命中次数（含版本失效）
+        uint64_t evictions = 0;  ///< 因预算淘汰的条目数
+        uint64_t insertions = 0; ///< 插入的条目数
+        size_t entries = 0;      ///< 当前条目数
+        size_t bytes = 0;        ///< 当前占用字节数
+    };
+
+    FileCache() = default;
+
+    /**
+     * @brief 获取全局缓存实例。
+     */
+    static FileCache& instance();
+
+    /**
+     * @brief 设置缓存参数并清空缓存。
+     *
+     * @param budget 总字节预算，0 表示关闭缓存。
+     * @param maxFileSize 可缓存的最大文件大小。
+     * @param shards 分片数量。
+     */
+    void configure(size_t budget, size_t maxFileSize, size_t shards = 16);
+
+    /**
+     * @brief 缓存是否开启。
+     */
+    bool enabled() const { return budget_ > 0; }
+
+    /**
+     * @brief 指定大小的文件是否可以缓存。
+     */
+    bool cacheable(off_t size) const;
+
+    /**
+     * @brief 查找并校验缓存内容。
+     *
+     * @param identity 文件的当前元数据。
+     * @return 命中返回内容；未命中或版本不符返回空指针。
+     */
+    std::shared_ptr<const std::string> lookup(const FileIdentity& identity);
+
+    /**
+     * @brief 插入文件内容（文件过大或刚被修改时不插入）。
+     *
+     * @param identity 读取内容前后一致的元数据。
+     * @param data 文件内容。
+     */
+    void insert(const FileIdentity& identity,
+                std::shared_ptr<const std::string> data);
+
+    /**
+     * @brief 获取统计数据。
+     */
+    Stats stats() const;
+
+private:
+    struct Key
+    {
+        dev_t dev;
+        ino_t ino;
+
+        bool operator==(const Key& other) const
+        {
+            return dev == other.dev && ino == other.ino;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry
+    {
+        FileIdentity identity;                    ///< 缓存时的文件版本
+        std::shared_ptr<const std::string> data;  ///< 文件内容
+        size_t charge;                            ///< 计入预算的字节数
+    };
+
+    /**
+     * @brief 一个分片：LRU 链表（表头最近使用）与索引。
+     */
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        size_t bytes = 0;
+    };
+
+    Shard& shard_for(const Key& key);
+
+    /**
+     * @brief 从分片中移除一个条目，调用方持有分片锁。
+     */
+    void erase(Shard& shard, std::list<Entry>::iterator it);
+
+    size_t budget_ = 0;                           ///< 总字节预算
+    size_t shardBudget_ = 0;                      ///< 每个分片的预算
+    size_t maxFileSize_ = 0;                      ///< 可缓存的最大文件
+    std::vector<std::unique_ptr<Shard> > shards_; ///< 分片
+    std::atomic<uint64_t> hits_{0};               ///< 命中次数
+    std::atomic<uint64_t> misses_{0};             ///< 未命中次数
+    std::atomic<uint64_t> evictions_{0};          ///< 淘汰次数
+    std::atomic<uint64_t> insertions_{0};         ///< 插入次数
+};
+
+#endif // FILE_CACHE_H
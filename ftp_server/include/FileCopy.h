@@ -0,0 +1,88 @@
+#ifndef FILE_COPY_H
+#define FILE_COPY_H
+
+#include "FileCache.h"
+#include "PathResolver.h"
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief 服务器端复制实际使用的方式。
+ */
+enum class CopyMethod
+{
+    REFLINK,         ///< FICLONE 共享数据块，不复制数据
+    COPY_FILE_RANGE, ///< 内核中复制（部分文件系统在服务端或设备上完成）
+    READ_WRITE,      ///< 用户态读写
+    MANIFEST         ///< 去重文件只复制清单，分块共享
+};
+
+/**
+ * @brief 复制方式的名称（reflink、copy_file_range、read/write、manifest）。
+ */
+const char* copy_method_name(CopyMethod method);
+
+/**
+ * @class FileCopy
+ * @brief SITE COPY 的服务器端复制：数据不经过客户端。
+ *
+ * 先尝试 FICLONE 整个文件（Btrfs、XFS 等共享数据块，瞬间完成），不支持时
+ * 以 copy_file_range 分段复制，跨文件系统或不支持时退回 pread/pwrite；
+ * 去重存储中的文件只复制清单，分块由两个文件共享。
+ * 数据写入目标目录中的临时文件，完成后确认源文件未被修改，再经由
+ * `UploadCommitter` 落盘并改名为目标文件，复制到一半不会留下不完整的目标文件；
+ * 失败或对象被销毁时删除临时文件。
+ *
+ * 方法会阻塞，应依次在线程池中调用，每次 `step()` 复制一段，
+ * 不会长时间占住线程；两次调用之间可读取进度。
+ */
+class FileCopy
+{
+public:
+    FileCopy(ResolvedPath from, ResolvedPath to);
+    ~FileCopy();
+    FileCopy(const FileCopy&) = delete;
+    FileCopy& operator=(const FileCopy&) = delete;
+
+    /**
+     * @brief 打开源文件并创建临时文件，尝试 reflink。
+     *
+     * @return 还需复制返回 1，已复制完（reflink 或空文件）返回 0，失败返回 -errno
+     * （源文件不是普通文件时为 -EISDIR）。
+     */
+    int open();
+
+    /**
+     * @brief 复制下一段。
+     *
+     * @return 还有剩余返回 1，完成返回 0，失败返回 -errno。
+     */
+    int step();
+
+    /**
+     * @brief 确认源文件未被修改（否则 -ESTALE），落盘并改名为目标文件。
+     *
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int commit();
+
+    const ResolvedPath& target() const { return to_; }
+    off_t size() const { return size_; }
+    off_t copied() const { return copied_; }
+    CopyMethod method() const { return method_; }
+
+private:
+    ResolvedPath from_;       ///< 源文件
+    ResolvedPath to_;         ///< 目标文件
+    ResolvedPath temporary_;  ///< 目标目录中的临时文件
+    bool created_ = false;    ///< 临时文件已创建且尚未改名
+    int source_ = -1;         ///< 源文件
+    int target_ = -1;         ///< 临时文件
+    FileIdentity identity_;   ///< 打开时源文件的版本
+    off_t size_ = 0;          ///< 源文件大小
+    off_t copied_ = 0;        ///< 已复制的字节数
+    CopyMethod method_ = CopyMethod::COPY_FILE_RANGE; ///< 复制方式
+    std::vector<char> buffer_; ///< pread/pwrite 的缓冲
+};
+
+#endif // FILE_COPY_H
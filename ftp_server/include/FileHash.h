@@ -0,0 +1,74 @@
+#ifndef FILE_HASH_H
+#define FILE_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 校验命令（HASH、XCRC、XMD5、XSHA256）支持的算法。
+ */
+enum class HashAlgorithm
+{
+    CRC32,  ///< CRC-32（IEEE 802.3，与 zlib/XCRC 相同）
+    CRC32C, ///< CRC-32C（Castagnoli，SSE4.2 指令）
+    MD5,
+    SHA1,
+    SHA256,
+    SHA512
+};
+
+/**
+ * @brief 算法的 HASH 命令名称（如 "SHA-256"）。
+ */
+const char* hash_algorithm_name(HashAlgorithm algorithm);
+
+/**
+ * @brief 按 HASH 命令名称解析算法，不区分大小写。
+ *
+ * @return 名称有效返回 true。
+ */
+bool parse_hash_algorithm(const std::string& name, HashAlgorithm& algorithm);
+
+/**
+ * @brief 计算 CRC-32（IEEE），crc 为上一段的结果，第一段为 0。
+ */
+uint32_t crc32_ieee(uint32_t crc, const void* data, size_t size);
+
+/**
+ * @brief 计算 CRC-32C，CPU 支持 SSE4.2 时使用 crc32 指令，crc 为上一段的结果。
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t size);
+
+/**
+ * @class Hasher
+ * @brief 增量计算一种摘要，结果为小写十六进制。
+ *
+ * CRC 由本地实现（按 8 字节切片查表或 SSE4.2 指令），
+ * MD5/SHA 由 OpenSSL EVP 计算（自动使用 SHA-NI、AVX2 等指令扩展）。
+ */
+class Hasher
+{
+public:
+    explicit Hasher(HashAlgorithm algorithm);
+    ~Hasher();
+    Hasher(const Hasher&) = delete;
+    Hasher& operator=(const Hasher&) = delete;
+
+    /**
+     * @brief 追加数据。
+     */
+    void update(const void* data, size_t size);
+
+    /**
+     * @brief 结束计算并返回十六进制摘要，之后不得再追加数据。
+     */
+    std::string finish();
+
+private:
+    HashAlgorithm algorithm_; ///< 算法
+    uint32_t crc_ = 0;        ///< CRC 的中间结果
+    void* context_ = nullptr; ///< OpenSSL 的 EVP_MD_CTX
+};
+
+#endif // FILE_HASH_H
@@ -0,0 +1,114 @@
+#ifndef FILE_SYSTEM_H
+#define FILE_SYSTEM_H
+
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+struct DirectoryHandle;
+class ResolvedPath;
+
+/**
+ * @brief 非本地文件系统的一个目录项。
+ */
+struct DirectoryEntry
+{
+    std::string name;   ///< 名称
+    struct statx stx;   ///< 元数据
+    off_t position = 0; ///< 该项之后的游标，目录修改后仍可用于继续读取
+};
+
+/**
+ * @class FileSystem
+ * @brief 文件命令使用的虚拟文件系统接口。
+ *
+ * 所有路径都先由会话的 `PathResolver` 规范化为 `ResolvedPath`，再交给文件系统执行。
+ * 打开文件返回真实的 fd，传输代码（pread/pwrite、页缓存策略、小文件缓存）
+ * 与后端无关；目录读取、io_uring 的按路径打开和 inotify 列表缓存只适用于本地文件系统
+ * （`native()`），其他后端由 `read_directory()` 提供目录内容，传输使用线程池路径。
+ *
+ * 方法可能阻塞，应在线程池中调用（CWD 等只访问元数据的命令除外）；
+ * 实现必须是线程安全的。所有方法失败时返回 -errno。
+ */
+class FileSystem
+{
+public:
+    virtual ~FileSystem() = default;
+
+    /**
+     * @brief 获取服务器使用的文件系统，未设置时为不限制根目录的本地文件系统。
+     */
+    static std::shared_ptr<FileSystem> instance();
+
+    /**
+     * @brief 设置服务器使用的文件系统，在接受连接前调用一次。
+     */
+    static void set_instance(std::shared_ptr<FileSystem> fs);
+
+    /**
+     * @brief 路径是否对应内核中的真实文件（可由 io_uring、inotify 按路径访问）。
+     */
+    virtual bool native() const = 0;
+
+    /**
+     * @brief 虚拟路径是否不同于真实路径（会话的初始工作目录为 "/"）。
+     */
+    virtual bool confined() const = 0;
+
+    /**
+     * @brief 根目录的句柄，由所有会话共享。
+     */
+    virtual std::shared_ptr<const DirectoryHandle> root() const = 0;
+
+    /**
+     * @brief 打开文件，flags/mode 同 open(2)。
+     *
+     * @return 成功返回 fd。
+     */
+    virtual int open(const ResolvedPath& path, int flags, mode_t mode) = 0;
+
+    /**
+     * @brief 获取元数据。
+     *
+     * @param follow 是否跟随最后一个分量的符号链接。
+     */
+    virtual int stat(const ResolvedPath& path, struct statx& stx, bool follow) = 0;
+
+    virtual int mkdir(const ResolvedPath& path, mode_t mode) = 0;
+    virtual int rmdir(const ResolvedPath& path) = 0;
+
+    /**
+     * @brief 删除文件，目录返回 -EISDIR。
+     */
+    virtual int unlink(const ResolvedPath& path) = 0;
+
+    /**
+     * @brief 改名，语义同 rename(2)：目标存在时原子地替换。
+     */
+    virtual int rename(const ResolvedPath& from, const ResolvedPath& to) = 0;
+
+    /**
+     * @brief 打开目录作为工作目录（要求可进入）。
+     *
+     * @param handle 输出的目录句柄。
+     */
+    virtual int open_directory(
+            const ResolvedPath& path,
+            std::shared_ptr<const DirectoryHandle>& handle) = 0;
+
+    /**
+     * @brief 读取非本地文件系统的目录内容，按游标顺序排列。
+     *
+     * @param cursor 只返回游标之后的目录项，0 表示目录开头。
+     * @param entries 输出的目录项（不含 "." 和 ".."）。
+     * @return 成功返回 0，不是目录时返回 -ENOTDIR；本地文件系统返回 -EOPNOTSUPP。
+     */
+    virtual int read_directory(
+            const ResolvedPath& path,
+            off_t cursor,
+            std::vector<DirectoryEntry>& entries) = 0;
+};
+
+#endif // FILE_SYSTEM_H
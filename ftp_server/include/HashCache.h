@@ -0,0 +1,190 @@
+#ifndef HASH_CACHE_H
+#define HASH_CACHE_H
+
+#include "FileCache.h"
+#include "FileHash.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class HashCache
+ * @brief 校验命令的摘要缓存：内存中的分片 LRU，可选持久化到文件的扩展属性。
+ *
+ * 校验大文件需要读完整个文件，同一数据集往往被多次校验（传输后、定期巡检）。
+ * - 以设备号/inode、算法与字节区间为键，命中时用当前的大小和 mtime/ctime 校验；
+ * - 开启持久化时，整个文件的摘要写入扩展属性 `user.ftp_server.<算法>`，
+ *   值为 "<mtime 秒>.<纳秒> <大小> <摘要>"，服务器重启或内存条目被淘汰后仍可命中。
+ *   写扩展属性会改变 ctime，因此扩展属性只以 mtime 和大小校验；
+ *   不支持扩展属性的文件系统只使用内存缓存；
+ * - mtime 距当前不足 1 秒的文件不缓存（同一时间戳内可能仍在被修改）；
+ *   STOR 边接收边计算的摘要对应服务器自己写入的内容，由 `seed()` 直接插入。
+ *
+ * 方法会访问文件（扩展属性），应在线程池中调用，各分片独立加锁。
+ * 配置在启动时设置一次；条目上限为 0 且不持久化时缓存关闭。
+ */
+class HashCache
+{
+public:
+    /**
+     * @brief 缓存统计。
+     */
+    struct Stats
+    {
+        uint64_t hits = 0;       ///< 内存命中次数
+        uint64_t xattrHits = 0;  ///< 扩展属性命中次数
+        uint64_t misses = 0;     ///< 未命中次数（含版本失效）
+        uint64_t evictions = 0;  ///< 因上限淘汰的条目数
+        uint64_t insertions = 0; ///< 插入的条目数
+        size_t entries = 0;      ///< 当前条目数
+    };
+
+    HashCache() = default;
+
+    /**
+     * @brief 获取全局缓存实例。
+     */
+    static HashCache& instance();
+
+    /**
+     * @brief 设置缓存参数并清空内存缓存。
+     *
+     * @param maxEntries 内存中最多的条目数，0 表示不使用内存缓存。
+     * @param persist 是否把整个文件的摘要写入扩展属性。
+     * @param shards 分片数量。
+     */
+    void configure(size_t maxEntries, bool persist, size_t shards = 16);
+
+    /**
+     * @brief 查找摘要。
+     *
+     * @param fd 已打开的文件，用于读取扩展属性。
+     * @param identity 文件的当前元数据。
+     * @param algorithm 算法。
+     * @param offset 区间起点。
+     * @param length 区间长度。
+     * @return 命中返回摘要，未命中返回空串。
+     */
+    std::string lookup(
+            int fd,
+            const FileIdentity& identity,
+            HashAlgorithm algorithm,
+            off_t offset,
+            off_t length);
+
+    /**
+     * @brief 插入摘要（刚被修改的文件不插入）。
+     *
+     * @param fd 已打开的文件，用于写入扩展属性。
+     * @param identity 计算前后一致的元数据。
+     */
+    void insert(
+            int fd,
+            const FileIdentity& identity,
+            HashAlgorithm algorithm,
+            off_t offset,
+            off_t length,
+            const std::string& digest);
+
+    /**
+     * @brief 插入上传时计算的摘要，不受刚被修改的限制。
+     *
+     * 摘要覆盖服务器写入的全部内容，identity 为写完后的版本。
+     */
+    void seed(
+            int fd,
+            const FileIdentity& identity,
+            HashAlgorithm algorithm,
+            const std::string& digest);
+
+    /**
+     * @brief 设置 STOR 边接收边计算的算法，空表示不计算。
+     */
+    void set_upload_algorithm(std::optional<HashAlgorithm> algorithm);
+
+    /**
+     * @brief 获取 STOR 边接收边计算的算法。
+     */
+    std::optional<HashAlgorithm> upload_algorithm() const;
+
+    /**
+     * @brief 获取统计数据。
+     */
+    Stats stats() const;
+
+private:
+    struct Key
+    {
+        dev_t dev;
+        ino_t ino;
+        HashAlgorithm algorithm;
+        off_t offset;
+        off_t length;
+
+        bool operator==(const Key& other) const
+        {
+            return dev == other.dev && ino == other.ino &&
+                   algorithm == other.algorithm && offset == other.offset &&
+                   length == other.length;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry
+    {
+        Key key;               ///< 键
+        FileIdentity identity; ///< 计算时的文件版本
+        std::string digest;    ///< 摘要
+    };
+
+    /**
+     * @brief 一个分片：LRU 链表（表头最近使用）与索引。
+     */
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    };
+
+    Shard& shard_for(const Key& key);
+
+    /**
+     * @brief 写入扩展属性（开启持久化时）并插入内存缓存。
+     */
+    void store(
+            int fd,
+            const FileIdentity& identity,
+            HashAlgorithm algorithm,
+            off_t offset,
+            off_t length,
+            const std::string& digest);
+
+    /**
+     * @brief 插入内存缓存，超出上限时淘汰最久未使用的条目。
+     */
+    void remember(const Key& key, const FileIdentity& identity, const std::string& digest);
+
+    size_t shardEntries_ = 0;                     ///< 每个分片的条目上限
+    bool persist_ = false;                        ///< 是否写入扩展属性
+    std::optional<HashAlgorithm> uploadAlgorithm_; ///< STOR 计算的算法
+    std::vector<std::unique_ptr<Shard> > shards_; ///< 分片
+    std::atomic<uint64_t> hits_{0};               ///< 内存命中次数
+    std::atomic<uint64_t> xattrHits_{0};          ///< 扩展属性命中次数
+    std::atomic<uint64_t> misses_{0};             ///< 未命中次数
+    std::atomic<uint64_t> evictions_{0};          ///< 淘汰次数
+    std::atomic<uint64_t> insertions_{0};         ///< 插入次数
+};
+
+#endif // HASH_CACHE_H
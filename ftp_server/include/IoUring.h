@@ -0,0 +1,331 @@
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include "PathResolver.h"
+#include <ace/Event_Handler.h>
+#include <ace/Reactor.h>
+#include <cerrno>
+#include <coroutine>
+#include <cstdint>
+#include <linux/openat2.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+class IoUring;
+
+/**
+ * @brief 一次已提交到 io_uring 的操作在内核完成前的状态。
+ *
+ * 状态由 IoUring 的在途表和等待它的 UringOp 共同持有：等待的协程被销毁后，
+ * 状态（以及它引用的缓冲区和路径）仍保持到内核返回完成事件为止，
+ * 内核不会写入已释放的内存。
+ */
+struct UringOpState
+{
+    int res = 0;                        ///< 完成结果（同系统调用返回值，错误为 -errno）
+    bool done = false;                  ///< 是否已收到完成事件
+    std::coroutine_handle<> waiter;     ///< 挂起等待该操作的协程
+    std::shared_ptr<void> keep;         ///< 内核访问期间需要保持存活的缓冲区
+    std::string path;                   ///< OPENAT2/STATX 的路径（相对于 dir）
+    std::shared_ptr<const DirectoryHandle> dir; ///< 路径的基准目录
+    struct open_how how = {};           ///< OPENAT2 的参数
+    int closingSlot = -1;               ///< 关闭完成后回收的固定文件槽位
+    struct statx stx = {};              ///< STATX 的结果
+};
+
+/**
+ * @class UringOp
+ * @brief 可 `co_await` 的 io_uring 操作，结果为系统调用风格的返回值。
+ *
+ * 操作在准备时写入提交队列，在协程挂起或一轮完成事件处理结束时统一提交，
+ * 因此同一协程连续准备的多个操作只需一次 `io_uring_enter`。
+ * 对象在操作完成前被销毁（传输被取消）时会提交取消请求。
+ */
+class UringOp
+{
+public:
+    UringOp() = default;
+    UringOp(IoUring* ring, std::shared_ptr<UringOpState> state);
+    UringOp(UringOp&& other) noexcept;
+    UringOp& operator=(UringOp&& other) noexcept;
+    UringOp(const UringOp&) = delete;
+    UringOp& operator=(const UringOp&) = delete;
+    ~UringOp();
+
+    /**
+     * @brief 检查操作是否已准备（提交队列已满时准备失败）。
+     */
+    bool valid() const { return state_ != nullptr; }
+
+    /**
+     * @brief 获取 STATX 操作的结果，仅在操作完成后有效。
+     */
+    const struct statx& statx_result() const { return state_->stx; }
+
+    /**
+     * @brief `co_await` 使用的等待器，挂起时提交所有已准备的操作。
+     */
+    struct Awaiter
+    {
+        UringOp* op_;
+
+        bool await_ready() const noexcept
+        {
+            return op_->state_ == nullptr || op_->state_->done;
+        }
+
+        void await_suspend(std::coroutine_handle<> waiter);
+
+        int await_resume() const noexcept
+        {
+            return op_->state_ == nullptr ? -EAGAIN : op_->state_->res;
+        }
+    };
+
+    /**
+     * @brief 等待操作完成，返回值为 -ECANCELED 表示链接的前一操作失败。
+     */
+    Awaiter operator co_await() noexcept { return Awaiter{this}; }
+
+private:
+    void abandon();
+
+    IoUring* ring_ = nullptr;             ///< 所属的 io_uring
+    std::shared_ptr<UringOpState> state_; ///< 与在途表共享的操作状态
+};
+
+/**
+ * @class IoUring
+ * @brief 每个 Reactor 线程一个的 io_uring 实例，为文件传输提供异步 I/O。
+ *
+ * 直接使用 io_uring 系统调用（不依赖 liburing）：
+ * - 注册缓冲区：启动时分配并注册一组传输缓冲区，文件读写使用 READ_FIXED/WRITE_FIXED；
+ * - 固定文件：注册稀疏文件表，OPENAT2 直接打开到表中的槽位，后续读写不再查找 fd；
+ * - 链接操作：OPENAT2→READ、SEND→READ 等通过 IOSQE_IO_LINK 在内核中顺序执行；
+ * - 批量提交：操作在协程挂起时或一轮完成事件处理后一次性提交。
+ *
+ * 完成事件通过注册到 Reactor 的 eventfd 通知，在 Reactor 线程中恢复等待的协程。
+ * 所有方法只能在所属 Reactor 线程调用。内核不支持 io_uring 或所需操作时 `open()` 失败，
+ * 调用方回退到线程池路径。
+ */
+class IoUring: public ACE_Event_Handler
+{
+public:
+    /**
+     * @brief 注册缓冲区，由传输协程租用，释放后归还缓冲池。
+     */
+    struct Buffer
+    {
+        char* data = nullptr; ///< 缓冲区地址
+        size_t size = 0;      ///< 缓冲区大小
+        int index = -1;       ///< 注册缓冲区下标（READ_FIXED/WRITE_FIXED 使用）
+    };
+
+    IoUring();
+    ~IoUring() override;
+
+    /**
+     * @brief 创建 io_uring 实例，注册缓冲区和稀疏文件表，并注册到 Reactor。
+     *
+     * @param reactor 所属的 Reactor。
+     * @param entries 提交队列深度。
+     * @param bufferCount 注册缓冲区数量。
+     * @param bufferSize 每个缓冲区的大小。
+     * @param fileSlots 固定文件表的槽位数量。
+     * @return 成功返回 0，失败返回 -1（调用方应回退到同步路径）。
+     */
+    int open(ACE_Reactor* reactor,
+             unsigned entries,
+             size_t bufferCount,
+             size_t bufferSize,
+             unsigned fileSlots);
+
+    /**
+     * @brief 从 Reactor 注销并销毁 io_uring，在途操作由内核取消。
+     */
+    void close();
+
+    /**
+     * @brief 检查 io_uring 是否可用。
+     */
+    bool is_open() const;
+
+    /**
+     * @brief 租用一个注册缓冲区。
+     *
+     * 在 Reactor 线程中租用；最后一个引用释放时归还，可以在线程池线程中释放。
+     *
+     * @return 缓冲区；缓冲池已耗尽时返回空指针。
+     */
+    std::shared_ptr<Buffer> acquire_buffer();
+
+    /**
+     * @brief 获取注册缓冲区的大小。
+     */
+    size_t buffer_size() const;
+
+    /**
+     * @brief 分配一个固定文件槽位。
+     *
+     * @return 槽位下标；槽位已用尽时返回 -1。
+     */
+    int acquire_file_slot();
+
+    /**
+     * @brief 异步关闭槽位中的文件并在关闭完成后回收槽位。
+     */
+    void release_file_slot(int slot);
+
+    /**
+     * @brief 打开文件到固定文件槽位（IORING_OP_OPENAT2），
+     * 以 RESOLVE_IN_ROOT 在会话根目录内解析。
+     */
+    UringOp openat(int slot,
+                   const ResolvedPath& path,
+                   int flags,
+                   mode_t mode,
+                   bool link = false);
+
+    /**
+     * @brief 获取文件元数据（IORING_OP_STATX），结果通过 `statx_result()` 读取。
+     *
+     * 路径从会话根目录解析，但 STATX 不能阻止符号链接指向根目录之外，
+     * 只用于未限制根目录的会话。
+     */
+    UringOp statx(const ResolvedPath& path, bool link = false);
+
+    /**
+     * @brief 从固定文件读取到注册缓冲区（IORING_OP_READ_FIXED）。
+     */
+    UringOp read_fixed(int slot,
+                       const std::shared_ptr<Buffer>& buffer,
+                       size_t size,
+                       off_t offset,
+                       bool link = false);
+
+    /**
+     * @brief 把注册缓冲区写入固定文件（IORING_OP_WRITE_FIXED）。
+     */
+    UringOp write_fixed(int slot,
+                        const std::shared_ptr<Buffer>& buffer,
+                        size_t size,
+                        off_t offset,
+                        bool link = false);
+
+    /**
+     * @brief 发送缓冲区数据（IORING_OP_SEND，MSG_WAITALL），套接字须为阻塞模式。
+     */
+    UringOp send(int fd,
+                 const std::shared_ptr<Buffer>& buffer,
+                 size_t size,
+                 bool link = false);
+
+    /**
+     * @brief 接收数据到缓冲区（IORING_OP_RECV，MSG_WAITALL），
+     * 结果小于请求长度表示对端已关闭。
+     */
+    UringOp recv(int fd,
+                 const std::shared_ptr<Buffer>& buffer,
+                 size_t size,
+                 bool link = false);
+
+    /**
+     * @brief 对固定文件的区间给出页缓存建议（IORING_OP_FADVISE）。
+     */
+    UringOp fadvise(int slot,
+                    off_t offset,
+                    off_t length,
+                    int advice,
+                    bool link = false);
+
+    /**
+     * @brief 启动或等待固定文件区间的回写（IORING_OP_SYNC_FILE_RANGE）。
+     */
+    UringOp sync_file_range(int slot,
+                            off_t offset,
+                            off_t length,
+                            unsigned flags,
+                            bool link = false);
+
+    /**
+     * @brief 提交所有已准备的操作。
+     */
+    void submit();
+
+    /**
+     * @brief 协程挂起时调用：处理完成事件期间延迟到本轮结束统一提交。
+     */
+    void submit_deferred();
+
+    /**
+     * @brief 取消一个尚未完成的操作（提交 IORING_OP_ASYNC_CANCEL）。
+     */
+    void cancel(UringOpState* state);
+
+    ACE_HANDLE get_handle() const override;
+
+    /**
+     * @brief eventfd 可读：收割完成事件并恢复等待的协程。
+     */
+    int handle_input(ACE_HANDLE fd = ACE_INVALID_HANDLE) override;
+
+    int handle_close(ACE_HANDLE handle, ACE_Reactor_Mask close_mask) override;
+
+private:
+    struct BufferPool;
+
+    /**
+     * @brief 获取一个空闲的提交队列项，队列已满时先提交再获取。
+     */
+    io_uring_sqe* get_sqe();
+
+    /**
+     * @brief 准备一个操作：填充 user_data 和链接标志并登记到在途表。
+     */
+    void prepare(
+            io_uring_sqe* sqe,
+            const std::shared_ptr<UringOpState>& state,
+            bool link);
+
+    /**
+     * @brief 检查内核是否支持传输所需的全部操作。
+     */
+    bool probe_ops();
+
+    int ringFd_ = -1;                 ///< io_uring 文件描述符
+    int eventFd_ = -1;                ///< 完成通知 eventfd
+
+    void* sqRing_ = nullptr;          ///< SQ 环映射
+    size_t sqRingSize_ = 0;           ///< SQ 环映射大小
+    void* cqRing_ = nullptr;          ///< CQ 环映射（单映射时与 SQ 环相同）
+    size_t cqRingSize_ = 0;           ///< CQ 环映射大小
+    io_uring_sqe* sqes_ = nullptr;    ///< SQE 数组映射
+    size_t sqesSize_ = 0;             ///< SQE 数组映射大小
+
+    unsigned* sqHead_ = nullptr;      ///< SQ 头（内核更新）
+    unsigned* sqTail_ = nullptr;      ///< SQ 尾（用户更新）
+    unsigned sqMask_ = 0;             ///< SQ 掩码
+    unsigned sqEntries_ = 0;          ///< SQ 容量
+    unsigned* sqArray_ = nullptr;     ///< SQ 索引数组
+    unsigned* cqHead_ = nullptr;      ///< CQ 头（用户更新）
+    unsigned* cqTail_ = nullptr;      ///< CQ 尾（内核更新）
+    unsigned cqMask_ = 0;             ///< CQ 掩码
+    io_uring_cqe* cqes_ = nullptr;    ///< CQE 数组
+
+    unsigned sqeTail_ = 0;            ///< 本地已准备的 SQ 尾
+    unsigned submitted_ = 0;          ///< 已提交给内核的 SQ 尾
+    bool reaping_ = false;            ///< 是否正在处理完成事件
+
+    std::shared_ptr<BufferPool> buffers_; ///< 注册缓冲池
+    std::vector<int> freeSlots_;          ///< 空闲的固定文件槽位
+    std::unordered_map<UringOpState*, std::shared_ptr<UringOpState> >
+            inflight_; ///< 在途操作，完成事件到达后移除
+};
+
+#endif // IO_URING_H
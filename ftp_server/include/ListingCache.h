@@ -0,0 +1,207 @@
+#ifndef LISTING_CACHE_H
+#define LISTING_CACHE_H
+
+#include "DirectoryListing.h"
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+
+/**
+ * @class ListingCache
+ * @brief LIST/MLSD 渲染结果的缓存，由 inotify 精确失效。
+ *
+ * 监控程序每隔几秒轮询同一批目录，而这些目录大多没有变化。命中时只需一次
+ * statx，省去 getdents64 和每个目录项的 statx。
+ * - 以目录的设备号/inode 为键，每个目录最多缓存 LIST、LIST -a、MLSD 三种渲染结果；
+ * - 每个缓存的目录持有一个 inotify 监视，目录项的增删改名、内容或属性变化都会
+ *   使该目录的全部渲染结果失效；事件在每次查找、插入前非阻塞地读取，修改操作返回时
+ *   事件已在队列中，因此之后的 LIST 不会读到旧结果；
+ * - 监视数量和渲染结果的总字节数都有上限，超出时淘汰最久未使用的目录并移除其监视；
+ * - inotify 不报告子目录自身的 mtime/链接数变化（在孙目录中增删条目时），
+ *   因此结果另有最长存活时间。
+ *
+ * 渲染期间发生的修改通过代数检测：开始读取目录前取得 `Ticket`，
+ * 读取完成时若目录的代数已变化则不插入。
+ * 所有方法都在线程池中调用，内部以一把锁保护。配置在启动时设置一次；
+ * 预算为 0 或 inotify 不可用时缓存关闭。
+ */
+class ListingCache
+{
+public:
+    /**
+     * @brief 缓存统计。
+     */
+    struct Stats
+    {
+        uint64_t hits = 0;          ///< 命中次数
+        uint64_t misses = 0;        ///< 未命中次数
+        uint64_t invalidations = 0; ///< 因 inotify 事件或过期失效的次数
+        uint64_t evictions = 0;     ///< 因监视数或预算淘汰的目录数
+        size_t watches = 0;         ///< 当前监视的目录数
+        size_t bytes = 0;           ///< 当前渲染结果占用的字节数
+    };
+
+    /**
+     * @brief 一次目录读取开始时的目录版本，用于在读取结束后判断能否插入。
+     */
+    struct Ticket
+    {
+        dev_t dev = 0;           ///< 目录设备号
+        ino_t ino = 0;           ///< 目录 inode 号
+        uint64_t generation = 0; ///< 读取开始时的代数，0 表示不可缓存
+
+        bool valid() const { return generation != 0; }
+    };
+
+    ListingCache() = default;
+    ~ListingCache();
+    ListingCache(const ListingCache&) = delete;
+    ListingCache& operator=(const ListingCache&) = delete;
+
+    /**
+     * @brief 获取全局缓存实例。
+     */
+    static ListingCache& instance();
+
+    /**
+     * @brief 设置缓存参数并清空缓存。
+     *
+     * @param budget 渲染结果的总字节预算，0 表示关闭缓存。
+     * @param maxWatches 最多监视的目录数。
+     * @param maxListing 可缓存的单个列表的最大字节数。
+     * @param maxAge 结果的最长存活时间（秒），0 表示不限。
+     * @return inotify 可用返回 true；不可用时缓存关闭并返回 false。
+     */
+    bool configure(
+            size_t budget,
+            size_t maxWatches,
+            size_t maxListing,
+            time_t maxAge);
+
+    /**
+     * @brief 缓存是否开启。
+     */
+    bool enabled() const { return inotifyFd_ != -1; }
+
+    /**
+     * @brief 查找目录的渲染结果。
+     *
+     * @param path 目录路径（跟随符号链接）。
+     * @param format 输出格式。
+     * @param hidden 是否包含以 '.' 开头的目录项。
+     * @return 命中返回渲染结果；未命中返回空指针。
+     */
+    std::shared_ptr<const std::string> lookup(
+            const ResolvedPath& path,
+            ListFormat format,
+            bool hidden);
+
+    /**
+     * @brief 读取目录前为其建立监视并取得当前版本。
+     *
+     * @param dirfd 已打开的目录（监视建立在该 fd 所指的 inode 上）。
+     * @return 可缓存时返回有效的 Ticket。
+     */
+    Ticket watch(int dirfd);
+
+    /**
+     * @brief 插入完整的渲染结果；读取期间目录已变化或结果过大时不插入。
+     *
+     * @param ticket 读取开始时由 `watch()` 取得的版本。
+     * @param format 输出格式。
+     * @param hidden 是否包含以 '.' 开头的目录项。
+     * @param listing 渲染结果。
+     */
+    void insert(
+            const Ticket& ticket,
+            ListFormat format,
+            bool hidden,
+            std::shared_ptr<const std::string> listing);
+
+    /**
+     * @brief 可缓存的单个列表的最大字节数。
+     */
+    size_t max_listing() const { return maxListing_; }
+
+    /**
+     * @brief 获取统计数据。
+     */
+    Stats stats() const;
+
+private:
+    // LIST、LIST -a、MLSD
+    static const int VARIANTS = 3;
+
+    struct Key
+    {
+        dev_t dev;
+        ino_t ino;
+
+        bool operator==(const Key& other) const
+        {
+            return dev == other.dev && ino == other.ino;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    /**
+     * @brief 一个被监视的目录及其渲染结果。
+     */
+    struct Directory
+    {
+        Key key;                 ///< 设备号/inode
+        int wd;                  ///< inotify 监视描述符
+        uint64_t generation;     ///< 每次失效时递增
+        time_t filled = 0;       ///< 最早一份渲染结果的插入时间
+        std::shared_ptr<const std::string> listings[VARIANTS]; ///< 渲染结果
+        size_t bytes = 0;        ///< 渲染结果的字节数
+    };
+
+    typedef std::list<Directory>::iterator DirectoryIt;
+
+    static int variant(ListFormat format, bool hidden);
+
+    /**
+     * @brief 读取并处理所有待处理的 inotify 事件，调用方持有锁。
+     */
+    void drain();
+
+    /**
+     * @brief 丢弃目录的渲染结果并递增代数，保留监视，调用方持有锁。
+     */
+    void invalidate(Directory& dir);
+
+    /**
+     * @brief 移除目录及其监视，调用方持有锁。
+     *
+     * @param removeWatch 监视仍然有效时为 true（事件 IN_IGNORED 表示内核已移除）。
+     */
+    void erase(DirectoryIt it, bool removeWatch);
+
+    mutable std::mutex mutex_;
+    int inotifyFd_ = -1;                             ///< inotify 实例
+    size_t budget_ = 0;                              ///< 总字节预算
+    size_t maxWatches_ = 0;                          ///< 最大监视数
+    size_t maxListing_ = 0;                          ///< 单个列表的最大字节数
+    time_t maxAge_ = 0;                              ///< 最长存活时间（秒）
+    uint64_t nextGeneration_ = 0;                    ///< 代数分配
+    size_t bytes_ = 0;                               ///< 渲染结果总字节数
+    std::list<Directory> lru_;                       ///< 表头最近使用
+    std::unordered_map<Key, DirectoryIt, KeyHash> index_; ///< 按 inode 索引
+    std::unordered_map<int, DirectoryIt> watches_;   ///< 按监视描述符索引
+    uint64_t hits_ = 0;                              ///< 命中次数
+    uint64_t misses_ = 0;                            ///< 未命中次数
+    uint64_t invalidations_ = 0;                     ///< 失效次数
+    uint64_t evictions_ = 0;                         ///< 淘汰次数
+};
+
+#endif // LISTING_CACHE_H
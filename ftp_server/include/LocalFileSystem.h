@@ -0,0 +1,60 @@
+#ifndef LOCAL_FILE_SYSTEM_H
+#define LOCAL_FILE_SYSTEM_H
+
+#include "FileSystem.h"
+#include "PathResolver.h"
+
+/**
+ * @class LocalFileSystem
+ * @brief 本地 POSIX 文件系统，可限制在一个根目录中。
+ *
+ * 根目录 fd 在启动时打开一次，由所有会话共享。文件操作通过 openat2 完成：
+ * 位于会话工作目录之下的路径以 RESOLVE_BENEATH 从工作目录 fd 解析（路径更短，
+ * 不必每次从根目录逐级查找），符号链接离开工作目录时再以 RESOLVE_IN_ROOT 从根目录解析，
+ * 符号链接不能越过根目录。内核不支持 openat2（5.6 之前）时，限制在根目录中的
+ * 文件系统拒绝所有访问（-EPERM，首次记录错误日志），因为 openat 拦截不了指向
+ * 根目录之外的符号链接；根目录为 "/" 时没有需要守住的边界，退回 openat。
+ * 删除与创建操作打开父目录后以 *at 系统调用作用于最后一个分量。
+ */
+class LocalFileSystem: public FileSystem
+{
+public:
+    LocalFileSystem() = default;
+
+    /**
+     * @brief 打开根目录。
+     *
+     * @param root 根目录路径，"/" 表示不限制。
+     * @return 成功返回 0；失败返回 -errno，不是目录时为 -ENOTDIR。
+     */
+    int open(const std::string& root);
+
+    bool native() const override { return true; }
+    bool confined() const override { return confined_; }
+    std::shared_ptr<const DirectoryHandle> root() const override;
+
+    int open(const ResolvedPath& path, int flags, mode_t mode) override;
+    int stat(const ResolvedPath& path, struct statx& stx, bool follow) override;
+    int mkdir(const ResolvedPath& path, mode_t mode) override;
+    int rmdir(const ResolvedPath& path) override;
+    int unlink(const ResolvedPath& path) override;
+    int rename(const ResolvedPath& from, const ResolvedPath& to) override;
+    int open_directory(
+            const ResolvedPath& path,
+            std::shared_ptr<const DirectoryHandle>& handle) override;
+    int read_directory(
+            const ResolvedPath& path,
+            off_t cursor,
+            std::vector<DirectoryEntry>& entries) override;
+
+private:
+    /**
+     * @brief 删除最后一个分量（unlinkat），flags 为 0 或 AT_REMOVEDIR。
+     */
+    int remove(const ResolvedPath& path, int flags);
+
+    std::shared_ptr<const DirectoryHandle> root_; ///< 根目录
+    bool confined_ = false;                       ///< 根目录是否不是 "/"
+};
+
+#endif // LOCAL_FILE_SYSTEM_H
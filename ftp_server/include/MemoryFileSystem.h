@@ -0,0 +1,113 @@
+#ifndef MEMORY_FILE_SYSTEM_H
+#define MEMORY_FILE_SYSTEM_H
+
+#include "FileSystem.h"
+#include "PathResolver.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+/**
+ * @class MemoryFileSystem
+ * @brief 完全位于内存中的文件系统，用于在没有磁盘影响的情况下测试协议与网络栈的性能。
+ *
+ * 目录树由内存中的节点表示，每个文件的内容是一个 memfd：打开文件时经 /proc 重新打开
+ * 该 memfd，得到独立的文件描述（访问模式、偏移互不影响），传输代码按普通 fd 读写。
+ * 文件被删除后已打开的 fd 仍然有效，与本地文件系统一致。
+ * 不支持符号链接；目录项按创建顺序列出，游标为创建序号，目录修改后仍可继续分页。
+ * 元数据操作以一把锁保护，文件内容的读写不经过该锁。内容占用进程内存，
+ * 服务器退出后丢失。
+ */
+class MemoryFileSystem: public FileSystem
+{
+public:
+    MemoryFileSystem();
+    ~MemoryFileSystem() override;
+
+    bool native() const override { return false; }
+    bool confined() const override { return true; }
+    std::shared_ptr<const DirectoryHandle> root() const override;
+
+    int open(const ResolvedPath& path, int flags, mode_t mode) override;
+    int stat(const ResolvedPath& path, struct statx& stx, bool follow) override;
+    int mkdir(const ResolvedPath& path, mode_t mode) override;
+    int rmdir(const ResolvedPath& path) override;
+    int unlink(const ResolvedPath& path) override;
+    int rename(const ResolvedPath& from, const ResolvedPath& to) override;
+    int open_directory(
+            const ResolvedPath& path,
+            std::shared_ptr<const DirectoryHandle>& handle) override;
+    int read_directory(
+            const ResolvedPath& path,
+            off_t cursor,
+            std::vector<DirectoryEntry>& entries) override;
+
+private:
+    struct Node;
+    typedef std::shared_ptr<Node> NodePtr;
+
+    /**
+     * @brief 目录中的一项：节点及其创建序号（列表游标）。
+     */
+    struct Child
+    {
+        NodePtr node;
+        off_t position;
+    };
+
+    /**
+     * @brief 文件或目录。
+     */
+    struct Node
+    {
+        mode_t mode = 0;                 ///< 类型与权限
+        uid_t uid = 0;                   ///< 属主
+        gid_t gid = 0;                   ///< 属组
+        uint64_t ino = 0;                ///< 节点编号（目录的 inode 号）
+        int fd = -1;                     ///< 文件内容（memfd）
+        struct statx_timestamp mtime = {}; ///< 目录的修改时间
+        std::map<std::string, Child> children;  ///< 目录项
+        std::map<off_t, std::string> positions; ///< 按创建序号排列的目录项
+        off_t nextPosition = 1;          ///< 下一个目录项的创建序号
+
+        ~Node();
+    };
+
+    /**
+     * @brief 查找路径对应的节点，调用方持有锁。
+     *
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int lookup(const std::string& path, NodePtr& node) const;
+
+    /**
+     * @brief 查找父目录与最后一个分量，调用方持有锁。
+     */
+    int lookup_parent(
+            const ResolvedPath& path,
+            NodePtr& parent,
+            std::string& name) const;
+
+    /**
+     * @brief 创建节点，调用方持有锁。
+     */
+    NodePtr make_node(mode_t mode);
+
+    /**
+     * @brief 填写节点的元数据，调用方持有锁。
+     */
+    int fill_statx(const Node& node, struct statx& stx) const;
+
+    /**
+     * @brief 在目录中加入或删除一项并更新目录的修改时间，调用方持有锁。
+     */
+    void add_child(Node& dir, const std::string& name, NodePtr node);
+    void remove_child(Node& dir, const std::string& name);
+
+    mutable std::mutex mutex_;
+    NodePtr root_;                                  ///< 根目录
+    std::shared_ptr<const DirectoryHandle> handle_; ///< 根目录句柄（无 fd）
+    uint64_t nextIno_ = 1;                          ///< 节点编号分配
+};
+
+#endif // MEMORY_FILE_SYSTEM_H
@@ -0,0 +1,200 @@
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+#include "PathResolver.h"
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class MetadataCache
+ * @brief SIZE/MDTM 的文件元数据缓存，以解析后的虚拟路径为键。
+ *
+ * 同步客户端在决定传输哪些文件前对每个文件发送 SIZE 和 MDTM，大目录树上
+ * 每轮同步就是几十万次 stat。命中时不访问文件系统。
+ * - 按路径哈希分片，每个分片独立加锁并维护 LRU，条目总数有上限；
+ * - 每个缓存条目的父目录持有一个 inotify 监视，外部进程对目录项的增删改名、
+ *   写入或属性变化都会使对应条目（以及目录自身的条目）失效；事件在每次查找、
+ *   插入前非阻塞地读取；
+ * - 本服务器的 STOR/DELE/RMD/MKD/改名在操作完成后显式失效条目及其父目录，
+ *   内存文件系统没有 inotify，完全依靠显式失效；
+ * - 查找未命中时先取得父目录的代数再 stat，期间父目录发生变化则不插入；
+ * - 最后一个分量是符号链接的路径不缓存（目标的变化不在父目录中报告）；
+ *   祖先目录被外部改名同样无法报告，因此条目另有最长存活时间。
+ *
+ * 查找在元数据线程池中调用；失效只取锁、不访问文件系统，也在 Reactor
+ * 线程中调用。配置在启动时设置一次；
+ * 条目上限为 0 或 inotify 不可用时缓存关闭。
+ */
+class MetadataCache
+{
+public:
+    /**
+     * @brief 缓存统计。
+     */
+    struct Stats
+    {
+        uint64_t hits = 0;          ///< 命中次数
+        uint64_t misses = 0;        ///< 未命中次数
+        uint64_t invalidations = 0; ///< 因事件、本服务器的修改或过期失效的条目数
+        uint64_t evictions = 0;     ///< 因条目数或监视数上限淘汰的条目数
+        size_t entries = 0;         ///< 当前条目数
+        size_t watches = 0;         ///< 当前监视的目录数
+    };
+
+    MetadataCache() = default;
+    ~MetadataCache();
+    MetadataCache(const MetadataCache&) = delete;
+    MetadataCache& operator=(const MetadataCache&) = delete;
+
+    /**
+     * @brief 获取全局缓存实例。
+     */
+    static MetadataCache& instance();
+
+    /**
+     * @brief 设置缓存参数并清空缓存。
+     *
+     * @param maxEntries 最多缓存的条目数，0 表示关闭缓存。
+     * @param maxWatches 最多监视的目录数。
+     * @param maxAge 条目的最长存活时间（秒），0 表示不限。
+     * @param shards 分片数量。
+     * @return inotify 可用返回 true；不可用时缓存关闭并返回 false。
+     */
+    bool configure(
+            size_t maxEntries,
+            size_t maxWatches,
+            time_t maxAge,
+            size_t shards = 16);
+
+    /**
+     * @brief 缓存是否开启。
+     */
+    bool enabled() const { return inotifyFd_ != -1; }
+
+    /**
+     * @brief 获取路径的元数据（跟随符号链接），未命中时 stat 并插入。
+     *
+     * @param path 路径。
+     * @param stx 输出的元数据。
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int stat(const ResolvedPath& path, struct statx& stx);
+
+    /**
+     * @brief 本服务器修改了路径（写入、创建、删除）后使其及父目录的条目失效。
+     */
+    void invalidate(const ResolvedPath& path);
+
+    /**
+     * @brief 目录被删除或改名后使其自身、其下所有条目及父目录的条目失效。
+     */
+    void invalidate_tree(const ResolvedPath& path);
+
+    /**
+     * @brief 获取统计数据。
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @brief 一条缓存的元数据。
+     */
+    struct Entry
+    {
+        std::string path;    ///< 虚拟路径
+        struct statx stx;    ///< 元数据
+        time_t filled;       ///< 插入时间
+    };
+
+    typedef std::list<Entry>::iterator EntryIt;
+
+    /**
+     * @brief 一个分片：独立的锁、LRU 与索引。
+     */
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> lru;                             ///< 表头最近使用
+        std::unordered_map<std::string, EntryIt> index;   ///< 按路径索引
+    };
+
+    /**
+     * @brief 一个被监视的父目录。
+     */
+    struct Watch
+    {
+        std::string path;    ///< 目录的虚拟路径
+        int wd;              ///< inotify 监视描述符，非本地文件系统为 -1
+        uint64_t generation; ///< 目录下的条目每次失效时递增
+    };
+
+    typedef std::list<Watch>::iterator WatchIt;
+
+    Shard& shard_for(const std::string& path);
+
+    /**
+     * @brief 取得父目录的代数，必要时为其建立监视。
+     *
+     * @return 可缓存时返回代数，否则返回 0。
+     */
+    uint64_t watch(const ResolvedPath& path);
+
+    /**
+     * @brief 父目录的代数未变化时插入条目。
+     */
+    void insert(
+            const ResolvedPath& path,
+            const struct statx& stx,
+            uint64_t generation);
+
+    /**
+     * @brief 读取并处理所有待处理的 inotify 事件，调用方持有 watchMutex_。
+     */
+    void drain();
+
+    /**
+     * @brief 删除一个条目并递增其父目录的代数，调用方持有 watchMutex_。
+     */
+    void invalidate_path(const std::string& path);
+
+    /**
+     * @brief 删除 dir 下的条目，recursive 为 false 时只删除直接子项，
+     * 调用方持有 watchMutex_。
+     *
+     * @return 删除的条目数。
+     */
+    size_t invalidate_children(const std::string& dir, bool recursive);
+
+    /**
+     * @brief 移除一个监视并使其目录下的条目失效，调用方持有 watchMutex_。
+     *
+     * @param removeWatch 监视仍然有效时为 true（事件 IN_IGNORED 表示内核已移除）。
+     */
+    void erase_watch(WatchIt it, bool removeWatch);
+
+    std::vector<std::unique_ptr<Shard> > shards_;    ///< 条目分片
+    size_t shardCapacity_ = 0;                       ///< 每个分片的条目上限
+    size_t maxWatches_ = 0;                          ///< 最大监视数
+    time_t maxAge_ = 0;                              ///< 最长存活时间（秒）
+
+    mutable std::mutex watchMutex_;                  ///< 保护 inotify 与监视表
+    int inotifyFd_ = -1;                             ///< inotify 实例
+    uint64_t nextGeneration_ = 0;                    ///< 代数分配
+    std::list<Watch> watchLru_;                      ///< 表头最近使用
+    std::unordered_map<std::string, WatchIt> watchByPath_; ///< 按目录路径索引
+    std::unordered_map<int, WatchIt> watchByWd_;     ///< 按监视描述符索引
+
+    std::atomic<uint64_t> hits_{0};                  ///< 命中次数
+    std::atomic<uint64_t> misses_{0};                ///< 未命中次数
+    std::atomic<uint64_t> invalidations_{0};         ///< 失效条目数
+    std::atomic<uint64_t> evictions_{0};             ///< 淘汰条目数
+};
+
+#endif // METADATA_CACHE_H
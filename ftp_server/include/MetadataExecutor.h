@@ -0,0 +1,69 @@
+#ifndef METADATA_EXECUTOR_H
+#define METADATA_EXECUTOR_H
+
+#include "ReactorAwaiters.h"
+#include "ThreadPool.h"
+#include <mutex>
+
+/**
+ * @class MetadataExecutor
+ * @brief 执行文件系统元数据操作（stat、mkdir、unlink、打开目录、读取目录项）的专用线程池。
+ *
+ * 元数据调用在 NFS 或繁忙的卷上可能阻塞很久，在 Reactor 线程上执行会让该 Reactor
+ * 上的所有会话一起停顿。这些调用经 `submit()` 提交到本线程池，完成后回到会话所属的
+ * Reactor 线程恢复协程，控制连接的延迟因此与存储延迟无关。
+ * 线程池与传输线程池分开，大文件读写排满队列时元数据操作仍能及时执行，反之亦然。
+ *
+ * 未调用 `configure` 时在首次使用时按默认参数启动；关闭后提交的操作被拒绝。
+ */
+class MetadataExecutor
+{
+public:
+    /**
+     * @brief 获取全局实例。
+     */
+    static MetadataExecutor& instance();
+
+    /**
+     * @brief 按配置启动线程池，需在接受连接之前调用。
+     *
+     * @param minThreads 常驻线程数量。
+     * @param maxThreads 线程数量上限。
+     * @param maxQueue 排队操作的最大数量，超出时拒绝。
+     */
+    void configure(int minThreads, int maxThreads, size_t maxQueue);
+
+    /**
+     * @brief 获取执行元数据操作的线程池，尚未启动时按默认参数启动。
+     */
+    ThreadPool& pool();
+
+    /**
+     * @brief 关闭线程池并等待正在执行的操作结束。
+     *
+     * 操作完成时会通知提交它的 Reactor，须在 Reactor 停止之前调用。
+     */
+    void close();
+
+    /**
+     * @brief 提交一个元数据操作，结果送回指定的 Reactor。
+     *
+     * @param reactor 当前协程所属的 Reactor。
+     * @param fn 阻塞的元数据操作，只能捕获值或共享指针。
+     * @return 可 `co_await` 的 Offload 对象，结果为空表示操作被拒绝。
+     */
+    template<typename F>
+    Offload<std::invoke_result_t<F> > submit(ACE_Reactor* reactor, F&& fn)
+    {
+        return offload(reactor, pool(), std::forward<F>(fn));
+    }
+
+private:
+    MetadataExecutor() = default;
+
+    std::mutex mutex_;    ///< 保护启动状态
+    ThreadPool pool_;     ///< 元数据线程池
+    bool opened_ = false; ///< 是否已启动（关闭后不再自动启动）
+};
+
+#endif // METADATA_EXECUTOR_H
@@ -0,0 +1,180 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @class PageCachePolicy
+ * @brief 大文件顺序传输的页缓存策略。
+ *
+ * 备份等超大文件的一次顺序传输会把交互用户的热数据挤出页缓存。
+ * 文件大小（STOR 为已写入的大小）达到阈值的传输按配置的模式处理：
+ * - NONE：不干预；
+ * - FADVISE：读取时声明顺序访问并按窗口丢弃已发送的页；写入时按窗口启动回写
+ *   （sync_file_range），等上一窗口落盘后丢弃；
+ * - DIRECT：以 O_DIRECT 绕过页缓存（传输缓冲区按页分配，块大小按页对齐），
+ *   文件系统不支持时退回 FADVISE。
+ *
+ * 策略在启动时配置一次，之后只读访问。
+ */
+class PageCachePolicy
+{
+public:
+    /**
+     * @brief 页缓存处理模式。
+     */
+    enum Mode
+    {
+        NONE,    ///< 不干预
+        FADVISE, ///< posix_fadvise + sync_file_range 窗口
+        DIRECT   ///< O_DIRECT
+    };
+
+    /**
+     * @brief 构造函数。
+     *
+     * @param mode 处理模式。
+     * @param threshold 启用策略的文件大小阈值（字节）。
+     * @param window 丢弃/回写窗口大小（字节）。
+     */
+    PageCachePolicy(Mode mode = NONE, off_t threshold = 0, off_t window = 0);
+
+    /**
+     * @brief 获取全局策略实例。
+     */
+    static PageCachePolicy& instance();
+
+    /**
+     * @brief 解析模式名称（none、fadvise、direct）。
+     *
+     * @param name 模式名称。
+     * @param def 无法识别时的默认值。
+     */
+    static Mode parse_mode(const std::string& name, Mode def);
+
+    /**
+     * @brief 设置策略参数。
+     */
+    void configure(Mode mode, off_t threshold, off_t window);
+
+    Mode mode() const { return mode_; }
+    off_t threshold() const { return threshold_; }
+    off_t window() const { return window_; }
+
+private:
+    Mode mode_;        ///< 处理模式
+    off_t threshold_;  ///< 启用阈值
+    off_t window_;     ///< 窗口大小
+};
+
+/**
+ * @brief 文件中的一段字节区间，长度为 0 表示无需处理。
+ */
+struct CacheRange
+{
+    off_t offset = 0; ///< 起始偏移
+    off_t length = 0; ///< 长度
+
+    bool empty() const { return length == 0; }
+};
+
+/**
+ * @class CacheWindow
+ * @brief 单次传输的页缓存窗口跟踪。
+ *
+ * 只计算每一步需要处理的区间，具体由调用方执行：线程池路径调用 `apply_*`
+ * 直接发起系统调用，io_uring 路径提交对应的 FADVISE/SYNC_FILE_RANGE 操作。
+ * 同一传输的读写是串行的，对象不需要加锁。
+ */
+class CacheWindow
+{
+public:
+    /**
+     * @brief 一次写入后的回写动作。
+     */
+    struct WriteBehind
+    {
+        CacheRange start; ///< 启动回写（SYNC_FILE_RANGE_WRITE），不等待
+        CacheRange drop;  ///< 等待回写完成后丢弃（上一窗口）
+    };
+
+    explicit CacheWindow(
+            const PageCachePolicy& policy = PageCachePolicy::instance());
+
+    /**
+     * @brief RETR 打开文件后按文件大小决定是否启用策略。
+     *
+     * @param size 文件大小。
+     * @return 是否启用。
+     */
+    bool engage(off_t size);
+
+    /**
+     * @brief 当前是否使用 O_DIRECT。
+     */
+    bool direct() const { return active_ && mode_ == PageCachePolicy::DIRECT; }
+
+    /**
+     * @brief O_DIRECT 不可用（文件系统不支持、块未对齐或使用 io_uring 固定文件），
+     * 改用 FADVISE 窗口。
+     *
+     * @param fd 已设置 O_DIRECT 的文件，传入时清除该标志。
+     */
+    void fall_back_to_fadvise(int fd = -1);
+
+    /**
+     * @brief 读取推进到 end 后需要丢弃的区间。
+     */
+    CacheRange advance_read(off_t end);
+
+    /**
+     * @brief 写入推进到 end 后的回写动作；STOR 在写入量达到阈值时启用策略。
+     */
+    WriteBehind advance_write(off_t end);
+
+    /**
+     * @brief 写入结束后剩余的未回写区间（启动回写并尽量丢弃，不等待）。
+     */
+    CacheRange finish_write(off_t end);
+
+    /**
+     * @brief 线程池路径：按当前模式设置文件的访问方式（O_DIRECT 或顺序访问声明）。
+     *
+     * @return 设置后是否仍使用 O_DIRECT。
+     */
+    bool apply_open(int fd);
+
+    /**
+     * @brief 线程池路径：写入前调整 O_DIRECT，对齐的块直接写入，
+     * 未对齐的尾块改用缓冲写入。
+     */
+    void apply_before_write(int fd, off_t offset, size_t size);
+
+    /**
+     * @brief 线程池路径：丢弃区间内的页。
+     */
+    static void apply_drop(int fd, const CacheRange& range);
+
+    /**
+     * @brief 线程池路径：执行写后回写动作。
+     */
+    static void apply_write_behind(int fd, const WriteBehind& action);
+
+    /**
+     * @brief 线程池路径：启动剩余区间的回写并丢弃。
+     */
+    static void apply_finish(int fd, const CacheRange& range);
+
+private:
+    PageCachePolicy::Mode mode_; ///< 本次传输的模式（可从 DIRECT 降级）
+    off_t threshold_;            ///< 启用阈值
+    off_t window_;               ///< 窗口大小
+    bool active_ = false;        ///< 是否已启用
+    bool directSet_ = false;     ///< 文件当前是否带 O_DIRECT 标志
+    off_t dropped_ = 0;          ///< 读取：此前的页已丢弃
+    off_t flushed_ = 0;          ///< 写入：此前的页已启动回写
+    off_t synced_ = 0;           ///< 写入：此前的页已落盘并丢弃
+};
+
+#endif // PAGE_CACHE_H
@@ -0,0 +1,211 @@
+#ifndef PATH_RESOLVER_H
+#define PATH_RESOLVER_H
+
+#include "FileSystem.h"
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief 会话根目录或工作目录的已打开句柄（本地文件系统为 O_PATH fd，否则为 -1）。
+ *
+ * 由解析结果共享持有，CWD 切换目录后，线程池中仍在使用旧目录的操作不受影响。
+ */
+struct DirectoryHandle
+{
+    int fd = -1;      ///< 目录 fd
+    std::string path; ///< 虚拟路径（以 "/" 开头，相对于会话根目录）
+
+    DirectoryHandle(int fd, std::string path);
+    ~DirectoryHandle();
+    DirectoryHandle(const DirectoryHandle&) = delete;
+    DirectoryHandle& operator=(const DirectoryHandle&) = delete;
+};
+
+/**
+ * @class ResolvedPath
+ * @brief 客户端路径的解析结果：规范化的虚拟路径及解析所基于的目录。
+ *
+ * 路径在词法上规范化（去掉 "."、折叠 ".."，不会越过根目录），
+ * 文件操作转交给会话的文件系统（`FileSystem`）执行。
+ * 对象可以复制，并可在线程池中使用。
+ */
+class ResolvedPath
+{
+public:
+    ResolvedPath() = default;
+
+    /**
+     * @brief 虚拟路径，用于回复客户端。
+     */
+    const std::string& path() const { return path_; }
+
+    /**
+     * @brief 是否为会话根目录。
+     */
+    bool is_root() const { return fromRoot_ == "."; }
+
+    /**
+     * @brief 路径是否对应内核中的真实文件，见 `FileSystem::native()`。
+     */
+    bool native() const { return fs_->native(); }
+
+    /**
+     * @brief 根目录 fd 与相对于根目录的路径，供本地文件系统和 io_uring 的 OPENAT2 使用。
+     */
+    int root_fd() const { return root_->fd; }
+    const std::string& root_relative() const { return fromRoot_; }
+
+    /**
+     * @brief 工作目录 fd 与相对于工作目录的路径，不在工作目录之下时路径为空。
+     */
+    int cwd_fd() const { return cwd_->fd; }
+    const std::string& cwd_relative() const { return fromCwd_; }
+
+    /**
+     * @brief 根目录句柄，需要在异步操作完成前保持 fd 有效时持有。
+     */
+    std::shared_ptr<const DirectoryHandle> root() const { return root_; }
+
+    /**
+     * @brief 打开路径。
+     *
+     * @return 成功返回 fd，失败返回 -errno。
+     */
+    int open(int flags, mode_t mode = 0) const;
+
+    /**
+     * @brief 获取元数据。
+     *
+     * @param stx 输出的元数据。
+     * @param follow 是否跟随最后一个分量的符号链接。
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int stat(struct statx& stx, bool follow = true) const;
+
+    /**
+     * @brief 创建目录。成功返回 0，失败返回 -errno。
+     */
+    int mkdir(mode_t mode) const;
+
+    /**
+     * @brief 删除空目录。成功返回 0，失败返回 -errno。
+     */
+    int rmdir() const;
+
+    /**
+     * @brief 删除文件（不能删除目录）。成功返回 0，失败返回 -errno。
+     */
+    int unlink() const;
+
+    /**
+     * @brief 改名为 to（目标存在时原子地替换）。成功返回 0，失败返回 -errno。
+     */
+    int rename(const ResolvedPath& to) const;
+
+    /**
+     * @brief 打开目录作为工作目录句柄，可在元数据线程上调用，再由
+     * `PathResolver::enter()` 在会话线程上切换。
+     *
+     * @return 成功返回 0，失败返回 -errno（不是目录时为 -ENOTDIR）。
+     */
+    int open_directory(std::shared_ptr<const DirectoryHandle>& handle) const;
+
+    /**
+     * @brief 读取非本地文件系统的目录内容，见 `FileSystem::read_directory()`。
+     */
+    int read_directory(off_t cursor, std::vector<DirectoryEntry>& entries) const;
+
+    /**
+     * @brief 子路径（name 为目录项名称，不含 '/'）。
+     */
+    ResolvedPath child(const std::string& name) const;
+
+    /**
+     * @brief 父目录（根目录的父目录仍为根目录）。
+     */
+    ResolvedPath parent() const;
+
+    /**
+     * @brief 最后一个分量，根目录为空。
+     */
+    std::string name() const;
+
+private:
+    friend class PathResolver;
+
+    /**
+     * @brief 由规范化的虚拟路径构造，计算相对于根目录和工作目录的路径。
+     */
+    ResolvedPath(
+            std::shared_ptr<FileSystem> fs,
+            std::shared_ptr<const DirectoryHandle> root,
+            std::shared_ptr<const DirectoryHandle> cwd,
+            std::string path);
+
+    std::shared_ptr<FileSystem> fs_;              ///< 执行操作的文件系统
+    std::shared_ptr<const DirectoryHandle> root_; ///< 会话根目录
+    std::shared_ptr<const DirectoryHandle> cwd_;  ///< 解析时的工作目录
+    std::string path_;     ///< 虚拟路径
+    std::string fromRoot_; ///< 相对于根目录的路径，根目录为 "."
+    std::string fromCwd_;  ///< 相对于工作目录的路径，不在工作目录之下时为空
+};
+
+/**
+ * @class PathResolver
+ * @brief 会话的路径解析：每个会话持有自己的工作目录句柄（本地文件系统为目录 fd）。
+ *
+ * 取代进程级的 chdir：CWD 只改变本会话的工作目录，各会话可以同时在不同的目录树中
+ * 操作，也不再需要每次 realpath。
+ * 文件系统被限制时（配置了 root_directory 或使用内存文件系统）虚拟路径以其根目录为
+ * "/"，初始工作目录为 "/"；否则初始工作目录为进程启动时的当前目录，虚拟路径即真实路径。
+ */
+class PathResolver
+{
+public:
+    /**
+     * @brief 设置会话的文件系统和初始工作目录。
+     *
+     * @param fs 文件系统。
+     * @param home 初始工作目录的虚拟路径，无法进入时为根目录。
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int open(std::shared_ptr<FileSystem> fs, const std::string& home);
+
+    /**
+     * @brief 会话是否被限制在 "/" 以外的根目录中，见 `FileSystem::confined()`。
+     */
+    bool confined() const { return fs_->confined(); }
+
+    /**
+     * @brief 当前工作目录的虚拟路径。
+     */
+    const std::string& cwd() const;
+
+    /**
+     * @brief 解析客户端给出的路径（相对路径基于工作目录），空路径为工作目录。
+     */
+    ResolvedPath resolve(const std::string& path) const;
+
+    /**
+     * @brief 改变工作目录。
+     *
+     * @param path 客户端给出的路径。
+     * @return 成功返回 0，失败返回 -errno（不是目录时为 -ENOTDIR）。
+     */
+    int change_directory(const std::string& path);
+
+    /**
+     * @brief 切换到已打开的目录句柄，见 `ResolvedPath::open_directory()`。
+     */
+    void enter(std::shared_ptr<const DirectoryHandle> handle);
+
+private:
+    std::shared_ptr<FileSystem> fs_;              ///< 文件系统
+    std::shared_ptr<const DirectoryHandle> root_; ///< 根目录
+    std::shared_ptr<const DirectoryHandle> cwd_;  ///< 工作目录
+};
+
+#endif // PATH_RESOLVER_H
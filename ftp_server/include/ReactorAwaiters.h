@@ -0,0 +1,283 @@
+#ifndef REACTOR_AWAITERS_H
+#define REACTOR_AWAITERS_H
+
+#include "Coroutine.h"
+#include "ThreadPool.h"
+#include <ace/Event_Handler.h>
+#include <ace/Reactor.h>
+#include <ace/SOCK_Acceptor.h>
+#include <ace/SOCK_Stream.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <sys/uio.h>
+#include <type_traits>
+
+/**
+ * @class IoWait
+ * @brief 等待句柄在 Reactor 上就绪的 awaitable。
+ *
+ * `IoWait waiting(reactor, handle, mask); co_await waiting;` 会把自身注册到 Reactor
+ * 上并挂起当前协程，句柄可读/可写/可接受连接时在 Reactor 线程中注销并恢复协程。
+ * 须先存入具名局部变量再 `co_await`（见 Task 关于 GCC 12 临时 awaitable 的说明）。
+ * 协程在挂起期间被销毁时，析构函数负责从 Reactor 注销，不会留下悬空的处理器。
+ */
+class IoWait: public ACE_Event_Handler
+{
+public:
+    /**
+     * @brief 构造函数。
+     *
+     * @param reactor 协程所属的 Reactor。
+     * @param handle 要等待的句柄。
+     * @param mask 等待的事件（READ_MASK、WRITE_MASK 或 ACCEPT_MASK）。
+     */
+    IoWait(ACE_Reactor* reactor, ACE_HANDLE handle, ACE_Reactor_Mask mask);
+
+    /**
+     * @brief 析构函数，若仍注册在 Reactor 上则注销。
+     */
+    ~IoWait() override;
+
+    bool await_ready() const noexcept { return false; }
+
+    /**
+     * @brief 注册到 Reactor 并挂起协程；注册失败时不挂起。
+     */
+    bool await_suspend(std::coroutine_handle<> waiter);
+
+    /**
+     * @brief 恢复时返回是否成功等到了事件。
+     */
+    bool await_resume() const noexcept { return !failed_; }
+
+    ACE_HANDLE get_handle() const override;
+    int handle_input(ACE_HANDLE fd = ACE_INVALID_HANDLE) override;
+    int handle_output(ACE_HANDLE fd = ACE_INVALID_HANDLE) override;
+    int handle_close(ACE_HANDLE handle, ACE_Reactor_Mask close_mask) override;
+
+private:
+    /**
+     * @brief 事件就绪：注销并恢复等待的协程。之后不得再访问成员。
+     */
+    int fire();
+
+    ACE_Reactor* reactor_;           ///< 所属 Reactor
+    ACE_HANDLE handle_;              ///< 等待的句柄
+    ACE_Reactor_Mask mask_;          ///< 等待的事件掩码
+    std::coroutine_handle<> waiter_; ///< 挂起的协程
+    bool registered_ = false;        ///< 是否已注册到 Reactor
+    bool failed_ = false;            ///< 注册失败
+};
+
+/**
+ * @class OffloadState
+ * @brief 一次卸载到线程池的阻塞操作的共享状态。
+ *
+ * 线程池线程写入结果后通过 `notify()` 回到所属 Reactor 线程，
+ * 在 `handle_exception()` 中恢复等待的协程。状态对象在通知送达前保持自身存活，
+ * 因此等待的协程被销毁（会话关闭）后，迟到的完成通知也是安全的。
+ *
+ * @tparam R 阻塞操作的返回值类型。
+ */
+template<typename R>
+class OffloadState: public ACE_Event_Handler
+{
+public:
+    explicit OffloadState(ACE_Reactor* reactor): reactor_(reactor) {}
+
+    /**
+     * @brief 在 Reactor 线程中处理完成通知并恢复等待的协程。
+     */
+    int handle_exception(ACE_HANDLE /*fd*/) override
+    {
+        std::shared_ptr<OffloadState> keep = std::move(self_);
+        completed_.load(std::memory_order_acquire);
+        done_ = true;
+        std::coroutine_handle<> waiter = std::exchange(waiter_, {});
+        if (waiter) {
+            waiter.resume();
+        }
+        return 0; // keep 析构后可能释放自身，此后不得访问成员
+    }
+
+    ACE_Reactor* reactor_;                ///< 结果送回的 Reactor
+    std::optional<R> value_;              ///< 阻塞操作的结果
+    std::atomic<bool> completed_{false};  ///< 线程池侧已写入结果
+    bool done_ = false;                   ///< Reactor 侧已收到完成通知
+    std::coroutine_handle<> waiter_;      ///< 挂起等待结果的协程
+    std::shared_ptr<OffloadState> self_;  ///< 通知送达前保持存活
+};
+
+/**
+ * @class Offload
+ * @brief 把阻塞操作（文件 I/O、元数据调用）卸载到线程池并在 Reactor 上等待结果。
+ *
+ * 操作在 `start()` 或首次 `co_await` 时提交，因此可以先启动下一块的读取，
+ * 再发送当前块，实现双缓冲流水线。`co_await` 的结果为 `std::optional<R>`，
+ * 线程池拒绝任务（背压）时为空，调用方应回复 450 而不是让客户端等待。
+ * 一项工作只有第一个操作以 BOUNDED 提交（准入），之后的操作以 ADMITTED 提交，
+ * 只在线程池关闭时被拒绝。
+ *
+ * @tparam R 阻塞操作的返回值类型。
+ */
+template<typename R>
+class Offload
+{
+public:
+    Offload(ACE_Reactor* reactor,
+            ThreadPool& pool,
+            std::function<R()> fn,
+            ThreadPool::Admission admission = ThreadPool::BOUNDED)
+        : state_(std::make_shared<OffloadState<R> >(reactor)),
+          pool_(pool),
+          fn_(std::move(fn)),
+          admission_(admission)
+    {
+    }
+
+    Offload(const Offload&) = delete;
+    Offload& operator=(const Offload&) = delete;
+
+    /**
+     * @brief 析构时放弃等待，迟到的完成通知不会再恢复已销毁的协程。
+     */
+    ~Offload()
+    {
+        if (state_) {
+            state_->waiter_ = {};
+        }
+    }
+
+    /**
+     * @brief 提交操作到线程池（只提交一次）。
+     */
+    void start()
+    {
+        if (started_) {
+            return;
+        }
+        started_ = true;
+
+        std::shared_ptr<OffloadState<R> > state = state_;
+        state->self_ = state;
+        auto task = [state, fn = fn_]() {
+            state->value_.emplace(fn());
+            state->completed_.store(true, std::memory_order_release);
+            // 线程池在 Reactor 停止之前关闭（见 main），此时 Reactor 仍然存活
+            state->reactor_->notify(
+                    state.get(), ACE_Event_Handler::EXCEPT_MASK);
+        };
+        bool accepted = pool_.enqueue(std::move(task), admission_);
+        if (!accepted) {
+            state->self_.reset();
+            state->done_ = true; // 被拒绝，结果为空
+        }
+    }
+
+    /**
+     * @brief 等待操作完成，结果为空表示线程池拒绝了任务。
+     */
+    auto operator co_await() noexcept
+    {
+        struct Awaiter
+        {
+            Offload* op_;
+
+            bool await_ready()
+            {
+                op_->start();
+                return op_->state_->done_;
+            }
+
+            void await_suspend(std::coroutine_handle<> waiter)
+            {
+                op_->state_->waiter_ = waiter;
+            }
+
+            std::optional<R> await_resume()
+            {
+                return std::move(op_->state_->value_);
+            }
+        };
+        return Awaiter{this};
+    }
+
+private:
+    std::shared_ptr<OffloadState<R> > state_; ///< 与线程池任务共享的状态
+    ThreadPool& pool_;                         ///< 执行阻塞操作的线程池
+    std::function<R()> fn_;                    ///< 阻塞操作
+    ThreadPool::Admission admission_;          ///< 提交时的准入方式
+    bool started_ = false;                     ///< 是否已提交
+};
+
+/**
+ * @brief 创建一个卸载到线程池的阻塞操作。
+ *
+ * @param reactor 结果送回的 Reactor（即当前协程所属的 Reactor）。
+ * @param pool 执行操作的线程池。
+ * @param fn 阻塞操作，只能捕获值或共享指针，不能引用协程帧中的对象。
+ * @param admission 准入方式，已被接纳的工作的后续操作为 ADMITTED。
+ * @return 可 `co_await` 的 Offload 对象。
+ */
+template<typename F>
+Offload<std::invoke_result_t<F> > offload(
+        ACE_Reactor* reactor,
+        ThreadPool& pool,
+        F&& fn,
+        ThreadPool::Admission admission = ThreadPool::BOUNDED)
+{
+    return Offload<std::invoke_result_t<F> >(
+            reactor, pool, std::forward<F>(fn), admission);
+}
+
+/**
+ * @brief 异步接受一个数据连接。
+ *
+ * 监听套接字被设置为非阻塞，未有连接到达时在 Reactor 上挂起。
+ * 接受的连接同样被设置为非阻塞，供 `async_recv`/`async_send_all` 使用。
+ *
+ * @return 成功返回 0，失败返回 -1。
+ */
+Task<int> async_accept(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Acceptor& acceptor,
+        ACE_SOCK_Stream& stream);
+
+/**
+ * @brief 异步接收数据，数据不可读时在 Reactor 上挂起。
+ *
+ * @return 接收的字节数，对端关闭返回 0，出错返回 -1。
+ */
+Task<ssize_t> async_recv(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& stream,
+        char* buffer,
+        size_t size);
+
+/**
+ * @brief 异步发送全部数据，发送缓冲区满时在 Reactor 上挂起。
+ *
+ * @return 成功返回 size，出错返回 -1。
+ */
+Task<ssize_t> async_send_all(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& stream,
+        const char* data,
+        size_t size);
+
+/**
+ * @brief 异步发送多段数据（sendmsg），发送缓冲区满时在 Reactor 上挂起。
+ *
+ * 多段数据一次系统调用发出，避免为拼接而复制；发送过程中会修改 iov。
+ *
+ * @return 成功返回各段的总长度，出错返回 -1。
+ */
+Task<ssize_t> async_sendv_all(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& stream,
+        iovec* iov,
+        size_t count);
+
+#endif // REACTOR_AWAITERS_H
@@ -0,0 +1,216 @@
+#ifndef RSYNC_DELTA_H
+#define RSYNC_DELTA_H
+
+#include "FileHash.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 按偏移读取基准文件的函数，语义与 pread 相同（去重文件经由清单读取）。
+ */
+typedef std::function<ssize_t(char*, size_t, off_t)> ReadAt;
+
+/**
+ * @brief 计算 rsync 弱校验：a = Σx，b = Σ(n - i)·x，结果为 a | b << 16（各取低 16 位）。
+ *
+ * CPU 支持 AVX2 时每次处理 32 字节（vpsadbw 求和、vpmaddubsw 加权），
+ * 否则逐字节计算。
+ */
+uint32_t rolling_checksum(const void* data, size_t size);
+
+/**
+ * @class RollingChecksum
+ * @brief 可滑动的弱校验：窗口移动一个字节时 O(1) 更新。
+ */
+class RollingChecksum
+{
+public:
+    /**
+     * @brief 以 data 开头的 size 个字节为窗口重新计算。
+     */
+    void reset(const char* data, size_t size);
+
+    /**
+     * @brief 窗口右移一个字节：移出 out，移入 in。
+     */
+    void roll(uint8_t out, uint8_t in)
+    {
+        a_ += in - out;
+        b_ += a_ - static_cast<uint32_t>(length_) * out;
+    }
+
+    uint32_t value() const { return (a_ & 0xffff) | (b_ << 16); }
+
+private:
+    uint32_t a_ = 0;    ///< 字节和
+    uint32_t b_ = 0;    ///< 加权和
+    size_t length_ = 0; ///< 窗口长度
+};
+
+/**
+ * @class DeltaSignature
+ * @brief 文件的块签名：每个固定大小的块一个弱校验和一个 MD5。
+ *
+ * 文本格式，首行 "FTPSIG 1 <块大小> <文件大小> <块数>"，之后每块一行
+ * "<弱校验 8 位十六进制> <MD5>"，最后一块可以不满。
+ */
+class DeltaSignature
+{
+public:
+    static constexpr size_t MIN_BLOCK = 512;        ///< 最小块大小
+    static constexpr size_t MAX_BLOCK = 128 * 1024; ///< 最大块大小
+
+    /**
+     * @brief 按文件大小选择块大小：约为大小的平方根，限制在 2 KiB～MAX_BLOCK。
+     */
+    static size_t default_block_size(off_t size);
+
+    /**
+     * @brief 签名的首行。
+     */
+    static std::string header(size_t blockSize, off_t size);
+
+    /**
+     * @brief 把 data 按块追加签名行，除最后一块外 size 应为块大小的整数倍。
+     */
+    static void append_blocks(const char* data, size_t size, size_t blockSize, std::string& out);
+
+    /**
+     * @brief 解析签名文本。
+     *
+     * @return 成功返回 0，格式错误返回 -EINVAL。
+     */
+    int parse(const std::string& text);
+
+    size_t block_size() const { return blockSize_; }
+    off_t size() const { return size_; }
+    size_t blocks() const { return blocks_.size(); }
+
+private:
+    friend class DeltaEncoder;
+
+    struct Block
+    {
+        uint32_t weak;      ///< 弱校验
+        std::string strong; ///< MD5
+    };
+
+    size_t blockSize_ = 0;      ///< 块大小
+    off_t size_ = 0;            ///< 文件大小
+    std::vector<Block> blocks_; ///< 各块签名
+    std::unordered_map<uint32_t, std::vector<size_t> > index_; ///< 弱校验到块号
+    std::vector<uint8_t> tags_; ///< 弱校验的 16 位标记，查表前快速排除
+};
+
+/**
+ * @class DeltaEncoder
+ * @brief 以对方文件的签名为基准，把新文件编码为增量。
+ *
+ * 增量为文本指令与原始数据交替的流：首行 "FTPDELTA 1 <块大小>"；
+ * "C <块号> <块数>" 复制基准文件中连续的块；"D <长度>" 后跟长度个字节的新数据；
+ * 最后 "E <大小> <SHA-256>" 给出结果的大小与摘要，供对方校验。
+ */
+class DeltaEncoder
+{
+public:
+    /**
+     * @param signature 基准文件的签名，须在编码期间保持有效。
+     */
+    explicit DeltaEncoder(const DeltaSignature& signature);
+
+    /**
+     * @brief 追加新文件的数据，把已确定的指令追加到 out。
+     */
+    void update(const char* data, size_t size, std::string& out);
+
+    /**
+     * @brief 结束编码，输出剩余的指令与结束行。
+     */
+    void finish(std::string& out);
+
+    /**
+     * @brief 复用基准文件的字节数。
+     */
+    off_t matched() const { return matched_; }
+
+private:
+    void start(std::string& out);
+    bool match_window(std::string& out);
+    void emit_copy(size_t block, size_t length, std::string& out);
+    void flush_run(std::string& out);
+    void flush_literal(std::string& out);
+
+    const DeltaSignature& signature_; ///< 基准签名
+    size_t blockSize_;                ///< 块大小
+    bool started_ = false;            ///< 已输出首行
+    std::string data_;                ///< 尚未编码的数据
+    size_t literal_ = 0;              ///< data_ 中待输出的新数据的起点
+    size_t pos_ = 0;                  ///< data_ 中当前窗口的起点
+    RollingChecksum rolling_;         ///< 当前窗口的弱校验
+    bool rollingValid_ = false;       ///< rolling_ 对应 pos_ 处的窗口
+    bool checked_ = false;            ///< 当前窗口已查找过
+    size_t runStart_ = 0;             ///< 待输出的连续复制的起始块
+    size_t runCount_ = 0;             ///< 待输出的连续复制的块数
+    off_t matched_ = 0;               ///< 复用的字节数
+    off_t size_ = 0;                  ///< 新文件大小
+    Hasher digest_;                   ///< 新文件的 SHA-256
+};
+
+/**
+ * @class DeltaPatcher
+ * @brief 把增量应用到基准文件，结果按顺序写入目标文件。
+ *
+ * 增量可以分段送入；结束行中的大小和 SHA-256 与写入的结果不符时失败。
+ * 方法会阻塞，应依次在线程池中调用。
+ */
+class DeltaPatcher
+{
+public:
+    /**
+     * @param basis 读取基准文件。
+     * @param basisSize 基准文件大小。
+     * @param target 目标文件（不持有）。
+     */
+    DeltaPatcher(ReadAt basis, off_t basisSize, int target);
+
+    /**
+     * @brief 送入一段增量。
+     *
+     * @return 成功返回 0，格式错误返回 -EBADMSG，其他失败返回 -errno。
+     */
+    int feed(const char* data, size_t size);
+
+    /**
+     * @brief 确认增量完整，结果与结束行一致。
+     *
+     * @return 成功返回 0，不完整或不一致返回 -EBADMSG。
+     */
+    int finish();
+
+    off_t size() const { return written_; }
+    off_t reused() const { return reused_; }
+
+private:
+    int command(const std::string& line);
+    int write(const char* data, size_t size);
+
+    ReadAt basis_;            ///< 基准文件
+    off_t basisSize_;         ///< 基准文件大小
+    int target_;              ///< 目标文件
+    size_t blockSize_ = 0;    ///< 块大小，读到首行后有效
+    std::string line_;        ///< 未读完的指令行
+    off_t literal_ = 0;       ///< 当前 D 指令剩余的数据字节
+    bool ended_ = false;      ///< 已读到结束行
+    bool valid_ = false;      ///< 结束行与结果一致
+    off_t written_ = 0;       ///< 已写入的字节数
+    off_t reused_ = 0;        ///< 从基准文件复制的字节数
+    Hasher digest_;           ///< 结果的 SHA-256
+    std::vector<char> buffer_; ///< 复制基准文件的缓冲
+};
+
+#endif // RSYNC_DELTA_H
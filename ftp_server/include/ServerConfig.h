@@ -0,0 +1,76 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <string>
+#include <map>
+
+/**
+ * @class ServerConfig
+ * @brief 服务器运行参数配置类。
+ *
+ * 配置文件格式与 userfile.txt 相同，每行一个 "键 值" 对，以 # 开头的行为注释。
+ * 未出现在配置文件中的键使用各模块的默认值。配置在启动时加载一次，
+ * 之后各模块只读访问，因此不需要加锁。
+ */
+class ServerConfig
+{
+public:
+    /**
+     * @brief 获取全局唯一的配置实例。
+     *
+     * @return 配置实例的引用。
+     */
+    static ServerConfig& instance();
+
+    /**
+     * @brief 从配置文件加载参数。
+     *
+     * @param path 配置文件路径。
+     * @return 文件存在并读取成功返回 true；文件不存在返回 false（使用默认值）。
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @brief 设置一个配置项，覆盖配置文件中的值。
+     *
+     * @param key 配置键。
+     * @param value 配置值。
+     */
+    void set(const std::string& key, const std::string& value);
+
+    /**
+     * @brief 获取字符串类型的配置项。
+     *
+     * @param key 配置键。
+     * @param def 配置项不存在时的默认值。
+     * @return 配置值。
+     */
+    std::string get_string(const std::string& key, const std::string& def) const;
+
+    /**
+     * @brief 获取整数类型的配置项。
+     *
+     * 支持 K/M/G 后缀（按 1024 进制），便于配置缓存大小等参数。
+     *
+     * @param key 配置键。
+     * @param def 配置项不存在或无法解析时的默认值。
+     * @return 配置值。
+     */
+    long long get_int(const std::string& key, long long def) const;
+
+    /**
+     * @brief 获取布尔类型的配置项，接受 on/off、yes/no、true/false、1/0。
+     *
+     * @param key 配置键。
+     * @param def 配置项不存在或无法解析时的默认值。
+     * @return 配置值。
+     */
+    bool get_bool(const std::string& key, bool def) const;
+
+private:
+    ServerConfig() = default;
+
+    std::map<std::string, std::string> values_; ///< 配置键值表
+};
+
+#endif // SERVER_CONFIG_H
@@ -1,11 +1,19 @@
 #ifndef SESSION_H
 #define SESSION_H
 
+#include "Coroutine.h"
+#include "FileHash.h"
+#include "PathResolver.h"
+#include <memory>
 #include <string>
 #include <ace/SOCK_Stream.h>
+#include <ace/Reactor.h>
 #include <pwd.h>    // For getpwuid
 #include <unistd.h> // For getuid
 
+class IoUring;
+class WatchSink;
+
 /**
  * @enum TransferMode
  * @brief 定义文件传输模式。
@@ -78,19 +86,31 @@ public:
      */
     void set_transfer_mode(TransferMode mode);
 
+    /**
+     * @brief 获取 HASH 命令使用的算法（由 OPTS HASH 选择，默认 SHA-256）。
+     */
+    HashAlgorithm get_hash_algorithm() const;
+
+    /**
+     * @brief 设置 HASH 命令使用的算法。
+     */
+    void set_hash_algorithm(HashAlgorithm algorithm);
+
     /**
      * @brief 获取当前的工作目录。
      *
-     * @return 当前工作目录的字符串引用。
+     * @return 当前工作目录的虚拟路径（相对于会话根目录）。
      */
     const std::string& get_working_directory() const;
 
     /**
-     * @brief 设置当前的工作目录。
+     * @brief 获取会话的路径解析器。
+     *
+     * 所有路径都经由它解析为基于会话根目录/工作目录 fd 的路径，CWD 通过它改变工作目录。
      *
-     * @param dir 要设置的工作目录路径。
+     * @return 会话的路径解析器。
      */
-    void set_working_directory(const std::string& dir);
+    PathResolver& get_path_resolver();
 
     /**
      * @brief 获取当前会话的用户名。
@@ -113,6 +133,73 @@ public:
      */
     ACE_SOCK_Stream& get_client_stream();
 
+    /**
+     * @brief 获取会话所属的 Reactor。
+     *
+     * 会话的所有事件处理和协程都在该 Reactor 线程上运行。
+     *
+     * @return 会话所属的 Reactor 指针。
+     */
+    ACE_Reactor* get_reactor() const;
+
+    /**
+     * @brief 设置会话所属的 Reactor。
+     *
+     * @param reactor 会话所属的 Reactor 指针。
+     */
+    void set_reactor(ACE_Reactor* reactor);
+
+    /**
+     * @brief 设置会话控制连接的事件处理器，异步命令执行期间暂停它的读事件。
+     *
+     * @param handler 控制连接的事件处理器。
+     */
+    void set_handler(ACE_Event_Handler* handler);
+
+    /**
+     * @brief 运行一个异步完成的命令（如等待元数据操作结果的命令）。
+     *
+     * 命令完成前暂停读取控制连接，之后到达的命令在它回复之后才处理，保持命令顺序；
+     * 期间暂缓异步通知（见 `begin_reply`）。
+     * 会话销毁时未完成的命令随之取消；命令协程不得引用命令对象本身。
+     *
+     * @param command 命令协程，尚未启动。
+     */
+    void run_command(Task<void> command);
+
+    /**
+     * @brief 开始等待一个命令或传输的最终回复，期间暂缓异步通知。
+     *
+     * 可以嵌套（如传输进行中又执行了异步命令），与 `end_reply` 成对调用。
+     */
+    void begin_reply();
+
+    /**
+     * @brief 最终回复已发送；没有其他等待中的回复时发送暂缓的通知。
+     */
+    void end_reply();
+
+    /**
+     * @brief 设置会话的异步通知出口（SITE WATCH），为空表示取消。
+     *
+     * @param sink 通知出口，按当前是否有等待中的回复暂缓。
+     */
+    void set_notices(std::shared_ptr<WatchSink> sink);
+
+    /**
+     * @brief 获取会话所属 Reactor 的 io_uring 实例。
+     *
+     * @return io_uring 实例指针；未启用或内核不支持时为 nullptr，传输使用线程池路径。
+     */
+    IoUring* get_io_uring() const;
+
+    /**
+     * @brief 设置会话所属 Reactor 的 io_uring 实例。
+     *
+     * @param uring io_uring 实例指针，可为 nullptr。
+     */
+    void set_io_uring(IoUring* uring);
+
     /**
      * @brief 获取当前用户的主目录。
      *
@@ -123,12 +210,24 @@ public:
     std::string get_home_directory();
 
 private:
+    /**
+     * @brief 等待命令完成后恢复读取控制连接。
+     */
+    Task<void> finish_command(Task<void> command);
+
     ACE_SOCK_Stream& clientStream_; ///< 与客户端通信的套接字流
     bool logged_in_;                ///< 指示用户是否已登录
     bool passive_mode_;             ///< 指示是否处于被动模式
     TransferMode transfer_mode_;    ///< 当前的文件传输模式
-    std::string working_directory_; ///< 当前的工作目录
+    HashAlgorithm hash_algorithm_;  ///< HASH 命令使用的算法
+    PathResolver resolver_;         ///< 根目录与工作目录
     std::string username_;          ///< 当前会话的用户名
+    ACE_Reactor* reactor_;          ///< 会话所属的 Reactor
+    IoUring* io_uring_;             ///< 会话所属 Reactor 的 io_uring，可为空
+    ACE_Event_Handler* handler_;    ///< 控制连接的事件处理器
+    Task<void> command_;            ///< 正在执行的异步命令
+    int replies_ = 0;               ///< 等待最终回复的命令与传输数
+    std::shared_ptr<WatchSink> notices_; ///< 异步通知出口，可为空
 };
 
 #endif // SESSION_H
@@ -0,0 +1,195 @@
+#ifndef TAR_ARCHIVE_H
+#define TAR_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+struct z_stream_s;
+
+/**
+ * @brief 归档成员的元数据。
+ */
+struct TarMember
+{
+    static constexpr char REGULAR = '0';   ///< 普通文件
+    static constexpr char DIRECTORY = '5'; ///< 目录
+
+    std::string name;    ///< 成员名（相对路径，不以 '/' 开头或结尾）
+    char type = REGULAR; ///< 类型
+    mode_t mode = 0644;  ///< 权限
+    uid_t uid = 0;       ///< 属主
+    gid_t gid = 0;       ///< 属组
+    off_t size = 0;      ///< 数据大小，目录为 0
+    int64_t mtime = 0;   ///< 修改时间（秒）
+};
+
+/**
+ * @class TarArchive
+ * @brief POSIX tar（pax 格式）的编码：512 字节的头部块、按块补齐的数据、两个全零块结尾。
+ *
+ * 成员名超过 ustar 的 100 字节或大小超过 8 GiB 时，前面加一个 pax 扩展头部
+ * 记录完整的值，GNU tar、bsdtar 和 Python tarfile 均可读取。
+ */
+class TarArchive
+{
+public:
+    static constexpr size_t BLOCK = 512; ///< 块大小
+
+    /**
+     * @brief 成员的头部（必要时带 pax 扩展头部），长度为块大小的整数倍。
+     */
+    static std::string header(const TarMember& member);
+
+    /**
+     * @brief 大小为 size 的数据之后补齐到块边界的字节数。
+     */
+    static size_t padding(off_t size);
+
+    /**
+     * @brief 归档结尾的两个全零块。
+     */
+    static std::string trailer();
+};
+
+/**
+ * @class TarReader
+ * @brief 流式解析 tar：输入按到达的分段送入，依次取出成员的头部与数据。
+ *
+ * 支持 ustar（含 prefix 字段）、pax 扩展头部（path、size、mtime）与 GNU 长文件名，
+ * 大小字段可以是八进制或 GNU 的 base-256。读取器不复制成员数据，取出的数据
+ * 指向送入的分段。
+ */
+class TarReader
+{
+public:
+    /**
+     * @brief `next()` 取出的项。
+     */
+    enum Item
+    {
+        MORE,    ///< 需要送入更多输入
+        HEADER,  ///< 新成员，元数据见 `member()`
+        DATA,    ///< 当前成员的一段数据
+        END,     ///< 归档结尾（全零块）
+        INVALID  ///< 格式错误（校验和不符等）
+    };
+
+    /**
+     * @brief 送入一段输入，须在 `next()` 返回 MORE 之后才能送入下一段。
+     */
+    void feed(const char* data, size_t size);
+
+    /**
+     * @brief 取出下一项，DATA 时 data 与 size 为数据。
+     */
+    Item next(const char*& data, size_t& size);
+
+    /**
+     * @brief 最近一个 HEADER 的成员，类型为 '0'（含旧格式的 '\0'、'7'）、'5'
+     * 或其他原始类型字符（链接、设备等）。
+     */
+    const TarMember& member() const { return member_; }
+
+    /**
+     * @brief 输入是否停在成员之间（读到结尾，或没有读了一半的头部与数据）。
+     */
+    bool complete() const;
+
+private:
+    enum State
+    {
+        READ_HEADER, ///< 读取头部块
+        READ_DATA,   ///< 读取成员数据
+        READ_META,   ///< 读取 pax 扩展头部或 GNU 长文件名
+        SKIP         ///< 跳过补齐或不需要的数据
+    };
+
+    Item header(const char* block);
+    bool apply_meta();
+
+    const char* input_ = nullptr; ///< 当前分段
+    size_t size_ = 0;             ///< 当前分段的长度
+    size_t pos_ = 0;              ///< 当前分段中已读取的位置
+    State state_ = READ_HEADER;   ///< 解析状态
+    std::string block_;           ///< 跨分段的头部块
+    char metaType_ = 0;           ///< 正在读取的扩展头部类型
+    std::string meta_;            ///< 扩展头部的内容
+    uint64_t remaining_ = 0;      ///< 当前成员或扩展头部剩余的字节
+    uint64_t skip_ = 0;           ///< 待跳过的字节
+    std::string longName_;        ///< 扩展头部给出的下一个成员名
+    int64_t longSize_ = -1;       ///< 扩展头部给出的下一个成员大小
+    int64_t longMtime_ = -1;      ///< 扩展头部给出的下一个成员修改时间
+    bool ended_ = false;          ///< 已读到结尾
+    bool failed_ = false;         ///< 已遇到格式错误
+    TarMember member_;            ///< 当前成员
+};
+
+/**
+ * @class GzipStream
+ * @brief 以 gzip 格式流式压缩（zlib deflate）。
+ *
+ * 方法会占用 CPU，应依次在线程池中调用。
+ */
+class GzipStream
+{
+public:
+    /**
+     * @param level 压缩级别（1～9）。
+     */
+    explicit GzipStream(int level);
+    ~GzipStream();
+    GzipStream(const GzipStream&) = delete;
+    GzipStream& operator=(const GzipStream&) = delete;
+
+    /**
+     * @brief 压缩一段数据，产生的输出追加到 out。
+     */
+    void write(const char* data, size_t size, std::string& out);
+
+    /**
+     * @brief 结束压缩，输出剩余数据与 gzip 尾部。
+     */
+    void finish(std::string& out);
+
+private:
+    void deflate(const char* data, size_t size, int flush, std::string& out);
+
+    std::unique_ptr<z_stream_s> stream_; ///< zlib 状态
+};
+
+/**
+ * @class GunzipStream
+ * @brief 流式解压 gzip（可以是多个依次连接的 gzip 成员），每次输出有上限。
+ *
+ * 方法会占用 CPU，应依次在线程池中调用。
+ */
+class GunzipStream
+{
+public:
+    GunzipStream();
+    ~GunzipStream();
+    GunzipStream(const GunzipStream&) = delete;
+    GunzipStream& operator=(const GunzipStream&) = delete;
+
+    /**
+     * @brief 送入压缩数据，须在 `read()` 返回 0 之后才能送入下一段。
+     */
+    void write(const char* data, size_t size);
+
+    /**
+     * @brief 解压到 out（替换其内容），最多 limit 字节。
+     *
+     * @return 还有未解压的输入返回 1，输入已用完返回 0，格式错误返回 -EBADMSG。
+     */
+    int read(std::string& out, size_t limit);
+
+private:
+    std::unique_ptr<z_stream_s> stream_; ///< zlib 状态
+    std::string input_;                  ///< 送入的压缩数据
+    size_t consumed_ = 0;                ///< 已解压的输入字节
+};
+
+#endif // TAR_ARCHIVE_H
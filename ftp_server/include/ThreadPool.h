@@ -8,18 +8,33 @@
 #include <mutex>
 #include <condition_variable>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
 
 /**
  * @class ThreadPool
- * @brief 一个简单的线程池类，用于管理并发任务的执行。
+ * @brief 一个弹性线程池类，用于管理并发任务的执行。
  *
- * 该线程池类通过创建多个工作线程来并发执行任务。任务被添加到任务队列中，
- * 空闲的工作线程将从队列中提取任务并执行。线程池支持设置任务队列的最大长度，
- * 当队列满时，新任务将被拒绝。
+ * 线程池在 [min_threads, max_threads] 区间内按需伸缩：当排队任务数超过空闲线程数
+ * 时创建新线程，线程空闲超过 idle_timeout 后自动退出（但不少于 min_threads）。
+ * 线程池支持设置任务队列的最大长度，当队列满或线程池已关闭时，新任务将被拒绝，
+ * 被拒绝的任务数会被统计，调用方应据此向客户端返回错误响应。
+ * 准入只在一项工作（如一次传输）开始时判断：已被接纳的工作的后续任务以
+ * ADMITTED 提交，不受队列上限限制，高峰期进行中的传输不会在中途被拒绝。
  */
 class ThreadPool
 {
 public:
+    /**
+     * @brief 任务的准入方式。
+     */
+    enum Admission
+    {
+        BOUNDED, ///< 新的工作：队列满时拒绝
+        ADMITTED ///< 已被接纳的工作的后续任务：只在线程池关闭时拒绝
+    };
+
     /**
      * @brief 构造函数，初始化线程池。
      *
@@ -35,12 +50,24 @@ public:
     ~ThreadPool();
 
     /**
-     * @brief 打开线程池并启动指定数量的线程。
+     * @brief 打开线程池并启动固定数量的线程。
+     *
+     * 等价于 `open(num_threads, num_threads)`。
      *
      * @param num_threads 要启动的线程数量，默认为 4。
      */
     void open(int num_threads = 4);
 
+    /**
+     * @brief 打开弹性线程池。
+     *
+     * 立即启动 min_threads 个常驻线程，高峰期最多扩展到 max_threads 个线程。
+     *
+     * @param min_threads 常驻线程数量下限。
+     * @param max_threads 线程数量上限，小于 min_threads 时按 min_threads 处理。
+     */
+    void open(int min_threads, int max_threads);
+
     /**
      * @brief 关闭线程池并等待所有线程结束。
      *
@@ -51,26 +78,36 @@ public:
     /**
      * @brief 提交一个新任务到线程池。
      *
-     * 该方法将一个任务加入到任务队列中。如果队列已满，任务将被拒绝。
+     * 该方法将一个任务加入到任务队列中。如果线程池未打开，或以 BOUNDED 提交且队列
+     * 已满，任务将被拒绝并计入拒绝计数。当排队任务多于空闲线程且未达到线程上限时，
+     * 会扩展一个新线程。
      *
      * @tparam F 任务类型，可以是任何可调用对象（如函数、lambda 表达式等）。
      * @param task 要执行的任务。
+     * @param admission 准入方式，默认受队列上限限制。
      * @return 如果任务成功加入队列返回 true，否则返回 false。
      */
     template<class F>
-    bool enqueue(F&& task)
+    bool enqueue(F&& task, Admission admission = BOUNDED)
     {
         {
             std::lock_guard<std::mutex> lock(queueMutex_);
 
-            // 检查队列长度，超过最大值则拒绝任务并返回 false
-            if (tasks_.size() >= max_queue_size_) {
-                std::cerr << "Task queue is full. Rejecting new task."
-                          << std::endl;
+            // 线程池已关闭或队列已满时拒绝任务，由调用方负责回复客户端
+            if (stop_ || (admission == BOUNDED &&
+                          tasks_.size() >= max_queue_size_)) {
+                ++rejected_tasks_;
                 return false; // 任务被拒绝
             }
 
             tasks_.emplace(std::forward<F>(task)); // 将任务加入队列
+
+            // 按需扩容：排队任务数超过空闲线程数时增加工作线程
+            reap_retired_locked();
+            if (tasks_.size() > idle_threads_ &&
+                workers_.size() < max_threads_) {
+                spawn_worker_locked();
+            }
         }
         condition_.notify_one(); // 通知一个工作线程
         return true;             // 任务已成功加入队列
@@ -83,13 +120,79 @@ public:
      */
     void set_max_queue_size(size_t max_size);
 
+    /**
+     * @brief 设置空闲线程的回收时间。
+     *
+     * 超过 min_threads 的线程空闲达到该时长后退出。
+     *
+     * @param timeout 空闲超时时间。
+     */
+    void set_idle_timeout(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief 设置工作线程绑定的 CPU 列表。
+     *
+     * 新创建的工作线程按轮询方式绑定到列表中的 CPU，需在 `open` 之前调用。
+     * 列表为空表示不绑定。
+     *
+     * @param cpus CPU 编号列表。
+     */
+    void set_cpu_affinity(const std::vector<int>& cpus);
+
+    /**
+     * @brief 检查线程池是否可以接收任务。
+     *
+     * @return 已调用 `open` 且尚未 `close` 时返回 true。
+     */
+    bool is_open() const;
+
+    /**
+     * @brief 获取当前存活的工作线程数量。
+     */
+    size_t thread_count() const;
+
+    /**
+     * @brief 获取当前空闲的工作线程数量。
+     */
+    size_t idle_count() const;
+
+    /**
+     * @brief 获取自启动以来被拒绝的任务总数。
+     */
+    size_t rejected_count() const;
+
 private:
-    std::vector<std::thread> workers_;         ///< 工作线程列表
+    /**
+     * @brief 工作线程主循环。
+     *
+     * 从队列中取出任务执行；空闲超时且线程数多于下限时退出。
+     */
+    void worker_loop();
+
+    /**
+     * @brief 创建一个新的工作线程，调用方需持有 queueMutex_。
+     */
+    void spawn_worker_locked();
+
+    /**
+     * @brief 回收已退出的工作线程，调用方需持有 queueMutex_。
+     */
+    void reap_retired_locked();
+
+    std::unordered_map<std::thread::id, std::thread> workers_; ///< 工作线程表
+    std::vector<std::thread::id> retired_;     ///< 已退出待回收的线程
     std::queue<std::function<void()> > tasks_; ///< 任务队列
-    std::mutex queueMutex_;             ///< 保护任务队列的互斥锁
+    mutable std::mutex queueMutex_;     ///< 保护任务队列的互斥锁
     std::condition_variable condition_; ///< 条件变量，用于通知工作线程
-    bool stop_ = false;           ///< 用于指示线程池是否应停止
+    bool stop_ = true;            ///< 用于指示线程池是否应停止
     size_t max_queue_size_ = 100; ///< 任务队列的最大长度，默认 100
+    size_t min_threads_ = 0;      ///< 常驻线程数量下限
+    size_t max_threads_ = 0;      ///< 线程数量上限
+    size_t idle_threads_ = 0;     ///< 正在等待任务的线程数量
+    std::chrono::milliseconds idle_timeout_{30000}; ///< 空闲线程回收时间
+    std::vector<int> cpus_;       ///< 工作线程绑定的 CPU 列表
+    size_t next_cpu_ = 0;         ///< 下一个新线程使用的 CPU 下标
+    std::atomic<size_t> rejected_tasks_{0};          ///< 被拒绝的任务数
 };
 
 #endif // THREADPOOL_H
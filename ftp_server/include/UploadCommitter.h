@@ -0,0 +1,156 @@
+#ifndef UPLOAD_COMMITTER_H
+#define UPLOAD_COMMITTER_H
+
+#include "PathResolver.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 上传完成时的落盘方式。
+ */
+enum class UploadDurability
+{
+    NONE,      ///< 不主动落盘
+    FDATASYNC, ///< 每个上传各自 fdatasync
+    GROUP      ///< 组提交：短时间内完成的上传合并为一批落盘
+};
+
+/**
+ * @class UploadCommitter
+ * @brief STOR 的提交：可选的原子上传（写临时文件再改名）与落盘。
+ *
+ * - 原子模式下上传写入同一目录中的临时文件 `.<名称>.<随机数>.part`，
+ *   226 之前改名为目标文件，读者不会看到写了一半的文件；传输失败时删除临时文件；
+ * - 落盘时先对文件 fdatasync，再改名，最后 fsync 所在目录，回复 226 时数据与
+ *   目录项均已持久；
+ * - 组提交时第一个到达的上传成为组长，等待一个时间窗口（或上一批仍在落盘时
+ *   等到其结束）收集同时完成的上传，先为整批启动回写，再逐个 fdatasync 并改名，
+ *   每个目录只 fsync 一次。日志型文件系统中同一批的 fdatasync 共享日志提交，
+ *   大量小文件不再各自付出一次完整的落盘延迟。
+ *
+ * `commit()` 会阻塞（组提交时直到整批完成），应在传输线程池中调用。
+ * 配置在启动时设置一次。
+ */
+class UploadCommitter
+{
+public:
+    /**
+     * @brief 提交统计。
+     */
+    struct Stats
+    {
+        uint64_t commits = 0;  ///< 提交的上传数
+        uint64_t syncs = 0;    ///< fdatasync 次数
+        uint64_t batches = 0;  ///< 组提交的批数
+        uint64_t failures = 0; ///< 失败的提交数
+    };
+
+    /**
+     * @brief 获取全局实例。
+     */
+    static UploadCommitter& instance();
+
+    /**
+     * @brief 解析落盘方式（none、fdatasync、group）。
+     */
+    static bool parse_durability(const std::string& name, UploadDurability& durability);
+
+    /**
+     * @brief 设置提交方式。
+     *
+     * @param atomic 是否写临时文件再改名。
+     * @param durability 落盘方式。
+     * @param window 组提交收集一批的时间窗口。
+     * @param maxBatch 一批最多的上传数，达到时不再等待窗口结束。
+     */
+    void configure(
+            bool atomic,
+            UploadDurability durability,
+            std::chrono::microseconds window,
+            size_t maxBatch);
+
+    /**
+     * @brief 是否使用原子上传。
+     */
+    bool atomic() const { return atomic_; }
+
+    /**
+     * @brief 落盘方式。
+     */
+    UploadDurability durability() const { return durability_; }
+
+    /**
+     * @brief 226 之前是否需要提交（原子上传或需要落盘）。
+     */
+    bool enabled() const { return atomic_ || durability_ != UploadDurability::NONE; }
+
+    /**
+     * @brief 目标文件所在目录中的一个新临时文件路径。
+     */
+    static ResolvedPath temporary_path(const ResolvedPath& target);
+
+    /**
+     * @brief 提交一个已写完的上传。
+     *
+     * @param fd 已写完的文件，-1 时按 written 打开（io_uring 的固定文件）。
+     * @param written 写入的文件（原子模式下为临时文件）。
+     * @param target 目标文件，与 written 不同时改名。
+     * @return 成功返回 0，失败返回 -errno。
+     */
+    int commit(int fd, const ResolvedPath& written, const ResolvedPath& target);
+
+    /**
+     * @brief 获取统计数据。
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @brief 等待提交的一个上传。
+     */
+    struct Pending
+    {
+        int fd;
+        ResolvedPath written;
+        ResolvedPath target;
+        int result = 0;
+        bool done = false;
+    };
+
+    UploadCommitter() = default;
+
+    /**
+     * @brief 组提交：加入当前批次，组长收集并执行整批，其他上传等待结果。
+     */
+    int group_commit(Pending& pending);
+
+    /**
+     * @brief 执行一批提交：启动回写、fdatasync、改名、fsync 目录。
+     *
+     * @param sync 是否落盘。
+     */
+    void run_batch(const std::vector<Pending*>& batch, bool sync);
+
+    bool atomic_ = false;                               ///< 是否原子上传
+    UploadDurability durability_ = UploadDurability::NONE; ///< 落盘方式
+    std::chrono::microseconds window_{2000};            ///< 组提交的时间窗口
+    size_t maxBatch_ = 64;                              ///< 一批最多的上传数
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Pending*> batch_; ///< 正在收集的批次
+    bool leading_ = false;        ///< 已有组长在收集
+    bool syncing_ = false;        ///< 有一批正在落盘
+
+    std::atomic<uint64_t> commits_{0};  ///< 提交的上传数
+    std::atomic<uint64_t> syncs_{0};    ///< fdatasync 次数
+    std::atomic<uint64_t> batches_{0};  ///< 组提交的批数
+    std::atomic<uint64_t> failures_{0}; ///< 失败的提交数
+};
+
+#endif // UPLOAD_COMMITTER_H
@@ -3,6 +3,14 @@
 
 #include <ace/Task.h>
 #include <ace/Reactor.h>
+#include <ace/SOCK_Stream.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+class IoUring;
+class ThreadPool;
 
 /**
  * @class WorkerReactorTask
@@ -12,6 +20,10 @@
  * `ACE_Reactor`，从而实现事件驱动的任务处理。 `WorkerReactorTask`
  * 启动一个工作线程并在其中运行 `ACE_Reactor` 的事件循环，直到调用 `stop()`
  * 方法停止事件循环。
+ *
+ * 配置了 CPU 时，Reactor 线程在启动时绑定到该 CPU。新连接通过 `assign()`
+ * 交给 Reactor 线程，由该线程自己创建 ClientHandler，使连接对象及其缓冲区
+ * 分配在 Reactor 所在的 NUMA 节点上。
  */
 class WorkerReactorTask: public ACE_Task_Base
 {
@@ -20,13 +32,16 @@ public:
      * @brief 构造函数，初始化 WorkerReactorTask 对象。
      *
      * 构造函数初始化 `reactor_` 指针为 nullptr，具体的 Reactor 实例将在 `svc()`
-     * 方法中创建。
+     * 方法中创建（在绑定 CPU 之后，位于本地 NUMA 节点）。
      */
     WorkerReactorTask();
 
     /**
      * @brief 启动工作线程并运行 Reactor 的事件循环。
      *
+     * 等待工作线程创建好 Reactor 后才返回，之后的 `assign()` 总能看到
+     * 完整初始化的 Reactor。
+     *
      * @return 如果成功启动线程，返回 0；否则返回 -1。
      */
     int start();
@@ -36,6 +51,49 @@ public:
      */
     void stop();
 
+    /**
+     * @brief 设置 Reactor 线程绑定的 CPU，需在 `start()` 之前调用。
+     *
+     * @param cpu CPU 编号，小于 0 表示不绑定。
+     */
+    void set_cpu(int cpu);
+
+    /**
+     * @brief 为该 Reactor 启用 io_uring 传输，需在 `start()` 之前调用。
+     *
+     * io_uring 在 Reactor 线程中创建，内核不支持时记录日志并回退到线程池路径。
+     *
+     * @param entries 提交队列深度，为 0 表示不启用。
+     * @param buffers 注册缓冲区数量，每个传输占用两个。
+     * @param bufferSize 每个注册缓冲区的大小。
+     * @param fileSlots 固定文件表的槽位数量，每个传输占用一个。
+     */
+    void set_io_uring(
+            unsigned entries,
+            size_t buffers,
+            size_t bufferSize,
+            unsigned fileSlots);
+
+    /**
+     * @brief 将新接受的客户端连接交给该 Reactor 线程处理。
+     *
+     * 连接句柄被放入待处理队列，并通过 `notify()` 唤醒 Reactor 线程，
+     * 由其在 `handle_exception()` 中创建并注册 ClientHandler。
+     *
+     * @param clientStream 已接受的客户端连接。
+     * @param threadPool 传递给 ClientHandler 的线程池。
+     * @return 成功返回 0，失败返回 -1（调用方负责关闭连接）。
+     */
+    int assign(ACE_SOCK_Stream& clientStream, ThreadPool& threadPool);
+
+    /**
+     * @brief 处理 `assign()` 发出的通知，在 Reactor 线程中创建 ClientHandler。
+     *
+     * @param fd 未使用。
+     * @return 总是返回 0。
+     */
+    virtual int handle_exception(ACE_HANDLE fd = ACE_INVALID_HANDLE) override;
+
     /**
      * @brief 获取当前线程中的 `ACE_Reactor` 实例。
      *
@@ -55,7 +113,20 @@ protected:
     virtual int svc() override;
 
 private:
-    ACE_Reactor* reactor_; ///< 指向当前工作线程中 `ACE_Reactor` 实例的指针
+    /// 指向当前工作线程中 `ACE_Reactor` 实例的指针，由工作线程初始化完成后发布
+    std::atomic<ACE_Reactor*> reactor_;
+    int cpu_;              ///< Reactor 线程绑定的 CPU，-1 表示不绑定
+    IoUring* uring_;       ///< 该 Reactor 的 io_uring，未启用时为 nullptr
+    unsigned uringEntries_;   ///< io_uring 提交队列深度，0 表示不启用
+    size_t uringBuffers_;     ///< io_uring 注册缓冲区数量
+    size_t uringBufferSize_;  ///< io_uring 注册缓冲区大小
+    unsigned uringFileSlots_; ///< io_uring 固定文件槽位数量
+    std::mutex pendingMutex_; ///< 保护待处理连接队列
+    std::vector<std::pair<ACE_HANDLE, ThreadPool*> >
+            pending_; ///< 等待 Reactor 线程创建 ClientHandler 的连接
+    std::mutex readyMutex_;              ///< 保护 ready_
+    std::condition_variable readyCv_;    ///< Reactor 就绪的通知
+    bool ready_ = false;                 ///< 工作线程已完成 Reactor 的初始化
 };
 
 #endif // WORKER_REACTOR_TASK_H
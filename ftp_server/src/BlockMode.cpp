@@ -0,0 +1,133 @@
+#include "BlockMode.h"
+#include <algorithm>
+#include <cerrno>
+
+void BlockMode::header(uint8_t descriptor, size_t count, char* out)
+{
+    out[0] = static_cast<char>(descriptor);
+    out[1] = static_cast<char>((count >> 8) & 0xff);
+    out[2] = static_cast<char>(count & 0xff);
+}
+
+void BlockMode::frame(
+        const char* data,
+        size_t size,
+        std::string& headers,
+        std::vector<iovec>& iov)
+{
+    // 先确定头部的存储，iov 中的指针之后不再失效
+    size_t blocks = (size + MAX_BLOCK - 1) / MAX_BLOCK;
+    headers.assign(blocks * HEADER, '\0');
+    for (size_t i = 0; i < blocks; ++i) {
+        size_t offset = i * MAX_BLOCK;
+        size_t count = std::min(MAX_BLOCK, size - offset);
+        char* head = &headers[i * HEADER];
+        header(0, count, head);
+        iov.push_back({head, HEADER});
+        iov.push_back({const_cast<char*>(data + offset), count});
+    }
+}
+
+std::string BlockMode::end()
+{
+    std::string block(HEADER, '\0');
+    header(END_OF_FILE, 0, &block[0]);
+    return block;
+}
+
+std::string BlockMode::marker(off_t offset)
+{
+    std::string text = std::to_string(offset);
+    std::string block(HEADER, '\0');
+    header(RESTART, text.size(), &block[0]);
+    return block + text;
+}
+
+size_t BlockReader::wanted() const
+{
+    switch (state_) {
+    case HEAD:
+        return BlockMode::HEADER - filled_;
+    case DATA:
+    case MARKER:
+        return remaining_;
+    case ENDED:
+        break;
+    }
+    return 0;
+}
+
+int BlockReader::feed(const char* data, size_t size)
+{
+    while (size > 0) {
+        size_t n = std::min(size, wanted());
+        if (n == 0) {
+            break;
+        }
+        if (state_ == HEAD) {
+            std::copy(data, data + n, head_ + filled_);
+            filled_ += n;
+            if (filled_ == BlockMode::HEADER) {
+                filled_ = 0;
+                descriptor_ = static_cast<uint8_t>(head_[0]);
+                remaining_ = static_cast<uint8_t>(head_[1]) << 8 |
+                             static_cast<uint8_t>(head_[2]);
+                // 记录结束与可疑标志对映像类型的文件没有影响，按普通数据接收
+                state_ = descriptor_ & BlockMode::RESTART ? MARKER : DATA;
+                if (remaining_ == 0) {
+                    finish_block();
+                }
+            }
+        } else {
+            if (state_ == DATA) {
+                received_ += n;
+            } else {
+                // 标记会出现在 110 回复中，只接受可打印字符
+                for (size_t i = 0; i < n; ++i) {
+                    if (data[i] <= ' ' || data[i] > '~') {
+                        return -EBADMSG;
+                    }
+                }
+                marker_.append(data, n);
+            }
+            remaining_ -= n;
+            if (remaining_ == 0) {
+                finish_block();
+            }
+        }
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+void BlockReader::finish_block()
+{
+    if (state_ == MARKER && !marker_.empty()) {
+        markers_.emplace_back(std::move(marker_), received_);
+        marker_.clear();
+    }
+    state_ = descriptor_ & BlockMode::END_OF_FILE ? ENDED : HEAD;
+}
+
+bool BlockReader::take_marker(off_t limit, std::string& marker, off_t& position)
+{
+    if (markers_.empty() || markers_.front().second > limit) {
+        return false;
+    }
+    marker = std::move(markers_.front().first);
+    position = markers_.front().second;
+    markers_.pop_front();
+    return true;
+}
+
+void BlockReader::reset()
+{
+    state_ = HEAD;
+    filled_ = 0;
+    descriptor_ = 0;
+    remaining_ = 0;
+    marker_.clear();
+    received_ = 0;
+    markers_.clear();
+}
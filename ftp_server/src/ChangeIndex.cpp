@@ -0,0 +1,635 @@
+#include "ChangeIndex.h"
+#include "DirectoryListing.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <functional>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// 会改变条目变更时间的事件：目录项增删改名、写入、属性变化；根目录自身被删除或改名
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                                   IN_CLOSE_WRITE | IN_DELETE_SELF |
+                                   IN_MOVE_SELF | IN_ONLYDIR;
+
+static const int64_t NANOS = 1000000000LL;
+
+typedef std::function<bool(int dirfd, const std::string& path)> EnterFn;
+typedef std::function<bool(const std::string& path, const struct statx& stx)> VisitFn;
+
+// 目录下子项的路径前缀
+static std::string child_prefix(const std::string& dir)
+{
+    return dir == "/" ? dir : dir + "/";
+}
+
+// 路径是否在目录之下（recursive 为 false 时只算直接子项）
+static bool under(const std::string& path, const std::string& prefix, bool recursive)
+{
+    return path.size() > prefix.size() &&
+           path.compare(0, prefix.size(), prefix) == 0 &&
+           (recursive || path.find('/', prefix.size()) == std::string::npos);
+}
+
+// 相对路径（可含 '/'）的解析结果
+static ResolvedPath descend(const ResolvedPath& base, const std::string& relative)
+{
+    ResolvedPath result = base;
+    size_t pos = 0;
+    while (pos < relative.size()) {
+        size_t end = relative.find('/', pos);
+        if (end == std::string::npos) {
+            end = relative.size();
+        }
+        result = result.child(relative.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return result;
+}
+
+static int64_t precise_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * NANOS + ts.tv_nsec;
+}
+
+// 变更时间：mtime 与 ctime 中较晚者
+static int64_t change_time(const struct statx& stx)
+{
+    int64_t mtime = stx.stx_mtime.tv_sec * NANOS + stx.stx_mtime.tv_nsec;
+    int64_t ctime = stx.stx_ctime.tv_sec * NANOS + stx.stx_ctime.tv_nsec;
+    return std::max(mtime, ctime);
+}
+
+// 获取条目的类型与时间，不跟随符号链接；name 为空时获取 dirfd 自身
+static int stat_change(int dirfd, const char* name, struct statx& stx)
+{
+    unsigned int mask = STATX_TYPE | STATX_MODE | STATX_MTIME | STATX_CTIME;
+    if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_EMPTY_PATH, mask, &stx) == -1) {
+        return -errno;
+    }
+    return 0;
+}
+
+// 深度优先遍历已打开的本地目录，不跟随符号链接，无法读取的子目录跳过。
+// enter 在读取每个目录前调用，visit 对每个条目调用，任一返回 false 时中止
+static bool walk_tree(
+        int dirfd,
+        const std::string& path,
+        bool recursive,
+        const EnterFn& enter,
+        const VisitFn& visit)
+{
+    if (!enter(dirfd, path)) {
+        return false;
+    }
+    int fd = dup(dirfd);
+    DIR* dir = fd == -1 ? nullptr : fdopendir(fd);
+    if (dir == nullptr) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return true;
+    }
+    rewinddir(dir);
+
+    bool ok = true;
+    std::string prefix = child_prefix(path);
+    while (ok) {
+        struct dirent* entry = readdir(dir);
+        if (entry == nullptr) {
+            break;
+        }
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+        struct statx stx;
+        if (stat_change(dirfd, name, stx) != 0) {
+            continue; // 读取期间已被删除
+        }
+        std::string child = prefix + name;
+        ok = visit(child, stx);
+        if (ok && recursive && S_ISDIR(stx.stx_mode)) {
+            int sub = openat(dirfd, name,
+                             O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (sub != -1) {
+                ok = walk_tree(sub, child, recursive, enter, visit);
+                close(sub);
+            }
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+// 遍历非本地文件系统的目录
+static int walk_entries(
+        const ResolvedPath& dir,
+        bool recursive,
+        const VisitFn& visit)
+{
+    std::vector<DirectoryEntry> entries;
+    int rc = dir.read_directory(0, entries);
+    if (rc != 0) {
+        return rc;
+    }
+    for (const DirectoryEntry& entry : entries) {
+        ResolvedPath child = dir.child(entry.name);
+        visit(child.path(), entry.stx);
+        if (recursive && S_ISDIR(entry.stx.stx_mode)) {
+            walk_entries(child, recursive, visit);
+        }
+    }
+    return 0;
+}
+
+ChangeIndex::~ChangeIndex()
+{
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_); // 关闭实例时内核移除全部监视
+    }
+}
+
+ChangeIndex& ChangeIndex::instance()
+{
+    static ChangeIndex index;
+    return index;
+}
+
+bool ChangeIndex::configure(
+        size_t maxRoots,
+        size_t maxWatches,
+        size_t maxEntries,
+        size_t maxDeleted)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    roots_.clear();
+    watches_.clear();
+    entries_ = 0;
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+
+    maxRoots_ = maxRoots;
+    maxWatches_ = maxWatches;
+    maxEntries_ = maxEntries;
+    maxDeleted_ = maxDeleted;
+    if (maxRoots == 0 || maxWatches == 0 || maxEntries == 0) {
+        return true;
+    }
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return inotifyFd_ != -1;
+}
+
+int64_t ChangeIndex::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return ts.tv_sec * NANOS + ts.tv_nsec;
+}
+
+int ChangeIndex::read(ChangeQuery& query, std::string& out, size_t count)
+{
+    std::vector<std::pair<std::string, bool> > batch;
+    bool more = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool first = query.last.empty();
+        if (first) {
+            query.changed = query.since;
+            ++queries_;
+        }
+        RootIt root;
+        int rc = enabled() && query.dir.native() ? find_root(query.dir, root) : 1;
+        if (rc < 0) {
+            return rc;
+        }
+        if (first) {
+            // 索引已建立、事件已处理：此后的修改都有新的时间或墓碑
+            query.now = now();
+        }
+        if (rc > 0) {
+            ++fallbacks_;
+            more = true;
+        } else {
+            // 按变更时间顺序取出目录下的条目，从上一批的最后一项之后继续
+            std::string prefix = child_prefix(query.dir.path());
+            auto it = query.last.empty()
+                              ? root->byTime.lower_bound(std::make_pair(
+                                        query.changed, std::string()))
+                              : root->byTime.upper_bound(std::make_pair(
+                                        query.changed, query.last));
+            for (; it != root->byTime.end(); ++it) {
+                if (!under(it->second, prefix, query.recursive)) {
+                    continue;
+                }
+                if (batch.size() == count) {
+                    more = true;
+                    break;
+                }
+                batch.emplace_back(it->second, root->nodes[it->second].deleted);
+                query.changed = it->first;
+                query.last = it->second;
+            }
+            query.deletions = query.deletions &&
+                              query.since >= root->deletionsFrom;
+        }
+    }
+    if (more && batch.empty()) {
+        return walk(query, out); // 索引不可用，在锁外完整遍历
+    }
+
+    // 在锁外 stat 并格式化，只涉及本批条目
+    for (const auto& entry : batch) {
+        append_change(query, entry.first, entry.second, out);
+    }
+    return more ? 1 : 0;
+}
+
+int ChangeIndex::find_root(const ResolvedPath& dir, RootIt& root)
+{
+    drain();
+    const std::string& path = dir.path();
+    for (root = roots_.begin(); root != roots_.end(); ++root) {
+        const std::string& top = root->base.path();
+        if (path != top && !under(path, child_prefix(top), true)) {
+            continue;
+        }
+        roots_.splice(roots_.begin(), roots_, root);
+        if (path == top) {
+            return 0;
+        }
+        // 索引中的子目录；符号链接或文件交给完整遍历处理
+        auto node = root->nodes.find(path);
+        bool directory = node != root->nodes.end() && !node->second.deleted &&
+                         node->second.directory;
+        return directory ? 0 : 1;
+    }
+
+    int fd = dir.open(O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return fd;
+    }
+    // 新索引覆盖的已有索引与其共享监视描述符，先丢弃
+    std::string prefix = child_prefix(path);
+    for (root = roots_.begin(); root != roots_.end();) {
+        RootIt next = std::next(root);
+        if (under(root->base.path(), prefix, true)) {
+            erase_root(root);
+        }
+        root = next;
+    }
+    while (roots_.size() >= maxRoots_) {
+        erase_root(std::prev(roots_.end()));
+    }
+
+    roots_.emplace_front();
+    root = roots_.begin();
+    root->base = dir;
+    root->deletionsFrom = now();
+    ++builds_;
+    bool indexed = index_tree(root, fd, path, 0);
+    close(fd);
+    if (!indexed) {
+        erase_root(root);
+        return 1;
+    }
+    return 0;
+}
+
+bool ChangeIndex::index_tree(
+        RootIt root,
+        int dirfd,
+        const std::string& path,
+        int64_t floor)
+{
+    // 超出上限时先淘汰最久未查询的其他索引
+    auto make_room = [this, root] {
+        if (roots_.size() < 2 || std::prev(roots_.end()) == root) {
+            return false;
+        }
+        erase_root(std::prev(roots_.end()));
+        return true;
+    };
+
+    // 先建立监视再读取目录，读取期间的变化都会产生事件
+    EnterFn enter = [this, root, &make_room](int fd, const std::string& dir) {
+        while (watches_.size() >= maxWatches_) {
+            if (!make_room()) {
+                return false;
+            }
+        }
+        char procPath[64];
+        snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", fd);
+        int wd = inotify_add_watch(inotifyFd_, procPath, WATCH_MASK);
+        while (wd == -1 && errno == ENOSPC && make_room()) {
+            wd = inotify_add_watch(inotifyFd_, procPath, WATCH_MASK);
+        }
+        if (wd == -1) {
+            return false; // 超出 fs.inotify.max_user_watches
+        }
+        auto found = watches_.find(wd);
+        if (found != watches_.end() &&
+            (found->second.root != root || found->second.path != dir)) {
+            // 绑定挂载或另一索引中的同一目录，事件无法对应到唯一的路径
+            return false;
+        }
+        watches_[wd] = Watch{root, dir};
+        if (dir == root->base.path()) {
+            root->wd = wd;
+        } else {
+            root->nodes[dir].wd = wd;
+        }
+        return true;
+    };
+    VisitFn visit = [this, root, floor, &make_room](
+                            const std::string& child, const struct statx& stx) {
+        while (entries_ >= maxEntries_) {
+            if (!make_room()) {
+                return false;
+            }
+        }
+        Node node;
+        node.changed = std::max(change_time(stx), floor);
+        node.directory = S_ISDIR(stx.stx_mode);
+        set_node(*root, child, node);
+        return true;
+    };
+    return walk_tree(dirfd, path, true, enter, visit);
+}
+
+void ChangeIndex::drain()
+{
+    alignas(struct inotify_event) char buf[8192];
+    for (;;) {
+        ssize_t n = ::read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0) {
+            return; // EAGAIN：队列已空
+        }
+        for (ssize_t pos = 0; pos < n;) {
+            const struct inotify_event* event =
+                    reinterpret_cast<const struct inotify_event*>(buf + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 事件丢失，索引不再可信，下次查询时重建
+                ++overflows_;
+                while (!roots_.empty()) {
+                    erase_root(roots_.begin());
+                }
+                continue;
+            }
+            auto found = watches_.find(event->wd);
+            if (found == watches_.end()) {
+                continue; // 已移除目录的迟到事件
+            }
+            ++events_;
+            RootIt root = found->second.root;
+            std::string dir = found->second.path;
+            bool top = dir == root->base.path();
+            if (event->mask & IN_IGNORED) {
+                // 子目录被删除时其条目由父目录的事件处理，这里只移除监视
+                watches_.erase(found);
+                auto node = root->nodes.find(dir);
+                if (top) {
+                    erase_root(root);
+                } else if (node != root->nodes.end() &&
+                           node->second.wd == event->wd) {
+                    node->second.wd = -1;
+                }
+                continue;
+            }
+            if (event->len == 0 || event->name[0] == '\0') {
+                // 根目录被删除、改名或所在文件系统被卸载后路径不再有效
+                if ((top && (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))) ||
+                    (event->mask & IN_UNMOUNT)) {
+                    erase_root(root);
+                }
+                continue;
+            }
+            std::string child = child_prefix(dir) + event->name;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                remove(root, child);
+            } else {
+                update(root, child, event->mask & (IN_CREATE | IN_MOVED_TO));
+            }
+        }
+    }
+}
+
+void ChangeIndex::update(RootIt root, const std::string& path, bool created)
+{
+    std::string relative = path.substr(child_prefix(root->base.path()).size());
+    int fd = descend(root->base, relative).open(O_PATH | O_NOFOLLOW);
+    if (fd < 0) {
+        if (fd == -ENOENT) {
+            remove(root, path); // 已被删除，删除事件随后到达
+        }
+        return;
+    }
+    struct statx stx;
+    if (stat_change(fd, "", stx) != 0) {
+        close(fd);
+        return;
+    }
+
+    Node node;
+    node.changed = change_time(stx);
+    node.directory = S_ISDIR(stx.stx_mode);
+    auto existing = root->nodes.find(path);
+    bool known = existing != root->nodes.end() && !existing->second.deleted &&
+                 existing->second.directory;
+    if (known && (created || !node.directory)) {
+        erase_subtree(*root, path); // 目录被替换，原有内容已不在此路径
+        known = false;
+    }
+    set_node(*root, path, node);
+    if (!node.directory || known) {
+        close(fd);
+        return;
+    }
+
+    // 新建或移入的目录：监视并索引其内容，条目按当前时间记录
+    int dirfd = openat(fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    close(fd);
+    if (dirfd == -1) {
+        return;
+    }
+    bool indexed = index_tree(root, dirfd, path, precise_now());
+    close(dirfd);
+    if (!indexed) {
+        erase_root(root); // 超出上限，索引不再完整
+    }
+}
+
+void ChangeIndex::remove(RootIt root, const std::string& path)
+{
+    auto found = root->nodes.find(path);
+    if (found == root->nodes.end() || found->second.deleted) {
+        return;
+    }
+    erase_subtree(*root, path);
+
+    Node tombstone;
+    tombstone.changed = precise_now();
+    tombstone.deleted = true;
+    set_node(*root, path, tombstone);
+    root->tombstones.emplace_back(tombstone.changed, path);
+    while (root->tombstones.size() > maxDeleted_) {
+        // 丢弃最早的墓碑；此后早于它的起始时间无法保证删除完整
+        std::pair<int64_t, std::string> oldest = root->tombstones.front();
+        root->tombstones.pop_front();
+        root->deletionsFrom = std::max(root->deletionsFrom, oldest.first + 1);
+        auto node = root->nodes.find(oldest.second);
+        if (node != root->nodes.end() && node->second.deleted &&
+            node->second.changed == oldest.first) {
+            root->byTime.erase(oldest);
+            root->nodes.erase(node);
+            --entries_;
+        }
+    }
+}
+
+void ChangeIndex::erase_subtree(Root& root, const std::string& path)
+{
+    auto own = root.nodes.find(path);
+    if (own != root.nodes.end() && own->second.wd != -1) {
+        drop_watch(own->second.wd);
+        own->second.wd = -1;
+    }
+    std::string prefix = child_prefix(path);
+    auto it = root.nodes.lower_bound(prefix);
+    while (it != root.nodes.end() &&
+           it->first.compare(0, prefix.size(), prefix) == 0) {
+        if (it->second.wd != -1) {
+            drop_watch(it->second.wd);
+        }
+        root.byTime.erase(std::make_pair(it->second.changed, it->first));
+        it = root.nodes.erase(it);
+        --entries_;
+    }
+}
+
+void ChangeIndex::set_node(Root& root, const std::string& path, const Node& node)
+{
+    auto it = root.nodes.find(path);
+    if (it == root.nodes.end()) {
+        it = root.nodes.emplace(path, node).first;
+        ++entries_;
+    } else {
+        root.byTime.erase(std::make_pair(it->second.changed, path));
+        int wd = it->second.wd;
+        it->second = node;
+        if (node.directory) {
+            it->second.wd = wd; // 目录属性变化，保留监视
+        }
+    }
+    root.byTime.emplace(node.changed, path);
+}
+
+void ChangeIndex::drop_watch(int wd)
+{
+    inotify_rm_watch(inotifyFd_, wd);
+    watches_.erase(wd);
+}
+
+void ChangeIndex::erase_root(RootIt root)
+{
+    for (const auto& node : root->nodes) {
+        if (node.second.wd != -1) {
+            drop_watch(node.second.wd);
+        }
+    }
+    if (root->wd != -1) {
+        drop_watch(root->wd);
+    }
+    entries_ -= root->nodes.size();
+    roots_.erase(root);
+}
+
+int ChangeIndex::walk(ChangeQuery& query, std::string& out)
+{
+    typedef std::pair<int64_t, std::string> Change;
+    std::vector<Change> changes;
+    VisitFn visit = [&query, &changes](
+                            const std::string& path, const struct statx& stx) {
+        int64_t changed = change_time(stx);
+        if (changed >= query.since) {
+            changes.emplace_back(changed, path);
+        }
+        return true;
+    };
+
+    if (query.dir.native()) {
+        int fd = query.dir.open(O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            return fd;
+        }
+        EnterFn enter = [](int, const std::string&) { return true; };
+        walk_tree(fd, query.dir.path(), query.recursive, enter, visit);
+        close(fd);
+    } else {
+        int rc = walk_entries(query.dir, query.recursive, visit);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    // 与索引相同的顺序；索引在分批读取中途失效时跳过已输出的部分
+    std::sort(changes.begin(), changes.end());
+    Change last(query.changed, query.last);
+    for (const Change& change : changes) {
+        if (!query.last.empty() && !(last < change)) {
+            continue;
+        }
+        append_change(query, change.second, false, out);
+    }
+    query.deletions = false;
+    return 0;
+}
+
+void ChangeIndex::append_change(
+        const ChangeQuery& query,
+        const std::string& path,
+        bool deleted,
+        std::string& out)
+{
+    std::string name = path.substr(child_prefix(query.dir.path()).size());
+    if (deleted) {
+        out += "type=deleted; ";
+    } else {
+        // 与 MLSD 相同，符号链接显示其目标；悬空的链接显示链接本身
+        ResolvedPath target = descend(query.dir, name);
+        struct statx stx;
+        if (target.stat(stx) != 0 && target.stat(stx, false) != 0) {
+            return; // 已被删除
+        }
+        out += format_facts(stx);
+    }
+    out += name;
+    out += "\r\n";
+}
+
+ChangeIndex::Stats ChangeIndex::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.queries = queries_;
+    stats.builds = builds_;
+    stats.fallbacks = fallbacks_;
+    stats.events = events_;
+    stats.overflows = overflows_;
+    stats.roots = roots_.size();
+    stats.watches = watches_.size();
+    stats.entries = entries_;
+    return stats;
+}
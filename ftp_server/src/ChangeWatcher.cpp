@@ -0,0 +1,538 @@
+#include "ChangeWatcher.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 目录项增删改名、写入、属性变化；订阅的目录自身被删除或改名
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                                   IN_CLOSE_WRITE | IN_DELETE_SELF |
+                                   IN_MOVE_SELF | IN_ONLYDIR;
+
+// 客户端长时间不读取时，一个会话最多积压的通知字节数
+static const size_t MAX_SINK_BYTES = 1024 * 1024;
+
+// 目录下子项的路径前缀
+static std::string child_prefix(const std::string& dir)
+{
+    return dir == "/" ? dir : dir + "/";
+}
+
+// 路径是否在目录之下（recursive 为 false 时只算直接子项）
+static bool under(const std::string& path, const std::string& prefix, bool recursive)
+{
+    return path.size() > prefix.size() &&
+           path.compare(0, prefix.size(), prefix) == 0 &&
+           (recursive || path.find('/', prefix.size()) == std::string::npos);
+}
+
+// 相对路径（可含 '/'）的解析结果
+static ResolvedPath descend(const ResolvedPath& base, const std::string& relative)
+{
+    ResolvedPath result = base;
+    size_t pos = 0;
+    while (pos < relative.size()) {
+        size_t end = relative.find('/', pos);
+        if (end == std::string::npos) {
+            end = relative.size();
+        }
+        result = result.child(relative.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return result;
+}
+
+static std::string overflow_notice(const std::string& path)
+{
+    return "211 Changes under " + path +
+           " overflowed; resynchronize with SITE CHANGES.\r\n";
+}
+
+WatchSink::WatchSink(ACE_Reactor* reactor, ACE_SOCK_Stream& stream, std::string path)
+    : reactor_(reactor), stream_(&stream), path_(std::move(path))
+{
+}
+
+void WatchSink::post(const std::string& block)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (overflowed_) {
+        return;
+    }
+    if (pending_.size() + block.size() > MAX_SINK_BYTES) {
+        pending_ = overflow_notice(path_);
+        overflowed_ = true;
+    } else {
+        pending_ += block;
+    }
+    if (notified_) {
+        return;
+    }
+    notified_ = true;
+    self_ = shared_from_this();
+    lock.unlock();
+    if (reactor_->notify(this, ACE_Event_Handler::EXCEPT_MASK) == -1) {
+        lock.lock();
+        notified_ = false;
+        self_.reset(); // 监视器仍持有订阅，此处不会释放自身
+    }
+}
+
+int WatchSink::handle_exception(ACE_HANDLE /*fd*/)
+{
+    std::shared_ptr<WatchSink> keep;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        keep = std::move(self_);
+        notified_ = false;
+    }
+    // 暂缓期间通知留在缓冲中，由 hold(false) 发送
+    if (!held_) {
+        deliver();
+    }
+    return 0; // keep 析构后可能释放自身，此后不得访问成员
+}
+
+void WatchSink::hold(bool held)
+{
+    held_ = held;
+    if (!held_) {
+        deliver();
+    }
+}
+
+void WatchSink::deliver()
+{
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        text.swap(pending_);
+        overflowed_ = false;
+    }
+    if (stream_ != nullptr && !text.empty()) {
+        stream_->send(text.c_str(), text.size());
+    }
+}
+
+ChangeWatcher::~ChangeWatcher()
+{
+    close();
+}
+
+ChangeWatcher& ChangeWatcher::instance()
+{
+    static ChangeWatcher watcher;
+    return watcher;
+}
+
+bool ChangeWatcher::configure(size_t maxWatches, int batchMillis, size_t maxPending)
+{
+    close();
+    maxWatches_ = maxWatches;
+    batch_ = std::chrono::milliseconds(batchMillis > 0 ? batchMillis : 0);
+    maxPending_ = maxPending > 0 ? maxPending : 1;
+    if (maxWatches == 0) {
+        return true;
+    }
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ == -1) {
+        return false;
+    }
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ == -1) {
+        ::close(inotifyFd_);
+        inotifyFd_ = -1;
+        return false;
+    }
+    stopping_ = false;
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+void ChangeWatcher::close()
+{
+    if (thread_.joinable()) {
+        stopping_ = true;
+        uint64_t one = 1;
+        if (write(wakeFd_, &one, sizeof(one)) != sizeof(one)) {
+            // eventfd 计数已满时线程已被唤醒
+        }
+        thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Subscription& subscription : subscriptions_) {
+        subscription.sink->active_ = false;
+    }
+    subscriptions_.clear();
+    byPath_.clear();
+    byWd_.clear();
+    due_ = false;
+    if (inotifyFd_ != -1) {
+        ::close(inotifyFd_); // 关闭实例时内核移除全部监视
+        inotifyFd_ = -1;
+    }
+    if (wakeFd_ != -1) {
+        ::close(wakeFd_);
+        wakeFd_ = -1;
+    }
+}
+
+int ChangeWatcher::subscribe(
+        const ResolvedPath& dir,
+        bool recursive,
+        const std::shared_ptr<WatchSink>& sink)
+{
+    int fd = dir.open(O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return fd;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (inotifyFd_ == -1) {
+        ::close(fd);
+        return -ENOTSUP;
+    }
+    Subscription subscription;
+    subscription.dir = dir;
+    subscription.recursive = recursive;
+    subscription.sink = sink;
+    subscriptions_.push_back(std::move(subscription));
+    int rc = watch_tree(fd, dir.path(), recursive, false);
+    ::close(fd);
+    if (rc != 0) {
+        subscriptions_.pop_back();
+        prune();
+        return rc;
+    }
+    ++subscribed_;
+    sink->active_ = true;
+    return 0;
+}
+
+void ChangeWatcher::unsubscribe(const std::shared_ptr<WatchSink>& sink)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = subscriptions_.begin(); it != subscriptions_.end(); ++it) {
+        if (it->sink == sink) {
+            sink->active_ = false;
+            subscriptions_.erase(it);
+            prune();
+            return;
+        }
+    }
+}
+
+void ChangeWatcher::run()
+{
+    struct pollfd fds[2];
+    fds[0].fd = inotifyFd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeFd_;
+    fds[1].events = POLLIN;
+    while (!stopping_) {
+        int timeout = -1;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (due_) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline_ - std::chrono::steady_clock::now());
+                timeout = left.count() > 0 ? static_cast<int>(left.count()) : 0;
+            }
+        }
+        if (poll(fds, 2, timeout) == -1 && errno != EINTR) {
+            break;
+        }
+        if (stopping_) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        drain();
+        if (due_ && std::chrono::steady_clock::now() >= deadline_) {
+            flush();
+        }
+    }
+}
+
+void ChangeWatcher::drain()
+{
+    alignas(struct inotify_event) char buf[8192];
+    for (;;) {
+        ssize_t n = read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0) {
+            return; // EAGAIN：队列已空
+        }
+        for (ssize_t pos = 0; pos < n;) {
+            const struct inotify_event* event =
+                    reinterpret_cast<const struct inotify_event*>(buf + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 事件丢失，全部订阅都无法给出准确的变更
+                for (Subscription& subscription : subscriptions_) {
+                    subscription.pending.clear();
+                    subscription.overflowed = true;
+                }
+                if (!due_) {
+                    due_ = true;
+                    deadline_ = std::chrono::steady_clock::now() + batch_;
+                }
+                continue;
+            }
+            auto found = byWd_.find(event->wd);
+            if (found == byWd_.end()) {
+                continue; // 已移除目录的迟到事件
+            }
+            ++events_;
+            std::string dir = found->second;
+            if (event->mask & IN_IGNORED) {
+                byWd_.erase(found);
+                auto watched = byPath_.find(dir);
+                if (watched != byPath_.end() && watched->second == event->wd) {
+                    byPath_.erase(watched);
+                }
+                continue;
+            }
+            if (event->len == 0 || event->name[0] == '\0') {
+                // 目录自身被删除或改名（订阅的目录报告为 "."）
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                    record(dir, Change::DELETED);
+                }
+                continue;
+            }
+
+            std::string child = child_prefix(dir) + event->name;
+            bool directory = event->mask & IN_ISDIR;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                record(child, Change::DELETED);
+                if (directory) {
+                    drop_subtree(child); // 移出的目录不再位于原路径
+                }
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                record(child, Change::CREATED);
+                SubscriptionIt owner = covering(child, true);
+                if (directory && owner != subscriptions_.end()) {
+                    // 新目录中的条目可能在建立监视前就已存在
+                    std::string relative =
+                            child.substr(child_prefix(owner->dir.path()).size());
+                    int fd = descend(owner->dir, relative)
+                                     .open(O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                    if (fd >= 0) {
+                        watch_tree(fd, child, true, true);
+                        ::close(fd);
+                    }
+                }
+            } else {
+                record(child, Change::MODIFIED);
+            }
+        }
+    }
+}
+
+void ChangeWatcher::record(const std::string& path, Change change)
+{
+    for (Subscription& subscription : subscriptions_) {
+        const std::string& base = subscription.dir.path();
+        if (subscription.overflowed ||
+            (path != base &&
+             !under(path, child_prefix(base), subscription.recursive))) {
+            continue;
+        }
+        auto found = subscription.pending.find(path);
+        if (found == subscription.pending.end()) {
+            if (subscription.pending.size() >= maxPending_) {
+                subscription.pending.clear();
+                subscription.overflowed = true;
+            } else {
+                subscription.pending.emplace(path, change);
+            }
+        } else if (found->second == Change::CREATED) {
+            // 新建后修改仍为新建，新建后删除对客户端不可见
+            if (change == Change::DELETED) {
+                subscription.pending.erase(found);
+            }
+        } else if (found->second == Change::DELETED) {
+            // 删除后重建视为修改
+            if (change != Change::DELETED) {
+                found->second = Change::MODIFIED;
+            }
+        } else {
+            found->second = change == Change::DELETED ? Change::DELETED
+                                                      : Change::MODIFIED;
+        }
+        if (!due_) {
+            due_ = true;
+            deadline_ = std::chrono::steady_clock::now() + batch_;
+        }
+    }
+}
+
+void ChangeWatcher::flush()
+{
+    static const char* const NAMES[] = {"created", "modified", "deleted"};
+    due_ = false;
+    for (Subscription& subscription : subscriptions_) {
+        const std::string& base = subscription.dir.path();
+        if (subscription.overflowed) {
+            subscription.overflowed = false;
+            ++overflows_;
+            subscription.sink->post(overflow_notice(base));
+            continue;
+        }
+        if (subscription.pending.empty()) {
+            continue;
+        }
+        size_t skip = child_prefix(base).size();
+        std::string block = "211-Changes under " + base + ":\r\n";
+        for (const auto& entry : subscription.pending) {
+            block += ' ';
+            block += NAMES[static_cast<int>(entry.second)];
+            block += ' ';
+            block += entry.first == base ? std::string(".") : entry.first.substr(skip);
+            block += "\r\n";
+        }
+        block += "211 End\r\n";
+        subscription.pending.clear();
+        ++batches_;
+        subscription.sink->post(block);
+    }
+}
+
+int ChangeWatcher::watch_tree(
+        int dirfd,
+        const std::string& path,
+        bool recursive,
+        bool report)
+{
+    // 先建立监视再读取目录，读取期间的变化都会产生事件
+    if (byPath_.find(path) == byPath_.end()) {
+        if (byPath_.size() >= maxWatches_) {
+            return -ENOSPC;
+        }
+        char procPath[64];
+        snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", dirfd);
+        int wd = inotify_add_watch(inotifyFd_, procPath, WATCH_MASK);
+        if (wd == -1) {
+            return -errno; // 超出 fs.inotify.max_user_watches 时为 -ENOSPC
+        }
+        auto found = byWd_.find(wd);
+        if (found != byWd_.end() && found->second != path) {
+            // 绑定挂载或符号链接，事件无法对应到唯一的路径
+            return -EEXIST;
+        }
+        byWd_[wd] = path;
+        byPath_[path] = wd;
+    }
+    if (!recursive && !report) {
+        return 0;
+    }
+
+    int fd = dup(dirfd);
+    DIR* dir = fd == -1 ? nullptr : fdopendir(fd);
+    if (dir == nullptr) {
+        if (fd != -1) {
+            ::close(fd);
+        }
+        return 0;
+    }
+    rewinddir(dir);
+
+    int rc = 0;
+    std::string prefix = child_prefix(path);
+    while (rc == 0) {
+        struct dirent* entry = readdir(dir);
+        if (entry == nullptr) {
+            break;
+        }
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+        std::string child = prefix + name;
+        if (report) {
+            record(child, Change::CREATED);
+        }
+        bool directory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            directory = fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+                        S_ISDIR(st.st_mode);
+        }
+        if (recursive && directory) {
+            int sub = openat(dirfd, name,
+                             O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (sub != -1) {
+                rc = watch_tree(sub, child, recursive, report);
+                ::close(sub);
+            }
+        }
+    }
+    closedir(dir);
+    return rc;
+}
+
+ChangeWatcher::SubscriptionIt ChangeWatcher::covering(
+        const std::string& dir,
+        bool recursiveOnly)
+{
+    for (auto it = subscriptions_.begin(); it != subscriptions_.end(); ++it) {
+        const std::string& base = it->dir.path();
+        if ((!recursiveOnly && dir == base) ||
+            (it->recursive && under(dir, child_prefix(base), true))) {
+            return it;
+        }
+    }
+    return subscriptions_.end();
+}
+
+void ChangeWatcher::drop_subtree(const std::string& dir)
+{
+    auto drop = [this](std::map<std::string, int>::iterator it) {
+        inotify_rm_watch(inotifyFd_, it->second);
+        byWd_.erase(it->second);
+        return byPath_.erase(it);
+    };
+    auto self = byPath_.find(dir);
+    if (self != byPath_.end()) {
+        drop(self);
+    }
+    std::string prefix = child_prefix(dir);
+    for (auto it = byPath_.lower_bound(prefix);
+         it != byPath_.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+        it = drop(it);
+    }
+}
+
+void ChangeWatcher::prune()
+{
+    for (auto it = byPath_.begin(); it != byPath_.end();) {
+        if (covering(it->first, false) != subscriptions_.end()) {
+            ++it;
+            continue;
+        }
+        inotify_rm_watch(inotifyFd_, it->second);
+        byWd_.erase(it->second);
+        it = byPath_.erase(it);
+    }
+}
+
+ChangeWatcher::Stats ChangeWatcher::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.subscriptions = subscribed_;
+    stats.events = events_;
+    stats.batches = batches_;
+    stats.overflows = overflows_;
+    stats.active = subscriptions_.size();
+    stats.watches = byPath_.size();
+    return stats;
+}
@@ -11,22 +11,34 @@
 #include "PwdCommand.h"
 #include "FileCommand.h"
 #include "CwdCommand.h"
+#include "FeatCommand.h"
+#include "HashCommand.h"
 
 ClientHandler::ClientHandler(
         ACE_SOCK_Stream& clientStream,
         ACE_Reactor* reactor,
-        ThreadPool& threadPool)
+        ThreadPool& threadPool,
+        IoUring* uring)
     : clientStream_(clientStream),
       threadPool_(threadPool),
       session_(clientStream),
       is_closed_(false)
 {
     this->reactor(reactor);
+    session_.set_reactor(reactor);
+    session_.set_io_uring(uring);
+    session_.set_handler(this);
     commands_["USER"] = std::unique_ptr<UserCommand>(new UserCommand());
     commands_["PASS"] = std::unique_ptr<PassCommand>(new PassCommand());
     commands_["SYST"] = std::unique_ptr<SystCommand>(new SystCommand());
     commands_["PWD"] = std::unique_ptr<PwdCommand>(new PwdCommand());
     commands_["CWD"] = std::unique_ptr<CwdCommand>(new CwdCommand());
+    commands_["FEAT"] = std::unique_ptr<FeatCommand>(new FeatCommand());
+    commands_["HASH"] = std::unique_ptr<HashCommand>(new HashCommand());
+    commands_["XCRC"] = std::unique_ptr<HashCommand>(new HashCommand());
+    commands_["XMD5"] = std::unique_ptr<HashCommand>(new HashCommand());
+    commands_["XSHA256"] = std::unique_ptr<HashCommand>(new HashCommand());
+    commands_["OPTS"] = std::unique_ptr<HashCommand>(new HashCommand());
     // filecommand_ = *(new FileCommand());
 }
 
@@ -97,12 +109,14 @@ int ClientHandler::handle_close(
                 this, ACE_Event_Handler::ALL_EVENTS_MASK |
                               ACE_Event_Handler::DONT_CALL);
     }
-    // 使用 ACE_Reactor::notify() 延迟释放资源，调用 handle_exception()
-    ACE_Reactor::instance()->notify(this, ACE_Event_Handler::EXCEPT_MASK);
+    // 使用所属 Reactor 的 notify() 延迟释放资源，调用 handle_exception()。
+    // 必须在本会话的 Reactor 线程中删除，挂起的传输协程才能安全地随之销毁
+    this->reactor()->notify(this, ACE_Event_Handler::EXCEPT_MASK);
     // ACE_DEBUG(
     //         (LM_DEBUG,
     //          ACE_TEXT("(%P|%t) Safely deleting the client handler.\n")));
     clientStream_.close();
+    return 0;
 }
 int ClientHandler::handle_exception(ACE_HANDLE /*fd*/)
 {
@@ -126,7 +140,9 @@ void ClientHandler::handle_command(
     }
     else if (name == "STOR" || name == "RETR" || name == "PASV" || name == "TYPE" ||
         name == "LIST" || name == "MKD" || name == "RMD" || name == "DELE" ||
-        name == "SIZE" || name == "EPSV") {
+        name == "SIZE" || name == "EPSV" || name == "MLSD" || name == "MLST" ||
+        name == "SITE" || name == "MDTM" || name == "RNFR" ||
+        name == "RNTO" || name == "MODE" || name == "REST") {
         filecommand_.execute(
                 session_, name, params, clientStream_, threadPool_);
     }
@@ -0,0 +1,157 @@
+#include "CpuAffinity.h"
+#include <sstream>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+std::vector<int> CpuAffinity::parse_cpu_list(const std::string& spec)
+{
+    std::vector<int> cpus;
+    std::istringstream iss(spec);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        try {
+            size_t dash = item.find('-');
+            if (dash == std::string::npos) {
+                cpus.push_back(std::stoi(item));
+            } else {
+                int first = std::stoi(item.substr(0, dash));
+                int last = std::stoi(item.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+        } catch (const std::exception&) {
+            // 忽略无法解析的条目
+        }
+    }
+    return cpus;
+}
+
+bool CpuAffinity::pin_current_thread(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+int CpuAffinity::numa_node_of_cpu(int cpu)
+{
+    // /sys/devices/system/cpu/cpuN/ 下存在名为 nodeM 的链接
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return -1;
+    }
+    int node = -1;
+    while (struct dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "node", 4) == 0 &&
+            entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+int CpuAffinity::current_numa_node()
+{
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == -1) {
+        return -1;
+    }
+    return static_cast<int>(node);
+}
+
+void* CpuAffinity::alloc_local(size_t size)
+{
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    int node = current_numa_node();
+    if (node >= 0 && node < static_cast<int>(sizeof(unsigned long) * 8)) {
+        unsigned long mask = 1UL << node;
+        // mbind 失败（如单节点机器或内核不支持）时依赖首次写入策略
+        syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, &mask,
+                sizeof(mask) * 8, 0);
+    }
+
+    // 由当前线程首次写入，确保物理页在本地节点上分配
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void CpuAffinity::free_local(void* ptr, size_t size)
+{
+    if (ptr != nullptr) {
+        munmap(ptr, size);
+    }
+}
+
+LocalBufferPool::LocalBufferPool(size_t bufferSize): bufferSize_(bufferSize)
+{
+}
+
+LocalBufferPool::~LocalBufferPool()
+{
+    for (char* buffer : free_) {
+        CpuAffinity::free_local(buffer, bufferSize_);
+    }
+}
+
+std::shared_ptr<LocalBufferPool> LocalBufferPool::current(size_t bufferSize)
+{
+    // 线程退出时只释放这一份引用，仍在使用的传输状态持有空闲表
+    static thread_local std::shared_ptr<LocalBufferPool> pool;
+    if (!pool) {
+        pool = std::make_shared<LocalBufferPool>(bufferSize);
+    }
+    return pool;
+}
+
+char* LocalBufferPool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            char* buffer = free_.back();
+            free_.pop_back();
+            return buffer;
+        }
+    }
+    return static_cast<char*>(CpuAffinity::alloc_local(bufferSize_));
+}
+
+void LocalBufferPool::release(char* buffer)
+{
+    if (buffer == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < MAX_FREE) {
+            free_.push_back(buffer);
+            return;
+        }
+    }
+    CpuAffinity::free_local(buffer, bufferSize_);
+}
+
+size_t LocalBufferPool::free_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_.size();
+}
@@ -0,0 +1,400 @@
+#include "DedupStore.h"
+#include "FileHash.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+// 清单标记：值为清单文本的长度
+static const char* MANIFEST_XATTR = "user.ftp_server.manifest";
+// 清单首行的标识
+static const char* MANIFEST_MAGIC = "FTPDEDUP";
+// 清单文本的长度上限（约一千万个分块）
+const size_t MANIFEST_MAX = 1024 * 1024 * 1024;
+// 还原为普通文件时的缓冲大小
+const size_t MATERIALIZE_BUFFER = 1024 * 1024;
+
+// 分块在存储目录中的相对路径
+static std::string chunk_path(const std::string& digest)
+{
+    return digest.substr(0, 2) + "/" + digest.substr(2);
+}
+
+// 写完整个缓冲区，失败时 errno 有效
+static bool write_fully(int fd, const char* data, size_t size, off_t offset)
+{
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            errno = n < 0 ? errno : EIO;
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+DedupStore::~DedupStore()
+{
+    if (dirfd_ != -1) {
+        close(dirfd_);
+    }
+}
+
+DedupStore& DedupStore::instance()
+{
+    static DedupStore store;
+    return store;
+}
+
+int DedupStore::configure(
+        const std::string& directory,
+        size_t minChunk,
+        size_t avgChunk,
+        size_t maxChunk)
+{
+    if (dirfd_ != -1) {
+        close(dirfd_);
+        dirfd_ = -1;
+    }
+    if (directory.empty()) {
+        return 0;
+    }
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        return -errno;
+    }
+    int fd = ::open(directory.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    chunker_ = FastCdc(minChunk, avgChunk, maxChunk);
+    dirfd_ = fd;
+    return 0;
+}
+
+int DedupStore::put(
+        const std::string& digest,
+        const char* data,
+        size_t size,
+        bool sync,
+        bool& created)
+{
+    created = false;
+    std::string path = chunk_path(digest);
+    struct stat st;
+    if (fstatat(dirfd_, path.c_str(), &st, 0) == 0 &&
+            static_cast<size_t>(st.st_size) == size) {
+        chunksShared_.fetch_add(1, std::memory_order_relaxed);
+        bytesShared_.fetch_add(size, std::memory_order_relaxed);
+        return 0;
+    }
+
+    std::string prefix = digest.substr(0, 2);
+    if (mkdirat(dirfd_, prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+        return -errno;
+    }
+    // 先写临时文件再改名，并发保存同一分块或中途失败都不会留下不完整的分块
+    thread_local std::mt19937_64 random(std::random_device{}());
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx.tmp",
+             static_cast<unsigned long long>(random()));
+    std::string temporary = path + suffix;
+    int fd = openat(dirfd_, temporary.c_str(),
+                    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+    if (fd < 0) {
+        return -errno;
+    }
+    int rc = 0;
+    if (!write_fully(fd, data, size, 0) || (sync && fdatasync(fd) != 0)) {
+        rc = -errno;
+    }
+    close(fd);
+    if (rc == 0 && renameat(dirfd_, temporary.c_str(), dirfd_, path.c_str()) != 0) {
+        rc = -errno;
+    }
+    if (rc != 0) {
+        unlinkat(dirfd_, temporary.c_str(), 0);
+        return rc;
+    }
+    created = true;
+    chunksStored_.fetch_add(1, std::memory_order_relaxed);
+    bytesStored_.fetch_add(size, std::memory_order_relaxed);
+    return 0;
+}
+
+int DedupStore::open_chunk(const std::string& digest) const
+{
+    int fd = openat(dirfd_, chunk_path(digest).c_str(), O_RDONLY | O_CLOEXEC);
+    return fd < 0 ? -errno : fd;
+}
+
+int DedupStore::sync_directories(const std::set<std::string>& prefixes) const
+{
+    for (const std::string& prefix : prefixes) {
+        int fd = openat(dirfd_, prefix.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return -errno;
+        }
+        int rc = fsync(fd) == 0 || errno == EINVAL ? 0 : -errno;
+        close(fd);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+int DedupStore::write_manifest(int fd, const std::string& text, off_t size)
+{
+    if (!write_fully(fd, text.data(), text.size(), 0)) {
+        return -errno;
+    }
+    if (ftruncate(fd, size) != 0) {
+        return -errno;
+    }
+    std::string length = std::to_string(text.size());
+    if (fsetxattr(fd, MANIFEST_XATTR, length.data(), length.size(), 0) != 0) {
+        return errno == EOPNOTSUPP ? -ENOTSUP : -errno;
+    }
+    manifests_.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+DedupStore::Stats DedupStore::stats() const
+{
+    Stats stats;
+    stats.chunksStored = chunksStored_.load(std::memory_order_relaxed);
+    stats.chunksShared = chunksShared_.load(std::memory_order_relaxed);
+    stats.bytesStored = bytesStored_.load(std::memory_order_relaxed);
+    stats.bytesShared = bytesShared_.load(std::memory_order_relaxed);
+    stats.manifests = manifests_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+DedupWriter::DedupWriter(bool sync) : sync_(sync)
+{
+}
+
+int DedupWriter::write(const char* data, size_t size)
+{
+    pending_.insert(pending_.end(), data, data + size);
+    size_ += size;
+    const FastCdc& chunker = DedupStore::instance().chunker();
+    size_t consumed = 0;
+    while (pending_.size() - consumed >= chunker.max_size()) {
+        size_t n = chunker.cut(pending_.data() + consumed, pending_.size() - consumed, false);
+        int rc = store(pending_.data() + consumed, n);
+        if (rc != 0) {
+            return rc;
+        }
+        consumed += n;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + consumed);
+    return 0;
+}
+
+int DedupWriter::store(const char* data, size_t size)
+{
+    Hasher hasher(HashAlgorithm::SHA256);
+    hasher.update(data, size);
+    std::string digest = hasher.finish();
+    bool created = false;
+    int rc = DedupStore::instance().put(digest, data, size, sync_, created);
+    if (rc != 0) {
+        return rc;
+    }
+    if (created && sync_) {
+        touched_.insert(digest.substr(0, 2));
+    }
+    entries_ += digest + " " + std::to_string(size) + "\n";
+    ++count_;
+    return 0;
+}
+
+int DedupWriter::finish(int fd)
+{
+    DedupStore& dedup = DedupStore::instance();
+    // 小文件的清单不比数据小，直接写入数据
+    if (count_ == 0 && pending_.size() < dedup.chunker().min_size()) {
+        if (!write_fully(fd, pending_.data(), pending_.size(), 0)) {
+            return -errno;
+        }
+        return ftruncate(fd, size_) == 0 ? 0 : -errno;
+    }
+
+    size_t consumed = 0;
+    while (consumed < pending_.size()) {
+        size_t n = dedup.chunker().cut(pending_.data() + consumed,
+                                       pending_.size() - consumed, true);
+        int rc = store(pending_.data() + consumed, n);
+        if (rc != 0) {
+            return rc;
+        }
+        consumed += n;
+    }
+    pending_.clear();
+    if (sync_) {
+        int rc = dedup.sync_directories(touched_);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    std::string text = std::string(MANIFEST_MAGIC) + " 1 " + std::to_string(size_) +
+            " " + std::to_string(count_) + "\n" + entries_;
+    int rc = dedup.write_manifest(fd, text, size_);
+    if (rc != -ENOTSUP) {
+        return rc;
+    }
+
+    // 目标文件系统不支持扩展属性，按清单还原为普通文件
+    ManifestReader reader;
+    rc = reader.load(text);
+    if (rc != 0) {
+        return rc;
+    }
+    std::vector<char> buffer(MATERIALIZE_BUFFER);
+    for (off_t offset = 0; offset < size_;) {
+        ssize_t n = reader.pread(buffer.data(), buffer.size(), offset);
+        if (n <= 0) {
+            return n < 0 ? -errno : -EIO;
+        }
+        if (!write_fully(fd, buffer.data(), n, offset)) {
+            return -errno;
+        }
+        offset += n;
+    }
+    return 0;
+}
+
+ManifestReader::~ManifestReader()
+{
+    if (chunkFd_ != -1) {
+        close(chunkFd_);
+    }
+}
+
+int ManifestReader::open(int fd)
+{
+    char value[32];
+    ssize_t n = fgetxattr(fd, MANIFEST_XATTR, value, sizeof(value) - 1);
+    if (n < 0) {
+        return errno == ENODATA || errno == ENOTSUP || errno == EOPNOTSUPP ? 0 : -errno;
+    }
+    value[n] = '\0';
+    char* end = nullptr;
+    unsigned long long length = strtoull(value, &end, 10);
+    if (end == value || *end != '\0' || length == 0 || length > MANIFEST_MAX) {
+        return -EIO;
+    }
+
+    std::string text(length, '\0');
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t r = ::pread(fd, text.data() + done, text.size() - done, done);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return r < 0 ? -errno : -EIO;
+        }
+        done += r;
+    }
+    int rc = load(text);
+    if (rc != 0) {
+        return rc;
+    }
+    // 文件被改写（大小与清单不符）时不再按清单读取
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -errno;
+    }
+    return st.st_size == size_ ? 1 : -EIO;
+}
+
+int ManifestReader::load(const std::string& text)
+{
+    std::istringstream in(text);
+    std::string magic;
+    int version = 0;
+    long long size = -1;
+    size_t count = 0;
+    if (!(in >> magic >> version >> size >> count) || magic != MANIFEST_MAGIC ||
+            version != 1 || size < 0) {
+        return -EIO;
+    }
+    std::vector<Chunk> chunks;
+    chunks.reserve(count);
+    off_t offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Chunk chunk;
+        if (!(in >> chunk.digest >> chunk.length) || chunk.digest.size() != 64 ||
+                chunk.length == 0) {
+            return -EIO;
+        }
+        chunk.offset = offset;
+        offset += chunk.length;
+        chunks.push_back(std::move(chunk));
+    }
+    if (offset != size) {
+        return -EIO;
+    }
+    if (chunkFd_ != -1) {
+        close(chunkFd_);
+        chunkFd_ = -1;
+    }
+    chunks_ = std::move(chunks);
+    text_ = text;
+    size_ = size;
+    return 0;
+}
+
+ssize_t ManifestReader::pread(char* buffer, size_t size, off_t offset)
+{
+    size_t done = 0;
+    while (done < size && offset < size_) {
+        // 二分查找包含 offset 的分块
+        auto it = std::upper_bound(chunks_.begin(), chunks_.end(), offset,
+                [](off_t value, const Chunk& chunk) { return value < chunk.offset; });
+        size_t index = static_cast<size_t>(it - chunks_.begin()) - 1;
+        const Chunk& chunk = chunks_[index];
+        if (chunkFd_ == -1 || current_ != index) {
+            if (chunkFd_ != -1) {
+                close(chunkFd_);
+                chunkFd_ = -1;
+            }
+            int fd = DedupStore::instance().open_chunk(chunk.digest);
+            if (fd < 0) {
+                errno = -fd;
+                return done > 0 ? static_cast<ssize_t>(done) : -1;
+            }
+            chunkFd_ = fd;
+            current_ = index;
+        }
+        off_t within = offset - chunk.offset;
+        size_t want = std::min(size - done, chunk.length - static_cast<size_t>(within));
+        ssize_t n = ::pread(chunkFd_, buffer + done, want, within);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // 分块比清单记录的短：存储被破坏
+            errno = n < 0 ? errno : EIO;
+            return done > 0 ? static_cast<ssize_t>(done) : -1;
+        }
+        done += n;
+        offset += n;
+    }
+    return static_cast<ssize_t>(done);
+}
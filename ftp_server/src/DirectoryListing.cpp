@@ -0,0 +1,425 @@
+#include "DirectoryListing.h"
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+// getdents64 返回的目录项（glibc 未导出该结构）
+struct linux_dirent64
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// getdents64 缓冲区大小
+static const size_t DENTS_SIZE = 32768;
+
+// 不依赖进程 locale 的月份缩写
+static const char* const MONTHS[] = {"Jan", "Feb", "Mar", "Apr",
+                                     "May", "Jun", "Jul", "Aug",
+                                     "Sep", "Oct", "Nov", "Dec"};
+
+// 权限位与文件类型，格式同 ls：drwxr-xr-x
+static void append_mode(std::string& out, mode_t mode)
+{
+    char type = '-';
+    if (S_ISDIR(mode)) {
+        type = 'd';
+    } else if (S_ISLNK(mode)) {
+        type = 'l';
+    } else if (S_ISCHR(mode)) {
+        type = 'c';
+    } else if (S_ISBLK(mode)) {
+        type = 'b';
+    } else if (S_ISFIFO(mode)) {
+        type = 'p';
+    } else if (S_ISSOCK(mode)) {
+        type = 's';
+    }
+
+    char bits[11] = {type, '-', '-', '-', '-', '-', '-', '-', '-', '-', '\0'};
+    static const char RWX[] = "rwx";
+    for (int i = 0; i < 9; ++i) {
+        if (mode & (0400 >> i)) {
+            bits[1 + i] = RWX[i % 3];
+        }
+    }
+    if (mode & S_ISUID) {
+        bits[3] = (mode & S_IXUSR) ? 's' : 'S';
+    }
+    if (mode & S_ISGID) {
+        bits[6] = (mode & S_IXGRP) ? 's' : 'S';
+    }
+    if (mode & S_ISVTX) {
+        bits[9] = (mode & S_IXOTH) ? 't' : 'T';
+    }
+    out.append(bits, 10);
+}
+
+// 修改时间，格式同 ls：半年内显示时分，否则显示年份
+static void append_time(std::string& out, time_t mtime)
+{
+    struct tm tm;
+    localtime_r(&mtime, &tm);
+    time_t now = time(nullptr);
+    const time_t halfYear = 365 * 24 * 3600 / 2;
+
+    char buf[32];
+    if (mtime > now - halfYear && mtime < now + halfYear) {
+        snprintf(buf, sizeof(buf), "%s %2d %02d:%02d", MONTHS[tm.tm_mon],
+                 tm.tm_mday, tm.tm_hour, tm.tm_min);
+    } else {
+        snprintf(buf, sizeof(buf), "%s %2d  %d", MONTHS[tm.tm_mon], tm.tm_mday,
+                 tm.tm_year + 1900);
+    }
+    out += buf;
+}
+
+// 目录项是否为目录（符号链接不算），文件系统未提供类型时 statx
+static bool is_directory(int dirfd, const linux_dirent64* entry)
+{
+    if (entry->d_type != DT_UNKNOWN) {
+        return entry->d_type == DT_DIR;
+    }
+    struct statx stx;
+    return stat_entry(dirfd, entry->d_name, stx) == 0 && S_ISDIR(stx.stx_mode);
+}
+
+//————————————————————DirectoryReader————————————————————————————
+
+DirectoryReader::DirectoryReader()
+    : fd_(-1),
+      fileFd_(-1),
+      format_(ListFormat::LIST),
+      hidden_(false),
+      pos_(0),
+      len_(0),
+      position_(0),
+      recursive_(false),
+      eof_(false),
+      snapshot_(false),
+      next_(0)
+{
+}
+
+DirectoryReader::~DirectoryReader()
+{
+    if (fd_ != -1) {
+        close(fd_);
+    }
+    if (fileFd_ != -1) {
+        close(fileFd_);
+    }
+}
+
+int DirectoryReader::open(
+        const ResolvedPath& path,
+        ListFormat format,
+        bool hidden)
+{
+    format_ = format;
+    hidden_ = hidden;
+    if (!path.native()) {
+        return open_entries(path);
+    }
+    int fd = path.open(O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fd_ = fd;
+        dents_.resize(DENTS_SIZE);
+        return 0;
+    }
+    if (fd != -ENOTDIR || format != ListFormat::LIST) {
+        return fd;
+    }
+
+    // LIST 一个文件：与 ls 相同，只输出该文件
+    fd = path.open(O_PATH | O_NOFOLLOW);
+    if (fd < 0) {
+        return fd;
+    }
+    fileFd_ = fd;
+    file_ = path.path();
+    return 0;
+}
+
+int DirectoryReader::open_entries(const ResolvedPath& path)
+{
+    snapshot_ = true;
+    path_ = path;
+    int rc = path.read_directory(0, entries_);
+    if (rc != -ENOTDIR || format_ != ListFormat::LIST) {
+        return rc;
+    }
+
+    // LIST 一个文件
+    DirectoryEntry entry;
+    entry.name = path.path();
+    rc = path.stat(entry.stx, false);
+    if (rc != 0) {
+        return rc;
+    }
+    file_ = entry.name;
+    entries_.push_back(std::move(entry));
+    return 0;
+}
+
+int DirectoryReader::read_entries(
+        std::string& out,
+        size_t limit,
+        size_t* remaining)
+{
+    while (out.size() < limit) {
+        if (next_ >= entries_.size()) {
+            eof_ = true;
+            return 0;
+        }
+        const DirectoryEntry& entry = entries_[next_++];
+        position_ = entry.position;
+        if (entry.name[0] == '.' && format_ == ListFormat::LIST && !hidden_ &&
+            directory()) {
+            continue;
+        }
+        if (recursive_ && S_ISDIR(entry.stx.stx_mode)) {
+            subdirs_.push_back(entry.name);
+        }
+        append_line(out, -1, "", entry.name.c_str(), entry.stx);
+        if (remaining != nullptr && --*remaining == 0) {
+            return 1;
+        }
+    }
+    return 1;
+}
+
+int DirectoryReader::read(std::string& out, size_t limit, size_t* remaining)
+{
+    if (snapshot_) {
+        return read_entries(out, limit, remaining);
+    }
+    if (fd_ == -1) {
+        if (!eof_ && !file_.empty()) {
+            append_entry(out, file_.c_str());
+        }
+        eof_ = true;
+        return 0;
+    }
+
+    while (out.size() < limit) {
+        if (pos_ >= len_) {
+            if (eof_) {
+                return 0;
+            }
+            long n = syscall(SYS_getdents64, fd_, dents_.data(), dents_.size());
+            if (n < 0) {
+                return -errno;
+            }
+            if (n == 0) {
+                eof_ = true;
+                return 0;
+            }
+            pos_ = 0;
+            len_ = static_cast<size_t>(n);
+        }
+
+        const linux_dirent64* entry =
+                reinterpret_cast<const linux_dirent64*>(dents_.data() + pos_);
+        pos_ += entry->d_reclen;
+        position_ = entry->d_off;
+
+        const char* name = entry->d_name;
+        if (name[0] == '.') {
+            bool self = name[1] == '\0' || (name[1] == '.' && name[2] == '\0');
+            if (self || (format_ == ListFormat::LIST && !hidden_)) {
+                continue;
+            }
+        }
+        if (recursive_ && is_directory(fd_, entry)) {
+            subdirs_.push_back(name);
+        }
+        if (append_entry(out, name) && remaining != nullptr &&
+            --*remaining == 0) {
+            return 1;
+        }
+    }
+    return 1;
+}
+
+int DirectoryReader::seek(off_t cursor)
+{
+    if (!directory()) {
+        return 0;
+    }
+    if (snapshot_) {
+        next_ = 0;
+        position_ = cursor;
+        eof_ = false;
+        return path_.read_directory(cursor, entries_);
+    }
+    if (lseek(fd_, cursor, SEEK_SET) == -1) {
+        return -errno;
+    }
+    pos_ = len_ = 0;
+    position_ = cursor;
+    eof_ = false;
+    return 0;
+}
+
+void DirectoryReader::set_recursive(const std::string& prefix)
+{
+    recursive_ = true;
+    prefix_ = prefix.empty() ? prefix : prefix + "/";
+}
+
+std::vector<std::string> DirectoryReader::take_subdirectories()
+{
+    return std::exchange(subdirs_, std::vector<std::string>());
+}
+
+bool DirectoryReader::append_entry(std::string& out, const char* name)
+{
+    // 目录项可能在 getdents64 之后被删除，此时跳过
+    int dirfd = fd_;
+    const char* path = name;
+    if (fd_ == -1) {
+        dirfd = fileFd_; // 单个文件
+        path = "";
+    }
+    struct statx stx;
+    if (format_ == ListFormat::LIST) {
+        if (stat_entry(dirfd, path, stx) != 0) {
+            return false;
+        }
+    } else if (stat_entry(dirfd, name, stx, true) != 0 &&
+               stat_entry(dirfd, name, stx) != 0) {
+        // 指向不存在目标的符号链接仍按链接本身列出
+        return false;
+    }
+    append_line(out, dirfd, path, name, stx);
+    return true;
+}
+
+void DirectoryReader::append_line(
+        std::string& out,
+        int dirfd,
+        const char* path,
+        const char* name,
+        const struct statx& stx)
+{
+    if (format_ == ListFormat::LIST) {
+        out += format_list_line(dirfd, path, name, stx);
+        return;
+    }
+    out += format_facts(stx);
+    out += prefix_;
+    out += name;
+    out += "\r\n";
+}
+
+//————————————————————格式化————————————————————————————
+
+int stat_entry(int dirfd, const char* path, struct statx& stx, bool follow)
+{
+    int flags = (follow ? 0 : AT_SYMLINK_NOFOLLOW) | AT_EMPTY_PATH;
+    unsigned int mask = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID |
+                        STATX_GID | STATX_MTIME | STATX_SIZE;
+    if (statx(dirfd, path, flags, mask, &stx) == -1) {
+        return -errno;
+    }
+    return 0;
+}
+
+std::string format_list_line(
+        int dirfd,
+        const char* path,
+        const char* name,
+        const struct statx& stx)
+{
+    std::string line;
+    line.reserve(80);
+    append_mode(line, stx.stx_mode);
+
+    char buf[96];
+    snprintf(buf, sizeof(buf), " %4u %-8u %-8u %12llu ", stx.stx_nlink,
+             stx.stx_uid, stx.stx_gid,
+             static_cast<unsigned long long>(stx.stx_size));
+    line += buf;
+    append_time(line, stx.stx_mtime.tv_sec);
+    line += ' ';
+    line += name;
+
+    if (S_ISLNK(stx.stx_mode)) {
+        char target[4096];
+        ssize_t len = readlinkat(dirfd, path, target, sizeof(target));
+        if (len > 0) {
+            line += " -> ";
+            line.append(target, len);
+        }
+    }
+    line += "\r\n";
+    return line;
+}
+
+std::string format_facts(const struct statx& stx)
+{
+    mode_t mode = stx.stx_mode;
+    bool dir = S_ISDIR(mode);
+
+    // 按服务进程的身份估算权限：属主、属组、其他人依次匹配
+    mode_t bits = mode & 07;
+    uid_t euid = geteuid();
+    if (euid == 0) {
+        bits = 07;
+    } else if (stx.stx_uid == euid) {
+        bits = (mode >> 6) & 07;
+    } else if (stx.stx_gid == getegid()) {
+        bits = (mode >> 3) & 07;
+    }
+
+    std::string perm;
+    if (dir) {
+        if (bits & 01) {
+            perm += 'e';
+        }
+        if (bits & 04) {
+            perm += 'l';
+        }
+        if (bits & 02) {
+            perm += "cmp";
+        }
+    } else {
+        if (bits & 04) {
+            perm += 'r';
+        }
+        if (bits & 02) {
+            perm += "adfw";
+        }
+    }
+
+    time_t mtime = stx.stx_mtime.tv_sec;
+    struct tm tm;
+    gmtime_r(&mtime, &tm);
+
+    char buf[192];
+    std::string facts;
+    snprintf(buf, sizeof(buf), "type=%s;", dir ? "dir" : "file");
+    facts += buf;
+    if (!dir) {
+        snprintf(buf, sizeof(buf), "size=%llu;",
+                 static_cast<unsigned long long>(stx.stx_size));
+        facts += buf;
+    }
+    snprintf(buf, sizeof(buf),
+             "modify=%04d%02d%02d%02d%02d%02d;perm=%s;unix.mode=%04o;"
+             "unix.uid=%u;unix.gid=%u; ",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+             tm.tm_min, tm.tm_sec, perm.c_str(), mode & 07777, stx.stx_uid,
+             stx.stx_gid);
+    facts += buf;
+    return facts;
+}
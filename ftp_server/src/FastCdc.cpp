@@ -0,0 +1,71 @@
+#include "FastCdc.h"
+#include <algorithm>
+
+// Gear 表：固定种子的 splitmix64，保证不同进程、不同版本的切点一致
+struct GearTable
+{
+    uint64_t table[256];
+
+    GearTable()
+    {
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+        for (uint64_t& value : table) {
+            state += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            value = z ^ (z >> 31);
+        }
+    }
+};
+
+static const GearTable GEAR;
+
+// 最高的 bits 位为 1 的掩码：指纹左移，最高位取决于最近的 64 个字节
+static uint64_t top_mask(int bits)
+{
+    bits = std::clamp(bits, 1, 63);
+    return ~0ULL << (64 - bits);
+}
+
+FastCdc::FastCdc(size_t minSize, size_t avgSize, size_t maxSize)
+{
+    min_ = std::max<size_t>(minSize, 64);
+    max_ = std::max(maxSize, min_ + 1);
+    int bits = 0;
+    while ((size_t(2) << bits) <= avgSize) {
+        ++bits;
+    }
+    avg_ = std::clamp(size_t(1) << bits, min_, max_);
+    // 归一化等级 2：平均值前后各相差 2 位
+    maskS_ = top_mask(bits + 2);
+    maskL_ = top_mask(bits - 2);
+}
+
+size_t FastCdc::cut(const char* data, size_t size, bool eof) const
+{
+    if (size < max_ && !eof) {
+        return 0;
+    }
+    if (size <= min_) {
+        return size;
+    }
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    size_t end = std::min(size, max_);
+    size_t normal = std::min(avg_, end);
+    uint64_t fp = 0;
+    size_t i = min_;
+    for (; i < normal; ++i) {
+        fp = (fp << 1) + GEAR.table[p[i]];
+        if ((fp & maskS_) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < end; ++i) {
+        fp = (fp << 1) + GEAR.table[p[i]];
+        if ((fp & maskL_) == 0) {
+            return i + 1;
+        }
+    }
+    return end;
+}
@@ -0,0 +1,165 @@
+#include "FileCache.h"
+#include <ctime>
+#include <functional>
+#include <sys/sysmacros.h>
+
+// 每个条目除内容外的估算开销（链表节点、索引、控制块）
+static const size_t ENTRY_OVERHEAD = 128;
+
+//————————————————————FileIdentity————————————————————————————
+
+FileIdentity FileIdentity::from_stat(const struct stat& st)
+{
+    FileIdentity identity;
+    identity.dev = st.st_dev;
+    identity.ino = st.st_ino;
+    identity.size = st.st_size;
+    identity.mtime = st.st_mtim;
+    identity.ctime = st.st_ctim;
+    return identity;
+}
+
+FileIdentity FileIdentity::from_statx(const struct statx& stx)
+{
+    FileIdentity identity;
+    identity.dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    identity.ino = stx.stx_ino;
+    identity.size = static_cast<off_t>(stx.stx_size);
+    identity.mtime.tv_sec = stx.stx_mtime.tv_sec;
+    identity.mtime.tv_nsec = stx.stx_mtime.tv_nsec;
+    identity.ctime.tv_sec = stx.stx_ctime.tv_sec;
+    identity.ctime.tv_nsec = stx.stx_ctime.tv_nsec;
+    return identity;
+}
+
+bool FileIdentity::same_version(const FileIdentity& other) const
+{
+    return dev == other.dev && ino == other.ino && size == other.size &&
+           mtime.tv_sec == other.mtime.tv_sec &&
+           mtime.tv_nsec == other.mtime.tv_nsec &&
+           ctime.tv_sec == other.ctime.tv_sec &&
+           ctime.tv_nsec == other.ctime.tv_nsec;
+}
+
+//————————————————————FileCache————————————————————————————
+
+size_t FileCache::KeyHash::operator()(const Key& key) const
+{
+    size_t h = std::hash<unsigned long long>()(key.ino);
+    return h ^ (std::hash<unsigned long long>()(key.dev) + 0x9e3779b97f4a7c15ULL +
+                (h << 6) + (h >> 2));
+}
+
+FileCache& FileCache::instance()
+{
+    static FileCache cache;
+    return cache;
+}
+
+void FileCache::configure(size_t budget, size_t maxFileSize, size_t shards)
+{
+    if (shards == 0) {
+        shards = 1;
+    }
+    budget_ = budget;
+    shardBudget_ = budget / shards;
+    maxFileSize_ = maxFileSize;
+    shards_.clear();
+    for (size_t i = 0; i < shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+bool FileCache::cacheable(off_t size) const
+{
+    return enabled() && size >= 0 && static_cast<size_t>(size) <= maxFileSize_ &&
+           static_cast<size_t>(size) + ENTRY_OVERHEAD <= shardBudget_;
+}
+
+FileCache::Shard& FileCache::shard_for(const Key& key)
+{
+    return *shards_[KeyHash()(key) % shards_.size()];
+}
+
+void FileCache::erase(Shard& shard, std::list<Entry>::iterator it)
+{
+    shard.bytes -= it->charge;
+    shard.index.erase(Key{it->identity.dev, it->identity.ino});
+    shard.lru.erase(it);
+}
+
+std::shared_ptr<const std::string> FileCache::lookup(const FileIdentity& identity)
+{
+    if (!cacheable(identity.size)) {
+        return nullptr;
+    }
+    Key key{identity.dev, identity.ino};
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto it = found->second;
+    if (!it->identity.same_version(identity)) {
+        // 文件已被修改，丢弃旧内容，由调用方重新读取
+        erase(shard, it);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->data;
+}
+
+void FileCache::insert(
+        const FileIdentity& identity,
+        std::shared_ptr<const std::string> data)
+{
+    if (!cacheable(identity.size) ||
+        data->size() != static_cast<size_t>(identity.size)) {
+        return;
+    }
+
+    // 刚被修改的文件可能在同一时间戳内再次被修改而版本不变，暂不缓存
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (now.tv_sec - identity.mtime.tv_sec < 1 ||
+        now.tv_sec - identity.ctime.tv_sec < 1) {
+        return;
+    }
+
+    Key key{identity.dev, identity.ino};
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        erase(shard, found->second);
+    }
+
+    size_t charge = data->size() + ENTRY_OVERHEAD;
+    while (!shard.lru.empty() && shard.bytes + charge > shardBudget_) {
+        erase(shard, std::prev(shard.lru.end()));
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.lru.push_front(Entry{identity, std::move(data), charge});
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += charge;
+    insertions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+FileCache::Stats FileCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    stats.insertions = insertions_.load(std::memory_order_relaxed);
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.entries += shard->lru.size();
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+}
@@ -0,0 +1,176 @@
+#include "FileCopy.h"
+#include "DedupStore.h"
+#include "UploadCommitter.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 每个线程池任务最多复制的字节数，复制大文件时不长时间占住线程
+const off_t COPY_STEP = 64 * 1024 * 1024;
+// pread/pwrite 的缓冲大小
+const size_t COPY_BUFFER = 1024 * 1024;
+
+// 写完整个缓冲区，失败时 errno 有效
+static bool write_fully(int fd, const char* data, size_t size, off_t offset)
+{
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            errno = n < 0 ? errno : EIO;
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+const char* copy_method_name(CopyMethod method)
+{
+    switch (method) {
+    case CopyMethod::REFLINK:
+        return "reflink";
+    case CopyMethod::COPY_FILE_RANGE:
+        return "copy_file_range";
+    case CopyMethod::MANIFEST:
+        return "manifest";
+    default:
+        return "read/write";
+    }
+}
+
+FileCopy::FileCopy(ResolvedPath from, ResolvedPath to)
+    : from_(std::move(from)), to_(std::move(to))
+{
+}
+
+FileCopy::~FileCopy()
+{
+    if (source_ != -1) {
+        close(source_);
+    }
+    if (target_ != -1) {
+        close(target_);
+    }
+    if (created_) {
+        temporary_.unlink();
+    }
+}
+
+int FileCopy::open()
+{
+    source_ = from_.open(O_RDONLY | O_CLOEXEC);
+    if (source_ < 0) {
+        int rc = source_;
+        source_ = -1;
+        return rc;
+    }
+    struct stat st;
+    if (fstat(source_, &st) != 0) {
+        return -errno;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return -EISDIR;
+    }
+    identity_ = FileIdentity::from_stat(st);
+    size_ = st.st_size;
+
+    temporary_ = UploadCommitter::temporary_path(to_);
+    target_ = temporary_.open(O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                              st.st_mode & 0777);
+    if (target_ < 0) {
+        int rc = target_;
+        target_ = -1;
+        return rc;
+    }
+    created_ = true;
+    if (size_ == 0) {
+        return 0;
+    }
+
+    // 去重文件只有清单，复制清单即可，分块由两个文件共享
+    if (DedupStore::instance().enabled()) {
+        ManifestReader manifest;
+        int rc = manifest.open(source_);
+        if (rc < 0) {
+            return rc;
+        }
+        if (rc == 1) {
+            method_ = CopyMethod::MANIFEST;
+            copied_ = size_;
+            return DedupStore::instance().write_manifest(target_, manifest.text(), size_);
+        }
+    }
+
+    // 支持 reflink 的文件系统共享数据块，整个文件一次完成
+    if (ioctl(target_, FICLONE, source_) == 0) {
+        method_ = CopyMethod::REFLINK;
+        copied_ = size_;
+        return 0;
+    }
+    return 1;
+}
+
+int FileCopy::step()
+{
+    off_t stop = std::min(size_, copied_ + COPY_STEP);
+    while (copied_ < stop) {
+        size_t want = static_cast<size_t>(stop - copied_);
+        ssize_t n;
+        if (method_ == CopyMethod::COPY_FILE_RANGE) {
+            loff_t in = copied_;
+            loff_t out = copied_;
+            n = copy_file_range(source_, &in, target_, &out, want, 0);
+            if (n < 0 && (errno == EXDEV || errno == EINVAL ||
+                          errno == EOPNOTSUPP || errno == ENOSYS)) {
+                // 跨文件系统或不支持，改为用户态读写
+                method_ = CopyMethod::READ_WRITE;
+                continue;
+            }
+        } else {
+            if (buffer_.empty()) {
+                buffer_.resize(COPY_BUFFER);
+            }
+            n = pread(source_, buffer_.data(), std::min(want, buffer_.size()),
+                      copied_);
+            if (n > 0 && !write_fully(target_, buffer_.data(), n, copied_)) {
+                return -errno;
+            }
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            return -ESTALE; // 源文件被截断
+        }
+        copied_ += n;
+    }
+    return copied_ < size_ ? 1 : 0;
+}
+
+int FileCopy::commit()
+{
+    struct stat st;
+    if (fstat(source_, &st) != 0) {
+        return -errno;
+    }
+    if (!identity_.same_version(FileIdentity::from_stat(st))) {
+        return -ESTALE;
+    }
+    int rc = UploadCommitter::instance().commit(target_, temporary_, to_);
+    if (rc == 0) {
+        created_ = false;
+    }
+    return rc;
+}
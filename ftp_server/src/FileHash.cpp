@@ -0,0 +1,193 @@
+#include "FileHash.h"
+#include <cstdio>
+#include <cstring>
+#include <openssl/evp.h>
+#include <strings.h>
+
+// 反射多项式
+static const uint32_t CRC32_POLY = 0xEDB88320u;
+static const uint32_t CRC32C_POLY = 0x82F63B78u;
+
+static const struct
+{
+    HashAlgorithm algorithm;
+    const char* name;
+} ALGORITHMS[] = {
+        {HashAlgorithm::CRC32, "CRC32"},
+        {HashAlgorithm::CRC32C, "CRC32C"},
+        {HashAlgorithm::MD5, "MD5"},
+        {HashAlgorithm::SHA1, "SHA-1"},
+        {HashAlgorithm::SHA256, "SHA-256"},
+        {HashAlgorithm::SHA512, "SHA-512"},
+};
+
+const char* hash_algorithm_name(HashAlgorithm algorithm)
+{
+    for (const auto& entry : ALGORITHMS) {
+        if (entry.algorithm == algorithm) {
+            return entry.name;
+        }
+    }
+    return "";
+}
+
+bool parse_hash_algorithm(const std::string& name, HashAlgorithm& algorithm)
+{
+    for (const auto& entry : ALGORITHMS) {
+        if (strcasecmp(entry.name, name.c_str()) == 0) {
+            algorithm = entry.algorithm;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 按 8 字节切片的查表：table[k][b] 为字节 b 之后再经过 k 个零字节的 CRC
+struct CrcTables
+{
+    uint32_t table[8][256];
+
+    explicit CrcTables(uint32_t poly)
+    {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t crc = b;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (poly & (0u - (crc & 1)));
+            }
+            table[0][b] = crc;
+        }
+        for (uint32_t b = 0; b < 256; ++b) {
+            for (int k = 1; k < 8; ++k) {
+                uint32_t prev = table[k - 1][b];
+                table[k][b] = (prev >> 8) ^ table[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+static uint32_t crc_sliced(
+        const CrcTables& tables,
+        uint32_t crc,
+        const void* data,
+        size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const auto& t = tables.table;
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc; // 小端序
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+              t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+              t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+uint32_t crc32_ieee(uint32_t crc, const void* data, size_t size)
+{
+    static const CrcTables tables(CRC32_POLY);
+    return crc_sliced(tables, crc, data, size);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t crc32c_sse42(
+        uint32_t crc,
+        const void* data,
+        size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t value = ~crc;
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        value = __builtin_ia32_crc32di(value, word);
+        p += 8;
+        size -= 8;
+    }
+    uint32_t crc32 = static_cast<uint32_t>(value);
+    while (size-- > 0) {
+        crc32 = __builtin_ia32_crc32qi(crc32, *p++);
+    }
+    return ~crc32;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t size)
+{
+#if defined(__x86_64__)
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware) {
+        return crc32c_sse42(crc, data, size);
+    }
+#endif
+    static const CrcTables tables(CRC32C_POLY);
+    return crc_sliced(tables, crc, data, size);
+}
+
+static const EVP_MD* digest_for(HashAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case HashAlgorithm::MD5:
+        return EVP_md5();
+    case HashAlgorithm::SHA1:
+        return EVP_sha1();
+    case HashAlgorithm::SHA256:
+        return EVP_sha256();
+    case HashAlgorithm::SHA512:
+        return EVP_sha512();
+    default:
+        return nullptr;
+    }
+}
+
+Hasher::Hasher(HashAlgorithm algorithm): algorithm_(algorithm)
+{
+    const EVP_MD* md = digest_for(algorithm);
+    if (md != nullptr) {
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(ctx, md, nullptr);
+        context_ = ctx;
+    }
+}
+
+Hasher::~Hasher()
+{
+    EVP_MD_CTX_free(static_cast<EVP_MD_CTX*>(context_));
+}
+
+void Hasher::update(const void* data, size_t size)
+{
+    if (algorithm_ == HashAlgorithm::CRC32) {
+        crc_ = crc32_ieee(crc_, data, size);
+    } else if (algorithm_ == HashAlgorithm::CRC32C) {
+        crc_ = crc32c(crc_, data, size);
+    } else {
+        EVP_DigestUpdate(static_cast<EVP_MD_CTX*>(context_), data, size);
+    }
+}
+
+std::string Hasher::finish()
+{
+    char hex[2 * EVP_MAX_MD_SIZE + 1];
+    if (context_ == nullptr) {
+        snprintf(hex, sizeof(hex), "%08x", crc_);
+        return hex;
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(static_cast<EVP_MD_CTX*>(context_), digest, &length);
+    for (unsigned int i = 0; i < length; ++i) {
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+    }
+    return std::string(hex, 2 * length);
+}
@@ -0,0 +1,23 @@
+#include "FileSystem.h"
+#include "LocalFileSystem.h"
+
+// 服务器使用的文件系统，默认为不限制根目录的本地文件系统
+static std::shared_ptr<FileSystem>& current()
+{
+    static std::shared_ptr<FileSystem> fs = [] {
+        auto local = std::make_shared<LocalFileSystem>();
+        local->open("/");
+        return std::shared_ptr<FileSystem>(local);
+    }();
+    return fs;
+}
+
+std::shared_ptr<FileSystem> FileSystem::instance()
+{
+    return current();
+}
+
+void FileSystem::set_instance(std::shared_ptr<FileSystem> fs)
+{
+    current() = std::move(fs);
+}
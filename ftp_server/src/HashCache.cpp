@@ -0,0 +1,215 @@
+#include "HashCache.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <sys/xattr.h>
+
+// 扩展属性名：user.ftp_server.<算法名小写>
+static std::string xattr_name(HashAlgorithm algorithm)
+{
+    std::string name = "user.ftp_server.";
+    for (const char* p = hash_algorithm_name(algorithm); *p != '\0'; ++p) {
+        name += static_cast<char>(std::tolower(static_cast<unsigned char>(*p)));
+    }
+    return name;
+}
+
+// 区间是否为整个文件
+static bool whole_file(const FileIdentity& identity, off_t offset, off_t length)
+{
+    return offset == 0 && length == identity.size;
+}
+
+size_t HashCache::KeyHash::operator()(const Key& key) const
+{
+    size_t h = std::hash<unsigned long long>()(key.ino);
+    h ^= std::hash<unsigned long long>()(key.dev) + 0x9e3779b97f4a7c15ULL +
+         (h << 6) + (h >> 2);
+    h ^= std::hash<long long>()(key.offset) + static_cast<size_t>(key.algorithm) +
+         (h << 6) + (h >> 2);
+    return h ^ (std::hash<long long>()(key.length) + (h << 6) + (h >> 2));
+}
+
+HashCache& HashCache::instance()
+{
+    static HashCache cache;
+    return cache;
+}
+
+void HashCache::configure(size_t maxEntries, bool persist, size_t shards)
+{
+    if (shards == 0) {
+        shards = 1;
+    }
+    shardEntries_ = maxEntries == 0 ? 0 : std::max<size_t>(maxEntries / shards, 1);
+    persist_ = persist;
+    shards_.clear();
+    for (size_t i = 0; i < shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+HashCache::Shard& HashCache::shard_for(const Key& key)
+{
+    return *shards_[KeyHash()(key) % shards_.size()];
+}
+
+std::string HashCache::lookup(
+        int fd,
+        const FileIdentity& identity,
+        HashAlgorithm algorithm,
+        off_t offset,
+        off_t length)
+{
+    Key key{identity.dev, identity.ino, algorithm, offset, length};
+    if (shardEntries_ > 0) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            auto it = found->second;
+            if (it->identity.same_version(identity)) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it);
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return it->digest;
+            }
+            // 文件已被修改，丢弃旧摘要
+            shard.index.erase(found);
+            shard.lru.erase(it);
+        }
+    }
+
+    if (persist_ && whole_file(identity, offset, length)) {
+        char value[256];
+        ssize_t n = fgetxattr(fd, xattr_name(algorithm).c_str(), value,
+                              sizeof(value) - 1);
+        long long seconds = 0;
+        long nanos = 0;
+        long long size = -1;
+        char digest[160];
+        if (n > 0) {
+            value[n] = '\0';
+            if (sscanf(value, "%lld.%ld %lld %159s", &seconds, &nanos, &size,
+                       digest) == 4 &&
+                seconds == identity.mtime.tv_sec &&
+                nanos == identity.mtime.tv_nsec && size == identity.size) {
+                xattrHits_.fetch_add(1, std::memory_order_relaxed);
+                remember(key, identity, digest);
+                return digest;
+            }
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::string();
+}
+
+void HashCache::insert(
+        int fd,
+        const FileIdentity& identity,
+        HashAlgorithm algorithm,
+        off_t offset,
+        off_t length,
+        const std::string& digest)
+{
+    // 刚被修改的文件可能在同一时间戳内再次被修改而版本不变，暂不缓存
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (now.tv_sec - identity.mtime.tv_sec < 1) {
+        return;
+    }
+    store(fd, identity, algorithm, offset, length, digest);
+}
+
+void HashCache::seed(
+        int fd,
+        const FileIdentity& identity,
+        HashAlgorithm algorithm,
+        const std::string& digest)
+{
+    store(fd, identity, algorithm, 0, identity.size, digest);
+}
+
+void HashCache::set_upload_algorithm(std::optional<HashAlgorithm> algorithm)
+{
+    uploadAlgorithm_ = algorithm;
+}
+
+std::optional<HashAlgorithm> HashCache::upload_algorithm() const
+{
+    return uploadAlgorithm_;
+}
+
+void HashCache::store(
+        int fd,
+        const FileIdentity& identity,
+        HashAlgorithm algorithm,
+        off_t offset,
+        off_t length,
+        const std::string& digest)
+{
+    FileIdentity current = identity;
+    if (persist_ && whole_file(identity, offset, length)) {
+        char value[256];
+        int n = snprintf(value, sizeof(value), "%lld.%09ld %lld %s",
+                         static_cast<long long>(identity.mtime.tv_sec),
+                         static_cast<long>(identity.mtime.tv_nsec),
+                         static_cast<long long>(identity.size), digest.c_str());
+        struct stat st;
+        if (fsetxattr(fd, xattr_name(algorithm).c_str(), value,
+                      static_cast<size_t>(n), 0) == 0 &&
+            fstat(fd, &st) == 0) {
+            // 写入扩展属性更新了 ctime，内存条目使用写入后的版本
+            FileIdentity after = FileIdentity::from_stat(st);
+            if (after.size != identity.size ||
+                after.mtime.tv_sec != identity.mtime.tv_sec ||
+                after.mtime.tv_nsec != identity.mtime.tv_nsec) {
+                return;
+            }
+            current = after;
+        }
+    }
+    remember(Key{identity.dev, identity.ino, algorithm, offset, length},
+             current, digest);
+}
+
+void HashCache::remember(
+        const Key& key,
+        const FileIdentity& identity,
+        const std::string& digest)
+{
+    if (shardEntries_ == 0) {
+        return;
+    }
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        shard.lru.erase(found->second);
+        shard.index.erase(found);
+    }
+    while (shard.lru.size() >= shardEntries_) {
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.lru.push_front(Entry{key, identity, digest});
+    shard.index[key] = shard.lru.begin();
+    insertions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+HashCache::Stats HashCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.xattrHits = xattrHits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    stats.insertions = insertions_.load(std::memory_order_relaxed);
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.entries += shard->lru.size();
+    }
+    return stats;
+}
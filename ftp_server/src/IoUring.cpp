@@ -0,0 +1,657 @@
+#include "IoUring.h"
+#include "CpuAffinity.h"
+#include <ace/Log_Msg.h>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                       unsigned flags)
+{
+    return static_cast<int>(syscall(
+            __NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, const void* arg,
+                          unsigned nrArgs)
+{
+    return static_cast<int>(
+            syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+unsigned load_acquire(const unsigned* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void store_release(unsigned* p, unsigned v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+} // namespace
+
+// 注册缓冲池：一块 NUMA 本地内存切分为等长缓冲区。
+// 线程池任务也可能持有缓冲区，最后的引用可能在线程池线程中释放，空闲表加锁
+struct IoUring::BufferPool
+{
+    char* memory = nullptr;
+    size_t total = 0;
+    std::vector<Buffer> buffers;
+    std::mutex mutex;
+    std::vector<int> free;
+
+    ~BufferPool()
+    {
+        CpuAffinity::free_local(memory, total);
+    }
+};
+
+//————————————————————UringOp————————————————————————————
+
+UringOp::UringOp(IoUring* ring, std::shared_ptr<UringOpState> state)
+    : ring_(ring), state_(std::move(state))
+{
+}
+
+UringOp::UringOp(UringOp&& other) noexcept
+    : ring_(other.ring_), state_(std::move(other.state_))
+{
+}
+
+UringOp& UringOp::operator=(UringOp&& other) noexcept
+{
+    if (this != &other) {
+        abandon();
+        ring_ = other.ring_;
+        state_ = std::move(other.state_);
+    }
+    return *this;
+}
+
+UringOp::~UringOp()
+{
+    abandon();
+}
+
+void UringOp::abandon()
+{
+    // 操作尚未完成：不再恢复协程，并请求内核尽快取消
+    if (state_ && !state_->done) {
+        state_->waiter = {};
+        ring_->cancel(state_.get());
+    }
+    state_.reset();
+}
+
+void UringOp::Awaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+    op_->state_->waiter = waiter;
+    op_->ring_->submit_deferred();
+}
+
+//————————————————————IoUring————————————————————————————
+
+IoUring::IoUring() = default;
+
+IoUring::~IoUring()
+{
+    close();
+}
+
+int IoUring::open(ACE_Reactor* reactor,
+                  unsigned entries,
+                  size_t bufferCount,
+                  size_t bufferSize,
+                  unsigned fileSlots)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd_ = sys_io_uring_setup(entries, &params);
+    if (ringFd_ < 0) {
+        ringFd_ = -1;
+        return -1; // 内核不支持或被禁用
+    }
+
+    // 直接打开到固定文件槽位需要 5.15 以上内核，以 CQE_SKIP 特性（5.17）作为判断依据
+    if (!(params.features & IORING_FEAT_NODROP) ||
+        !(params.features & IORING_FEAT_CQE_SKIP) || !probe_ops()) {
+        close();
+        return -1;
+    }
+
+    // 映射 SQ/CQ 环和 SQE 数组
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ =
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        close();
+        return -1;
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            close();
+            return -1;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        close();
+        return -1;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sqeTail_ = submitted_ = *sqTail_;
+
+    // 注册缓冲区：在 Reactor 线程上分配，位于本地 NUMA 节点
+    auto pool = std::make_shared<BufferPool>();
+    pool->total = bufferCount * bufferSize;
+    pool->memory = static_cast<char*>(CpuAffinity::alloc_local(pool->total));
+    if (pool->memory == nullptr) {
+        close();
+        return -1;
+    }
+    std::vector<iovec> iovecs(bufferCount);
+    for (size_t i = 0; i < bufferCount; ++i) {
+        Buffer buffer;
+        buffer.data = pool->memory + i * bufferSize;
+        buffer.size = bufferSize;
+        buffer.index = static_cast<int>(i);
+        pool->buffers.push_back(buffer);
+        pool->free.push_back(static_cast<int>(bufferCount - 1 - i));
+        iovecs[i].iov_base = buffer.data;
+        iovecs[i].iov_len = bufferSize;
+    }
+    if (sys_io_uring_register(ringFd_, IORING_REGISTER_BUFFERS, iovecs.data(),
+                              static_cast<unsigned>(bufferCount)) < 0) {
+        close();
+        return -1;
+    }
+    buffers_ = pool;
+
+    // 注册稀疏的固定文件表，OPENAT2 直接安装到空槽位
+    std::vector<int> files(fileSlots, -1);
+    if (sys_io_uring_register(ringFd_, IORING_REGISTER_FILES, files.data(),
+                              fileSlots) < 0) {
+        close();
+        return -1;
+    }
+    for (unsigned i = fileSlots; i > 0; --i) {
+        freeSlots_.push_back(static_cast<int>(i - 1));
+    }
+
+    // 完成事件通过 eventfd 通知 Reactor
+    eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd_ == -1 ||
+        sys_io_uring_register(ringFd_, IORING_REGISTER_EVENTFD, &eventFd_,
+                              1) < 0) {
+        close();
+        return -1;
+    }
+    this->reactor(reactor);
+    if (reactor->register_handler(this, ACE_Event_Handler::READ_MASK) == -1) {
+        close();
+        return -1;
+    }
+    return 0;
+}
+
+bool IoUring::probe_ops()
+{
+    const size_t probeSize =
+            sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<char> storage(probeSize, 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (sys_io_uring_register(ringFd_, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        return false;
+    }
+    const unsigned required[] = {
+            IORING_OP_OPENAT2, IORING_OP_STATX, IORING_OP_READ_FIXED,
+            IORING_OP_WRITE_FIXED, IORING_OP_SEND, IORING_OP_RECV,
+            IORING_OP_CLOSE, IORING_OP_ASYNC_CANCEL, IORING_OP_FADVISE,
+            IORING_OP_SYNC_FILE_RANGE};
+    for (unsigned op : required) {
+        if (op > probe->last_op ||
+            !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void IoUring::close()
+{
+    if (eventFd_ != -1) {
+        ACE_Reactor* reactor = this->reactor();
+        if (reactor != nullptr) {
+            reactor->remove_handler(
+                    this, ACE_Event_Handler::READ_MASK |
+                                  ACE_Event_Handler::DONT_CALL);
+        }
+        ::close(eventFd_);
+        eventFd_ = -1;
+    }
+    // 关闭 io_uring 后内核取消所有在途操作，之后才能释放缓冲区
+    if (sqes_ != nullptr) {
+        munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+        munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = nullptr;
+    if (sqRing_ != nullptr) {
+        munmap(sqRing_, sqRingSize_);
+        sqRing_ = nullptr;
+    }
+    if (ringFd_ != -1) {
+        ::close(ringFd_);
+        ringFd_ = -1;
+    }
+    for (auto& entry : inflight_) {
+        entry.second->waiter = {};
+    }
+    inflight_.clear();
+    freeSlots_.clear();
+    buffers_.reset();
+}
+
+bool IoUring::is_open() const
+{
+    return ringFd_ != -1 && eventFd_ != -1;
+}
+
+std::shared_ptr<IoUring::Buffer> IoUring::acquire_buffer()
+{
+    if (!buffers_) {
+        return nullptr;
+    }
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(buffers_->mutex);
+        if (buffers_->free.empty()) {
+            return nullptr;
+        }
+        index = buffers_->free.back();
+        buffers_->free.pop_back();
+    }
+    // 缓冲区由传输协程、在途操作和线程池任务共同持有，最后一个持有者释放时归还缓冲池
+    std::shared_ptr<BufferPool> pool = buffers_;
+    return std::shared_ptr<Buffer>(
+            &pool->buffers[index], [pool](Buffer* buffer) {
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                pool->free.push_back(buffer->index);
+            });
+}
+
+size_t IoUring::buffer_size() const
+{
+    return buffers_ && !buffers_->buffers.empty() ? buffers_->buffers[0].size
+                                                  : 0;
+}
+
+int IoUring::acquire_file_slot()
+{
+    if (freeSlots_.empty()) {
+        return -1;
+    }
+    int slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    return slot;
+}
+
+void IoUring::release_file_slot(int slot)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        freeSlots_.push_back(slot); // 下次 OPENAT2 会替换槽位中的旧文件
+        return;
+    }
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = slot + 1;
+    auto state = std::make_shared<UringOpState>();
+    state->closingSlot = slot;
+    prepare(sqe, state, false);
+    submit_deferred();
+}
+
+io_uring_sqe* IoUring::get_sqe()
+{
+    if (ringFd_ == -1) {
+        return nullptr;
+    }
+    if (sqeTail_ - load_acquire(sqHead_) >= sqEntries_) {
+        submit(); // 提交队列已满，先提交已准备的操作
+        if (sqeTail_ - load_acquire(sqHead_) >= sqEntries_) {
+            return nullptr;
+        }
+    }
+    unsigned index = sqeTail_ & sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    ++sqeTail_;
+    return sqe;
+}
+
+void IoUring::prepare(
+        io_uring_sqe* sqe,
+        const std::shared_ptr<UringOpState>& state,
+        bool link)
+{
+    sqe->user_data = reinterpret_cast<__u64>(state.get());
+    if (link) {
+        sqe->flags |= IOSQE_IO_LINK;
+    }
+    inflight_.emplace(state.get(), state);
+}
+
+UringOp IoUring::openat(int slot,
+                        const ResolvedPath& path,
+                        int flags,
+                        mode_t mode,
+                        bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    state->path = path.root_relative();
+    state->dir = path.root(); // 内核在工作线程中解析路径时根目录 fd 仍有效
+    // 直接打开到固定文件表时内核拒绝 O_CLOEXEC（固定文件不属于进程 fd 表）
+    state->how.flags = static_cast<__u64>(flags & ~O_CLOEXEC);
+    state->how.mode = (flags & O_CREAT) ? mode : 0;
+    state->how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+    sqe->opcode = IORING_OP_OPENAT2;
+    sqe->fd = state->dir->fd;
+    sqe->addr = reinterpret_cast<__u64>(state->path.c_str());
+    sqe->len = sizeof(state->how);
+    sqe->addr2 = reinterpret_cast<__u64>(&state->how);
+    sqe->file_index = slot + 1;
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+UringOp IoUring::statx(const ResolvedPath& path, bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    state->path = path.root_relative();
+    state->dir = path.root();
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = state->dir->fd;
+    sqe->addr = reinterpret_cast<__u64>(state->path.c_str());
+    sqe->len = STATX_BASIC_STATS;
+    sqe->off = reinterpret_cast<__u64>(&state->stx);
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+UringOp IoUring::read_fixed(int slot,
+                            const std::shared_ptr<Buffer>& buffer,
+                            size_t size,
+                            off_t offset,
+                            bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    state->keep = buffer;
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = slot;
+    sqe->addr = reinterpret_cast<__u64>(buffer->data);
+    sqe->len = static_cast<__u32>(std::min(size, buffer->size));
+    sqe->off = static_cast<__u64>(offset);
+    sqe->buf_index = static_cast<__u16>(buffer->index);
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+UringOp IoUring::write_fixed(int slot,
+                             const std::shared_ptr<Buffer>& buffer,
+                             size_t size,
+                             off_t offset,
+                             bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    state->keep = buffer;
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = slot;
+    sqe->addr = reinterpret_cast<__u64>(buffer->data);
+    sqe->len = static_cast<__u32>(std::min(size, buffer->size));
+    sqe->off = static_cast<__u64>(offset);
+    sqe->buf_index = static_cast<__u16>(buffer->index);
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+UringOp IoUring::send(int fd,
+                      const std::shared_ptr<Buffer>& buffer,
+                      size_t size,
+                      bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    state->keep = buffer;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<__u64>(buffer->data);
+    sqe->len = static_cast<__u32>(std::min(size, buffer->size));
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+UringOp IoUring::recv(int fd,
+                      const std::shared_ptr<Buffer>& buffer,
+                      size_t size,
+                      bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    state->keep = buffer;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<__u64>(buffer->data);
+    sqe->len = static_cast<__u32>(std::min(size, buffer->size));
+    sqe->msg_flags = MSG_WAITALL;
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+// FADVISE/SYNC_FILE_RANGE 的长度字段为 32 位，超出时用 0 表示直到文件末尾
+static __u32 range_length(off_t length)
+{
+    return length > static_cast<off_t>(UINT32_MAX) ? 0
+                                                   : static_cast<__u32>(length);
+}
+
+UringOp IoUring::fadvise(int slot,
+                         off_t offset,
+                         off_t length,
+                         int advice,
+                         bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    sqe->opcode = IORING_OP_FADVISE;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = slot;
+    sqe->off = static_cast<__u64>(offset);
+    sqe->len = range_length(length);
+    sqe->fadvise_advice = static_cast<__u32>(advice);
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+UringOp IoUring::sync_file_range(int slot,
+                                 off_t offset,
+                                 off_t length,
+                                 unsigned flags,
+                                 bool link)
+{
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return UringOp();
+    }
+    auto state = std::make_shared<UringOpState>();
+    sqe->opcode = IORING_OP_SYNC_FILE_RANGE;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = slot;
+    sqe->off = static_cast<__u64>(offset);
+    sqe->len = range_length(length);
+    sqe->sync_range_flags = flags;
+    prepare(sqe, state, link);
+    return UringOp(this, state);
+}
+
+void IoUring::cancel(UringOpState* state)
+{
+    if (inflight_.find(state) == inflight_.end()) {
+        return; // 已完成或 io_uring 已关闭
+    }
+    io_uring_sqe* sqe = get_sqe();
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = reinterpret_cast<__u64>(state);
+    sqe->user_data = 0; // 取消请求本身的完成事件被忽略
+    submit_deferred();
+}
+
+void IoUring::submit()
+{
+    unsigned pending = sqeTail_ - submitted_;
+    if (pending == 0 || ringFd_ == -1) {
+        return;
+    }
+    store_release(sqTail_, sqeTail_);
+    int ret = sys_io_uring_enter(ringFd_, pending, 0, 0);
+    if (ret > 0) {
+        submitted_ += static_cast<unsigned>(ret);
+    } else if (ret < 0 && errno != EAGAIN && errno != EBUSY &&
+               errno != EINTR) {
+        ACE_ERROR((LM_ERROR, ACE_TEXT("(%t) io_uring_enter failed: %m\n")));
+    }
+    // EAGAIN/EBUSY：内核暂时无法接收，留待下一轮完成事件处理后再提交
+}
+
+void IoUring::submit_deferred()
+{
+    if (!reaping_) {
+        submit();
+    }
+}
+
+ACE_HANDLE IoUring::get_handle() const
+{
+    return eventFd_;
+}
+
+int IoUring::handle_input(ACE_HANDLE /*fd*/)
+{
+    uint64_t count;
+    while (read(eventFd_, &count, sizeof(count)) > 0) {
+    }
+
+    // 先取出本轮全部完成事件再恢复协程：恢复的协程可能准备新的操作
+    std::vector<std::shared_ptr<UringOpState> > completed;
+    unsigned head = *cqHead_;
+    unsigned tail = load_acquire(cqTail_);
+    while (head != tail) {
+        io_uring_cqe* cqe = &cqes_[head & cqMask_];
+        auto it = inflight_.find(reinterpret_cast<UringOpState*>(cqe->user_data));
+        if (cqe->user_data != 0 && it != inflight_.end()) {
+            it->second->res = cqe->res;
+            it->second->done = true;
+            completed.push_back(std::move(it->second));
+            inflight_.erase(it);
+        }
+        ++head;
+    }
+    store_release(cqHead_, head);
+
+    reaping_ = true;
+    for (auto& state : completed) {
+        if (state->closingSlot >= 0) {
+            freeSlots_.push_back(state->closingSlot);
+        }
+        std::coroutine_handle<> waiter = std::exchange(state->waiter, {});
+        if (waiter) {
+            waiter.resume();
+        }
+    }
+    reaping_ = false;
+
+    // 本轮恢复的所有协程准备的操作一次提交
+    submit();
+    return 0;
+}
+
+int IoUring::handle_close(ACE_HANDLE /*handle*/, ACE_Reactor_Mask /*close_mask*/)
+{
+    return 0; // 生命周期由 WorkerReactorTask 管理
+}
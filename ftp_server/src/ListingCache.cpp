@@ -0,0 +1,255 @@
+#include "ListingCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <functional>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+// 会改变目录列表内容的事件：目录项增删改名、内容或属性变化、目录自身被删除
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                                   IN_DELETE_SELF | IN_ONLYDIR;
+
+ListingCache::~ListingCache()
+{
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_); // 关闭实例时内核移除全部监视
+    }
+}
+
+size_t ListingCache::KeyHash::operator()(const Key& key) const
+{
+    size_t h = std::hash<unsigned long long>()(key.ino);
+    return h ^ (std::hash<unsigned long long>()(key.dev) + 0x9e3779b97f4a7c15ULL +
+                (h << 6) + (h >> 2));
+}
+
+ListingCache& ListingCache::instance()
+{
+    static ListingCache cache;
+    return cache;
+}
+
+int ListingCache::variant(ListFormat format, bool hidden)
+{
+    if (format == ListFormat::MLSD) {
+        return 2;
+    }
+    return hidden ? 1 : 0;
+}
+
+bool ListingCache::configure(
+        size_t budget,
+        size_t maxWatches,
+        size_t maxListing,
+        time_t maxAge)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    watches_.clear();
+    bytes_ = 0;
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+
+    budget_ = budget;
+    maxWatches_ = maxWatches;
+    maxListing_ = std::min(maxListing, budget);
+    maxAge_ = maxAge;
+    if (budget == 0 || maxWatches == 0) {
+        return true;
+    }
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return inotifyFd_ != -1;
+}
+
+void ListingCache::drain()
+{
+    alignas(struct inotify_event) char buf[8192];
+    for (;;) {
+        ssize_t n = read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0) {
+            return; // EAGAIN：队列已空
+        }
+        for (ssize_t pos = 0; pos < n;) {
+            const struct inotify_event* event =
+                    reinterpret_cast<const struct inotify_event*>(buf + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 事件丢失，无法判断哪些目录变化，全部失效
+                for (Directory& dir : lru_) {
+                    invalidate(dir);
+                }
+                continue;
+            }
+            auto found = watches_.find(event->wd);
+            if (found == watches_.end()) {
+                continue; // 已淘汰目录的迟到事件
+            }
+            if (event->mask & IN_IGNORED) {
+                erase(found->second, false); // 目录被删除或所在文件系统被卸载
+            } else {
+                invalidate(*found->second);
+            }
+        }
+    }
+}
+
+void ListingCache::invalidate(Directory& dir)
+{
+    dir.generation = ++nextGeneration_;
+    if (dir.bytes == 0) {
+        return;
+    }
+    for (auto& listing : dir.listings) {
+        listing.reset();
+    }
+    bytes_ -= dir.bytes;
+    dir.bytes = 0;
+    ++invalidations_;
+}
+
+void ListingCache::erase(DirectoryIt it, bool removeWatch)
+{
+    if (removeWatch) {
+        inotify_rm_watch(inotifyFd_, it->wd);
+    }
+    bytes_ -= it->bytes;
+    watches_.erase(it->wd);
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+std::shared_ptr<const std::string> ListingCache::lookup(
+        const ResolvedPath& path,
+        ListFormat format,
+        bool hidden)
+{
+    struct statx stx;
+    if (path.stat(stx) != 0 ||
+        !S_ISDIR(stx.stx_mode)) {
+        return nullptr;
+    }
+    Key key{makedev(stx.stx_dev_major, stx.stx_dev_minor), stx.stx_ino};
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    drain();
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    DirectoryIt it = found->second;
+    if (maxAge_ > 0 && it->bytes > 0 && time(nullptr) - it->filled >= maxAge_) {
+        invalidate(*it);
+    }
+    std::shared_ptr<const std::string> listing =
+            it->listings[variant(format, hidden)];
+    if (!listing) {
+        ++misses_;
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it);
+    ++hits_;
+    return listing;
+}
+
+ListingCache::Ticket ListingCache::watch(int dirfd)
+{
+    Ticket ticket;
+    struct stat st;
+    if (fstat(dirfd, &st) == -1) {
+        return ticket;
+    }
+    Key key{st.st_dev, st.st_ino};
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    drain();
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        while (!lru_.empty() && lru_.size() >= maxWatches_) {
+            erase(std::prev(lru_.end()), true);
+            ++evictions_;
+        }
+        // 通过 /proc 监视已打开的目录本身，避免路径在打开后被替换
+        char procPath[64];
+        snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", dirfd);
+        int wd = inotify_add_watch(inotifyFd_, procPath, WATCH_MASK);
+        if (wd == -1) {
+            return ticket; // 如超出 fs.inotify.max_user_watches
+        }
+        auto existing = watches_.find(wd);
+        if (existing != watches_.end()) {
+            // 同一 inode 已以其他键登记（不应发生），以新键为准
+            erase(existing->second, false);
+        }
+        lru_.push_front(Directory{key, wd, ++nextGeneration_});
+        index_[key] = lru_.begin();
+        watches_[wd] = lru_.begin();
+        found = index_.find(key);
+    }
+    ticket.dev = key.dev;
+    ticket.ino = key.ino;
+    ticket.generation = found->second->generation;
+    return ticket;
+}
+
+void ListingCache::insert(
+        const Ticket& ticket,
+        ListFormat format,
+        bool hidden,
+        std::shared_ptr<const std::string> listing)
+{
+    if (!ticket.valid() || listing->size() > maxListing_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    drain();
+    auto found = index_.find(Key{ticket.dev, ticket.ino});
+    if (found == index_.end() || found->second->generation != ticket.generation) {
+        return; // 读取期间目录已变化或已被淘汰
+    }
+    DirectoryIt it = found->second;
+    lru_.splice(lru_.begin(), lru_, it);
+
+    std::shared_ptr<const std::string>& slot =
+            it->listings[variant(format, hidden)];
+    if (slot) {
+        it->bytes -= slot->size();
+        bytes_ -= slot->size();
+        slot.reset();
+    }
+    while (bytes_ + listing->size() > budget_ && std::prev(lru_.end()) != it) {
+        erase(std::prev(lru_.end()), true);
+        ++evictions_;
+    }
+    if (bytes_ + listing->size() > budget_) {
+        return; // 本目录的其他格式已占满预算
+    }
+    if (it->bytes == 0) {
+        it->filled = time(nullptr);
+    }
+    it->bytes += listing->size();
+    bytes_ += listing->size();
+    slot = std::move(listing);
+}
+
+ListingCache::Stats ListingCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.invalidations = invalidations_;
+    stats.evictions = evictions_;
+    stats.watches = lru_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
@@ -0,0 +1,190 @@
+#include "LocalFileSystem.h"
+#include "DirectoryListing.h"
+#include <ace/Log_Msg.h>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 内核不支持 openat2 时置位，之后直接使用 openat
+static std::atomic<bool> noOpenat2(false);
+
+// 受限的根目录因缺少 openat2 而拒绝访问时置位，错误只记录一次
+static std::atomic<bool> confinementReported(false);
+
+// openat2：失败返回 -errno
+static int open_how_at(
+        int dirfd,
+        const char* path,
+        int flags,
+        mode_t mode,
+        uint64_t resolve)
+{
+    struct open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = static_cast<uint64_t>(flags) | O_CLOEXEC;
+    // openat2 拒绝未创建文件时的非零 mode
+    how.mode = (flags & (O_CREAT | O_TMPFILE)) ? mode : 0;
+    how.resolve = resolve;
+    long fd = syscall(SYS_openat2, dirfd, path, &how, sizeof(how));
+    return fd < 0 ? -errno : static_cast<int>(fd);
+}
+
+int LocalFileSystem::open(const std::string& root)
+{
+    char real[PATH_MAX];
+    if (realpath(root.c_str(), real) == nullptr) {
+        return -errno;
+    }
+    int fd = ::open(real, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        return -errno;
+    }
+    root_ = std::make_shared<const DirectoryHandle>(fd, "/");
+    confined_ = std::string(real) != "/";
+    return 0;
+}
+
+std::shared_ptr<const DirectoryHandle> LocalFileSystem::root() const
+{
+    return root_;
+}
+
+int LocalFileSystem::open(const ResolvedPath& path, int flags, mode_t mode)
+{
+    if (!noOpenat2.load(std::memory_order_relaxed)) {
+        // 工作目录之下的路径从工作目录解析，符号链接离开工作目录时（EXDEV）
+        // 再从根目录解析
+        const std::string& fromCwd = path.cwd_relative();
+        if (!fromCwd.empty()) {
+            int fd = open_how_at(path.cwd_fd(), fromCwd.c_str(), flags, mode,
+                                 RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS);
+            if (fd != -EXDEV && fd != -ENOSYS) {
+                return fd;
+            }
+        }
+        int fd = open_how_at(path.root_fd(), path.root_relative().c_str(),
+                             flags, mode,
+                             RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS);
+        if (fd != -ENOSYS) {
+            return fd;
+        }
+        noOpenat2.store(true, std::memory_order_relaxed);
+    }
+
+    // openat 无法阻止符号链接越过根目录，受限时拒绝访问而不是退回
+    if (confined_) {
+        if (!confinementReported.exchange(true, std::memory_order_relaxed)) {
+            ACE_ERROR((LM_ERROR,
+                    ACE_TEXT("(%t) openat2 is not supported by the kernel, ")
+                    ACE_TEXT("refusing file access under a confined root\n")));
+        }
+        return -EPERM;
+    }
+
+    int fd = openat(path.root_fd(), path.root_relative().c_str(),
+                    flags | O_CLOEXEC, mode);
+    return fd == -1 ? -errno : fd;
+}
+
+int LocalFileSystem::stat(
+        const ResolvedPath& path,
+        struct statx& stx,
+        bool follow)
+{
+    int fd = open(path, O_PATH | (follow ? 0 : O_NOFOLLOW), 0);
+    if (fd < 0) {
+        return fd;
+    }
+    int rc = stat_entry(fd, "", stx);
+    close(fd);
+    return rc;
+}
+
+int LocalFileSystem::mkdir(const ResolvedPath& path, mode_t mode)
+{
+    if (path.is_root()) {
+        return -EEXIST;
+    }
+    int dirfd = open(path.parent(), O_PATH | O_DIRECTORY, 0);
+    if (dirfd < 0) {
+        return dirfd;
+    }
+    int rc = mkdirat(dirfd, path.name().c_str(), mode) == -1 ? -errno : 0;
+    close(dirfd);
+    return rc;
+}
+
+int LocalFileSystem::rmdir(const ResolvedPath& path)
+{
+    return path.is_root() ? -EBUSY : remove(path, AT_REMOVEDIR);
+}
+
+int LocalFileSystem::unlink(const ResolvedPath& path)
+{
+    return path.is_root() ? -EISDIR : remove(path, 0);
+}
+
+int LocalFileSystem::remove(const ResolvedPath& path, int flags)
+{
+    int dirfd = open(path.parent(), O_PATH | O_DIRECTORY, 0);
+    if (dirfd < 0) {
+        return dirfd;
+    }
+    int rc = unlinkat(dirfd, path.name().c_str(), flags) == -1 ? -errno : 0;
+    close(dirfd);
+    return rc;
+}
+
+int LocalFileSystem::rename(const ResolvedPath& from, const ResolvedPath& to)
+{
+    if (from.is_root() || to.is_root()) {
+        return -EBUSY;
+    }
+    int fromDir = open(from.parent(), O_PATH | O_DIRECTORY, 0);
+    if (fromDir < 0) {
+        return fromDir;
+    }
+    int toDir = open(to.parent(), O_PATH | O_DIRECTORY, 0);
+    if (toDir < 0) {
+        close(fromDir);
+        return toDir;
+    }
+    int rc = renameat(fromDir, from.name().c_str(), toDir, to.name().c_str()) == -1
+                     ? -errno
+                     : 0;
+    close(toDir);
+    close(fromDir);
+    return rc;
+}
+
+int LocalFileSystem::open_directory(
+        const ResolvedPath& path,
+        std::shared_ptr<const DirectoryHandle>& handle)
+{
+    int fd = open(path, O_PATH | O_DIRECTORY, 0);
+    if (fd < 0) {
+        return fd;
+    }
+    // O_PATH 不检查搜索权限，与 chdir 一致地要求可进入
+    if (faccessat(fd, ".", X_OK, 0) == -1) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+    handle = std::make_shared<const DirectoryHandle>(fd, path.path());
+    return 0;
+}
+
+int LocalFileSystem::read_directory(
+        const ResolvedPath& /*path*/,
+        off_t /*cursor*/,
+        std::vector<DirectoryEntry>& /*entries*/)
+{
+    return -EOPNOTSUPP; // 本地目录由 DirectoryReader 以 getdents64 读取
+}
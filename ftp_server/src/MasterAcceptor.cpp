@@ -1,7 +1,7 @@
 #include "MasterAcceptor.h"
-#include "ClientHandler.h"
 #include <ace/Log_Msg.h>
 #include <map>
+#include <string>
 
 std::map<std::string, std::string> ps_map{};
 MasterAcceptor::MasterAcceptor(
@@ -45,13 +45,10 @@ int MasterAcceptor::handle_input(ACE_HANDLE /*fd*/)
     WorkerReactorTask* worker_task = worker_tasks_[next_worker_];
     next_worker_ = (next_worker_ + 1) % num_workers_; // 轮询选择工作线程
 
-    // 创建一个新的 ClientHandler 处理客户端请求
-    ClientHandler* handler = new ClientHandler(
-            clientStream, worker_task->get_reactor(), threadPool_);
-
-    // 打开 ClientHandler，如果失败则关闭连接
-    if (handler->open() == -1) {
-        handler->handle_close(ACE_INVALID_HANDLE, 0);
+    // 交给工作线程创建 ClientHandler 处理客户端请求，失败则关闭连接
+    if (worker_task->assign(clientStream, threadPool_) == -1) {
+        ACE_ERROR((LM_ERROR, "Failed to hand client to worker reactor\n"));
+        clientStream.close();
     }
 
     return 0;
@@ -0,0 +1,342 @@
+#include "MemoryFileSystem.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 当前时间，用于目录的修改时间
+static struct statx_timestamp now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    struct statx_timestamp stamp = {};
+    stamp.tv_sec = ts.tv_sec;
+    stamp.tv_nsec = static_cast<__u32>(ts.tv_nsec);
+    return stamp;
+}
+
+MemoryFileSystem::Node::~Node()
+{
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+MemoryFileSystem::MemoryFileSystem()
+{
+    root_ = make_node(S_IFDIR | 0755);
+    handle_ = std::make_shared<const DirectoryHandle>(-1, "/");
+}
+
+MemoryFileSystem::~MemoryFileSystem() = default;
+
+std::shared_ptr<const DirectoryHandle> MemoryFileSystem::root() const
+{
+    return handle_;
+}
+
+MemoryFileSystem::NodePtr MemoryFileSystem::make_node(mode_t mode)
+{
+    NodePtr node = std::make_shared<Node>();
+    node->mode = mode;
+    node->uid = geteuid();
+    node->gid = getegid();
+    node->ino = nextIno_++;
+    node->mtime = now();
+    return node;
+}
+
+int MemoryFileSystem::lookup(const std::string& path, NodePtr& node) const
+{
+    node = root_;
+    size_t pos = 1;
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (!S_ISDIR(node->mode)) {
+            return -ENOTDIR;
+        }
+        auto found = node->children.find(path.substr(pos, end - pos));
+        if (found == node->children.end()) {
+            return -ENOENT;
+        }
+        node = found->second.node;
+        pos = end + 1;
+    }
+    return 0;
+}
+
+int MemoryFileSystem::lookup_parent(
+        const ResolvedPath& path,
+        NodePtr& parent,
+        std::string& name) const
+{
+    int rc = lookup(path.parent().path(), parent);
+    if (rc != 0) {
+        return rc;
+    }
+    if (!S_ISDIR(parent->mode)) {
+        return -ENOTDIR;
+    }
+    name = path.name();
+    return 0;
+}
+
+int MemoryFileSystem::fill_statx(const Node& node, struct statx& stx) const
+{
+    memset(&stx, 0, sizeof(stx));
+    if (node.fd != -1) {
+        // 大小与时间来自 memfd，设备号/inode 号可作为小文件缓存的键
+        if (statx(node.fd, "", AT_EMPTY_PATH, STATX_BASIC_STATS, &stx) == -1) {
+            return -errno;
+        }
+        stx.stx_nlink = 1;
+    } else {
+        size_t subdirs = 0;
+        for (const auto& child : node.children) {
+            subdirs += S_ISDIR(child.second.node->mode) ? 1 : 0;
+        }
+        stx.stx_mask = STATX_BASIC_STATS;
+        stx.stx_ino = node.ino;
+        stx.stx_nlink = static_cast<__u32>(2 + subdirs);
+        stx.stx_size = 4096;
+        stx.stx_blksize = 4096;
+        stx.stx_atime = stx.stx_mtime = stx.stx_ctime = node.mtime;
+    }
+    stx.stx_mode = static_cast<__u16>(node.mode);
+    stx.stx_uid = node.uid;
+    stx.stx_gid = node.gid;
+    return 0;
+}
+
+void MemoryFileSystem::add_child(Node& dir, const std::string& name, NodePtr node)
+{
+    off_t position = dir.nextPosition++;
+    dir.children[name] = Child{std::move(node), position};
+    dir.positions[position] = name;
+    dir.mtime = now();
+}
+
+void MemoryFileSystem::remove_child(Node& dir, const std::string& name)
+{
+    auto found = dir.children.find(name);
+    dir.positions.erase(found->second.position);
+    dir.children.erase(found);
+    dir.mtime = now();
+}
+
+int MemoryFileSystem::open(const ResolvedPath& path, int flags, mode_t mode)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr node;
+    int rc = lookup(path.path(), node);
+    if (rc == -ENOENT && (flags & O_CREAT) && !path.is_root()) {
+        NodePtr parent;
+        std::string name;
+        rc = lookup_parent(path, parent, name);
+        if (rc != 0) {
+            return rc;
+        }
+        node = make_node(S_IFREG | (mode & 07777));
+        node->fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+        if (node->fd == -1) {
+            return -errno;
+        }
+        add_child(*parent, name, node);
+    } else if (rc != 0) {
+        return rc;
+    } else if ((flags & O_CREAT) && (flags & O_EXCL)) {
+        return -EEXIST;
+    }
+    if (S_ISDIR(node->mode)) {
+        return -EISDIR;
+    }
+    if (flags & O_DIRECTORY) {
+        return -ENOTDIR;
+    }
+
+    // 经 /proc 重新打开 memfd，得到独立的文件描述；O_TRUNC 在此生效
+    char procPath[64];
+    snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", node->fd);
+    int fd = ::open(procPath,
+                    (flags & ~(O_CREAT | O_EXCL | O_NOFOLLOW)) | O_CLOEXEC);
+    return fd == -1 ? -errno : fd;
+}
+
+int MemoryFileSystem::stat(
+        const ResolvedPath& path,
+        struct statx& stx,
+        bool /*follow*/)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr node;
+    int rc = lookup(path.path(), node);
+    return rc != 0 ? rc : fill_statx(*node, stx);
+}
+
+int MemoryFileSystem::mkdir(const ResolvedPath& path, mode_t mode)
+{
+    if (path.is_root()) {
+        return -EEXIST;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr parent;
+    std::string name;
+    int rc = lookup_parent(path, parent, name);
+    if (rc != 0) {
+        return rc;
+    }
+    if (parent->children.count(name) != 0) {
+        return -EEXIST;
+    }
+    add_child(*parent, name, make_node(S_IFDIR | (mode & 07777)));
+    return 0;
+}
+
+int MemoryFileSystem::rmdir(const ResolvedPath& path)
+{
+    if (path.is_root()) {
+        return -EBUSY;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr parent;
+    std::string name;
+    int rc = lookup_parent(path, parent, name);
+    if (rc != 0) {
+        return rc;
+    }
+    auto found = parent->children.find(name);
+    if (found == parent->children.end()) {
+        return -ENOENT;
+    }
+    const Node& node = *found->second.node;
+    if (!S_ISDIR(node.mode)) {
+        return -ENOTDIR;
+    }
+    if (!node.children.empty()) {
+        return -ENOTEMPTY;
+    }
+    remove_child(*parent, name);
+    return 0;
+}
+
+int MemoryFileSystem::unlink(const ResolvedPath& path)
+{
+    if (path.is_root()) {
+        return -EISDIR;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr parent;
+    std::string name;
+    int rc = lookup_parent(path, parent, name);
+    if (rc != 0) {
+        return rc;
+    }
+    auto found = parent->children.find(name);
+    if (found == parent->children.end()) {
+        return -ENOENT;
+    }
+    if (S_ISDIR(found->second.node->mode)) {
+        return -EISDIR;
+    }
+    remove_child(*parent, name); // 已打开的 fd 仍引用 memfd 的内容
+    return 0;
+}
+
+int MemoryFileSystem::rename(const ResolvedPath& from, const ResolvedPath& to)
+{
+    if (from.is_root() || to.is_root()) {
+        return -EBUSY;
+    }
+    // 目录不能移动到自身之下
+    if (to.path().compare(0, from.path().size() + 1, from.path() + "/") == 0) {
+        return -EINVAL;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr fromParent;
+    NodePtr toParent;
+    std::string fromName;
+    std::string toName;
+    int rc = lookup_parent(from, fromParent, fromName);
+    if (rc == 0) {
+        rc = lookup_parent(to, toParent, toName);
+    }
+    if (rc != 0) {
+        return rc;
+    }
+    auto found = fromParent->children.find(fromName);
+    if (found == fromParent->children.end()) {
+        return -ENOENT;
+    }
+    NodePtr node = found->second.node;
+    auto existing = toParent->children.find(toName);
+    if (existing != toParent->children.end()) {
+        const Node& target = *existing->second.node;
+        if (&target == node.get()) {
+            return 0;
+        }
+        if (S_ISDIR(target.mode) && !S_ISDIR(node->mode)) {
+            return -EISDIR;
+        }
+        if (!S_ISDIR(target.mode) && S_ISDIR(node->mode)) {
+            return -ENOTDIR;
+        }
+        if (!target.children.empty()) {
+            return -ENOTEMPTY;
+        }
+        remove_child(*toParent, toName);
+    }
+    remove_child(*fromParent, fromName);
+    add_child(*toParent, toName, node);
+    return 0;
+}
+
+int MemoryFileSystem::open_directory(
+        const ResolvedPath& path,
+        std::shared_ptr<const DirectoryHandle>& handle)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr node;
+    int rc = lookup(path.path(), node);
+    if (rc != 0) {
+        return rc;
+    }
+    if (!S_ISDIR(node->mode)) {
+        return -ENOTDIR;
+    }
+    handle = std::make_shared<const DirectoryHandle>(-1, path.path());
+    return 0;
+}
+
+int MemoryFileSystem::read_directory(
+        const ResolvedPath& path,
+        off_t cursor,
+        std::vector<DirectoryEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePtr node;
+    int rc = lookup(path.path(), node);
+    if (rc != 0) {
+        return rc;
+    }
+    if (!S_ISDIR(node->mode)) {
+        return -ENOTDIR;
+    }
+    entries.clear();
+    entries.reserve(node->children.size());
+    for (auto it = node->positions.upper_bound(cursor);
+         it != node->positions.end(); ++it) {
+        DirectoryEntry entry;
+        entry.name = it->second;
+        entry.position = it->first;
+        if (fill_statx(*node->children[it->second].node, entry.stx) == 0) {
+            entries.push_back(std::move(entry));
+        }
+    }
+    return 0;
+}
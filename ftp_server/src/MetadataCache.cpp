@@ -0,0 +1,358 @@
+#include "MetadataCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <functional>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 会改变目录下条目元数据的事件：目录项增删改名、写入、属性变化、目录自身被删除或改名
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                                   IN_CLOSE_WRITE | IN_DELETE_SELF |
+                                   IN_MOVE_SELF | IN_ONLYDIR;
+
+// 改变目录自身内容（从而改变其 mtime）的事件
+static const uint32_t ENTRY_CHANGE_MASK =
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+// 虚拟路径的父目录，根目录的父目录为其自身
+static std::string parent_of(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    return slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+}
+
+// 目录下子项的路径前缀
+static std::string child_prefix(const std::string& dir)
+{
+    return dir == "/" ? dir : dir + "/";
+}
+
+MetadataCache::~MetadataCache()
+{
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_); // 关闭实例时内核移除全部监视
+    }
+}
+
+MetadataCache& MetadataCache::instance()
+{
+    static MetadataCache cache;
+    return cache;
+}
+
+bool MetadataCache::configure(
+        size_t maxEntries,
+        size_t maxWatches,
+        time_t maxAge,
+        size_t shards)
+{
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    watchLru_.clear();
+    watchByPath_.clear();
+    watchByWd_.clear();
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+
+    shards = std::max<size_t>(shards, 1);
+    shards_.clear();
+    for (size_t i = 0; i < shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+    shardCapacity_ = std::max<size_t>(maxEntries / shards, 1);
+    maxWatches_ = maxWatches;
+    maxAge_ = maxAge;
+    if (maxEntries == 0 || maxWatches == 0) {
+        return true;
+    }
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return inotifyFd_ != -1;
+}
+
+MetadataCache::Shard& MetadataCache::shard_for(const std::string& path)
+{
+    return *shards_[std::hash<std::string>()(path) % shards_.size()];
+}
+
+int MetadataCache::stat(const ResolvedPath& path, struct statx& stx)
+{
+    if (!enabled() || path.is_root()) {
+        return path.stat(stx);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(watchMutex_);
+        drain();
+    }
+    Shard& shard = shard_for(path.path());
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(path.path());
+        if (found != shard.index.end()) {
+            EntryIt it = found->second;
+            if (maxAge_ == 0 || time(nullptr) - it->filled < maxAge_) {
+                stx = it->stx;
+                shard.lru.splice(shard.lru.begin(), shard.lru, it);
+                ++hits_;
+                return 0;
+            }
+            shard.lru.erase(it);
+            shard.index.erase(found);
+            ++invalidations_;
+        }
+    }
+    ++misses_;
+
+    // 先取得父目录的代数再 stat，stat 期间的修改使本次结果不被插入
+    uint64_t generation = watch(path);
+    int rc = path.stat(stx, false);
+    if (rc != 0) {
+        return rc;
+    }
+    if (S_ISLNK(stx.stx_mode)) {
+        return path.stat(stx);
+    }
+    if (generation != 0) {
+        insert(path, stx, generation);
+    }
+    return 0;
+}
+
+uint64_t MetadataCache::watch(const ResolvedPath& path)
+{
+    ResolvedPath parent = path.parent();
+    {
+        std::lock_guard<std::mutex> lock(watchMutex_);
+        drain();
+        auto found = watchByPath_.find(parent.path());
+        if (found != watchByPath_.end()) {
+            watchLru_.splice(watchLru_.begin(), watchLru_, found->second);
+            return found->second->generation;
+        }
+    }
+
+    // 在锁外打开父目录，慢速存储不阻塞其他会话的查找
+    int dirfd = -1;
+    if (path.native()) {
+        dirfd = parent.open(O_PATH | O_DIRECTORY);
+        if (dirfd < 0) {
+            return 0;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    drain();
+    auto found = watchByPath_.find(parent.path());
+    if (found == watchByPath_.end()) {
+        while (!watchLru_.empty() && watchLru_.size() >= maxWatches_) {
+            erase_watch(std::prev(watchLru_.end()), true);
+        }
+        int wd = -1;
+        if (dirfd != -1) {
+            // 通过 /proc 监视已打开的目录本身，避免路径在打开后被替换
+            char procPath[64];
+            snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", dirfd);
+            wd = inotify_add_watch(inotifyFd_, procPath, WATCH_MASK);
+            if (wd == -1 || watchByWd_.count(wd) != 0) {
+                // 超出 fs.inotify.max_user_watches，或同一目录已以其他路径
+                // （符号链接）监视，事件无法对应到本路径，不缓存
+                close(dirfd);
+                return 0;
+            }
+        }
+        watchLru_.push_front(Watch{parent.path(), wd, ++nextGeneration_});
+        watchByPath_[parent.path()] = watchLru_.begin();
+        if (wd != -1) {
+            watchByWd_[wd] = watchLru_.begin();
+        }
+        found = watchByPath_.find(parent.path());
+    }
+    if (dirfd != -1) {
+        close(dirfd);
+    }
+    return found->second->generation;
+}
+
+void MetadataCache::insert(
+        const ResolvedPath& path,
+        const struct statx& stx,
+        uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    drain();
+    auto found = watchByPath_.find(path.parent().path());
+    if (found == watchByPath_.end() || found->second->generation != generation) {
+        return; // stat 期间父目录已变化或监视已被淘汰
+    }
+
+    Shard& shard = shard_for(path.path());
+    std::lock_guard<std::mutex> shardLock(shard.mutex);
+    auto existing = shard.index.find(path.path());
+    if (existing != shard.index.end()) {
+        shard.lru.erase(existing->second);
+        shard.index.erase(existing);
+    }
+    while (shard.lru.size() >= shardCapacity_) {
+        shard.index.erase(shard.lru.back().path);
+        shard.lru.pop_back();
+        ++evictions_;
+    }
+    shard.lru.push_front(Entry{path.path(), stx, time(nullptr)});
+    shard.index[path.path()] = shard.lru.begin();
+}
+
+void MetadataCache::invalidate(const ResolvedPath& path)
+{
+    if (!enabled()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    invalidate_path(path.path());
+    invalidate_path(path.parent().path());
+}
+
+void MetadataCache::invalidate_tree(const ResolvedPath& path)
+{
+    if (!enabled()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    invalidate_path(path.path());
+    invalidate_path(path.parent().path());
+    invalidations_ += invalidate_children(path.path(), true);
+}
+
+void MetadataCache::drain()
+{
+    alignas(struct inotify_event) char buf[8192];
+    for (;;) {
+        ssize_t n = read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0) {
+            return; // EAGAIN：队列已空
+        }
+        for (ssize_t pos = 0; pos < n;) {
+            const struct inotify_event* event =
+                    reinterpret_cast<const struct inotify_event*>(buf + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 事件丢失，无法判断哪些条目变化，全部失效
+                for (Watch& watch : watchLru_) {
+                    watch.generation = ++nextGeneration_;
+                }
+                invalidations_ += invalidate_children("/", true);
+                invalidate_path("/");
+                continue;
+            }
+            auto found = watchByWd_.find(event->wd);
+            if (found == watchByWd_.end()) {
+                continue; // 已淘汰目录的迟到事件
+            }
+            WatchIt it = found->second;
+            if (event->mask & IN_IGNORED) {
+                erase_watch(it, false); // 目录被删除或所在文件系统被卸载
+                continue;
+            }
+            if (event->len == 0 || event->name[0] == '\0') {
+                // 目录自身的变化；被删除或改名后其下的路径都不再有效
+                invalidate_path(it->path);
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                    invalidations_ += invalidate_children(it->path, true);
+                }
+                continue;
+            }
+            std::string child = child_prefix(it->path) + event->name;
+            invalidate_path(child);
+            if (event->mask & ENTRY_CHANGE_MASK) {
+                invalidate_path(it->path); // 目录的 mtime 随目录项变化
+                if (event->mask & IN_ISDIR) {
+                    // 子目录被删除或改名
+                    invalidations_ += invalidate_children(child, true);
+                }
+            }
+        }
+    }
+}
+
+void MetadataCache::invalidate_path(const std::string& path)
+{
+    auto watch = watchByPath_.find(parent_of(path));
+    if (watch != watchByPath_.end()) {
+        watch->second->generation = ++nextGeneration_;
+    }
+    Shard& shard = shard_for(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(path);
+    if (found != shard.index.end()) {
+        shard.lru.erase(found->second);
+        shard.index.erase(found);
+        ++invalidations_;
+    }
+}
+
+size_t MetadataCache::invalidate_children(
+        const std::string& dir,
+        bool recursive)
+{
+    size_t removed = 0;
+    std::string prefix = child_prefix(dir);
+    for (auto& watch : watchLru_) {
+        if (watch.path == dir ||
+            (recursive && watch.path.compare(0, prefix.size(), prefix) == 0)) {
+            watch.generation = ++nextGeneration_;
+        }
+    }
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        for (auto it = shard->lru.begin(); it != shard->lru.end();) {
+            const std::string& path = it->path;
+            bool under = path.size() > prefix.size() &&
+                         path.compare(0, prefix.size(), prefix) == 0 &&
+                         (recursive ||
+                          path.find('/', prefix.size()) == std::string::npos);
+            if (under) {
+                shard->index.erase(path);
+                it = shard->lru.erase(it);
+                ++removed;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return removed;
+}
+
+void MetadataCache::erase_watch(WatchIt it, bool removeWatch)
+{
+    if (it->wd != -1) {
+        if (removeWatch) {
+            inotify_rm_watch(inotifyFd_, it->wd);
+        }
+        watchByWd_.erase(it->wd);
+    }
+    // 失去监视后无法得知外部修改，目录下的条目一并丢弃
+    std::string path = it->path;
+    watchByPath_.erase(path);
+    watchLru_.erase(it);
+    evictions_ += invalidate_children(path, false);
+}
+
+MetadataCache::Stats MetadataCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.invalidations = invalidations_.load();
+    stats.evictions = evictions_.load();
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    stats.watches = watchLru_.size();
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> shardLock(shard->mutex);
+        stats.entries += shard->lru.size();
+    }
+    return stats;
+}
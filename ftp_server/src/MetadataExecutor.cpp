@@ -0,0 +1,39 @@
+#include "MetadataExecutor.h"
+
+// 未配置时的默认参数
+static const int DEFAULT_MIN_THREADS = 2;
+static const int DEFAULT_MAX_THREADS = 8;
+static const size_t DEFAULT_MAX_QUEUE = 1024;
+
+MetadataExecutor& MetadataExecutor::instance()
+{
+    static MetadataExecutor executor;
+    return executor;
+}
+
+void MetadataExecutor::configure(int minThreads, int maxThreads, size_t maxQueue)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_.close();
+    pool_.set_max_queue_size(maxQueue);
+    pool_.open(minThreads, maxThreads);
+    opened_ = true;
+}
+
+ThreadPool& MetadataExecutor::pool()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!opened_) {
+        pool_.set_max_queue_size(DEFAULT_MAX_QUEUE);
+        pool_.open(DEFAULT_MIN_THREADS, DEFAULT_MAX_THREADS);
+        opened_ = true;
+    }
+    return pool_;
+}
+
+void MetadataExecutor::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_.close();
+    opened_ = true;
+}
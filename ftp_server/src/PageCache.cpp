@@ -0,0 +1,192 @@
+#include "PageCache.h"
+#include <fcntl.h>
+
+// O_DIRECT 要求的偏移、长度对齐（传输缓冲区本身按页分配）
+static const off_t DIRECT_ALIGN = 4096;
+
+// 设置或清除文件的 O_DIRECT 标志
+static bool set_direct(int fd, bool enable)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1) {
+        return false;
+    }
+    flags = enable ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+//————————————————————PageCachePolicy————————————————————————————
+
+PageCachePolicy::PageCachePolicy(Mode mode, off_t threshold, off_t window)
+    : mode_(mode), threshold_(threshold), window_(window)
+{
+}
+
+PageCachePolicy& PageCachePolicy::instance()
+{
+    static PageCachePolicy policy;
+    return policy;
+}
+
+PageCachePolicy::Mode PageCachePolicy::parse_mode(
+        const std::string& name,
+        Mode def)
+{
+    if (name == "none") {
+        return NONE;
+    }
+    if (name == "fadvise") {
+        return FADVISE;
+    }
+    if (name == "direct") {
+        return DIRECT;
+    }
+    return def;
+}
+
+void PageCachePolicy::configure(Mode mode, off_t threshold, off_t window)
+{
+    mode_ = mode;
+    threshold_ = threshold;
+    window_ = window;
+}
+
+//————————————————————CacheWindow————————————————————————————
+
+CacheWindow::CacheWindow(const PageCachePolicy& policy)
+    : mode_(policy.window() > 0 ? policy.mode() : PageCachePolicy::NONE),
+      threshold_(policy.threshold()),
+      window_(policy.window())
+{
+}
+
+bool CacheWindow::engage(off_t size)
+{
+    active_ = mode_ != PageCachePolicy::NONE && size >= threshold_;
+    return active_;
+}
+
+void CacheWindow::fall_back_to_fadvise(int fd)
+{
+    if (fd != -1 && directSet_ && set_direct(fd, false)) {
+        directSet_ = false;
+    }
+    if (mode_ == PageCachePolicy::DIRECT) {
+        mode_ = PageCachePolicy::FADVISE;
+    }
+}
+
+CacheRange CacheWindow::advance_read(off_t end)
+{
+    CacheRange range;
+    // O_DIRECT 读取不经过页缓存，无需丢弃
+    if (!active_ || direct() || end - dropped_ < window_) {
+        return range;
+    }
+    range.offset = dropped_;
+    range.length = end - dropped_;
+    dropped_ = end;
+    return range;
+}
+
+CacheWindow::WriteBehind CacheWindow::advance_write(off_t end)
+{
+    WriteBehind action;
+    if (!active_) {
+        // 上传大小事先未知，写入量达到阈值后才启用
+        if (mode_ == PageCachePolicy::NONE || end < threshold_) {
+            return action;
+        }
+        active_ = true;
+    }
+    if (end - flushed_ < window_) {
+        return action;
+    }
+
+    // 启动本窗口的回写；上一窗口等待落盘后丢弃，脏页总量不超过两个窗口
+    action.start.offset = flushed_;
+    action.start.length = end - flushed_;
+    action.drop.offset = synced_;
+    action.drop.length = flushed_ - synced_;
+    synced_ = flushed_;
+    flushed_ = end;
+    return action;
+}
+
+CacheRange CacheWindow::finish_write(off_t end)
+{
+    CacheRange range;
+    if (!active_ || end <= synced_) {
+        return range;
+    }
+    range.offset = synced_;
+    range.length = end - synced_;
+    synced_ = flushed_ = end;
+    return range;
+}
+
+bool CacheWindow::apply_open(int fd)
+{
+    if (!active_) {
+        return false;
+    }
+    if (mode_ == PageCachePolicy::DIRECT) {
+        directSet_ = set_direct(fd, true);
+        if (!directSet_) {
+            fall_back_to_fadvise(); // 如 tmpfs 不支持 O_DIRECT
+        }
+    }
+    if (mode_ == PageCachePolicy::FADVISE) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    return direct();
+}
+
+void CacheWindow::apply_before_write(int fd, off_t offset, size_t size)
+{
+    if (!direct()) {
+        return;
+    }
+    bool aligned = offset % DIRECT_ALIGN == 0 &&
+                   static_cast<off_t>(size) % DIRECT_ALIGN == 0;
+    if (aligned != directSet_) {
+        if (set_direct(fd, aligned)) {
+            directSet_ = aligned;
+        } else if (aligned) {
+            fall_back_to_fadvise();
+        }
+    }
+}
+
+void CacheWindow::apply_drop(int fd, const CacheRange& range)
+{
+    if (!range.empty()) {
+        posix_fadvise(fd, range.offset, range.length, POSIX_FADV_DONTNEED);
+    }
+}
+
+void CacheWindow::apply_write_behind(int fd, const WriteBehind& action)
+{
+    if (!action.start.empty()) {
+        sync_file_range(
+                fd, action.start.offset, action.start.length,
+                SYNC_FILE_RANGE_WRITE);
+    }
+    if (!action.drop.empty()) {
+        sync_file_range(
+                fd, action.drop.offset, action.drop.length,
+                SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                        SYNC_FILE_RANGE_WAIT_AFTER);
+        apply_drop(fd, action.drop);
+    }
+}
+
+void CacheWindow::apply_finish(int fd, const CacheRange& range)
+{
+    if (!range.empty()) {
+        // 不等待落盘：回写中的页不会被丢弃，其余页立即释放
+        sync_file_range(
+                fd, range.offset, range.length, SYNC_FILE_RANGE_WRITE);
+        apply_drop(fd, range);
+    }
+}
@@ -0,0 +1,177 @@
+#include "PathResolver.h"
+#include <unistd.h>
+#include <vector>
+
+// 词法规范化：base 为虚拟绝对路径，path 为绝对路径时忽略 base；".." 不越过根目录
+static std::string normalize(const std::string& base, const std::string& path)
+{
+    std::vector<std::string> parts;
+    auto split = [&parts](const std::string& s) {
+        size_t pos = 0;
+        while (pos <= s.size()) {
+            size_t end = s.find('/', pos);
+            if (end == std::string::npos) {
+                end = s.size();
+            }
+            std::string part = s.substr(pos, end - pos);
+            if (part == "..") {
+                if (!parts.empty()) {
+                    parts.pop_back();
+                }
+            } else if (!part.empty() && part != ".") {
+                parts.push_back(std::move(part));
+            }
+            pos = end + 1;
+        }
+    };
+    if (path.empty() || path[0] != '/') {
+        split(base);
+    }
+    split(path);
+
+    std::string result;
+    for (const std::string& part : parts) {
+        result += '/';
+        result += part;
+    }
+    return result.empty() ? "/" : result;
+}
+
+//————————————————————DirectoryHandle————————————————————————————
+
+DirectoryHandle::DirectoryHandle(int fd, std::string path)
+    : fd(fd),
+      path(std::move(path))
+{
+}
+
+DirectoryHandle::~DirectoryHandle()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+//————————————————————ResolvedPath————————————————————————————
+
+ResolvedPath::ResolvedPath(
+        std::shared_ptr<FileSystem> fs,
+        std::shared_ptr<const DirectoryHandle> root,
+        std::shared_ptr<const DirectoryHandle> cwd,
+        std::string path)
+    : fs_(std::move(fs)),
+      root_(std::move(root)),
+      cwd_(std::move(cwd)),
+      path_(std::move(path))
+{
+    fromRoot_ = path_ == "/" ? "." : path_.substr(1);
+
+    const std::string& base = cwd_->path;
+    if (base == "/") {
+        fromCwd_ = fromRoot_;
+    } else if (path_ == base) {
+        fromCwd_ = ".";
+    } else if (path_.compare(0, base.size(), base) == 0 &&
+               path_[base.size()] == '/') {
+        fromCwd_ = path_.substr(base.size() + 1);
+    }
+}
+
+int ResolvedPath::open(int flags, mode_t mode) const
+{
+    return fs_->open(*this, flags, mode);
+}
+
+int ResolvedPath::stat(struct statx& stx, bool follow) const
+{
+    return fs_->stat(*this, stx, follow);
+}
+
+int ResolvedPath::mkdir(mode_t mode) const
+{
+    return fs_->mkdir(*this, mode);
+}
+
+int ResolvedPath::rmdir() const
+{
+    return fs_->rmdir(*this);
+}
+
+int ResolvedPath::unlink() const
+{
+    return fs_->unlink(*this);
+}
+
+int ResolvedPath::rename(const ResolvedPath& to) const
+{
+    return fs_->rename(*this, to);
+}
+
+int ResolvedPath::open_directory(
+        std::shared_ptr<const DirectoryHandle>& handle) const
+{
+    return fs_->open_directory(*this, handle);
+}
+
+int ResolvedPath::read_directory(
+        off_t cursor,
+        std::vector<DirectoryEntry>& entries) const
+{
+    return fs_->read_directory(*this, cursor, entries);
+}
+
+ResolvedPath ResolvedPath::child(const std::string& name) const
+{
+    return ResolvedPath(fs_, root_, cwd_,
+                        path_ == "/" ? "/" + name : path_ + "/" + name);
+}
+
+ResolvedPath ResolvedPath::parent() const
+{
+    if (is_root()) {
+        return *this;
+    }
+    size_t slash = path_.rfind('/');
+    return ResolvedPath(fs_, root_, cwd_,
+                        slash == 0 ? "/" : path_.substr(0, slash));
+}
+
+std::string ResolvedPath::name() const
+{
+    return is_root() ? std::string() : path_.substr(path_.rfind('/') + 1);
+}
+
+//————————————————————PathResolver————————————————————————————
+
+int PathResolver::open(std::shared_ptr<FileSystem> fs, const std::string& home)
+{
+    fs_ = std::move(fs);
+    root_ = fs_->root();
+    cwd_ = root_;
+    return change_directory(home);
+}
+
+const std::string& PathResolver::cwd() const
+{
+    return cwd_->path;
+}
+
+ResolvedPath PathResolver::resolve(const std::string& path) const
+{
+    return ResolvedPath(fs_, root_, cwd_, normalize(cwd_->path, path));
+}
+
+int PathResolver::change_directory(const std::string& path)
+{
+    std::shared_ptr<const DirectoryHandle> handle;
+    int rc = resolve(path).open_directory(handle);
+    if (rc == 0) {
+        enter(std::move(handle));
+    }
+    return rc;
+}
+
+void PathResolver::enter(std::shared_ptr<const DirectoryHandle> handle)
+{
+    cwd_ = std::move(handle);
+}
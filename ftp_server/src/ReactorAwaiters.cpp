@@ -0,0 +1,185 @@
+#include "ReactorAwaiters.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <sys/socket.h>
+
+IoWait::IoWait(ACE_Reactor* reactor, ACE_HANDLE handle, ACE_Reactor_Mask mask)
+    : reactor_(reactor), handle_(handle), mask_(mask)
+{
+}
+
+IoWait::~IoWait()
+{
+    // 协程在挂起期间被销毁（会话关闭），从 Reactor 注销
+    if (registered_) {
+        reactor_->remove_handler(this, mask_ | ACE_Event_Handler::DONT_CALL);
+    }
+}
+
+bool IoWait::await_suspend(std::coroutine_handle<> waiter)
+{
+    waiter_ = waiter;
+    if (reactor_ == nullptr || reactor_->register_handler(this, mask_) == -1) {
+        failed_ = true;
+        return false; // 注册失败，不挂起
+    }
+    registered_ = true;
+    return true;
+}
+
+ACE_HANDLE IoWait::get_handle() const
+{
+    return handle_;
+}
+
+int IoWait::handle_input(ACE_HANDLE /*fd*/)
+{
+    return fire();
+}
+
+int IoWait::handle_output(ACE_HANDLE /*fd*/)
+{
+    return fire();
+}
+
+int IoWait::handle_close(ACE_HANDLE /*handle*/, ACE_Reactor_Mask /*close_mask*/)
+{
+    return 0; // 生命周期由协程帧管理
+}
+
+int IoWait::fire()
+{
+    reactor_->remove_handler(this, mask_ | ACE_Event_Handler::DONT_CALL);
+    registered_ = false;
+    // 恢复后协程会销毁本对象，resume 之后不得访问任何成员
+    std::coroutine_handle<> waiter = std::exchange(waiter_, {});
+    waiter.resume();
+    return 0;
+}
+
+// 非阻塞调用是否只是暂时无法完成
+static bool would_block()
+{
+    return errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR;
+}
+
+Task<int> async_accept(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Acceptor& acceptor,
+        ACE_SOCK_Stream& stream)
+{
+    acceptor.enable(ACE_NONBLOCK);
+    while (true) {
+        if (acceptor.accept(stream) != -1) {
+            stream.enable(ACE_NONBLOCK);
+            co_return 0;
+        }
+        if (!would_block()) {
+            co_return -1;
+        }
+        IoWait waiting(
+                reactor, acceptor.get_handle(), ACE_Event_Handler::ACCEPT_MASK);
+        bool ready = co_await waiting;
+        if (!ready) {
+            co_return -1;
+        }
+    }
+}
+
+Task<ssize_t> async_recv(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& stream,
+        char* buffer,
+        size_t size)
+{
+    while (true) {
+        ssize_t bytesReceived = stream.recv(buffer, size);
+        if (bytesReceived >= 0) {
+            co_return bytesReceived;
+        }
+        if (!would_block()) {
+            co_return -1;
+        }
+        IoWait waiting(
+                reactor, stream.get_handle(), ACE_Event_Handler::READ_MASK);
+        bool ready = co_await waiting;
+        if (!ready) {
+            co_return -1;
+        }
+    }
+}
+
+Task<ssize_t> async_send_all(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& stream,
+        const char* data,
+        size_t size)
+{
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t bytesSent = stream.send(data + offset, size - offset);
+        if (bytesSent > 0) {
+            offset += bytesSent;
+            continue;
+        }
+        if (bytesSent == -1 && !would_block()) {
+            co_return -1;
+        }
+        IoWait waiting(
+                reactor, stream.get_handle(), ACE_Event_Handler::WRITE_MASK);
+        bool ready = co_await waiting;
+        if (!ready) {
+            co_return -1;
+        }
+    }
+    co_return static_cast<ssize_t>(size);
+}
+
+Task<ssize_t> async_sendv_all(
+        ACE_Reactor* reactor,
+        ACE_SOCK_Stream& stream,
+        iovec* iov,
+        size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += iov[i].iov_len;
+    }
+    while (count > 0) {
+        // 跳过已发送完的段
+        if (iov->iov_len == 0) {
+            ++iov;
+            --count;
+            continue;
+        }
+        msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = std::min<size_t>(count, IOV_MAX);
+        ssize_t bytesSent = sendmsg(stream.get_handle(), &message, MSG_NOSIGNAL);
+        if (bytesSent > 0) {
+            size_t sent = bytesSent;
+            while (sent > 0) {
+                size_t n = std::min(sent, iov->iov_len);
+                iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                iov->iov_len -= n;
+                sent -= n;
+                if (iov->iov_len == 0) {
+                    ++iov;
+                    --count;
+                }
+            }
+            continue;
+        }
+        if (bytesSent == -1 && !would_block()) {
+            co_return -1;
+        }
+        IoWait waiting(
+                reactor, stream.get_handle(), ACE_Event_Handler::WRITE_MASK);
+        bool ready = co_await waiting;
+        if (!ready) {
+            co_return -1;
+        }
+    }
+    co_return static_cast<ssize_t>(total);
+}
@@ -0,0 +1,468 @@
+#include "RsyncDelta.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// 默认块大小的下限
+const size_t DEFAULT_MIN_BLOCK = 2 * 1024;
+// 一条 D 指令最多携带的新数据
+const size_t LITERAL_MAX = 64 * 1024;
+// 指令行的长度上限
+const size_t COMMAND_MAX = 256;
+// 复制基准文件时的缓冲大小
+const size_t PATCH_BUFFER = 1024 * 1024;
+
+// 弱校验的 16 位标记
+static uint16_t checksum_tag(uint32_t weak)
+{
+    return static_cast<uint16_t>(weak ^ (weak >> 16));
+}
+
+// 块的 MD5
+static std::string strong_checksum(const char* data, size_t size)
+{
+    Hasher hasher(HashAlgorithm::MD5);
+    hasher.update(data, size);
+    return hasher.finish();
+}
+
+// 逐字节累加：a += x，b += a
+static void checksum_scalar(const uint8_t* p, size_t size, uint32_t& a, uint32_t& b)
+{
+    for (size_t i = 0; i < size; ++i) {
+        a += p[i];
+        b += a;
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static uint32_t horizontal_sum(__m256i v)
+{
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    uint32_t sum = 0;
+    for (uint32_t lane : lanes) {
+        sum += lane;
+    }
+    return sum;
+}
+
+// 每次 32 字节：字节和由 vpsadbw 求出，块内的加权和 Σ(32 - k)·x 由
+// vpmaddubsw/vpmaddwd 求出，之前各块的贡献由每块开始前的字节和累计。
+// 通道按 32 位回绕，与结果只取低 16 位一致
+__attribute__((target("avx2"))) static void checksum_avx2(
+        const uint8_t* p,
+        size_t blocks,
+        uint32_t& a,
+        uint32_t& b)
+{
+    const __m256i weights = _mm256_setr_epi8(
+            32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+            16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sums = zero;
+    __m256i prefix = zero;
+    __m256i weighted = zero;
+    for (size_t i = 0; i < blocks; ++i) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+        prefix = _mm256_add_epi32(prefix, sums);
+        sums = _mm256_add_epi32(sums, _mm256_sad_epu8(x, zero));
+        weighted = _mm256_add_epi32(
+                weighted, _mm256_madd_epi16(_mm256_maddubs_epi16(x, weights), ones));
+    }
+    b += 32 * a * static_cast<uint32_t>(blocks) + 32 * horizontal_sum(prefix) +
+         horizontal_sum(weighted);
+    a += horizontal_sum(sums);
+}
+#endif
+
+uint32_t rolling_checksum(const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint32_t a = 0;
+    uint32_t b = 0;
+#if defined(__x86_64__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2 && size >= 32) {
+        size_t blocks = size / 32;
+        checksum_avx2(p, blocks, a, b);
+        p += blocks * 32;
+        size -= blocks * 32;
+    }
+#endif
+    checksum_scalar(p, size, a, b);
+    return (a & 0xffff) | (b << 16);
+}
+
+void RollingChecksum::reset(const char* data, size_t size)
+{
+    length_ = size;
+    uint32_t value = rolling_checksum(data, size);
+    // 只保留低 16 位即可继续滑动：之后的运算同样按 2^16 取模
+    a_ = value & 0xffff;
+    b_ = value >> 16;
+}
+
+size_t DeltaSignature::default_block_size(off_t size)
+{
+    size_t root = static_cast<size_t>(std::sqrt(static_cast<double>(size)));
+    root = (root + 1023) / 1024 * 1024;
+    return std::clamp(root, DEFAULT_MIN_BLOCK, MAX_BLOCK);
+}
+
+std::string DeltaSignature::header(size_t blockSize, off_t size)
+{
+    size_t count = static_cast<size_t>((size + blockSize - 1) / blockSize);
+    return "FTPSIG 1 " + std::to_string(blockSize) + " " + std::to_string(size) +
+           " " + std::to_string(count) + "\n";
+}
+
+void DeltaSignature::append_blocks(
+        const char* data,
+        size_t size,
+        size_t blockSize,
+        std::string& out)
+{
+    for (size_t offset = 0; offset < size; offset += blockSize) {
+        size_t length = std::min(blockSize, size - offset);
+        char weak[16];
+        snprintf(weak, sizeof(weak), "%08x ", rolling_checksum(data + offset, length));
+        out += weak;
+        out += strong_checksum(data + offset, length);
+        out += '\n';
+    }
+}
+
+int DeltaSignature::parse(const std::string& text)
+{
+    std::istringstream in(text);
+    std::string magic;
+    int version = 0;
+    size_t blockSize = 0;
+    long long size = -1;
+    size_t count = 0;
+    if (!(in >> magic >> version >> blockSize >> size >> count) ||
+        magic != "FTPSIG" || version != 1 || blockSize == 0 ||
+        blockSize > MAX_BLOCK || size < 0 ||
+        count != static_cast<size_t>((size + blockSize - 1) / blockSize)) {
+        return -EINVAL;
+    }
+
+    std::vector<Block> blocks;
+    blocks.reserve(count);
+    std::unordered_map<uint32_t, std::vector<size_t> > index;
+    std::vector<uint8_t> tags(65536, 0);
+    for (size_t i = 0; i < count; ++i) {
+        std::string weak;
+        Block block;
+        if (!(in >> weak >> block.strong) || weak.size() != 8 ||
+            block.strong.size() != 32) {
+            return -EINVAL;
+        }
+        char* end = nullptr;
+        block.weak = static_cast<uint32_t>(strtoul(weak.c_str(), &end, 16));
+        if (*end != '\0') {
+            return -EINVAL;
+        }
+        index[block.weak].push_back(i);
+        tags[checksum_tag(block.weak)] = 1;
+        blocks.push_back(std::move(block));
+    }
+    blockSize_ = blockSize;
+    size_ = static_cast<off_t>(size);
+    blocks_ = std::move(blocks);
+    index_ = std::move(index);
+    tags_ = std::move(tags);
+    return 0;
+}
+
+DeltaEncoder::DeltaEncoder(const DeltaSignature& signature)
+    : signature_(signature),
+      blockSize_(signature.block_size()),
+      digest_(HashAlgorithm::SHA256)
+{
+}
+
+void DeltaEncoder::update(const char* data, size_t size, std::string& out)
+{
+    start(out);
+    digest_.update(data, size);
+    size_ += size;
+    data_.append(data, size);
+
+    if (signature_.blocks_.empty()) {
+        pos_ = data_.size();
+    }
+    // 逐字节滑动窗口查找与基准块相同的内容
+    while (data_.size() - pos_ >= blockSize_) {
+        if (!rollingValid_) {
+            rolling_.reset(data_.data() + pos_, blockSize_);
+            rollingValid_ = true;
+            checked_ = false;
+        }
+        if (!checked_) {
+            checked_ = true;
+            if (match_window(out)) {
+                continue;
+            }
+        }
+        if (data_.size() - pos_ == blockSize_) {
+            break; // 需要更多数据才能继续滑动
+        }
+        rolling_.roll(static_cast<uint8_t>(data_[pos_]),
+                      static_cast<uint8_t>(data_[pos_ + blockSize_]));
+        ++pos_;
+        checked_ = false;
+        if (pos_ - literal_ >= LITERAL_MAX) {
+            flush_literal(out);
+        }
+    }
+    if (pos_ - literal_ >= LITERAL_MAX) {
+        flush_literal(out);
+    }
+
+    // 丢弃已输出的数据
+    data_.erase(0, literal_);
+    pos_ -= literal_;
+    literal_ = 0;
+}
+
+void DeltaEncoder::finish(std::string& out)
+{
+    start(out);
+    // 不足一块的结尾只可能与基准文件不满的最后一块相同
+    size_t rest = data_.size() - pos_;
+    const std::vector<DeltaSignature::Block>& blocks = signature_.blocks_;
+    if (rest > 0 && !blocks.empty()) {
+        size_t last = blocks.size() - 1;
+        size_t lastLength = static_cast<size_t>(signature_.size() - last * blockSize_);
+        const char* tail = data_.data() + pos_;
+        if (lastLength == rest && rolling_checksum(tail, rest) == blocks[last].weak &&
+            strong_checksum(tail, rest) == blocks[last].strong) {
+            emit_copy(last, rest, out);
+            pos_ += rest;
+            literal_ = pos_;
+        }
+    }
+    pos_ = data_.size();
+    flush_literal(out);
+    flush_run(out);
+    out += "E " + std::to_string(size_) + " " + digest_.finish() + "\n";
+}
+
+void DeltaEncoder::start(std::string& out)
+{
+    if (!started_) {
+        started_ = true;
+        out += "FTPDELTA 1 " + std::to_string(blockSize_) + "\n";
+    }
+}
+
+bool DeltaEncoder::match_window(std::string& out)
+{
+    uint32_t weak = rolling_.value();
+    if (!signature_.tags_[checksum_tag(weak)]) {
+        return false;
+    }
+    auto it = signature_.index_.find(weak);
+    if (it == signature_.index_.end()) {
+        return false;
+    }
+    std::string strong;
+    for (size_t block : it->second) {
+        // 不满的最后一块在结束时比较
+        if (signature_.size() - static_cast<off_t>(block * blockSize_) <
+            static_cast<off_t>(blockSize_)) {
+            continue;
+        }
+        if (strong.empty()) {
+            strong = strong_checksum(data_.data() + pos_, blockSize_);
+        }
+        if (signature_.blocks_[block].strong == strong) {
+            emit_copy(block, blockSize_, out);
+            pos_ += blockSize_;
+            literal_ = pos_;
+            rollingValid_ = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeltaEncoder::emit_copy(size_t block, size_t length, std::string& out)
+{
+    flush_literal(out);
+    if (runCount_ > 0 && block == runStart_ + runCount_) {
+        ++runCount_;
+    } else {
+        flush_run(out);
+        runStart_ = block;
+        runCount_ = 1;
+    }
+    matched_ += length;
+}
+
+void DeltaEncoder::flush_run(std::string& out)
+{
+    if (runCount_ > 0) {
+        out += "C " + std::to_string(runStart_) + " " + std::to_string(runCount_) + "\n";
+        runCount_ = 0;
+    }
+}
+
+void DeltaEncoder::flush_literal(std::string& out)
+{
+    if (pos_ > literal_) {
+        flush_run(out);
+        size_t length = pos_ - literal_;
+        out += "D " + std::to_string(length) + "\n";
+        out.append(data_, literal_, length);
+        literal_ = pos_;
+    }
+}
+
+DeltaPatcher::DeltaPatcher(ReadAt basis, off_t basisSize, int target)
+    : basis_(std::move(basis)),
+      basisSize_(basisSize),
+      target_(target),
+      digest_(HashAlgorithm::SHA256)
+{
+}
+
+int DeltaPatcher::feed(const char* data, size_t size)
+{
+    while (size > 0) {
+        if (ended_) {
+            return -EBADMSG; // 结束行之后还有数据
+        }
+        if (literal_ > 0) {
+            size_t n = static_cast<size_t>(std::min<off_t>(literal_, size));
+            int rc = write(data, n);
+            if (rc != 0) {
+                return rc;
+            }
+            literal_ -= n;
+            data += n;
+            size -= n;
+            continue;
+        }
+        const char* newline = static_cast<const char*>(memchr(data, '\n', size));
+        size_t n = newline != nullptr ? static_cast<size_t>(newline - data) : size;
+        line_.append(data, n);
+        if (line_.size() > COMMAND_MAX) {
+            return -EBADMSG;
+        }
+        if (newline == nullptr) {
+            break;
+        }
+        data += n + 1;
+        size -= n + 1;
+        int rc = command(line_);
+        line_.clear();
+        if (rc != 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+int DeltaPatcher::command(const std::string& line)
+{
+    std::istringstream in(line);
+    std::string op;
+    in >> op;
+    if (blockSize_ == 0) {
+        int version = 0;
+        if (op != "FTPDELTA" || !(in >> version >> blockSize_) || version != 1 ||
+            blockSize_ == 0 || blockSize_ > DeltaSignature::MAX_BLOCK) {
+            blockSize_ = 0;
+            return -EBADMSG;
+        }
+        return 0;
+    }
+
+    if (op == "C") {
+        // 复制基准文件中连续的块，最后一块可以不满
+        unsigned long long block = 0;
+        unsigned long long count = 0;
+        off_t blocks = (basisSize_ + blockSize_ - 1) / blockSize_;
+        if (!(in >> block >> count) || count == 0 ||
+            block >= static_cast<unsigned long long>(blocks) ||
+            count > static_cast<unsigned long long>(blocks) - block) {
+            return -EBADMSG;
+        }
+        off_t offset = static_cast<off_t>(block * blockSize_);
+        off_t end = std::min<off_t>(basisSize_, offset + count * blockSize_);
+        if (buffer_.empty()) {
+            buffer_.resize(PATCH_BUFFER);
+        }
+        while (offset < end) {
+            size_t want = static_cast<size_t>(std::min<off_t>(end - offset, buffer_.size()));
+            ssize_t n = basis_(buffer_.data(), want, offset);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return n < 0 ? -errno : -ESTALE; // 基准文件被截断
+            }
+            int rc = write(buffer_.data(), static_cast<size_t>(n));
+            if (rc != 0) {
+                return rc;
+            }
+            offset += n;
+            reused_ += n;
+        }
+        return 0;
+    }
+    if (op == "D") {
+        long long length = -1;
+        if (!(in >> length) || length < 0) {
+            return -EBADMSG;
+        }
+        literal_ = static_cast<off_t>(length);
+        return 0;
+    }
+    if (op == "E") {
+        long long size = -1;
+        std::string digest;
+        if (!(in >> size >> digest)) {
+            return -EBADMSG;
+        }
+        ended_ = true;
+        valid_ = size == written_ && digest == digest_.finish();
+        return 0;
+    }
+    return -EBADMSG;
+}
+
+int DeltaPatcher::write(const char* data, size_t size)
+{
+    digest_.update(data, size);
+    while (size > 0) {
+        ssize_t n = pwrite(target_, data, size, written_);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n < 0 ? -errno : -EIO;
+        }
+        data += n;
+        size -= n;
+        written_ += n;
+    }
+    return 0;
+}
+
+int DeltaPatcher::finish()
+{
+    return ended_ && valid_ && line_.empty() && literal_ == 0 ? 0 : -EBADMSG;
+}
@@ -0,0 +1,99 @@
+#include "ServerConfig.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+
+ServerConfig& ServerConfig::instance()
+{
+    static ServerConfig config;
+    return config;
+}
+
+bool ServerConfig::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string key, value;
+        if (!(iss >> key) || key[0] == '#') {
+            continue; // 空行或注释
+        }
+        std::getline(iss >> std::ws, value);
+        // 去掉行尾的空白和 \r
+        while (!value.empty() && std::isspace((unsigned char)value.back())) {
+            value.pop_back();
+        }
+        values_[key] = value;
+    }
+    return true;
+}
+
+void ServerConfig::set(const std::string& key, const std::string& value)
+{
+    values_[key] = value;
+}
+
+std::string ServerConfig::get_string(
+        const std::string& key,
+        const std::string& def) const
+{
+    auto it = values_.find(key);
+    return it == values_.end() ? def : it->second;
+}
+
+long long ServerConfig::get_int(const std::string& key, long long def) const
+{
+    auto it = values_.find(key);
+    if (it == values_.end() || it->second.empty()) {
+        return def;
+    }
+
+    size_t pos = 0;
+    long long value = 0;
+    try {
+        value = std::stoll(it->second, &pos);
+    } catch (const std::exception&) {
+        return def;
+    }
+
+    // 支持 K/M/G 后缀
+    if (pos < it->second.size()) {
+        switch (std::toupper((unsigned char)it->second[pos])) {
+        case 'K':
+            value <<= 10;
+            break;
+        case 'M':
+            value <<= 20;
+            break;
+        case 'G':
+            value <<= 30;
+            break;
+        default:
+            return def;
+        }
+    }
+    return value;
+}
+
+bool ServerConfig::get_bool(const std::string& key, bool def) const
+{
+    auto it = values_.find(key);
+    if (it == values_.end()) {
+        return def;
+    }
+    std::string value = it->second;
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    if (value == "on" || value == "yes" || value == "true" || value == "1") {
+        return true;
+    }
+    if (value == "off" || value == "no" || value == "false" || value == "0") {
+        return false;
+    }
+    return def;
+}
@@ -1,14 +1,22 @@
 #include "Session.h"
+#include "ChangeWatcher.h"
 
 // 构造函数
 Session::Session(ACE_SOCK_Stream& stream)
     : clientStream_(stream),
       logged_in_(false),
       passive_mode_(false),
-      transfer_mode_(ASCII)
+      transfer_mode_(ASCII),
+      hash_algorithm_(HashAlgorithm::SHA256),
+      reactor_(nullptr),
+      io_uring_(nullptr),
+      handler_(nullptr)
 {
-    // 初始化工作目录为当前用户的主目录
-    working_directory_ = get_home_directory();
+    // 未限制根目录时初始工作目录为服务器的当前目录，否则为根目录；
+    // 无法进入时停留在根目录
+    std::shared_ptr<FileSystem> fs = FileSystem::instance();
+    std::string home = fs->confined() ? "/" : get_home_directory();
+    resolver_.open(fs, home);
 }
 
 // 登录状态
@@ -44,15 +52,26 @@ void Session::set_transfer_mode(TransferMode mode)
     transfer_mode_ = mode;
 }
 
+// HASH 算法
+HashAlgorithm Session::get_hash_algorithm() const
+{
+    return hash_algorithm_;
+}
+
+void Session::set_hash_algorithm(HashAlgorithm algorithm)
+{
+    hash_algorithm_ = algorithm;
+}
+
 // 工作目录
 const std::string& Session::get_working_directory() const
 {
-    return working_directory_;
+    return resolver_.cwd();
 }
 
-void Session::set_working_directory(const std::string& dir)
+PathResolver& Session::get_path_resolver()
 {
-    working_directory_ = dir;
+    return resolver_;
 }
 
 // 用户名
@@ -72,6 +91,73 @@ ACE_SOCK_Stream& Session::get_client_stream()
     return clientStream_;
 }
 
+// 所属 Reactor
+ACE_Reactor* Session::get_reactor() const
+{
+    return reactor_;
+}
+
+void Session::set_reactor(ACE_Reactor* reactor)
+{
+    reactor_ = reactor;
+}
+
+// 所属 Reactor 的 io_uring
+IoUring* Session::get_io_uring() const
+{
+    return io_uring_;
+}
+
+void Session::set_io_uring(IoUring* uring)
+{
+    io_uring_ = uring;
+}
+
+// 控制连接的事件处理器
+void Session::set_handler(ACE_Event_Handler* handler)
+{
+    handler_ = handler;
+}
+
+// 异步命令：执行期间暂停读取控制连接
+void Session::run_command(Task<void> command)
+{
+    command_ = finish_command(std::move(command));
+    reactor_->suspend_handler(handler_);
+    begin_reply();
+    command_.start();
+}
+
+Task<void> Session::finish_command(Task<void> command)
+{
+    co_await std::move(command);
+    end_reply();
+    reactor_->resume_handler(handler_);
+}
+
+// 等待最终回复期间暂缓异步通知，避免客户端把通知当作命令的回复
+void Session::begin_reply()
+{
+    if (replies_++ == 0 && notices_) {
+        notices_->hold(true);
+    }
+}
+
+void Session::end_reply()
+{
+    if (--replies_ == 0 && notices_) {
+        notices_->hold(false);
+    }
+}
+
+void Session::set_notices(std::shared_ptr<WatchSink> sink)
+{
+    notices_ = std::move(sink);
+    if (notices_) {
+        notices_->hold(replies_ > 0);
+    }
+}
+
 // 获取当前用户的主目录
 std::string Session::get_home_directory()
 {
@@ -0,0 +1,434 @@
+#include "TarArchive.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+// ustar 的 12 字节数字字段能表示的最大值（11 位八进制）
+static const uint64_t OCTAL_MAX = 077777777777ULL;
+
+// pax 扩展头部与 GNU 长文件名的大小上限
+static const uint64_t META_MAX = 1024 * 1024;
+
+// 以 width - 1 位八进制加 NUL 写入字段，放不下时返回 false
+static bool put_octal(char* field, size_t width, uint64_t value)
+{
+    char digits[32];
+    int n = snprintf(digits, sizeof(digits), "%0*llo", static_cast<int>(width - 1),
+                     static_cast<unsigned long long>(value));
+    if (n != static_cast<int>(width - 1)) {
+        return false;
+    }
+    memcpy(field, digits, width);
+    return true;
+}
+
+// 一个 ustar 头部块：名称超长时截断，超出范围的属主置 0
+static std::string ustar_block(
+        const std::string& name,
+        char type,
+        const TarMember& member,
+        uint64_t size)
+{
+    std::string block(TarArchive::BLOCK, '\0');
+    char* h = &block[0];
+    memcpy(h, name.data(), std::min<size_t>(name.size(), 100));
+    put_octal(h + 100, 8, member.mode & 07777);
+    if (!put_octal(h + 108, 8, member.uid)) {
+        put_octal(h + 108, 8, 0);
+    }
+    if (!put_octal(h + 116, 8, member.gid)) {
+        put_octal(h + 116, 8, 0);
+    }
+    put_octal(h + 124, 12, size);
+    put_octal(h + 136, 12,
+              static_cast<uint64_t>(std::clamp<int64_t>(member.mtime, 0, OCTAL_MAX)));
+    h[156] = type;
+    memcpy(h + 257, "ustar", 6);
+    memcpy(h + 263, "00", 2);
+
+    // 校验和按校验和字段全为空格计算，写为 6 位八进制、NUL、空格
+    memset(h + 148, ' ', 8);
+    unsigned int sum = 0;
+    for (unsigned char c : block) {
+        sum += c;
+    }
+    snprintf(h + 148, 8, "%06o", sum);
+    h[155] = ' ';
+    return block;
+}
+
+// pax 记录 "<长度> <键>=<值>\n"，长度包括自身的位数
+static void append_record(std::string& out, const std::string& key, const std::string& value)
+{
+    size_t length = key.size() + value.size() + 3;
+    size_t digits = std::to_string(length).size();
+    while (std::to_string(length + digits).size() != digits) {
+        ++digits;
+    }
+    out += std::to_string(length + digits);
+    out += ' ';
+    out += key;
+    out += '=';
+    out += value;
+    out += '\n';
+}
+
+std::string TarArchive::header(const TarMember& member)
+{
+    std::string name = member.type == TarMember::DIRECTORY ? member.name + "/"
+                                                           : member.name;
+    uint64_t size = member.type == TarMember::DIRECTORY
+                            ? 0
+                            : static_cast<uint64_t>(member.size);
+
+    std::string records;
+    if (name.size() > 100) {
+        append_record(records, "path", name);
+    }
+    if (size > OCTAL_MAX) {
+        append_record(records, "size", std::to_string(size));
+    }
+
+    std::string out;
+    if (!records.empty()) {
+        TarMember extended;
+        extended.mtime = member.mtime;
+        out = ustar_block("././@PaxHeader", 'x', extended, records.size());
+        out += records;
+        out.append(padding(records.size()), '\0');
+    }
+    out += ustar_block(name, member.type, member, size > OCTAL_MAX ? 0 : size);
+    return out;
+}
+
+size_t TarArchive::padding(off_t size)
+{
+    return (BLOCK - static_cast<size_t>(size) % BLOCK) % BLOCK;
+}
+
+std::string TarArchive::trailer()
+{
+    return std::string(2 * BLOCK, '\0');
+}
+
+//————————————————————TarReader————————————————————————————
+
+// 解析数字字段：八进制（可有前导空格，以 NUL 或空格结束），或最高位为 1 的 base-256
+static bool parse_number(const char* field, size_t width, uint64_t& value)
+{
+    value = 0;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(field);
+    if (p[0] & 0x80) {
+        if (p[0] & 0x40) {
+            return false; // 负数
+        }
+        value = p[0] & 0x3f;
+        for (size_t i = 1; i < width; ++i) {
+            if (value >> 56) {
+                return false;
+            }
+            value = value << 8 | p[i];
+        }
+        return true;
+    }
+    size_t i = 0;
+    while (i < width && p[i] == ' ') {
+        ++i;
+    }
+    for (; i < width && p[i] != '\0' && p[i] != ' '; ++i) {
+        if (p[i] < '0' || p[i] > '7') {
+            return false;
+        }
+        value = value << 3 | (p[i] - '0');
+    }
+    return true;
+}
+
+// 以 NUL 结尾（或占满宽度）的字符串字段
+static std::string string_field(const char* field, size_t width)
+{
+    return std::string(field, strnlen(field, width));
+}
+
+void TarReader::feed(const char* data, size_t size)
+{
+    input_ = data;
+    size_ = size;
+    pos_ = 0;
+}
+
+bool TarReader::complete() const
+{
+    return ended_ || (!failed_ && state_ == READ_HEADER && block_.empty());
+}
+
+TarReader::Item TarReader::next(const char*& data, size_t& size)
+{
+    while (true) {
+        if (failed_) {
+            return INVALID;
+        }
+        if (ended_) {
+            return END;
+        }
+        switch (state_) {
+        case SKIP: {
+            uint64_t n = std::min<uint64_t>(skip_, size_ - pos_);
+            pos_ += n;
+            skip_ -= n;
+            if (skip_ > 0) {
+                return MORE;
+            }
+            state_ = READ_HEADER;
+            break;
+        }
+        case READ_HEADER: {
+            const char* block;
+            if (block_.empty() && size_ - pos_ >= TarArchive::BLOCK) {
+                block = input_ + pos_;
+                pos_ += TarArchive::BLOCK;
+            } else {
+                size_t n = std::min(TarArchive::BLOCK - block_.size(), size_ - pos_);
+                block_.append(input_ + pos_, n);
+                pos_ += n;
+                if (block_.size() < TarArchive::BLOCK) {
+                    return MORE;
+                }
+                block = block_.data();
+            }
+            Item item = header(block);
+            block_.clear();
+            if (item != MORE) {
+                return item;
+            }
+            break;
+        }
+        case READ_DATA: {
+            if (remaining_ == 0) {
+                state_ = SKIP;
+                break;
+            }
+            if (pos_ == size_) {
+                return MORE;
+            }
+            size_t n = static_cast<size_t>(std::min<uint64_t>(remaining_, size_ - pos_));
+            data = input_ + pos_;
+            size = n;
+            pos_ += n;
+            remaining_ -= n;
+            return DATA;
+        }
+        case READ_META: {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(remaining_, size_ - pos_));
+            meta_.append(input_ + pos_, n);
+            pos_ += n;
+            remaining_ -= n;
+            if (remaining_ > 0) {
+                return MORE;
+            }
+            if (!apply_meta()) {
+                failed_ = true;
+                return INVALID;
+            }
+            state_ = SKIP;
+            break;
+        }
+        }
+    }
+}
+
+// 解析一个头部块：成员返回 HEADER，扩展头部返回 MORE（继续读取其内容）
+TarReader::Item TarReader::header(const char* block)
+{
+    if (std::all_of(block, block + TarArchive::BLOCK, [](char c) { return c == '\0'; })) {
+        ended_ = true;
+        return END;
+    }
+    uint64_t stored = 0;
+    uint64_t size = 0;
+    unsigned int sum = 0;
+    for (size_t i = 0; i < TarArchive::BLOCK; ++i) {
+        sum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(block[i]);
+    }
+    if (!parse_number(block + 148, 8, stored) || stored != sum ||
+        !parse_number(block + 124, 12, size)) {
+        failed_ = true;
+        return INVALID;
+    }
+
+    char type = block[156];
+    if (type == 'x' || type == 'L') {
+        if (size > META_MAX) {
+            failed_ = true;
+            return INVALID;
+        }
+        metaType_ = type;
+        meta_.clear();
+        remaining_ = size;
+        skip_ = TarArchive::padding(size);
+        state_ = READ_META;
+        return MORE;
+    }
+    if (type == 'g' || type == 'K' || type == 'X') {
+        // 全局扩展头部、长链接名：不需要，跳过
+        skip_ = size + TarArchive::padding(size);
+        state_ = SKIP;
+        return MORE;
+    }
+
+    member_ = TarMember();
+    if (!longName_.empty()) {
+        member_.name = std::move(longName_);
+    } else {
+        member_.name = string_field(block, 100);
+        std::string prefix = string_field(block + 345, 155);
+        if (memcmp(block + 257, "ustar", 5) == 0 && !prefix.empty()) {
+            member_.name = prefix + "/" + member_.name;
+        }
+    }
+    while (member_.name.size() > 1 && member_.name.back() == '/') {
+        member_.name.pop_back();
+    }
+    member_.type = type == '\0' || type == '7' ? TarMember::REGULAR : type;
+    uint64_t value = 0;
+    parse_number(block + 100, 8, value);
+    member_.mode = static_cast<mode_t>(value & 07777);
+    parse_number(block + 108, 8, value);
+    member_.uid = static_cast<uid_t>(value);
+    parse_number(block + 116, 8, value);
+    member_.gid = static_cast<gid_t>(value);
+    parse_number(block + 136, 12, value);
+    member_.mtime = longMtime_ >= 0 ? longMtime_ : static_cast<int64_t>(value);
+    member_.size = longSize_ >= 0 ? longSize_ : static_cast<off_t>(size);
+    longName_.clear();
+    longSize_ = -1;
+    longMtime_ = -1;
+
+    remaining_ = static_cast<uint64_t>(member_.size);
+    skip_ = TarArchive::padding(member_.size);
+    state_ = READ_DATA;
+    return HEADER;
+}
+
+// 应用扩展头部：pax 记录 "<长度> <键>=<值>\n"，GNU 长文件名以 NUL 结尾
+bool TarReader::apply_meta()
+{
+    if (metaType_ == 'L') {
+        longName_ = string_field(meta_.data(), meta_.size());
+        return true;
+    }
+    size_t pos = 0;
+    while (pos < meta_.size()) {
+        size_t space = meta_.find(' ', pos);
+        if (space == std::string::npos) {
+            return false;
+        }
+        size_t length = strtoul(meta_.c_str() + pos, nullptr, 10);
+        if (length <= space - pos || pos + length > meta_.size() ||
+            meta_[pos + length - 1] != '\n') {
+            return false;
+        }
+        std::string record = meta_.substr(space + 1, pos + length - space - 2);
+        size_t equals = record.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+        std::string key = record.substr(0, equals);
+        std::string value = record.substr(equals + 1);
+        if (key == "path") {
+            longName_ = value;
+        } else if (key == "size") {
+            longSize_ = strtoll(value.c_str(), nullptr, 10);
+        } else if (key == "mtime") {
+            longMtime_ = strtoll(value.c_str(), nullptr, 10); // 忽略小数部分
+        }
+        pos += length;
+    }
+    return true;
+}
+
+//————————————————————GzipStream————————————————————————————
+
+GzipStream::GzipStream(int level)
+    : stream_(std::make_unique<z_stream>())
+{
+    // windowBits 加 16 输出 gzip 头部与尾部
+    deflateInit2(stream_.get(), level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+}
+
+GzipStream::~GzipStream()
+{
+    deflateEnd(stream_.get());
+}
+
+void GzipStream::write(const char* data, size_t size, std::string& out)
+{
+    deflate(data, size, Z_NO_FLUSH, out);
+}
+
+void GzipStream::finish(std::string& out)
+{
+    deflate(nullptr, 0, Z_FINISH, out);
+}
+
+void GzipStream::deflate(const char* data, size_t size, int flush, std::string& out)
+{
+    z_stream* z = stream_.get();
+    z->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    z->avail_in = static_cast<uInt>(size);
+    char buffer[16384];
+    do {
+        z->next_out = reinterpret_cast<Bytef*>(buffer);
+        z->avail_out = sizeof(buffer);
+        ::deflate(z, flush);
+        out.append(buffer, sizeof(buffer) - z->avail_out);
+    } while (z->avail_out == 0);
+}
+
+//————————————————————GunzipStream————————————————————————————
+
+GunzipStream::GunzipStream()
+    : stream_(std::make_unique<z_stream>())
+{
+    inflateInit2(stream_.get(), 15 + 16);
+}
+
+GunzipStream::~GunzipStream()
+{
+    inflateEnd(stream_.get());
+}
+
+void GunzipStream::write(const char* data, size_t size)
+{
+    input_.assign(data, size);
+    consumed_ = 0;
+}
+
+int GunzipStream::read(std::string& out, size_t limit)
+{
+    z_stream* z = stream_.get();
+    out.resize(limit);
+    z->next_out = reinterpret_cast<Bytef*>(out.data());
+    z->avail_out = static_cast<uInt>(limit);
+    while (z->avail_out > 0 && consumed_ < input_.size()) {
+        z->next_in = reinterpret_cast<Bytef*>(input_.data() + consumed_);
+        z->avail_in = static_cast<uInt>(input_.size() - consumed_);
+        int rc = inflate(z, Z_NO_FLUSH);
+        consumed_ = input_.size() - z->avail_in;
+        if (rc == Z_STREAM_END) {
+            inflateReset(z); // 下一个 gzip 成员
+            continue;
+        }
+        if (rc == Z_BUF_ERROR) {
+            break;
+        }
+        if (rc != Z_OK) {
+            return -EBADMSG;
+        }
+    }
+    out.resize(limit - z->avail_out);
+    return consumed_ < input_.size() ? 1 : 0;
+}
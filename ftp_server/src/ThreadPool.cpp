@@ -1,4 +1,6 @@
 #include "ThreadPool.h"
+#include "CpuAffinity.h"
+#include <algorithm>
 
 ThreadPool::ThreadPool() = default;
 
@@ -9,44 +11,132 @@ ThreadPool::~ThreadPool()
 
 void ThreadPool::open(int num_threads)
 {
+    open(num_threads, num_threads);
+}
+
+void ThreadPool::open(int min_threads, int max_threads)
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
     stop_ = false; // 确保线程池在启动时可以正常工作
-    for (int i = 0; i < num_threads; ++i) {
-        workers_.emplace_back([this] {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(this->queueMutex_);
-                    this->condition_.wait(lock, [this] {
-                        return this->stop_ || !this->tasks_.empty();
-                    });
-                    if (this->stop_ && this->tasks_.empty())
-                        return; // 线程退出
-                    task = std::move(this->tasks_.front());
-                    this->tasks_.pop();
+    min_threads_ = static_cast<size_t>(std::max(min_threads, 1));
+    max_threads_ = std::max(static_cast<size_t>(std::max(max_threads, 1)),
+                            min_threads_);
+    while (workers_.size() < min_threads_) {
+        spawn_worker_locked();
+    }
+}
+
+void ThreadPool::spawn_worker_locked()
+{
+    int cpu = cpus_.empty() ? -1 : cpus_[next_cpu_++ % cpus_.size()];
+    std::thread worker([this, cpu] {
+        // 先绑定 CPU，之后线程分配的传输缓冲区都位于本地 NUMA 节点
+        CpuAffinity::pin_current_thread(cpu);
+        worker_loop();
+    });
+    std::thread::id id = worker.get_id();
+    workers_.emplace(id, std::move(worker));
+}
+
+void ThreadPool::reap_retired_locked()
+{
+    // 已退出的线程在登记后不再访问队列锁，此处可安全 join
+    for (const std::thread::id &id : retired_) {
+        auto it = workers_.find(id);
+        if (it != workers_.end()) {
+            if (it->second.joinable()) {
+                it->second.join();
+            }
+            workers_.erase(it);
+        }
+    }
+    retired_.clear();
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            ++idle_threads_;
+            bool ready = condition_.wait_for(lock, idle_timeout_, [this] {
+                return stop_ || !tasks_.empty();
+            });
+            --idle_threads_;
+            if (stop_ && tasks_.empty())
+                return; // 线程退出，由 close() 负责 join
+            if (!ready) {
+                // 空闲超时：多于常驻线程数时缩容
+                if (workers_.size() - retired_.size() > min_threads_) {
+                    retired_.push_back(std::this_thread::get_id());
+                    return;
                 }
-                task(); // 执行任务
+                continue;
             }
-        });
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task(); // 执行任务
     }
 }
 
 void ThreadPool::close()
 {
+    std::unordered_map<std::thread::id, std::thread> workers;
     {
         std::lock_guard<std::mutex> lock(queueMutex_);
         stop_ = true; // 设置线程池停止标志
+        workers.swap(workers_);
+        retired_.clear();
     }
     condition_.notify_all(); // 唤醒所有等待中的线程
 
-    for (std::thread &worker : workers_) {
-        if (worker.joinable()) {
-            worker.join(); // 等待线程完成任务
+    for (auto &entry : workers) {
+        if (entry.second.joinable()) {
+            entry.second.join(); // 等待线程完成任务
         }
     }
-    workers_.clear(); // 清空线程池
 }
 
 void ThreadPool::set_max_queue_size(size_t max_size)
 {
+    std::lock_guard<std::mutex> lock(queueMutex_);
     max_queue_size_ = max_size;
 }
+
+void ThreadPool::set_idle_timeout(std::chrono::milliseconds timeout)
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    idle_timeout_ = timeout;
+}
+
+void ThreadPool::set_cpu_affinity(const std::vector<int>& cpus)
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    cpus_ = cpus;
+    next_cpu_ = 0;
+}
+
+bool ThreadPool::is_open() const
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    return !stop_;
+}
+
+size_t ThreadPool::thread_count() const
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    return workers_.size() - retired_.size();
+}
+
+size_t ThreadPool::idle_count() const
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    return idle_threads_;
+}
+
+size_t ThreadPool::rejected_count() const
+{
+    return rejected_tasks_.load();
+}
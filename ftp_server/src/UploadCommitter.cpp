@@ -0,0 +1,192 @@
+#include "UploadCommitter.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <random>
+#include <set>
+#include <strings.h>
+#include <unistd.h>
+
+UploadCommitter& UploadCommitter::instance()
+{
+    static UploadCommitter committer;
+    return committer;
+}
+
+bool UploadCommitter::parse_durability(
+        const std::string& name,
+        UploadDurability& durability)
+{
+    if (strcasecmp(name.c_str(), "none") == 0) {
+        durability = UploadDurability::NONE;
+    } else if (strcasecmp(name.c_str(), "fdatasync") == 0) {
+        durability = UploadDurability::FDATASYNC;
+    } else if (strcasecmp(name.c_str(), "group") == 0) {
+        durability = UploadDurability::GROUP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void UploadCommitter::configure(
+        bool atomic,
+        UploadDurability durability,
+        std::chrono::microseconds window,
+        size_t maxBatch)
+{
+    atomic_ = atomic;
+    durability_ = durability;
+    window_ = window;
+    maxBatch_ = maxBatch == 0 ? 1 : maxBatch;
+}
+
+ResolvedPath UploadCommitter::temporary_path(const ResolvedPath& target)
+{
+    thread_local std::mt19937_64 random(std::random_device{}());
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx.part",
+             static_cast<unsigned long long>(random()));
+    return target.parent().child("." + target.name() + suffix);
+}
+
+int UploadCommitter::commit(
+        int fd,
+        const ResolvedPath& written,
+        const ResolvedPath& target)
+{
+    Pending pending{fd, written, target};
+    int rc = 0;
+    if (durability_ == UploadDurability::GROUP) {
+        rc = group_commit(pending);
+    } else {
+        run_batch({&pending}, durability_ == UploadDurability::FDATASYNC);
+        rc = pending.result;
+    }
+    commits_.fetch_add(1, std::memory_order_relaxed);
+    if (rc != 0) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return rc;
+}
+
+int UploadCommitter::group_commit(Pending& pending)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_.push_back(&pending);
+    if (leading_) {
+        // 批次已满时提前唤醒组长
+        if (batch_.size() >= maxBatch_) {
+            cv_.notify_all();
+        }
+        cv_.wait(lock, [&pending] { return pending.done; });
+        return pending.result;
+    }
+
+    // 成为组长：收集一个窗口内到达的上传，上一批仍在落盘时继续收集
+    leading_ = true;
+    cv_.wait_for(lock, window_, [this] { return batch_.size() >= maxBatch_; });
+    cv_.wait(lock, [this] { return !syncing_; });
+    std::vector<Pending*> batch;
+    batch.swap(batch_);
+    leading_ = false;
+    syncing_ = true;
+    lock.unlock();
+
+    run_batch(batch, true);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+
+    lock.lock();
+    syncing_ = false;
+    for (Pending* member : batch) {
+        member->done = true;
+    }
+    cv_.notify_all();
+    return pending.result;
+}
+
+void UploadCommitter::run_batch(const std::vector<Pending*>& batch, bool sync)
+{
+    if (sync) {
+        // io_uring 写入的文件没有普通 fd，按路径打开后落盘（同一 inode）
+        std::vector<int> opened(batch.size(), -1);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            Pending& pending = *batch[i];
+            if (pending.fd == -1) {
+                opened[i] = pending.written.open(O_RDONLY | O_CLOEXEC);
+                if (opened[i] < 0) {
+                    pending.result = opened[i];
+                    opened[i] = -1;
+                }
+            }
+        }
+        auto fd_of = [&](size_t i) {
+            return batch[i]->fd != -1 ? batch[i]->fd : opened[i];
+        };
+
+        // 先为整批启动回写，各文件的数据 I/O 并行进行
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (fd_of(i) != -1) {
+                sync_file_range(fd_of(i), 0, 0, SYNC_FILE_RANGE_WRITE);
+            }
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (fd_of(i) != -1 && batch[i]->result == 0) {
+                if (fdatasync(fd_of(i)) != 0) {
+                    batch[i]->result = -errno;
+                }
+                syncs_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        for (int fd : opened) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+
+    std::set<std::string> directories;
+    std::vector<ResolvedPath> parents;
+    for (Pending* pending : batch) {
+        if (pending->result != 0) {
+            continue;
+        }
+        if (pending->written.path() != pending->target.path()) {
+            pending->result = pending->written.rename(pending->target);
+        }
+        if (pending->result == 0 && sync) {
+            ResolvedPath parent = pending->target.parent();
+            if (directories.insert(parent.path()).second) {
+                parents.push_back(parent);
+            }
+        }
+    }
+
+    // 目录项（新文件或改名）持久化，每个目录一次；不支持的文件系统跳过
+    for (const ResolvedPath& parent : parents) {
+        int dirfd = parent.open(O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd < 0) {
+            continue;
+        }
+        int rc = fsync(dirfd) == 0 || errno == EINVAL ? 0 : -errno;
+        close(dirfd);
+        if (rc == 0) {
+            continue;
+        }
+        for (Pending* pending : batch) {
+            if (pending->result == 0 && pending->target.parent().path() == parent.path()) {
+                pending->result = rc;
+            }
+        }
+    }
+}
+
+UploadCommitter::Stats UploadCommitter::stats() const
+{
+    Stats stats;
+    stats.commits = commits_.load(std::memory_order_relaxed);
+    stats.syncs = syncs_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -1,42 +1,167 @@
 #include "WorkerReactorTask.h"
+#include "ClientHandler.h"
+#include "CpuAffinity.h"
+#include "IoUring.h"
 #include <ace/Log_Msg.h>
+#include <ace/OS_NS_unistd.h>
 
-WorkerReactorTask::WorkerReactorTask(): reactor_(nullptr) {}
+WorkerReactorTask::WorkerReactorTask()
+    : reactor_(nullptr),
+      cpu_(-1),
+      uring_(nullptr),
+      uringEntries_(0),
+      uringBuffers_(0),
+      uringBufferSize_(0),
+      uringFileSlots_(0)
+{
+}
 
 int WorkerReactorTask::start()
 {
-    return this->activate(THR_NEW_LWP | THR_JOINABLE, 1);
+    if (this->activate(THR_NEW_LWP | THR_JOINABLE, 1) == -1) {
+        return -1;
+    }
+    // 等待工作线程创建 Reactor，避免 assign() 拒绝连接或看到未初始化的 Reactor
+    std::unique_lock<std::mutex> lock(readyMutex_);
+    readyCv_.wait(lock, [this] { return ready_; });
+    return 0;
 }
 
 void WorkerReactorTask::stop()
 {
-    if (reactor_ != nullptr) {
-        reactor_->end_reactor_event_loop(); // 停止事件循环
+    ACE_Reactor* reactor = reactor_.load(std::memory_order_acquire);
+    if (reactor != nullptr) {
+        reactor->end_reactor_event_loop(); // 停止事件循环
     }
     this->wait(); // 等待线程结束
-    if (reactor_ != nullptr) {
-        reactor_->close(); // 关闭 Reactor
-        delete reactor_;   // 释放 Reactor 动态内存
-        reactor_ = nullptr;
+    if (uring_ != nullptr) {
+        uring_->close(); // 内核取消在途操作
+        delete uring_;
+        uring_ = nullptr;
+    }
+    if (reactor != nullptr) {
+        reactor_.store(nullptr, std::memory_order_release);
+        reactor->close(); // 关闭 Reactor
+        delete reactor;   // 释放 Reactor 动态内存
     }
+
+    // 关闭尚未交给 ClientHandler 的连接
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    for (auto& entry : pending_) {
+        ACE_OS::close(entry.first);
+    }
+    pending_.clear();
+}
+
+void WorkerReactorTask::set_cpu(int cpu)
+{
+    cpu_ = cpu;
+}
+
+void WorkerReactorTask::set_io_uring(
+        unsigned entries,
+        size_t buffers,
+        size_t bufferSize,
+        unsigned fileSlots)
+{
+    uringEntries_ = entries;
+    uringBuffers_ = buffers;
+    uringBufferSize_ = bufferSize;
+    uringFileSlots_ = fileSlots;
 }
 
 ACE_Reactor* WorkerReactorTask::get_reactor()
 {
-    return reactor_;
+    return reactor_.load(std::memory_order_acquire);
+}
+
+int WorkerReactorTask::assign(
+        ACE_SOCK_Stream& clientStream,
+        ThreadPool& threadPool)
+{
+    ACE_Reactor* reactor = reactor_.load(std::memory_order_acquire);
+    if (reactor == nullptr) {
+        return -1; // 未启动或已停止
+    }
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pending_.emplace_back(clientStream.get_handle(), &threadPool);
+    }
+    // 唤醒 Reactor 线程，在其线程内创建 ClientHandler
+    if (reactor->notify(this, ACE_Event_Handler::EXCEPT_MASK) == -1) {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pending_.pop_back();
+        return -1;
+    }
+    return 0;
+}
+
+int WorkerReactorTask::handle_exception(ACE_HANDLE /*fd*/)
+{
+    std::vector<std::pair<ACE_HANDLE, ThreadPool*> > pending;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pending.swap(pending_);
+    }
+
+    for (auto& entry : pending) {
+        ACE_SOCK_Stream clientStream;
+        clientStream.set_handle(entry.first);
+
+        // 在 Reactor 线程中分配连接对象，使其位于本地 NUMA 节点
+        ClientHandler* handler = new ClientHandler(
+                clientStream, reactor_.load(std::memory_order_relaxed),
+                *entry.second, uring_);
+
+        // 打开 ClientHandler，如果失败则关闭连接
+        if (handler->open() == -1) {
+            handler->handle_close(ACE_INVALID_HANDLE, 0);
+        }
+    }
+    return 0;
 }
 
 int WorkerReactorTask::svc()
 {
+    // 先绑定 CPU，之后 Reactor 及其连接对象都在本地 NUMA 节点上分配
+    if (cpu_ >= 0 && !CpuAffinity::pin_current_thread(cpu_)) {
+        ACE_ERROR(
+                (LM_ERROR,
+                 ACE_TEXT("(%t) Failed to pin reactor thread to CPU %d\n"),
+                 cpu_));
+    }
+
     // 动态分配 Reactor，确保其生命周期与 WorkerReactorTask 绑定
-    reactor_ = new ACE_Reactor();
+    ACE_Reactor* reactor = new ACE_Reactor();
+
+    // 按配置创建本 Reactor 的 io_uring，不可用时传输使用线程池路径
+    if (uringEntries_ > 0) {
+        uring_ = new IoUring();
+        if (uring_->open(reactor, uringEntries_, uringBuffers_,
+                         uringBufferSize_, uringFileSlots_) == -1) {
+            ACE_ERROR(
+                    (LM_ERROR,
+                     ACE_TEXT("(%t) io_uring unavailable, falling back to "
+                              "thread pool I/O\n")));
+            delete uring_;
+            uring_ = nullptr;
+        }
+    }
 
     // ACE_DEBUG(
     //         (LM_DEBUG,
     //          "(Reactor Thread ID: %t) Reactor event loop starting.\n"));
 
+    // 初始化完成后才发布 Reactor，并唤醒等待的 start()
+    reactor_.store(reactor, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(readyMutex_);
+        ready_ = true;
+    }
+    readyCv_.notify_all();
+
     // 启动事件循环
-    reactor_->run_reactor_event_loop();
+    reactor->run_reactor_event_loop();
 
     // 事件循环结束后，打印日志
     ACE_DEBUG(
@@ -7,8 +7,23 @@
 #include "WorkerReactorTask.h"
 #include "ThreadPool.h"
 #include "MasterAcceptor.h"
+#include "ServerConfig.h"
+#include "CpuAffinity.h"
+#include "FileCache.h"
+#include "HashCache.h"
+#include "UploadCommitter.h"
+#include "DedupStore.h"
+#include "ChangeIndex.h"
+#include "ChangeWatcher.h"
+#include "ListingCache.h"
+#include "PageCache.h"
+#include "LocalFileSystem.h"
+#include "MemoryFileSystem.h"
+#include "MetadataCache.h"
+#include "MetadataExecutor.h"
 #include <iostream> // For std::stoi
 #include <atomic>
+#include <cstring>
 
 // 全局变量声明
 MasterAcceptor* acceptor = nullptr;         ///< 主接收器指针
@@ -62,7 +77,8 @@ int main(int argc, char* argv[])
     // 检查命令行参数
     if (argc < 2) {
         std::cerr << "Usage: " << argv[0]
-                  << " <port> [num_workers] [num_threadpool_threads]\n";
+                  << " <port> [num_workers] [num_threadpool_threads]"
+                     " [max_threadpool_threads]\n";
         return 1;
     }
 
@@ -99,6 +115,18 @@ int main(int argc, char* argv[])
         }
     }
 
+    // 设置 ThreadPool 的线程上限，默认与常驻线程数相同（即固定大小）
+    int max_threadpool_threads = num_threadpool_threads;
+    if (argc >= 5) {
+        try {
+            max_threadpool_threads = std::stoi(argv[4]);
+        } catch (const std::exception& e) {
+            std::cerr << "Invalid max number of thread pool threads: "
+                      << argv[4] << std::endl;
+            return 1;
+        }
+    }
+
     // 捕获 SIGINT 信号 (Ctrl + C)
     std::signal(SIGINT, handle_signal);
 
@@ -107,16 +135,173 @@ int main(int argc, char* argv[])
 
     make_map(ps_map);
 
+    // 读取可选的服务器配置文件，不存在时使用默认值
+    ServerConfig& config = ServerConfig::instance();
+    config.load("serverconfig.txt");
+
+    // 文件系统：local 为本地文件系统（可限制根目录，"/" 表示不限制），
+    // memory 为内存文件系统
+    if (config.get_string("filesystem", "local") == "memory") {
+        FileSystem::set_instance(std::make_shared<MemoryFileSystem>());
+    } else {
+        auto local = std::make_shared<LocalFileSystem>();
+        if (local->open(config.get_string("root_directory", "/")) != 0) {
+            ACE_ERROR_RETURN(
+                    (LM_ERROR,
+                     "root_directory is not an accessible directory\n"),
+                    1);
+        }
+        FileSystem::set_instance(local);
+    }
+
+    // CPU 绑定配置：接收线程、各 Reactor 线程、线程池线程
+    std::vector<int> acceptor_cpus =
+            CpuAffinity::parse_cpu_list(config.get_string("acceptor_cpus", ""));
+    std::vector<int> reactor_cpus =
+            CpuAffinity::parse_cpu_list(config.get_string("reactor_cpus", ""));
+    std::vector<int> pool_cpus =
+            CpuAffinity::parse_cpu_list(config.get_string("pool_cpus", ""));
+
+    // 大文件传输的页缓存策略：超过阈值的传输按窗口丢弃页缓存或使用 O_DIRECT，
+    // 避免备份流量挤出交互用户的热数据
+    PageCachePolicy::instance().configure(
+            PageCachePolicy::parse_mode(
+                    config.get_string("cache_policy", "fadvise"),
+                    PageCachePolicy::FADVISE),
+            config.get_int("cache_policy_threshold", 1024LL * 1024 * 1024),
+            config.get_int("cache_policy_window", 8 * 1024 * 1024));
+
+    // RETR 小文件内存缓存：总预算为 0 时关闭
+    FileCache::instance().configure(
+            config.get_int("file_cache_bytes", 64 * 1024 * 1024),
+            config.get_int("file_cache_max_file", 64 * 1024),
+            config.get_int("file_cache_shards", 16));
+
+    // HASH/XCRC/XMD5/XSHA256 的摘要缓存：可选写入扩展属性，重启后仍可命中
+    HashCache::instance().configure(
+            config.get_int("hash_cache_entries", 65536),
+            config.get_bool("hash_cache_xattr", false),
+            config.get_int("hash_cache_shards", 16));
+
+    // STOR 边接收边计算摘要：226 回复附带摘要并插入摘要缓存
+    std::string storChecksum = config.get_string("stor_checksum", "CRC32C");
+    HashAlgorithm uploadAlgorithm;
+    if (parse_hash_algorithm(storChecksum, uploadAlgorithm)) {
+        HashCache::instance().set_upload_algorithm(uploadAlgorithm);
+    } else if (storChecksum != "none") {
+        ACE_ERROR((LM_WARNING,
+                   "Unknown stor_checksum %s, upload checksums disabled\n",
+                   storChecksum.c_str()));
+    }
+
+    // STOR 的提交：原子上传（临时文件改名）与落盘方式
+    UploadDurability durability = UploadDurability::NONE;
+    std::string storDurability = config.get_string("stor_durability", "none");
+    if (!UploadCommitter::parse_durability(storDurability, durability)) {
+        ACE_ERROR((LM_WARNING,
+                   "Unknown stor_durability %s, uploads are not synced\n",
+                   storDurability.c_str()));
+    }
+    UploadCommitter::instance().configure(
+            config.get_bool("stor_atomic", false),
+            durability,
+            std::chrono::microseconds(
+                    config.get_int("stor_group_commit_us", 2000)),
+            config.get_int("stor_group_commit_max", 64));
+
+    // 去重上传：分块目录为空时关闭
+    std::string dedupStore = config.get_string("dedup_store", "");
+    int dedupResult = DedupStore::instance().configure(
+            dedupStore,
+            config.get_int("dedup_chunk_min", 16 * 1024),
+            config.get_int("dedup_chunk_avg", 64 * 1024),
+            config.get_int("dedup_chunk_max", 256 * 1024));
+    if (dedupResult != 0) {
+        ACE_ERROR((LM_WARNING,
+                   "Cannot open dedup store %s (%s), deduplication disabled\n",
+                   dedupStore.c_str(), strerror(-dedupResult)));
+    }
+
+    // LIST/MLSD 列表缓存：由 inotify 失效，总预算为 0 时关闭
+    if (!ListingCache::instance().configure(
+                config.get_int("listing_cache_bytes", 16 * 1024 * 1024),
+                config.get_int("listing_cache_watches", 1024),
+                config.get_int("listing_cache_max_listing", 1024 * 1024),
+                config.get_int("listing_cache_max_age", 60))) {
+        ACE_ERROR((LM_WARNING,
+                   "inotify unavailable, listing cache disabled\n"));
+    }
+
+    // SIZE/MDTM 元数据缓存：由 inotify 与本服务器的修改失效，条目上限为 0 时关闭
+    if (!MetadataCache::instance().configure(
+                config.get_int("metadata_cache_entries", 65536),
+                config.get_int("metadata_cache_watches", 1024),
+                config.get_int("metadata_cache_max_age", 60),
+                config.get_int("metadata_cache_shards", 16))) {
+        ACE_ERROR((LM_WARNING,
+                   "inotify unavailable, metadata cache disabled\n"));
+    }
+
+    // SITE CHANGES 的变更索引：由 inotify 增量维护，索引数为 0 时总是完整遍历
+    if (!ChangeIndex::instance().configure(
+                config.get_int("change_index_roots", 16),
+                config.get_int("change_index_watches", 8192),
+                config.get_int("change_index_entries", 1024 * 1024),
+                config.get_int("change_index_deleted", 65536))) {
+        ACE_ERROR((LM_WARNING,
+                   "inotify unavailable, change index disabled\n"));
+    }
+
+    // SITE WATCH 的变更推送：全部会话共用一个 inotify 监视线程，监视数为 0 时关闭
+    if (!ChangeWatcher::instance().configure(
+                config.get_int("watch_max_watches", 8192),
+                static_cast<int>(config.get_int("watch_batch_ms", 200)),
+                config.get_int("watch_max_pending", 1000))) {
+        ACE_ERROR((LM_WARNING,
+                   "inotify unavailable, SITE WATCH disabled\n"));
+    }
+
+    // 元数据线程池：stat/mkdir/unlink/打开目录/读取目录项，与传输线程池分开
+    MetadataExecutor::instance().configure(
+            static_cast<int>(config.get_int("metadata_threads", 2)),
+            static_cast<int>(config.get_int("metadata_max_threads", 8)),
+            static_cast<size_t>(config.get_int("metadata_queue", 1024)));
+
+    // 传输 I/O 引擎：sync 为线程池 + Reactor，io_uring 为每个 Reactor 一个 io_uring
+    bool use_io_uring = config.get_string("io_engine", "sync") == "io_uring";
+    unsigned uring_entries =
+            static_cast<unsigned>(config.get_int("io_uring_entries", 256));
+    size_t uring_buffers =
+            static_cast<size_t>(config.get_int("io_uring_buffers", 128));
+    size_t uring_buffer_size =
+            static_cast<size_t>(config.get_int("io_uring_buffer_size", 65536));
+    unsigned uring_files =
+            static_cast<unsigned>(config.get_int("io_uring_files", 64));
+
     // 创建从 Reactor 任务并启动 Reactor 线程池
     for (int i = 0; i < num_workers; ++i) {
         worker_tasks[i] = new WorkerReactorTask();
+        if (!reactor_cpus.empty()) {
+            worker_tasks[i]->set_cpu(reactor_cpus[i % reactor_cpus.size()]);
+        }
+        if (use_io_uring) {
+            worker_tasks[i]->set_io_uring(
+                    uring_entries, uring_buffers, uring_buffer_size,
+                    uring_files);
+        }
         if (worker_tasks[i]->start() == -1) {
             ACE_ERROR_RETURN((LM_ERROR, "Failed to start worker task.\n"), 1);
         }
     }
 
-    // 打开线程池
-    threadPool->open(num_threadpool_threads);
+    // 打开线程池，空闲时收缩到常驻线程数，高峰时扩展到上限；
+    // 排队的任务达到上限时新的传输回复 450
+    threadPool->set_cpu_affinity(pool_cpus);
+    threadPool->set_max_queue_size(
+            static_cast<size_t>(config.get_int("pool_queue", 100)));
+    threadPool->set_idle_timeout(std::chrono::milliseconds(
+            config.get_int("pool_idle_ms", 30000)));
+    threadPool->open(num_threadpool_threads, max_threadpool_threads);
 
     // 创建 MasterAcceptor 并启动服务器
     acceptor = new MasterAcceptor(worker_tasks, num_workers, *threadPool);
@@ -125,6 +310,13 @@ int main(int argc, char* argv[])
         ACE_ERROR_RETURN((LM_ERROR, "Failed to open server\n"), 1);
     }
 
+    // 主线程运行接收器的事件循环，按配置绑定 CPU
+    if (!acceptor_cpus.empty() &&
+        !CpuAffinity::pin_current_thread(acceptor_cpus[0])) {
+        ACE_ERROR((LM_ERROR, "Failed to pin acceptor thread to CPU %d\n",
+                   acceptor_cpus[0]));
+    }
+
     // 启动主 Reactor 的事件循环
     // ACE_DEBUG((
     //         LM_DEBUG,
@@ -134,6 +326,12 @@ int main(int argc, char* argv[])
 
     // 确保所有线程和资源在关闭时正确处理
     if (shutting_down) {
+        // 先停止线程池与监视线程：排队和执行中的任务完成后仍会通知会话所属的
+        // Reactor，必须在 Reactor 被删除之前全部结束
+        threadPool->close();
+        MetadataExecutor::instance().close();
+        ChangeWatcher::instance().close();
+
         // 停止所有 Worker Reactor 任务
         for (int i = 0; i < num_workers; ++i) {
             if (worker_tasks[i]) {
@@ -141,8 +339,98 @@ int main(int argc, char* argv[])
             }
         }
 
-        // 停止线程池
-        threadPool->close();
+        FileCache::Stats cacheStats = FileCache::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "File cache: %Q hits, %Q misses, %Q evictions, %Q entries "
+                 "(%Q bytes)\n",
+                 static_cast<ACE_UINT64>(cacheStats.hits),
+                 static_cast<ACE_UINT64>(cacheStats.misses),
+                 static_cast<ACE_UINT64>(cacheStats.evictions),
+                 static_cast<ACE_UINT64>(cacheStats.entries),
+                 static_cast<ACE_UINT64>(cacheStats.bytes)));
+
+        HashCache::Stats hashStats = HashCache::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "Hash cache: %Q hits, %Q xattr hits, %Q misses, %Q evictions, "
+                 "%Q entries\n",
+                 static_cast<ACE_UINT64>(hashStats.hits),
+                 static_cast<ACE_UINT64>(hashStats.xattrHits),
+                 static_cast<ACE_UINT64>(hashStats.misses),
+                 static_cast<ACE_UINT64>(hashStats.evictions),
+                 static_cast<ACE_UINT64>(hashStats.entries)));
+
+        UploadCommitter::Stats commitStats = UploadCommitter::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "Upload commits: %Q commits, %Q fdatasyncs, %Q batches, "
+                 "%Q failures\n",
+                 static_cast<ACE_UINT64>(commitStats.commits),
+                 static_cast<ACE_UINT64>(commitStats.syncs),
+                 static_cast<ACE_UINT64>(commitStats.batches),
+                 static_cast<ACE_UINT64>(commitStats.failures)));
+
+        DedupStore::Stats dedupStats = DedupStore::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "Dedup store: %Q chunks stored (%Q bytes), %Q chunks shared "
+                 "(%Q bytes), %Q manifests\n",
+                 static_cast<ACE_UINT64>(dedupStats.chunksStored),
+                 static_cast<ACE_UINT64>(dedupStats.bytesStored),
+                 static_cast<ACE_UINT64>(dedupStats.chunksShared),
+                 static_cast<ACE_UINT64>(dedupStats.bytesShared),
+                 static_cast<ACE_UINT64>(dedupStats.manifests)));
+
+        ListingCache::Stats listingStats = ListingCache::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "Listing cache: %Q hits, %Q misses, %Q invalidations, "
+                 "%Q evictions, %Q watches (%Q bytes)\n",
+                 static_cast<ACE_UINT64>(listingStats.hits),
+                 static_cast<ACE_UINT64>(listingStats.misses),
+                 static_cast<ACE_UINT64>(listingStats.invalidations),
+                 static_cast<ACE_UINT64>(listingStats.evictions),
+                 static_cast<ACE_UINT64>(listingStats.watches),
+                 static_cast<ACE_UINT64>(listingStats.bytes)));
+
+        MetadataCache::Stats metadataStats = MetadataCache::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "Metadata cache: %Q hits, %Q misses, %Q invalidations, "
+                 "%Q evictions, %Q entries, %Q watches\n",
+                 static_cast<ACE_UINT64>(metadataStats.hits),
+                 static_cast<ACE_UINT64>(metadataStats.misses),
+                 static_cast<ACE_UINT64>(metadataStats.invalidations),
+                 static_cast<ACE_UINT64>(metadataStats.evictions),
+                 static_cast<ACE_UINT64>(metadataStats.entries),
+                 static_cast<ACE_UINT64>(metadataStats.watches)));
+
+        ChangeIndex::Stats changeStats = ChangeIndex::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "Change index: %Q queries, %Q builds, %Q fallbacks, "
+                 "%Q events, %Q overflows, %Q roots, %Q watches, %Q entries\n",
+                 static_cast<ACE_UINT64>(changeStats.queries),
+                 static_cast<ACE_UINT64>(changeStats.builds),
+                 static_cast<ACE_UINT64>(changeStats.fallbacks),
+                 static_cast<ACE_UINT64>(changeStats.events),
+                 static_cast<ACE_UINT64>(changeStats.overflows),
+                 static_cast<ACE_UINT64>(changeStats.roots),
+                 static_cast<ACE_UINT64>(changeStats.watches),
+                 static_cast<ACE_UINT64>(changeStats.entries)));
+
+        ChangeWatcher::Stats watchStats = ChangeWatcher::instance().stats();
+        ACE_DEBUG(
+                (LM_DEBUG,
+                 "Change watcher: %Q subscriptions, %Q events, %Q batches, "
+                 "%Q overflows, %Q active, %Q watches\n",
+                 static_cast<ACE_UINT64>(watchStats.subscriptions),
+                 static_cast<ACE_UINT64>(watchStats.events),
+                 static_cast<ACE_UINT64>(watchStats.batches),
+                 static_cast<ACE_UINT64>(watchStats.overflows),
+                 static_cast<ACE_UINT64>(watchStats.active),
+                 static_cast<ACE_UINT64>(watchStats.watches)));
 
         // 删除主接收器
         delete[] worker_tasks;
@@ -38,6 +38,27 @@ public:
         clientStream.close();
     }
     
+    // 发送数据后只关闭写方向，再接收对方的回应直到连接关闭
+    std::string exchangedata(const std::string& data) {
+        clientStream.send_n(data.c_str(), data.size());
+        clientStream.close_writer();
+        return recvdata();
+    }
+
+    // 发送数据但不关闭连接（块模式下连接留给下一次传输）
+    void sendraw(const std::string& data) {
+        clientStream.send_n(data.c_str(), data.size());
+    }
+
+    // 接收恰好 size 个字节，连接提前关闭时返回已收到的部分
+    std::string recvexact(size_t size) {
+        std::string receivedData(size, '\0');
+        size_t received = 0;
+        clientStream.recv_n(&receivedData[0], size, 0, &received);
+        receivedData.resize(received);
+        return receivedData;
+    }
+
     std::string recvdata() {
         std::string receivedData;
         char buffer[1024];  // 使用较大的缓冲区提高效率
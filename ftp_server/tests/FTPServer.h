@@ -1,5 +1,7 @@
 #include "MasterAcceptor.h"
 #include "ThreadPool.h"
+#include "MetadataExecutor.h"
+#include "ChangeWatcher.h"
 #include <ace/INET_Addr.h>
 #include "WorkerReactorTask.h"
 #include <ace/Reactor.h>
@@ -15,6 +17,7 @@ public:
         ACE_Reactor* reactor = new ACE_Reactor(tp_reactor); // 使用 TP_Reactor 构造 ACE_Reactor
         ACE_Reactor::instance(reactor);  // 将其设置为全局 Reactor
 
+        this->numWorkers = numWorkers;
         workerTasks = new WorkerReactorTask*[numWorkers];
         threadPool = new ThreadPool();
 
@@ -25,8 +28,9 @@ public:
             ACE_ERROR((LM_ERROR, "Failed to start worker task.\n"));
         }
     }
-        // 启动线程池
+        // 启动线程池；元数据线程池在上一个服务器析构时已关闭，按默认参数重新启动
         threadPool->open(numThreadPoolThreads);
+        MetadataExecutor::instance().configure(2, 8, 1024);
 
         // 初始化 MasterAcceptor 并监听端口
         acceptor = new MasterAcceptor(workerTasks, numWorkers, *threadPool);
@@ -42,14 +46,16 @@ public:
     }
 
     ~FTPServer() {
+        // 先关闭线程池与监视线程，它们的任务完成时仍会通知工作线程的 Reactor
+        threadPool->close();
+        MetadataExecutor::instance().close();
+        ChangeWatcher::instance().close();
+
         // 停止所有工作线程
         for (int i = 0; i < numWorkers; ++i) {
             workerTasks[i]->stop();
             delete workerTasks[i];
         }
-
-        // 关闭线程池
-        threadPool->close();
         delete[] workerTasks;
         delete threadPool;
         // 停止服务器线程
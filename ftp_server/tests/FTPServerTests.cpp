@@ -2,12 +2,38 @@
 #include "FTPClient.h"
 #include "FTPServer.h"
 #include "TestThreadpool.h"
+#include "BlockMode.h"
+#include "ChangeIndex.h"
+#include "ChangeWatcher.h"
+#include "CpuAffinity.h"
+#include "Coroutine.h"
+#include "DedupStore.h"
+#include "FastCdc.h"
+#include "FileCache.h"
+#include "FileHash.h"
+#include "HashCache.h"
+#include "IoUring.h"
+#include "ListingCache.h"
+#include "LocalFileSystem.h"
+#include "MemoryFileSystem.h"
+#include "MetadataCache.h"
+#include "MetadataExecutor.h"
+#include "PageCache.h"
+#include "RsyncDelta.h"
+#include "TarArchive.h"
+#include "UploadCommitter.h"
+#include <set>
 #include <thread>
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <sstream>
 #include <iomanip>
 #include <openssl/md5.h>
+#include <random>
+#include <poll.h>
+#include <sys/xattr.h>
+#include <zlib.h>
 
 // 定义测试类
 class FTPServerTest : public ::testing::Test {
@@ -233,6 +259,80 @@ TEST_F(FTPServerTest, Test_RMD) {
     ASSERT_NE(system("test -d testdir"), 0);
 }
 
+// 测试 RNFR/RNTO：改名文件与目录，RNTO 必须紧跟成功的 RNFR
+TEST_F(FTPServerTest, Test_RNFRRNTO) {
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    system("rm -rf renamedir && mkdir renamedir && echo data > renamedir/a.txt");
+
+    response = client.sendCommand("RNFR renamedir/a.txt\r\n");
+    ASSERT_EQ(response, "350 Ready for RNTO.\r\n");
+    response = client.sendCommand("RNTO renamedir/b.txt\r\n");
+    ASSERT_EQ(response, "250 Rename successful.\r\n");
+    ASSERT_NE(system("test -f renamedir/a.txt"), 0);
+    ASSERT_EQ(system("test -f renamedir/b.txt"), 0);
+    response = client.sendCommand("SIZE renamedir/b.txt\r\n");
+    ASSERT_EQ(response, "213 5\r\n");
+
+    // 目录改名后其下的路径随之改变
+    response = client.sendCommand("RNFR renamedir\r\n");
+    ASSERT_EQ(response, "350 Ready for RNTO.\r\n");
+    response = client.sendCommand("RNTO renamed\r\n");
+    ASSERT_EQ(response, "250 Rename successful.\r\n");
+    response = client.sendCommand("SIZE renamedir/b.txt\r\n");
+    ASSERT_TRUE(response.find("550") == 0);
+    response = client.sendCommand("SIZE renamed/b.txt\r\n");
+    ASSERT_EQ(response, "213 5\r\n");
+
+    response = client.sendCommand("RNTO renamed/c.txt\r\n");
+    ASSERT_EQ(response, "503 Bad sequence of commands.\r\n");
+    response = client.sendCommand("RNFR no_such_file\r\n");
+    ASSERT_TRUE(response.find("550") == 0);
+    response = client.sendCommand("RNTO renamed/c.txt\r\n");
+    ASSERT_EQ(response, "503 Bad sequence of commands.\r\n");
+    response = client.sendCommand("RNFR renamed/b.txt\r\n");
+    response = client.sendCommand("SIZE renamed/b.txt\r\n");
+    response = client.sendCommand("RNTO renamed/c.txt\r\n");
+    ASSERT_EQ(response, "503 Bad sequence of commands.\r\n");
+    system("rm -rf renamed");
+}
+
+// 测试 SITE COPY：服务器端复制，不留下临时文件
+TEST_F(FTPServerTest, Test_SITECopy) {
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    system("rm -rf copydir && mkdir -p copydir/sub && "
+           "head -c 3000000 /dev/urandom > copydir/src.bin && "
+           "echo old > copydir/sub/dst.bin");
+
+    response = client.sendCommand("SITE COPY copydir/src.bin copydir/sub/dst.bin\r\n");
+    ASSERT_TRUE(response.find("250 Copied 3000000 bytes to ") == 0);
+    ASSERT_TRUE(response.find("/copydir/sub/dst.bin (") != std::string::npos);
+    ASSERT_EQ(system("cmp -s copydir/src.bin copydir/sub/dst.bin"), 0);
+    ASSERT_EQ(system("test $(ls -A copydir/sub | wc -l) -eq 1"), 0);
+    response = client.sendCommand("SIZE copydir/sub/dst.bin\r\n");
+    ASSERT_EQ(response, "213 3000000\r\n");
+
+    // 带空格的路径加引号；空文件
+    system("touch 'copydir/empty file'");
+    response = client.sendCommand("SITE COPY \"copydir/empty file\" copydir/e2\r\n");
+    ASSERT_TRUE(response.find("250 Copied 0 bytes") == 0);
+    ASSERT_EQ(system("test -f copydir/e2"), 0);
+
+    response = client.sendCommand("SITE COPY copydir/none copydir/x\r\n");
+    ASSERT_EQ(response, "550 File not found.\r\n");
+    response = client.sendCommand("SITE COPY copydir/sub copydir/x\r\n");
+    ASSERT_EQ(response, "550 Not a regular file.\r\n");
+    response = client.sendCommand("SITE COPY copydir/src.bin\r\n");
+    ASSERT_TRUE(response.find("501") == 0);
+    ASSERT_EQ(system("test $(ls -A copydir | wc -l) -eq 4"), 0);
+    system("rm -rf copydir");
+}
+
 // 测试 TYPE 命令 (ASCII 模式)
 TEST_F(FTPServerTest, Test_TYPEASCII) {
     FTPClient client("127.0.0.1", port);
@@ -309,6 +409,119 @@ TEST_F(FTPServerTest, Test_SIZENotFound) {
     ASSERT_TRUE(response.find("550 File not found") != std::string::npos);
 }
 
+// 测试 MDTM 命令，以及 SIZE/MDTM 经过元数据缓存时外部修改与 DELE 立即可见
+TEST_F(FTPServerTest, Test_MDTM) {
+    MetadataCache::instance().configure(1024, 16, 0);
+    system("echo 'Test content' > mdtm_file.txt");
+    system("touch -d '2001-02-03 04:05:06 UTC' mdtm_file.txt");
+
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+
+    response = client.sendCommand("MDTM mdtm_file.txt\r\n");
+    ASSERT_TRUE(response.find("213 20010203040506\r\n") != std::string::npos);
+    response = client.sendCommand("SIZE mdtm_file.txt\r\n");
+    ASSERT_TRUE(response.find("213 13") != std::string::npos);
+
+    // 外部写入经 inotify 失效
+    system("echo 'more' >> mdtm_file.txt");
+    response = client.sendCommand("SIZE mdtm_file.txt\r\n");
+    ASSERT_TRUE(response.find("213 18") != std::string::npos);
+    response = client.sendCommand("MDTM mdtm_file.txt\r\n");
+    ASSERT_TRUE(response.find("213 2001") == std::string::npos);
+
+    response = client.sendCommand("DELE mdtm_file.txt\r\n");
+    ASSERT_TRUE(response.find("250 ") != std::string::npos);
+    response = client.sendCommand("MDTM mdtm_file.txt\r\n");
+    ASSERT_TRUE(response.find("550 File not found") != std::string::npos);
+
+    ASSERT_GT(MetadataCache::instance().stats().hits, 0u);
+    MetadataCache::instance().configure(0, 0, 0);
+}
+
+// 测试 CWD 只改变本会话的工作目录，之后的相对路径基于该目录
+TEST_F(FTPServerTest, Test_CWDPerSession) {
+    system("rm -rf cwd_test && mkdir cwd_test");
+    system("echo 'Test content' > cwd_test/inner.txt");
+    char pwd[PATH_MAX];
+    getcwd(pwd, sizeof(pwd));
+
+    FTPClient first("127.0.0.1", port);
+    FTPClient second("127.0.0.1", port);
+    std::string response = first.recvCommand();
+    response = second.recvCommand();
+    for (FTPClient* client : {&first, &second}) {
+        response = client->sendCommand("USER admin\r\n");
+        response = client->sendCommand("PASS admin\r\n");
+    }
+
+    response = first.sendCommand("CWD cwd_test\r\n");
+    ASSERT_TRUE(response.find("250 ") != std::string::npos);
+    response = first.sendCommand("SIZE inner.txt\r\n");
+    ASSERT_TRUE(response.find("213 13") != std::string::npos);
+    response = first.sendCommand("PWD\r\n");
+    ASSERT_TRUE(response.find("\"" + std::string(pwd) + "/cwd_test\"") !=
+                std::string::npos);
+
+    // 另一个会话的工作目录不受影响
+    response = second.sendCommand("PWD\r\n");
+    ASSERT_TRUE(response.find("\"" + std::string(pwd) + "\"") !=
+                std::string::npos);
+    response = second.sendCommand("SIZE inner.txt\r\n");
+    ASSERT_TRUE(response.find("550 File not found") != std::string::npos);
+
+    response = first.sendCommand("CWD inner.txt\r\n");
+    ASSERT_TRUE(response.find("550 ") != std::string::npos);
+    response = first.sendCommand("CWD ..\r\n");
+    ASSERT_TRUE(response.find("250 ") != std::string::npos);
+    response = first.sendCommand("SIZE cwd_test/inner.txt\r\n");
+    ASSERT_TRUE(response.find("213 13") != std::string::npos);
+
+    system("rm -rf cwd_test");
+}
+
+
+// 测试元数据线程池阻塞时控制连接仍然响应，元数据命令完成后按顺序回复
+TEST_F(FTPServerTest, Test_MetadataOffload) {
+    system("rm -rf meta_dir");
+    MetadataExecutor& executor = MetadataExecutor::instance();
+    executor.configure(1, 1, 16);
+
+    // 占住唯一的元数据线程，模拟卡住的存储
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    ASSERT_TRUE(executor.pool().enqueue([released] { released.wait(); }));
+
+    FTPClient first("127.0.0.1", port);
+    FTPClient second("127.0.0.1", port);
+    std::string response = first.recvCommand();
+    response = second.recvCommand();
+    for (FTPClient* client : {&first, &second}) {
+        response = client->sendCommand("USER admin\r\n");
+        response = client->sendCommand("PASS admin\r\n");
+    }
+
+    std::future<std::string> mkd = std::async(std::launch::async, [&first] {
+        return first.sendCommand("MKD meta_dir\r\n");
+    });
+    response = second.sendCommand("PWD\r\n");
+    ASSERT_TRUE(response.find("257 ") != std::string::npos);
+    ASSERT_EQ(mkd.wait_for(std::chrono::milliseconds(200)),
+              std::future_status::timeout);
+    ASSERT_NE(system("test -d meta_dir"), 0);
+
+    release.set_value();
+    response = mkd.get();
+    ASSERT_TRUE(response.find("257 Directory created") != std::string::npos);
+    response = first.sendCommand("CWD meta_dir\r\n");
+    ASSERT_TRUE(response.find("250 ") != std::string::npos);
+    response = first.sendCommand("RMD ../meta_dir\r\n");
+    ASSERT_TRUE(response.find("250 Directory deleted.") != std::string::npos);
+
+    executor.configure(2, 8, 1024);
+}
 
 // 测试 STOR 命令 (基于 PASV 模式)
 TEST_F(FTPServerTest, Test_STORPASV) {
@@ -518,6 +731,47 @@ TEST_F(FTPServerTest, Test_RETRLargeFile) {
 }
 
 
+// 测试 RETR 小文件缓存：第二次下载从内存发送，文件修改后重新读取
+TEST_F(FTPServerTest, Test_RETRCached) {
+    FileCache::instance().configure(1024 * 1024, 64 * 1024, 4);
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    // 刚修改的文件（1 秒内）不缓存
+    system("echo 'cached content' > cachedfile.txt");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    auto retr = [&]() {
+        std::string response = client.sendCommand("PASV\r\n");
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(response.substr(response.find('(') + 1).c_str(),
+               "%d,%d,%d,%d,%d,%d", &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        FTPClient dataClient("127.0.0.1", p1 * 256 + p2);
+        response = client.sendCommand("RETR cachedfile.txt\r\n");
+        EXPECT_TRUE(response.find("150") != std::string::npos);
+        std::string content = dataClient.recvdata();
+        response = client.recvCommand();
+        EXPECT_TRUE(response.find("226 Transfer complete") != std::string::npos);
+        return content;
+    };
+
+    ASSERT_EQ(retr(), "cached content\n");
+    FileCache::Stats before = FileCache::instance().stats();
+    ASSERT_EQ(before.entries, 1u);
+    ASSERT_EQ(retr(), "cached content\n");
+    ASSERT_EQ(FileCache::instance().stats().hits, before.hits + 1);
+
+    // 修改文件后缓存失效
+    system("echo 'changed content' > cachedfile.txt");
+    ASSERT_EQ(retr(), "changed content\n");
+
+    system("rm -f cachedfile.txt");
+    FileCache::instance().configure(0, 0);
+}
+
 // 测试 LIST 命令 (基于 PASV 模式)
 TEST_F(FTPServerTest, Test_LISTPASV) {
     FTPClient client("127.0.0.1", port);
@@ -571,6 +825,1914 @@ TEST_F(FTPServerTest, Test_LISTPASV) {
 }
 
 
+// 测试 MLSD/MLST 机器可读列表与 FEAT
+TEST_F(FTPServerTest, Test_MLSDAndMLST) {
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+
+    response = client.sendCommand("FEAT\r\n");
+    ASSERT_TRUE(response.find("211-") != std::string::npos);
+    ASSERT_TRUE(response.find(" MLST type*;size*;modify*;") != std::string::npos);
+
+    response = client.sendCommand("USER admin\r\n");
+    ASSERT_TRUE(response.find("331 Username okay") != std::string::npos);
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    system("echo 'Test content' > testfile2.txt");
+    system("mkdir testdir2");
+
+    // MLST 在控制连接上返回单个文件的事实
+    response = client.sendCommand("MLST testfile2.txt\r\n");
+    ASSERT_TRUE(response.find("250-") != std::string::npos);
+    ASSERT_TRUE(response.find(" type=file;size=13;modify=") != std::string::npos);
+    ASSERT_TRUE(response.find("250 End") != std::string::npos);
+
+    response = client.sendCommand("MLST no_such_file.txt\r\n");
+    ASSERT_TRUE(response.find("550") != std::string::npos);
+
+    // MLSD 通过数据连接返回目录中每个条目的事实
+    response = client.sendCommand("PASV\r\n");
+    ASSERT_TRUE(response.find("227 Entering Passive Mode") != std::string::npos);
+    int ip1, ip2, ip3, ip4, p1, p2;
+    std::string::size_type start = response.find('(');
+    sscanf(response.c_str() + start + 1, "%d,%d,%d,%d,%d,%d", &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+    FTPClient dataClient("127.0.0.1", p1 * 256 + p2);
+
+    response = client.sendCommand("MLSD\r\n");
+    ASSERT_TRUE(response.find("150 Here comes the directory listing") != std::string::npos);
+
+    std::string listContent = dataClient.recvCommand();
+    ASSERT_TRUE(listContent.find("type=file;size=13;") != std::string::npos);
+    ASSERT_TRUE(listContent.find("; testfile2.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(listContent.find("type=dir;") != std::string::npos);
+    ASSERT_TRUE(listContent.find("; testdir2\r\n") != std::string::npos);
+
+    response = client.recvCommand();
+    ASSERT_TRUE(response.find("226 Directory send OK") != std::string::npos);
+
+    system("rm -f testfile2.txt");
+    system("rm -rf testdir2");
+}
+
+
+// 测试 SITE 分页列表：按游标逐页读取，合起来正好是整个目录
+TEST_F(FTPServerTest, Test_SITEPagedList) {
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    ASSERT_TRUE(response.find("331 Username okay") != std::string::npos);
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    system("rm -rf pagedir && mkdir pagedir");
+    for (int i = 0; i < 5; ++i) {
+        system(("touch pagedir/page" + std::to_string(i) + ".txt").c_str());
+    }
+
+    response = client.sendCommand("SITE MLSD x 2 pagedir\r\n");
+    ASSERT_TRUE(response.find("501") != std::string::npos);
+
+    std::set<std::string> names;
+    std::string cursor = "0";
+    int pages = 0;
+    while (cursor != "end" && pages < 10) {
+        response = client.sendCommand("PASV\r\n");
+        ASSERT_TRUE(response.find("227 Entering Passive Mode") != std::string::npos);
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(response.c_str() + response.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        FTPClient dataClient("127.0.0.1", p1 * 256 + p2);
+
+        response = client.sendCommand("SITE MLSD " + cursor + " 2 pagedir\r\n");
+        ASSERT_TRUE(response.find("150") != std::string::npos);
+        if (response.find("226") == std::string::npos) {
+            response += client.recvCommand();
+        }
+        size_t at = response.find("226 Directory send OK; cursor=");
+        ASSERT_NE(at, std::string::npos);
+        cursor = response.substr(at + 30, response.find('\r', at) - at - 30);
+
+        // 每页最多 2 条
+        std::string page = dataClient.recvCommand();
+        int lines = 0;
+        for (size_t pos = page.find("; "); pos != std::string::npos;
+             pos = page.find("; ", pos + 2)) {
+            size_t eol = page.find("\r\n", pos);
+            std::string name = page.substr(pos + 2, eol - pos - 2);
+            ASSERT_TRUE(names.insert(name).second) << name;
+            ++lines;
+        }
+        ASSERT_LE(lines, 2);
+        ++pages;
+    }
+    ASSERT_EQ(cursor, "end");
+    ASSERT_EQ(names.size(), 5u);
+    ASSERT_GE(pages, 3);
+
+    system("rm -rf pagedir");
+}
+
+
+// 测试递归列表：SITE TREE 的层数限制与 LIST -R 的目录分组
+TEST_F(FTPServerTest, Test_SITETree) {
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    ASSERT_TRUE(response.find("331 Username okay") != std::string::npos);
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    system("rm -rf treedir && mkdir -p treedir/sub1/sub2 treedir/sub3");
+    system("touch treedir/f0.txt treedir/sub1/f1.txt treedir/sub1/sub2/f2.txt "
+           "treedir/sub3/f3.txt");
+
+    // 发送列表命令，返回数据连接上的全部内容
+    auto list = [&client](const std::string& command) {
+        std::string response = client.sendCommand("PASV\r\n");
+        EXPECT_TRUE(response.find("227 Entering Passive Mode") != std::string::npos);
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(response.c_str() + response.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        FTPClient dataClient("127.0.0.1", p1 * 256 + p2);
+        response = client.sendCommand(command);
+        EXPECT_TRUE(response.find("150") != std::string::npos);
+        std::string content = dataClient.recvdata();
+        if (response.find("226") == std::string::npos) {
+            response = client.recvCommand();
+        }
+        EXPECT_TRUE(response.find("226 Directory send OK") != std::string::npos);
+        return content;
+    };
+
+    std::string tree = list("SITE TREE 0 treedir\r\n");
+    ASSERT_TRUE(tree.find("type=file;size=0;") != std::string::npos);
+    ASSERT_TRUE(tree.find("; f0.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(tree.find("; sub1/f1.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(tree.find("; sub1/sub2/f2.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(tree.find("; sub3/f3.txt\r\n") != std::string::npos);
+
+    // 两层：列出 sub1/sub2 本身，但不进入
+    tree = list("SITE TREE 2 treedir\r\n");
+    ASSERT_TRUE(tree.find("; sub1/sub2\r\n") != std::string::npos);
+    ASSERT_TRUE(tree.find("sub1/sub2/f2.txt") == std::string::npos);
+
+    tree = list("LIST -lR treedir\r\n");
+    ASSERT_EQ(tree.find(".:\r\n"), 0u);
+    size_t sub2 = tree.find("\r\n./sub1/sub2:\r\n");
+    ASSERT_NE(sub2, std::string::npos);
+    ASSERT_NE(tree.find("f2.txt", sub2), std::string::npos);
+
+    system("rm -rf treedir");
+}
+
+
+// 测试 SITE CHANGES：以上次回复的 now 为起始时间，只列出其后修改和删除的条目
+TEST_F(FTPServerTest, Test_SITEChanges) {
+    ChangeIndex::instance().configure(16, 1024, 65536, 1024);
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    system("rm -rf changedir && mkdir -p changedir/sub");
+    system("touch changedir/keep.txt changedir/gone.txt changedir/sub/edit.txt");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20)); // 拉开时间戳的时钟周期
+
+    // 发送变更查询，返回数据连接上的内容，reply 为完成回复
+    auto changes = [&client](const std::string& command, std::string& reply) {
+        std::string response = client.sendCommand("PASV\r\n");
+        EXPECT_TRUE(response.find("227 Entering Passive Mode") != std::string::npos);
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(response.c_str() + response.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        FTPClient dataClient("127.0.0.1", p1 * 256 + p2);
+        response = client.sendCommand(command);
+        EXPECT_TRUE(response.find("150") != std::string::npos);
+        std::string content = dataClient.recvdata();
+        if (response.find("226") == std::string::npos) {
+            response = client.recvCommand();
+        }
+        reply = response.substr(response.find("226"));
+        return content;
+    };
+
+    std::string reply;
+    std::string all = changes("SITE CHANGES 19700101000000 -R changedir\r\n", reply);
+    ASSERT_TRUE(all.find("; keep.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(all.find("; sub/edit.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(reply.find("226 Changes sent; now=") == 0);
+    ASSERT_TRUE(reply.find("deletions=incomplete") != std::string::npos);
+    std::string now = reply.substr(22, reply.find_first_of(";\r", 22) - 22);
+    ASSERT_EQ(now.size(), 24u);
+
+    system("echo edited >> changedir/sub/edit.txt && rm changedir/gone.txt");
+    std::string changed = changes("SITE CHANGES " + now + " -R changedir\r\n", reply);
+    ASSERT_TRUE(changed.find("type=file;size=7;") != std::string::npos);
+    ASSERT_TRUE(changed.find("; sub/edit.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(changed.find("type=deleted; gone.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(changed.find("keep.txt") == std::string::npos);
+    ASSERT_TRUE(reply.find("deletions=incomplete") == std::string::npos);
+
+    // 不带 -R 时只列出直接子项
+    changed = changes("SITE CHANGES " + now + " changedir\r\n", reply);
+    ASSERT_TRUE(changed.find("gone.txt") != std::string::npos);
+    ASSERT_TRUE(changed.find("edit.txt") == std::string::npos);
+
+    response = client.sendCommand("SITE CHANGES yesterday\r\n");
+    ASSERT_TRUE(response.find("501 Usage") != std::string::npos);
+
+    system("rm -rf changedir");
+    ChangeIndex::instance().configure(0, 0, 0, 0);
+}
+
+// 测试 SITE WATCH：变更在批次内合并后推送到控制连接
+TEST_F(FTPServerTest, Test_SITEWatch) {
+    ChangeWatcher::instance().configure(1024, 50, 1000);
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    system("rm -rf watchdir && mkdir -p watchdir/sub && touch watchdir/old.txt");
+    response = client.sendCommand("SITE WATCH -R watchdir\r\n");
+    ASSERT_TRUE(response.find("200 Watching") == 0);
+    ASSERT_TRUE(response.find("watchdir recursively.") != std::string::npos);
+    response = client.sendCommand("SITE WATCH watchdir\r\n");
+    ASSERT_TRUE(response.find("503") == 0);
+
+    system("touch watchdir/new.txt && echo x >> watchdir/new.txt && "
+           "touch watchdir/tmp.txt && rm watchdir/tmp.txt && rm watchdir/old.txt && "
+           "echo y > watchdir/sub/inner.txt && mkdir watchdir/sub/deep && "
+           "touch watchdir/sub/deep/leaf.txt");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    std::string notices;
+    while (notices.size() < 9 ||
+           notices.compare(notices.size() - 9, 9, "211 End\r\n") != 0) {
+        std::string part = client.recvCommand();
+        ASSERT_FALSE(part.empty());
+        notices += part;
+    }
+    ASSERT_TRUE(notices.find("211-Changes under ") == 0);
+    ASSERT_TRUE(notices.find(" created new.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(notices.find("modified new.txt") == std::string::npos);
+    ASSERT_TRUE(notices.find("tmp.txt") == std::string::npos);
+    ASSERT_TRUE(notices.find(" deleted old.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(notices.find(" created sub/inner.txt\r\n") != std::string::npos);
+    ASSERT_TRUE(notices.find(" created sub/deep\r\n") != std::string::npos);
+    ASSERT_TRUE(notices.find(" created sub/deep/leaf.txt\r\n") != std::string::npos);
+
+    // 传输期间的变更在 226 之后才推送
+    system("head -c 33554432 /dev/zero > watchbig.bin");
+    response = client.sendCommand("PASV\r\n");
+    ASSERT_TRUE(response.find("227 Entering Passive Mode") != std::string::npos);
+    int ip1, ip2, ip3, ip4, p1, p2;
+    sscanf(response.substr(response.find('(') + 1).c_str(), "%d,%d,%d,%d,%d,%d",
+           &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+    FTPClient dataClient("127.0.0.1", p1 * 256 + p2);
+    response = client.sendCommand("RETR watchbig.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    system("touch watchdir/during.txt");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_EQ(dataClient.recvdata().size(), 33554432u);
+    std::string replies;
+    while (replies.size() < 9 ||
+           replies.compare(replies.size() - 9, 9, "211 End\r\n") != 0) {
+        std::string part = client.recvCommand();
+        ASSERT_FALSE(part.empty());
+        replies += part;
+    }
+    ASSERT_TRUE(replies.find("226") == 0);
+    ASSERT_TRUE(replies.find(" created during.txt\r\n") != std::string::npos);
+    system("rm -f watchbig.bin");
+
+    response = client.sendCommand("SITE UNWATCH\r\n");
+    ASSERT_TRUE(response.find("200 Watch ended.") == 0);
+    response = client.sendCommand("SITE UNWATCH\r\n");
+    ASSERT_TRUE(response.find("503") == 0);
+
+    // 取消后不再推送
+    system("touch watchdir/after.txt");
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    response = client.sendCommand("PWD\r\n");
+    ASSERT_TRUE(response.find("257") == 0);
+    ASSERT_EQ(ChangeWatcher::instance().stats().watches, 0u);
+
+    system("rm -rf watchdir");
+    ChangeWatcher::instance().configure(0, 0, 0);
+}
+
+// 测试校验命令：摘要与本地计算一致，重复校验命中缓存
+TEST_F(FTPServerTest, Test_Checksums) {
+    HashCache::instance().configure(1024, false);
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    // 超过一个计算分段，mtime 设为过去使结果可以缓存
+    system("head -c 20000000 /dev/urandom > hashfile.bin && "
+           "touch -m -d '10 seconds ago' hashfile.bin");
+    std::ifstream file("hashfile.bin", std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    ASSERT_EQ(content.size(), 20000000u);
+
+    std::string md5 = "250 " + calculateMD5("hashfile.bin") + "\r\n";
+    response = client.sendCommand("XMD5 hashfile.bin\r\n");
+    ASSERT_EQ(response, md5);
+    uint64_t hits = HashCache::instance().stats().hits;
+    response = client.sendCommand("XMD5 hashfile.bin\r\n");
+    ASSERT_EQ(response, md5);
+    ASSERT_EQ(HashCache::instance().stats().hits, hits + 1);
+
+    // HASH 默认 SHA-256，与 sha256sum 一致
+    char sha[65] = {0};
+    FILE* pipe = popen("sha256sum hashfile.bin", "r");
+    ASSERT_TRUE(pipe != nullptr);
+    ASSERT_EQ(fread(sha, 1, 64, pipe), 64u);
+    pclose(pipe);
+    response = client.sendCommand("HASH hashfile.bin\r\n");
+    ASSERT_TRUE(response.find("213 SHA-256 0-19999999 " + std::string(sha) + " /") == 0);
+    ASSERT_TRUE(response.find("/hashfile.bin\r\n") != std::string::npos);
+
+    response = client.sendCommand("OPTS HASH crc32c\r\n");
+    ASSERT_EQ(response, "200 CRC32C\r\n");
+    char crc[16];
+    snprintf(crc, sizeof(crc), "%08x", crc32c(0, content.data(), content.size()));
+    response = client.sendCommand("HASH hashfile.bin\r\n");
+    ASSERT_TRUE(response.find("213 CRC32C 0-19999999 " + std::string(crc) + " ") == 0);
+    response = client.sendCommand("FEAT\r\n");
+    ASSERT_TRUE(response.find(" HASH CRC32;CRC32C*;MD5;SHA-1;SHA-256;SHA-512\r\n") !=
+                std::string::npos);
+
+    // XCRC 区间为 [start, end)
+    snprintf(crc, sizeof(crc), "%08x", crc32_ieee(0, content.data() + 10, 20));
+    response = client.sendCommand("XCRC \"hashfile.bin\" 10 30\r\n");
+    ASSERT_EQ(response, "250 " + std::string(crc) + "\r\n");
+
+    // 持久化到扩展属性：清空内存缓存后仍可命中（文件系统不支持时跳过）
+    HashCache::instance().configure(1024, true);
+    response = client.sendCommand("XMD5 hashfile.bin\r\n");
+    ASSERT_EQ(response, md5);
+    char stored[256];
+    if (getxattr("hashfile.bin", "user.ftp_server.md5", stored, sizeof(stored)) > 0) {
+        HashCache::instance().configure(1024, true);
+        response = client.sendCommand("XMD5 hashfile.bin\r\n");
+        ASSERT_EQ(response, md5);
+        ASSERT_EQ(HashCache::instance().stats().xattrHits, 1u);
+    }
+
+    response = client.sendCommand("XSHA256 no_such_file.bin\r\n");
+    ASSERT_TRUE(response.find("550") == 0);
+    response = client.sendCommand("XCRC \"hashfile.bin\" 30 10\r\n");
+    ASSERT_TRUE(response.find("501") == 0);
+    response = client.sendCommand("OPTS HASH SHA-3\r\n");
+    ASSERT_TRUE(response.find("504") == 0);
+
+    system("rm -f hashfile.bin");
+    HashCache::instance().configure(0, false);
+}
+
+// 测试 STOR 边接收边计算摘要：226 回复附带摘要，之后的 HASH 命中缓存
+TEST_F(FTPServerTest, Test_STORChecksum) {
+    HashCache::instance().configure(1024, false);
+    HashCache::instance().set_upload_algorithm(HashAlgorithm::SHA256);
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    // 多个传输块，最后一块不满
+    std::string content;
+    for (int i = 0; i < 3 * 1024 * 1024 + 1234; ++i) {
+        content += static_cast<char>((i * 131) >> 3);
+    }
+    std::ofstream("stor_hash_src.bin", std::ios::binary) << content;
+    char sha[65] = {0};
+    FILE* pipe = popen("sha256sum stor_hash_src.bin", "r");
+    ASSERT_TRUE(pipe != nullptr);
+    ASSERT_EQ(fread(sha, 1, 64, pipe), 64u);
+    pclose(pipe);
+
+    response = client.sendCommand("PASV\r\n");
+    ASSERT_TRUE(response.find("227 Entering Passive Mode") != std::string::npos);
+    int ip1, ip2, ip3, ip4, p1, p2;
+    sscanf(response.c_str() + response.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+           &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+    FTPClient dataClient("127.0.0.1", p1 * 256 + p2);
+    response = client.sendCommand("STOR stor_hash.bin\r\n");
+    ASSERT_TRUE(response.find("150 Opening data connection") != std::string::npos);
+    dataClient.senddata(content);
+    response = client.recvCommand();
+    ASSERT_EQ(response, "226 Transfer complete; SHA-256=" + std::string(sha) + "\r\n");
+
+    // 摘要已插入缓存，刚上传的文件校验时不再读取
+    uint64_t hits = HashCache::instance().stats().hits;
+    response = client.sendCommand("HASH stor_hash.bin\r\n");
+    ASSERT_TRUE(response.find(" " + std::string(sha) + " ") != std::string::npos);
+    ASSERT_EQ(HashCache::instance().stats().hits, hits + 1);
+
+    system("rm -f stor_hash.bin stor_hash_src.bin");
+    HashCache::instance().set_upload_algorithm(std::nullopt);
+    HashCache::instance().configure(0, false);
+}
+
+// 测试原子上传与组提交：同时完成的两个上传在一批中落盘，不留下临时文件
+TEST_F(FTPServerTest, Test_STORAtomicGroupCommit) {
+    UploadCommitter::instance().configure(
+            true, UploadDurability::GROUP, std::chrono::milliseconds(300), 64);
+    UploadCommitter::Stats before = UploadCommitter::instance().stats();
+    system("rm -rf atomicdir && mkdir atomicdir && echo old > atomicdir/a.txt");
+
+    FTPClient first("127.0.0.1", port);
+    FTPClient second("127.0.0.1", port);
+    std::unique_ptr<FTPClient> data[2];
+    FTPClient* clients[2] = {&first, &second};
+    const char* names[2] = {"a.txt", "b.txt"};
+    for (int i = 0; i < 2; ++i) {
+        FTPClient& client = *clients[i];
+        std::string response = client.recvCommand();
+        response = client.sendCommand("USER admin\r\n");
+        response = client.sendCommand("PASS admin\r\n");
+        ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+        response = client.sendCommand("PASV\r\n");
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(response.c_str() + response.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        data[i] = std::make_unique<FTPClient>("127.0.0.1", p1 * 256 + p2);
+        response = client.sendCommand(
+                "STOR atomicdir/" + std::string(names[i]) + "\r\n");
+        ASSERT_TRUE(response.find("150 Opening data connection") != std::string::npos);
+    }
+    data[0]->senddata("first upload");
+    data[1]->senddata("second upload");
+    ASSERT_TRUE(first.recvCommand().find("226 Transfer complete") == 0);
+    ASSERT_TRUE(second.recvCommand().find("226 Transfer complete") == 0);
+
+    std::ifstream a("atomicdir/a.txt");
+    std::string content((std::istreambuf_iterator<char>(a)),
+                        std::istreambuf_iterator<char>());
+    ASSERT_EQ(content, "first upload");
+    std::ifstream b("atomicdir/b.txt");
+    content.assign((std::istreambuf_iterator<char>(b)),
+                   std::istreambuf_iterator<char>());
+    ASSERT_EQ(content, "second upload");
+    ASSERT_EQ(system("test $(ls -A atomicdir | wc -l) -eq 2"), 0);
+
+    UploadCommitter::Stats after = UploadCommitter::instance().stats();
+    ASSERT_EQ(after.commits, before.commits + 2);
+    ASSERT_EQ(after.syncs, before.syncs + 2);
+    ASSERT_EQ(after.batches, before.batches + 1);
+    ASSERT_EQ(after.failures, before.failures);
+
+    system("rm -rf atomicdir");
+    UploadCommitter::instance().configure(
+            false, UploadDurability::NONE, std::chrono::microseconds(2000), 64);
+}
+
+// 测试去重上传：插入数据后大部分分块共享，下载、校验、复制按清单读取
+TEST_F(FTPServerTest, Test_STORDedup) {
+    ASSERT_EQ(DedupStore::instance().configure(
+            "dedup_chunks", 16 * 1024, 64 * 1024, 256 * 1024), 0);
+    system("rm -rf dedupdir && mkdir dedupdir");
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+
+    auto open_data = [&client]() {
+        std::string reply = client.sendCommand("PASV\r\n");
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(reply.c_str() + reply.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        return std::make_unique<FTPClient>("127.0.0.1", p1 * 256 + p2);
+    };
+    auto upload = [&](const std::string& name, const std::string& data) {
+        std::unique_ptr<FTPClient> dataClient = open_data();
+        std::string reply = client.sendCommand("STOR dedupdir/" + name + "\r\n");
+        EXPECT_TRUE(reply.find("150 Opening data connection") != std::string::npos);
+        dataClient->senddata(data);
+        return client.recvCommand();
+    };
+
+    std::mt19937 random(42);
+    std::string content(2 * 1024 * 1024, '\0');
+    for (char& c : content) {
+        c = static_cast<char>(random());
+    }
+    DedupStore::Stats before = DedupStore::instance().stats();
+    ASSERT_TRUE(upload("a.bin", content).find("226 Transfer complete") == 0);
+    DedupStore::Stats first = DedupStore::instance().stats();
+    uint64_t chunks = first.chunksStored - before.chunksStored;
+    ASSERT_GT(chunks, 8u);
+    ASSERT_EQ(first.bytesStored - before.bytesStored, content.size());
+
+    // 开头插入数据：只有第一个分块改变
+    std::string shifted = "inserted" + content;
+    ASSERT_TRUE(upload("b.bin", shifted).find("226 Transfer complete") == 0);
+    DedupStore::Stats second = DedupStore::instance().stats();
+    ASSERT_GE(second.chunksShared - first.chunksShared, chunks - 2);
+    ASSERT_LT(second.bytesStored - first.bytesStored, 512u * 1024);
+    ASSERT_EQ(second.manifests, first.manifests + 1);
+
+    // 文件只保存清单，元数据为逻辑大小
+    char value[32];
+    ASSERT_GT(getxattr("dedupdir/b.bin", "user.ftp_server.manifest",
+                       value, sizeof(value)), 0);
+    response = client.sendCommand("SIZE dedupdir/b.bin\r\n");
+    ASSERT_EQ(response, "213 " + std::to_string(shifted.size()) + "\r\n");
+
+    std::unique_ptr<FTPClient> dataClient = open_data();
+    response = client.sendCommand("RETR dedupdir/b.bin\r\n");
+    ASSERT_TRUE(response.find("150 Opening data connection") != std::string::npos);
+    ASSERT_TRUE(dataClient->recvdata() == shifted);
+    ASSERT_TRUE(client.recvCommand().find("226 Transfer complete") == 0);
+
+    Hasher sha(HashAlgorithm::SHA256);
+    sha.update(content.data(), content.size());
+    response = client.sendCommand("HASH dedupdir/a.bin\r\n");
+    ASSERT_TRUE(response.find(" " + sha.finish() + " ") != std::string::npos);
+
+    response = client.sendCommand("SITE COPY dedupdir/a.bin dedupdir/c.bin\r\n");
+    ASSERT_TRUE(response.find("(manifest).") != std::string::npos);
+    dataClient = open_data();
+    response = client.sendCommand("RETR dedupdir/c.bin\r\n");
+    ASSERT_TRUE(dataClient->recvdata() == content);
+    ASSERT_TRUE(client.recvCommand().find("226 Transfer complete") == 0);
+
+    // 小文件直接保存数据
+    ASSERT_TRUE(upload("small.txt", "small file").find("226 Transfer complete") == 0);
+    std::ifstream small("dedupdir/small.txt");
+    std::string text((std::istreambuf_iterator<char>(small)),
+                     std::istreambuf_iterator<char>());
+    ASSERT_EQ(text, "small file");
+
+    system("rm -rf dedupdir dedup_chunks");
+    DedupStore::instance().configure("", 0, 0, 0);
+}
+
+// 测试增量传输：下载签名后上传增量修改文件；上传签名后下载增量
+TEST_F(FTPServerTest, Test_SITEDelta) {
+    system("rm -rf deltadir && mkdir deltadir");
+    std::mt19937 random(1);
+    std::string basis(1024 * 1024 + 777, '\0');
+    for (char& c : basis) {
+        c = static_cast<char>(random());
+    }
+    std::ofstream("deltadir/f.bin", std::ios::binary) << basis;
+    std::string changed = basis.substr(0, 300000) + "inserted bytes" +
+                          basis.substr(300000, 400000) + std::string(5000, 'x') +
+                          basis.substr(705000);
+
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+    auto open_data = [&client]() {
+        std::string reply = client.sendCommand("PASV\r\n");
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(reply.c_str() + reply.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        return std::make_unique<FTPClient>("127.0.0.1", p1 * 256 + p2);
+    };
+
+    // 服务器文件的签名
+    std::unique_ptr<FTPClient> data = open_data();
+    response = client.sendCommand("SITE SIGNATURE 0 deltadir/f.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    std::string text = data->recvdata();
+    response = client.recvCommand();
+    ASSERT_TRUE(response.find("226 Signature sent") == 0);
+    DeltaSignature signature;
+    ASSERT_EQ(signature.parse(text), 0);
+    ASSERT_EQ(signature.size(), static_cast<off_t>(basis.size()));
+
+    // 上传增量，服务器以现有文件为基准生成新内容
+    DeltaEncoder encoder(signature);
+    std::string delta;
+    encoder.update(changed.data(), changed.size(), delta);
+    encoder.finish(delta);
+    ASSERT_LT(delta.size(), 64u * 1024);
+    data = open_data();
+    response = client.sendCommand("SITE PATCH deltadir/f.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    data->senddata(delta);
+    response = client.recvCommand();
+    ASSERT_TRUE(response.find("226 Patched " + std::to_string(changed.size())) == 0);
+    std::ifstream patched("deltadir/f.bin", std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(patched)),
+                        std::istreambuf_iterator<char>());
+    ASSERT_TRUE(content == changed);
+    ASSERT_EQ(system("test $(ls -A deltadir | wc -l) -eq 1"), 0);
+
+    // 内容不符的增量被拒绝，文件不变
+    std::string bad = delta;
+    bad[bad.size() - 2] = bad[bad.size() - 2] == '0' ? '1' : '0';
+    data = open_data();
+    response = client.sendCommand("SITE PATCH deltadir/f.bin\r\n");
+    data->senddata(bad);
+    response = client.recvCommand();
+    ASSERT_EQ(response, "451 Invalid delta; file not patched.\r\n");
+    ASSERT_EQ(system("test $(ls -A deltadir | wc -l) -eq 1"), 0);
+
+    // 下载：客户端持有旧内容，发送签名后接收增量
+    size_t blockSize = DeltaSignature::default_block_size(basis.size());
+    std::string local = DeltaSignature::header(blockSize, basis.size());
+    DeltaSignature::append_blocks(basis.data(), basis.size(), blockSize, local);
+    data = open_data();
+    response = client.sendCommand("SITE DELTA deltadir/f.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    std::string download = data->exchangedata(local);
+    response = client.recvCommand();
+    ASSERT_TRUE(response.find("226 Delta sent") == 0);
+    ASSERT_LT(download.size(), 64u * 1024);
+
+    FILE* result = tmpfile();
+    ASSERT_TRUE(result != nullptr);
+    DeltaPatcher patcher(
+            [&basis](char* buffer, size_t size, off_t offset) -> ssize_t {
+                size_t n = std::min(size, basis.size() - static_cast<size_t>(offset));
+                memcpy(buffer, basis.data() + offset, n);
+                return static_cast<ssize_t>(n);
+            },
+            basis.size(), fileno(result));
+    ASSERT_EQ(patcher.feed(download.data(), download.size()), 0);
+    ASSERT_EQ(patcher.finish(), 0);
+    ASSERT_EQ(patcher.size(), static_cast<off_t>(changed.size()));
+    fclose(result);
+
+    response = client.sendCommand("SITE PATCH\r\n");
+    ASSERT_TRUE(response.find("501") == 0);
+    system("rm -rf deltadir");
+}
+
+// 测试 SITE TAR：一个数据连接发送整个目录树，系统 tar 解出的内容与原文件一致
+TEST_F(FTPServerTest, Test_SITETar) {
+    system("rm -rf tardir tarout && mkdir -p tardir/small tardir/empty tarout");
+    for (int i = 0; i < 300; ++i) {
+        std::ofstream("tardir/small/f" + std::to_string(i) + ".txt")
+                << "file " << i << std::string(i * 7, 'x');
+    }
+    std::mt19937 random(3);
+    std::string large(3 * 1024 * 1024 + 123, '\0');
+    for (char& c : large) {
+        c = static_cast<char>(random());
+    }
+    std::ofstream("tardir/large.bin", std::ios::binary) << large;
+    std::ofstream("tardir/" + std::string(120, 'n') + ".txt") << "long name";
+    std::ofstream("tardir/with space.txt") << "space";
+
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+    auto open_data = [&client]() {
+        std::string reply = client.sendCommand("PASV\r\n");
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(reply.c_str() + reply.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        return std::make_unique<FTPClient>("127.0.0.1", p1 * 256 + p2);
+    };
+
+    // 整个目录，包括空目录、大文件、长文件名
+    std::unique_ptr<FTPClient> data = open_data();
+    response = client.sendCommand("SITE TAR tardir\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    std::string archive = data->recvdata();
+    response = client.recvCommand();
+    ASSERT_EQ(response, "226 Archive sent; 303 files.\r\n");
+    std::ofstream("tarout/all.tar", std::ios::binary) << archive;
+    ASSERT_EQ(system("tar -xf tarout/all.tar -C tarout && diff -r tardir tarout/tardir"), 0);
+
+    // 通配符与 gzip 压缩
+    system("rm -rf tarout && mkdir tarout");
+    data = open_data();
+    response = client.sendCommand("SITE TAR -z \"tardir/with space.txt\" tardir/small/f1*.txt\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    archive = data->recvdata();
+    response = client.recvCommand();
+    ASSERT_EQ(response, "226 Archive sent; 112 files.\r\n");
+    std::ofstream("tarout/some.tgz", std::ios::binary) << archive;
+    ASSERT_EQ(system("tar -xzf tarout/some.tgz -C tarout && "
+                     "test $(ls tarout/tardir/small | wc -l) -eq 111 && "
+                     "cmp tardir/small/f150.txt tarout/tardir/small/f150.txt && "
+                     "cmp \"tardir/with space.txt\" \"tarout/tardir/with space.txt\""), 0);
+
+    data = open_data();
+    response = client.sendCommand("SITE TAR tardir/none*\r\n");
+    ASSERT_EQ(response, "550 No files matched.\r\n");
+    data = open_data();
+    response = client.sendCommand("SITE TAR tardir/missing\r\n");
+    ASSERT_EQ(response, "550 File not found.\r\n");
+    response = client.sendCommand("SITE TAR -z\r\n");
+    ASSERT_TRUE(response.find("501") == 0);
+    system("rm -rf tardir tarout");
+}
+
+// 测试 SITE UNTAR：一个数据连接上传系统 tar 生成的归档，解出的内容与原目录一致
+TEST_F(FTPServerTest, Test_SITEUntar) {
+    system("rm -rf untarsrc untardst && mkdir -p untarsrc/tree/small untarsrc/tree/empty untardst");
+    for (int i = 0; i < 300; ++i) {
+        std::ofstream("untarsrc/tree/small/f" + std::to_string(i) + ".txt")
+                << "file " << i << std::string(i * 11, 'y');
+    }
+    std::mt19937 random(4);
+    std::string large(2 * 1024 * 1024 + 4321, '\0');
+    for (char& c : large) {
+        c = static_cast<char>(random());
+    }
+    std::ofstream("untarsrc/tree/large.bin", std::ios::binary) << large;
+    std::ofstream("untarsrc/tree/" + std::string(130, 'n') + ".txt") << "long name";
+    std::ofstream("untarsrc/tree/zero.txt");
+    system("touch -d '2020-01-02 03:04:05' untarsrc/tree/zero.txt");
+    ASSERT_EQ(system("tar -cf untarsrc/tree.tar -C untarsrc tree && "
+                     "tar -czf untarsrc/tree.tgz -C untarsrc tree"), 0);
+    auto read_file = [](const std::string& name) {
+        std::ifstream in(name, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)),
+                           std::istreambuf_iterator<char>());
+    };
+
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+    auto open_data = [&client]() {
+        std::string reply = client.sendCommand("PASV\r\n");
+        int ip1, ip2, ip3, ip4, p1, p2;
+        sscanf(reply.c_str() + reply.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+               &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+        return std::make_unique<FTPClient>("127.0.0.1", p1 * 256 + p2);
+    };
+
+    // GNU 格式（长文件名为 ././@LongLink），大文件分段并行写入
+    std::unique_ptr<FTPClient> data = open_data();
+    response = client.sendCommand("SITE UNTAR untardst\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    data->senddata(read_file("untarsrc/tree.tar"));
+    response = client.recvCommand();
+    ASSERT_EQ(response, "226 Extracted 303 files, 3 directories.\r\n");
+    ASSERT_EQ(system("diff -r untarsrc/tree untardst/tree"), 0);
+    struct stat extracted;
+    struct stat original;
+    ASSERT_EQ(stat("untardst/tree/zero.txt", &extracted), 0);
+    ASSERT_EQ(stat("untarsrc/tree/zero.txt", &original), 0);
+    ASSERT_EQ(extracted.st_size, 0);
+    ASSERT_EQ(extracted.st_mtime, original.st_mtime);
+
+    // gzip 压缩，解出到工作目录，已存在的文件被覆盖
+    system("echo changed > untardst/tree/small/f7.txt");
+    ASSERT_TRUE(client.sendCommand("CWD untardst\r\n").find("250") == 0);
+    data = open_data();
+    response = client.sendCommand("SITE UNTAR -z\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    data->senddata(read_file("untarsrc/tree.tgz"));
+    response = client.recvCommand();
+    ASSERT_EQ(response, "226 Extracted 303 files, 3 directories.\r\n");
+    ASSERT_EQ(system("diff -r untarsrc/tree untardst/tree"), 0);
+
+    // 越出目标目录的成员跳过，同名文件后者覆盖前者
+    TarMember member;
+    member.name = "../escape.txt";
+    member.size = 4;
+    std::string archive = TarArchive::header(member) + "evil" +
+                          std::string(TarArchive::padding(4), '\0');
+    member.name = "/twice.txt";
+    member.size = 5;
+    archive += TarArchive::header(member) + "first" +
+               std::string(TarArchive::padding(5), '\0');
+    member.name = "twice.txt";
+    member.size = 6;
+    archive += TarArchive::header(member) + "second" +
+               std::string(TarArchive::padding(6), '\0');
+    data = open_data();
+    response = client.sendCommand("SITE UNTAR\r\n");
+    data->senddata(archive + TarArchive::trailer());
+    response = client.recvCommand();
+    ASSERT_EQ(response, "226 Extracted 2 files, 0 directories, 1 skipped.\r\n");
+    ASSERT_NE(access("untarsrc/../escape.txt", F_OK), 0);
+    ASSERT_NE(access("escape.txt", F_OK), 0);
+    ASSERT_EQ(read_file("untardst/twice.txt"), "second");
+
+    // 在成员数据中间结束的归档
+    data = open_data();
+    response = client.sendCommand("SITE UNTAR\r\n");
+    data->senddata(archive.substr(0, TarArchive::BLOCK + 2));
+    response = client.recvCommand();
+    ASSERT_TRUE(response.find("451 Archive truncated") == 0);
+
+    data = open_data();
+    response = client.sendCommand("SITE UNTAR missing\r\n");
+    ASSERT_EQ(response, "550 Directory not found.\r\n");
+    system("rm -rf untarsrc untardst");
+}
+
+// 测试 MODE B：一个数据连接上连续 STOR/RETR/LIST，重启标记与 REST 续传
+TEST_F(FTPServerTest, Test_MODEBlock) {
+    std::mt19937 random(5);
+    std::string large(20 * 1024 * 1024 + 77, '\0');
+    for (char& c : large) {
+        c = static_cast<char>(random());
+    }
+    std::ofstream("blocklarge.bin", std::ios::binary) << large;
+    system("rm -f blockup1.bin blockup2.bin");
+
+    FTPClient client("127.0.0.1", port);
+    std::string response = client.recvCommand();
+    response = client.sendCommand("USER admin\r\n");
+    response = client.sendCommand("PASS admin\r\n");
+    ASSERT_TRUE(response.find("230 User logged in") != std::string::npos);
+    response = client.sendCommand("MODE X\r\n");
+    ASSERT_TRUE(response.find("504") == 0);
+    response = client.sendCommand("MODE B\r\n");
+    ASSERT_EQ(response, "200 Mode set to B.\r\n");
+
+    // 块：描述符、16 位大端长度、数据
+    auto block = [](unsigned char descriptor, const std::string& payload) {
+        std::string out;
+        out += static_cast<char>(descriptor);
+        out += static_cast<char>(payload.size() >> 8);
+        out += static_cast<char>(payload.size() & 0xff);
+        return out + payload;
+    };
+    // 读到 EOF 块为止，重启标记与其之前的数据字节数放入 markers
+    std::vector<std::pair<std::string, size_t> > markers;
+    auto recv_file = [&markers](FTPClient& data) {
+        markers.clear();
+        std::string content;
+        while (true) {
+            std::string head = data.recvexact(3);
+            if (head.size() != 3) {
+                return content + "<closed>";
+            }
+            unsigned char descriptor = head[0];
+            size_t count = static_cast<unsigned char>(head[1]) << 8 |
+                           static_cast<unsigned char>(head[2]);
+            std::string payload = data.recvexact(count);
+            if (descriptor & 0x10) {
+                markers.emplace_back(payload, content.size());
+            } else {
+                content += payload;
+            }
+            if (descriptor & 0x40) {
+                return content;
+            }
+        }
+    };
+    // 读取控制连接，直到收到 1xx 之外的回复
+    auto final_reply = [&client](std::string replies) {
+        while (true) {
+            size_t start = 0;
+            size_t end;
+            while ((end = replies.find("\r\n", start)) != std::string::npos) {
+                if (replies[start] != '1') {
+                    return replies;
+                }
+                start = end + 2;
+            }
+            std::string more = client.recvCommand();
+            if (more.empty()) {
+                return replies;
+            }
+            replies += more;
+        }
+    };
+
+    response = client.sendCommand("PASV\r\n");
+    int ip1, ip2, ip3, ip4, p1, p2;
+    sscanf(response.c_str() + response.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+           &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+    FTPClient data("127.0.0.1", p1 * 256 + p2);
+
+    // 上传：两个数据块之后是客户端的重启标记，标记之前的数据写入后以 110 确认
+    std::string first(100000, 'a');
+    response = client.sendCommand("STOR blockup1.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    data.sendraw(block(0, first.substr(0, 60000)) + block(0, first.substr(60000)) +
+                 block(0x10, "m1") + block(0x40, "tail"));
+    response = final_reply(client.recvCommand());
+    ASSERT_TRUE(response.find("110 MARK m1 = 100000\r\n") == 0);
+    ASSERT_TRUE(response.find("\r\n226 ") != std::string::npos);
+
+    // 同一连接上的空文件、下载与列表
+    response = client.sendCommand("STOR blockup2.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    data.sendraw(block(0x40, ""));
+    response = final_reply(client.recvCommand());
+    ASSERT_TRUE(response.find("226 ") == 0);
+    struct stat st;
+    ASSERT_EQ(stat("blockup2.bin", &st), 0);
+    ASSERT_EQ(st.st_size, 0);
+
+    response = client.sendCommand("RETR blockup1.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    ASSERT_TRUE(recv_file(data) == first + "tail");
+    response = final_reply(client.recvCommand());
+    ASSERT_EQ(response, "226 Transfer complete.\r\n");
+
+    response = client.sendCommand("LIST\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    ASSERT_TRUE(recv_file(data).find("blockup1.bin") != std::string::npos);
+    response = final_reply(client.recvCommand());
+    ASSERT_EQ(response, "226 Directory send OK.\r\n");
+
+    // 失败的下载不影响连接
+    response = client.sendCommand("RETR blockmissing.bin\r\n");
+    ASSERT_EQ(response, "550 File not found.\r\n");
+
+    // 大文件中每 16 MiB 一个重启标记，内容为文件偏移
+    response = client.sendCommand("RETR blocklarge.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    ASSERT_TRUE(recv_file(data) == large);
+    response = final_reply(client.recvCommand());
+    ASSERT_EQ(response, "226 Transfer complete.\r\n");
+    ASSERT_EQ(markers.size(), 1u);
+    ASSERT_EQ(markers[0].first, "16777216");
+    ASSERT_EQ(markers[0].second, 16777216u);
+
+    // 以重启标记续传下载
+    response = client.sendCommand("REST " + markers[0].first + "\r\n");
+    ASSERT_EQ(response, "350 Restarting at 16777216. Send STOR or RETR to initiate transfer.\r\n");
+    response = client.sendCommand("RETR blocklarge.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    ASSERT_TRUE(recv_file(data) == large.substr(16777216));
+    response = final_reply(client.recvCommand());
+    ASSERT_EQ(response, "226 Transfer complete.\r\n");
+
+    response = client.sendCommand("REST 999999999\r\n");
+    response = client.sendCommand("RETR blockup1.bin\r\n");
+    ASSERT_EQ(response, "554 Restart position beyond end of file.\r\n");
+
+    // 续传上传：截断到重启位置后继续写入
+    response = client.sendCommand("REST 5\r\n");
+    ASSERT_TRUE(response.find("350") == 0);
+    response = client.sendCommand("STOR blockup1.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    data.sendraw(block(0x40, "XYZ"));
+    response = final_reply(client.recvCommand());
+    ASSERT_TRUE(response.find("226 ") == 0);
+
+    // REST 只作用于紧随其后的命令
+    response = client.sendCommand("REST 3\r\n");
+    response = client.sendCommand("SIZE blockup1.bin\r\n");
+    ASSERT_EQ(response, "213 8\r\n");
+    response = client.sendCommand("RETR blockup1.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    ASSERT_EQ(recv_file(data), "aaaaaXYZ");
+    response = final_reply(client.recvCommand());
+    ASSERT_EQ(response, "226 Transfer complete.\r\n");
+    response = client.sendCommand("REST abc\r\n");
+    ASSERT_TRUE(response.find("501") == 0);
+
+    // 回到流模式时关闭保持着的连接
+    response = client.sendCommand("MODE S\r\n");
+    ASSERT_EQ(response, "200 Mode set to S.\r\n");
+    ASSERT_EQ(data.recvexact(1), "");
+    response = client.sendCommand("PASV\r\n");
+    sscanf(response.c_str() + response.find('(') + 1, "%d,%d,%d,%d,%d,%d",
+           &ip1, &ip2, &ip3, &ip4, &p1, &p2);
+    FTPClient stream("127.0.0.1", p1 * 256 + p2);
+    response = client.sendCommand("RETR blockup1.bin\r\n");
+    ASSERT_TRUE(response.find("150") == 0);
+    ASSERT_EQ(stream.recvdata(), "aaaaaXYZ");
+    response = final_reply(client.recvCommand());
+    ASSERT_EQ(response, "226 Transfer complete.\r\n");
+    system("rm -f blocklarge.bin blockup1.bin blockup2.bin");
+}
+
+// 测试 CRC 与摘要的已知结果，分段计算与一次计算一致
+TEST(FileHashTest, Test_KnownVectors) {
+    ASSERT_EQ(crc32_ieee(0, "123456789", 9), 0xCBF43926u);
+    ASSERT_EQ(crc32c(0, "123456789", 9), 0xE3069283u);
+
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data += static_cast<char>(i * 7 + 3);
+    }
+    ASSERT_EQ(crc32c(crc32c(0, data.data(), 333), data.data() + 333, 667),
+              crc32c(0, data.data(), data.size()));
+    ASSERT_EQ(crc32_ieee(crc32_ieee(0, data.data(), 5), data.data() + 5, 995),
+              crc32_ieee(0, data.data(), data.size()));
+
+    Hasher sha(HashAlgorithm::SHA256);
+    sha.update("a", 1);
+    sha.update("bc", 2);
+    ASSERT_EQ(sha.finish(),
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    Hasher md5(HashAlgorithm::MD5);
+    md5.update("abc", 3);
+    ASSERT_EQ(md5.finish(), "900150983cd24fb0d6963f7d28e17f72");
+    Hasher crc(HashAlgorithm::CRC32);
+    crc.update("123456789", 9);
+    ASSERT_EQ(crc.finish(), "cbf43926");
+}
+
+// 测试 FastCDC：分块大小在范围内，数据前面插入内容后切点随内容移动
+TEST(FastCdcTest, Test_BoundariesFollowContent) {
+    FastCdc chunker(2048, 8192, 32768);
+    std::mt19937 random(7);
+    std::string data(1024 * 1024, '\0');
+    for (char& c : data) {
+        c = static_cast<char>(random());
+    }
+    auto boundaries = [&chunker](const std::string& input) {
+        std::vector<size_t> ends;
+        size_t offset = 0;
+        while (offset < input.size()) {
+            size_t n = chunker.cut(input.data() + offset, input.size() - offset, true);
+            EXPECT_GT(n, 0u);
+            EXPECT_LE(n, chunker.max_size());
+            offset += n;
+            ends.push_back(offset);
+        }
+        return ends;
+    };
+    std::vector<size_t> original = boundaries(data);
+    ASSERT_GT(original.size(), 64u);
+    for (size_t i = 0; i + 1 < original.size(); ++i) {
+        size_t length = original[i] - (i == 0 ? 0 : original[i - 1]);
+        ASSERT_GE(length, chunker.min_size());
+    }
+    // 数据不足最大分块且未到末尾时需要更多数据
+    ASSERT_EQ(chunker.cut(data.data(), chunker.max_size() - 1, false), 0u);
+
+    std::vector<size_t> shifted = boundaries("0123456789" + data);
+    std::set<size_t> moved;
+    for (size_t end : shifted) {
+        moved.insert(end - 10);
+    }
+    size_t same = 0;
+    for (size_t end : original) {
+        same += moved.count(end);
+    }
+    ASSERT_GE(same, original.size() - 2);
+}
+
+// 测试 rsync 弱校验：向量化与逐字节结果一致，滑动与重新计算一致
+TEST(RsyncDeltaTest, Test_RollingChecksum) {
+    std::mt19937 random(3);
+    std::string data(5000, '\0');
+    for (char& c : data) {
+        c = static_cast<char>(random());
+    }
+    for (size_t size : {0u, 1u, 31u, 32u, 33u, 100u, 4097u}) {
+        uint32_t a = 0;
+        uint32_t b = 0;
+        for (size_t i = 0; i < size; ++i) {
+            a += static_cast<uint8_t>(data[i]);
+            b += a;
+        }
+        ASSERT_EQ(rolling_checksum(data.data(), size), (a & 0xffff) | (b << 16));
+    }
+    RollingChecksum rolling;
+    rolling.reset(data.data(), 700);
+    for (size_t i = 0; i < 1000; ++i) {
+        rolling.roll(static_cast<uint8_t>(data[i]), static_cast<uint8_t>(data[i + 700]));
+        ASSERT_EQ(rolling.value(), rolling_checksum(data.data() + i + 1, 700));
+    }
+}
+
+// 测试增量的编码与应用：分段送入，大部分内容复用基准文件，篡改的增量被拒绝
+TEST(RsyncDeltaTest, Test_EncodeAndPatch) {
+    std::mt19937 random(5);
+    std::string basis(300000, '\0');
+    for (char& c : basis) {
+        c = static_cast<char>(random());
+    }
+    std::string changed = "head" + basis.substr(0, 100000) + basis.substr(100100);
+    size_t blockSize = 2048;
+    std::string text = DeltaSignature::header(blockSize, basis.size());
+    DeltaSignature::append_blocks(basis.data(), basis.size(), blockSize, text);
+    DeltaSignature signature;
+    ASSERT_EQ(signature.parse(text), 0);
+    ASSERT_EQ(signature.blocks(), (basis.size() + blockSize - 1) / blockSize);
+
+    DeltaEncoder encoder(signature);
+    std::string delta;
+    for (size_t offset = 0; offset < changed.size(); offset += 7777) {
+        encoder.update(changed.data() + offset,
+                       std::min<size_t>(7777, changed.size() - offset), delta);
+    }
+    encoder.finish(delta);
+    ASSERT_GE(encoder.matched(), static_cast<off_t>(basis.size() - 3 * blockSize));
+
+    auto apply = [&basis](const std::string& input, std::string& output) {
+        FILE* file = tmpfile();
+        DeltaPatcher patcher(
+                [&basis](char* buffer, size_t size, off_t offset) -> ssize_t {
+                    size_t n = std::min(size, basis.size() - static_cast<size_t>(offset));
+                    memcpy(buffer, basis.data() + offset, n);
+                    return static_cast<ssize_t>(n);
+                },
+                basis.size(), fileno(file));
+        int rc = 0;
+        for (size_t offset = 0; offset < input.size() && rc == 0; offset += 1000) {
+            rc = patcher.feed(input.data() + offset,
+                              std::min<size_t>(1000, input.size() - offset));
+        }
+        if (rc == 0) {
+            rc = patcher.finish();
+        }
+        output.assign(patcher.size(), '\0');
+        pread(fileno(file), output.data(), output.size(), 0);
+        fclose(file);
+        return rc;
+    };
+    std::string output;
+    ASSERT_EQ(apply(delta, output), 0);
+    ASSERT_TRUE(output == changed);
+
+    std::string bad = delta;
+    bad[bad.size() - 2] ^= 1;
+    ASSERT_EQ(apply(bad, output), -EBADMSG);
+    ASSERT_EQ(apply(delta.substr(0, delta.size() / 2), output), -EBADMSG);
+}
+
+// 测试 tar 头部：ustar 字段与校验和，长名称使用 pax 扩展头部；gzip 可以解压
+TEST(TarArchiveTest, Test_HeaderAndGzip) {
+    TarMember member;
+    member.name = "dir/file.txt";
+    member.mode = 0640;
+    member.size = 1000;
+    member.mtime = 1700000000;
+    std::string header = TarArchive::header(member);
+    ASSERT_EQ(header.size(), TarArchive::BLOCK);
+    ASSERT_EQ(std::string(header.c_str()), "dir/file.txt");
+    ASSERT_EQ(std::string(header.c_str() + 100), "0000640");
+    ASSERT_EQ(std::string(header.c_str() + 124), "00000001750");
+    ASSERT_EQ(header[156], '0');
+    ASSERT_EQ(std::string(header.c_str() + 257), "ustar");
+    unsigned int sum = 0;
+    for (size_t i = 0; i < header.size(); ++i) {
+        sum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    ASSERT_EQ(strtoul(header.c_str() + 148, nullptr, 8), sum);
+    ASSERT_EQ(TarArchive::padding(1000), 24u);
+    ASSERT_EQ(TarArchive::padding(1024), 0u);
+
+    member.name = std::string(150, 'a');
+    member.type = TarMember::DIRECTORY;
+    header = TarArchive::header(member);
+    ASSERT_EQ(header.size(), 3 * TarArchive::BLOCK);
+    ASSERT_EQ(header[156], 'x');
+    std::string record = "path=" + member.name + "/\n";
+    ASSERT_EQ(header.substr(TarArchive::BLOCK, record.size() + 4), "161 " + record);
+    ASSERT_EQ(header[2 * TarArchive::BLOCK + 156], '5');
+
+    std::string plain;
+    for (int i = 0; i < 10000; ++i) {
+        plain += "line " + std::to_string(i) + "\n";
+    }
+    GzipStream gzip(1);
+    std::string packed;
+    gzip.write(plain.data(), plain.size() / 2, packed);
+    gzip.write(plain.data() + plain.size() / 2, plain.size() - plain.size() / 2, packed);
+    gzip.finish(packed);
+    ASSERT_LT(packed.size(), plain.size() / 2);
+    z_stream z = {};
+    ASSERT_EQ(inflateInit2(&z, 15 + 16), Z_OK);
+    std::string unpacked(plain.size() + 1, '\0');
+    z.next_in = reinterpret_cast<Bytef*>(packed.data());
+    z.avail_in = packed.size();
+    z.next_out = reinterpret_cast<Bytef*>(unpacked.data());
+    z.avail_out = unpacked.size();
+    ASSERT_EQ(inflate(&z, Z_FINISH), Z_STREAM_END);
+    unpacked.resize(z.total_out);
+    inflateEnd(&z);
+    ASSERT_TRUE(unpacked == plain);
+}
+
+// 测试流式解析：输入任意切分时成员与数据不变，校验和不符时报错；gzip 分段解压
+TEST(TarArchiveTest, Test_ReaderAndGunzip) {
+    std::vector<std::pair<TarMember, std::string> > members(3);
+    members[0].first.name = "dir";
+    members[0].first.type = TarMember::DIRECTORY;
+    members[1].first.name = "dir/" + std::string(200, 'p') + ".bin";
+    members[1].second = std::string(5000, 'q');
+    members[2].first.name = "dir/small.txt";
+    members[2].second = "hello";
+    std::string archive;
+    for (auto& [member, content] : members) {
+        member.size = content.size();
+        member.mtime = 1600000000;
+        archive += TarArchive::header(member) + content +
+                   std::string(TarArchive::padding(content.size()), '\0');
+    }
+    archive += TarArchive::trailer();
+
+    for (size_t step : {1u, 7u, 512u, 100000u}) {
+        TarReader reader;
+        std::vector<std::pair<TarMember, std::string> > parsed;
+        bool ended = false;
+        for (size_t pos = 0; pos < archive.size() && !ended; pos += step) {
+            reader.feed(archive.data() + pos, std::min(step, archive.size() - pos));
+            while (true) {
+                const char* data = nullptr;
+                size_t size = 0;
+                TarReader::Item item = reader.next(data, size);
+                ASSERT_NE(item, TarReader::INVALID);
+                if (item == TarReader::MORE) {
+                    break;
+                }
+                if (item == TarReader::END) {
+                    ended = true;
+                    break;
+                }
+                if (item == TarReader::HEADER) {
+                    parsed.emplace_back(reader.member(), std::string());
+                } else {
+                    parsed.back().second.append(data, size);
+                }
+            }
+        }
+        ASSERT_TRUE(ended);
+        ASSERT_TRUE(reader.complete());
+        ASSERT_EQ(parsed.size(), members.size());
+        for (size_t i = 0; i < members.size(); ++i) {
+            ASSERT_EQ(parsed[i].first.name, members[i].first.name);
+            ASSERT_EQ(parsed[i].first.type, members[i].first.type);
+            ASSERT_EQ(parsed[i].first.mtime, 1600000000);
+            ASSERT_TRUE(parsed[i].second == members[i].second);
+        }
+    }
+
+    std::string bad = archive;
+    bad[0] ^= 1;
+    TarReader reader;
+    reader.feed(bad.data(), bad.size());
+    const char* data = nullptr;
+    size_t size = 0;
+    ASSERT_EQ(reader.next(data, size), TarReader::INVALID);
+
+    GzipStream gzip(6);
+    std::string packed;
+    gzip.write(archive.data(), archive.size(), packed);
+    gzip.finish(packed);
+    GunzipStream gunzip;
+    std::string unpacked;
+    for (size_t pos = 0; pos < packed.size(); pos += 100) {
+        gunzip.write(packed.data() + pos, std::min<size_t>(100, packed.size() - pos));
+        int rc = 1;
+        while (rc == 1) {
+            std::string out;
+            rc = gunzip.read(out, 1000);
+            ASSERT_GE(rc, 0);
+            ASSERT_LE(out.size(), 1000u);
+            unpacked += out;
+        }
+    }
+    ASSERT_TRUE(unpacked == archive);
+    std::string garbage(64, 'z');
+    gunzip.write(garbage.data(), garbage.size());
+    ASSERT_EQ(gunzip.read(unpacked, 1000), -EBADMSG);
+}
+
+// 测试块模式的编码与逐字节解析：数据、重启标记、EOF 块
+TEST(BlockModeTest, Test_FrameAndReader) {
+    std::string payload(70000, 'p');
+    std::string headers;
+    std::vector<iovec> iov;
+    BlockMode::frame(payload.data(), payload.size(), headers, iov);
+    ASSERT_EQ(iov.size(), 4u);
+    ASSERT_EQ(headers, std::string("\0\xff\xff\0\x11\x71", 6));
+    ASSERT_EQ(iov[1].iov_len, 65535u);
+    ASSERT_EQ(iov[3].iov_len, 4465u);
+    ASSERT_EQ(BlockMode::marker(123), std::string("\x10\0\x03" "123", 6));
+    ASSERT_EQ(BlockMode::end(), std::string("\x40\0\0", 3));
+
+    // 逐字节送入，每次不超过 wanted()
+    std::string stream = std::string("\0\0\x05hello", 8) + BlockMode::marker(42) +
+                         std::string("\x40\0\x01!", 4) + "next file";
+    BlockReader reader;
+    std::string data;
+    size_t pos = 0;
+    while (!reader.ended()) {
+        ASSERT_GT(reader.wanted(), 0u);
+        if (reader.in_data()) {
+            data += stream[pos];
+        }
+        ASSERT_EQ(reader.feed(&stream[pos], 1), 0);
+        ++pos;
+    }
+    ASSERT_EQ(data, "hello!");
+    ASSERT_EQ(reader.received(), 6);
+    ASSERT_EQ(reader.wanted(), 0u);
+    ASSERT_EQ(stream.substr(pos), "next file");
+    std::string marker;
+    off_t position = 0;
+    ASSERT_FALSE(reader.take_marker(4, marker, position));
+    ASSERT_TRUE(reader.take_marker(5, marker, position));
+    ASSERT_EQ(marker, "42");
+    ASSERT_EQ(position, 5);
+
+    // 标记只能是可打印字符
+    reader.reset();
+    std::string bad("\x10\0\x03" "a b", 6);
+    ASSERT_EQ(reader.feed(bad.data(), bad.size()), -EBADMSG);
+}
+
+// 测试弹性线程池：按需扩容、空闲收缩
+TEST(ThreadPoolTest, Test_ElasticGrowAndShrink) {
+    ThreadPool pool;
+    pool.set_idle_timeout(std::chrono::milliseconds(100));
+    pool.open(1, 4);
+    ASSERT_EQ(pool.thread_count(), 1u);
+
+    // 提交多个阻塞任务，线程池应扩展到上限
+    std::mutex gateMutex;
+    std::condition_variable gate;
+    bool release = false;
+    std::atomic<int> done(0);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(pool.enqueue([&] {
+            std::unique_lock<std::mutex> lock(gateMutex);
+            gate.wait(lock, [&] { return release; });
+            ++done;
+        }));
+    }
+    ASSERT_EQ(pool.thread_count(), 4u);
+
+    {
+        std::lock_guard<std::mutex> lock(gateMutex);
+        release = true;
+    }
+    gate.notify_all();
+
+    // 空闲超时后收缩回常驻线程数
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ASSERT_EQ(done.load(), 4);
+    ASSERT_EQ(pool.thread_count(), 1u);
+    pool.close();
+}
+
+// 测试线程池队列满时拒绝任务并计数
+TEST(ThreadPoolTest, Test_RejectWhenFull) {
+    ThreadPool pool;
+    pool.set_max_queue_size(1);
+    pool.open(1, 1);
+
+    std::mutex gateMutex;
+    std::condition_variable gate;
+    bool release = false;
+    auto blocker = [&] {
+        std::unique_lock<std::mutex> lock(gateMutex);
+        gate.wait(lock, [&] { return release; });
+    };
+    ASSERT_TRUE(pool.enqueue(blocker));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(pool.enqueue(blocker)); // 占满队列
+    ASSERT_FALSE(pool.enqueue(blocker));
+    ASSERT_EQ(pool.rejected_count(), 1u);
+
+    // 已被接纳的工作的后续任务不受队列上限限制
+    ASSERT_TRUE(pool.enqueue(blocker, ThreadPool::ADMITTED));
+    ASSERT_EQ(pool.rejected_count(), 1u);
+
+    {
+        std::lock_guard<std::mutex> lock(gateMutex);
+        release = true;
+    }
+    gate.notify_all();
+    pool.close();
+
+    // 关闭后的提交同样被拒绝
+    ASSERT_FALSE(pool.is_open());
+    ASSERT_FALSE(pool.enqueue([] {}));
+    ASSERT_EQ(pool.rejected_count(), 2u);
+    ASSERT_FALSE(pool.enqueue([] {}, ThreadPool::ADMITTED));
+    ASSERT_EQ(pool.rejected_count(), 3u);
+}
+
+// 测试 CPU 列表解析
+TEST(CpuAffinityTest, Test_ParseCpuList) {
+    std::vector<int> cpus = CpuAffinity::parse_cpu_list("0-2,8,x,10-11");
+    ASSERT_EQ(cpus, (std::vector<int>{0, 1, 2, 8, 10, 11}));
+    ASSERT_TRUE(CpuAffinity::parse_cpu_list("").empty());
+
+    // 线程的缓冲区空闲表：归还的缓冲区被复用，超过上限的直接释放
+    std::shared_ptr<LocalBufferPool> pool = LocalBufferPool::current(4096);
+    ASSERT_EQ(LocalBufferPool::current(4096), pool);
+    char* buffer = pool->acquire();
+    ASSERT_NE(buffer, nullptr);
+    buffer[4095] = 1;
+    pool->release(buffer);
+    ASSERT_EQ(pool->free_count(), 1u);
+    ASSERT_EQ(pool->acquire(), buffer);
+    ASSERT_EQ(pool->free_count(), 0u);
+
+    std::vector<char*> buffers(LocalBufferPool::MAX_FREE + 1, nullptr);
+    for (char*& held : buffers) {
+        held = pool->acquire();
+        ASSERT_NE(held, nullptr);
+    }
+    for (char* held : buffers) {
+        pool->release(held);
+    }
+    ASSERT_EQ(pool->free_count(), LocalBufferPool::MAX_FREE);
+    pool->release(buffer);
+    ASSERT_EQ(pool->free_count(), LocalBufferPool::MAX_FREE);
+}
+
+TEST(FileCacheTest, Test_LookupEvictAndValidate) {
+    FileCache cache;
+    cache.configure(2 * (1000 + 128), 1000, 1);
+
+    // 构造足够旧的文件版本（刚修改的文件不会被缓存）
+    auto identity = [](ino_t ino, off_t size) {
+        FileIdentity identity;
+        identity.dev = 1;
+        identity.ino = ino;
+        identity.size = size;
+        identity.mtime.tv_sec = 1000;
+        identity.ctime.tv_sec = 1000;
+        return identity;
+    };
+    auto content = [](size_t size) {
+        return std::make_shared<const std::string>(size, 'x');
+    };
+
+    ASSERT_FALSE(cache.cacheable(1001));
+    ASSERT_EQ(cache.lookup(identity(1, 1000)), nullptr);
+    cache.insert(identity(1, 1000), content(1000));
+    cache.insert(identity(2, 1000), content(1000));
+    ASSERT_NE(cache.lookup(identity(1, 1000)), nullptr);
+
+    // 超出预算时淘汰最久未使用的条目（2），最近命中的 1 保留
+    cache.insert(identity(3, 1000), content(1000));
+    ASSERT_EQ(cache.lookup(identity(2, 1000)), nullptr);
+    ASSERT_NE(cache.lookup(identity(1, 1000)), nullptr);
+
+    // 版本（mtime）不符时丢弃
+    FileIdentity modified = identity(1, 1000);
+    modified.mtime.tv_nsec = 1;
+    ASSERT_EQ(cache.lookup(modified), nullptr);
+    ASSERT_EQ(cache.lookup(identity(1, 1000)), nullptr);
+
+    // 刚修改的文件不缓存
+    FileIdentity recent = identity(4, 10);
+    recent.mtime.tv_sec = recent.ctime.tv_sec = time(nullptr);
+    cache.insert(recent, content(10));
+    ASSERT_EQ(cache.lookup(recent), nullptr);
+
+    FileCache::Stats stats = cache.stats();
+    ASSERT_EQ(stats.hits, 2u);
+    ASSERT_EQ(stats.evictions, 1u);
+    ASSERT_EQ(stats.insertions, 3u);
+    ASSERT_EQ(stats.entries, 1u);
+}
+
+// 测试列表缓存：命中、inotify 失效、读取期间修改不插入、按监视数淘汰
+TEST(MetadataCacheTest, Test_InvalidateAndEvict) {
+    system("rm -rf metadata_cache && mkdir -p metadata_cache/sub");
+    system("echo 'abc' > metadata_cache/a.txt");
+    system("ln -s a.txt metadata_cache/link.txt");
+
+    MetadataCache cache;
+    ASSERT_TRUE(cache.configure(1024, 2, 0, 4));
+    char cwd[PATH_MAX];
+    ASSERT_NE(getcwd(cwd, sizeof(cwd)), nullptr);
+    PathResolver resolver;
+    ASSERT_EQ(resolver.open(FileSystem::instance(), cwd), 0);
+    auto size = [&cache, &resolver](const std::string& path) {
+        struct statx stx;
+        int rc = cache.stat(resolver.resolve(path), stx);
+        return rc == 0 ? static_cast<long long>(stx.stx_size) : rc;
+    };
+
+    ASSERT_EQ(size("metadata_cache/a.txt"), 4);
+    ASSERT_EQ(size("metadata_cache/a.txt"), 4);
+    ASSERT_EQ(cache.stats().hits, 1u);
+
+    // 外部写入、改名子目录都经 inotify 失效
+    system("echo 'abcdef' > metadata_cache/a.txt");
+    ASSERT_EQ(size("metadata_cache/a.txt"), 7);
+    ASSERT_EQ(size("metadata_cache/sub"), 4096);
+    system("touch metadata_cache/sub/x && mv metadata_cache/sub metadata_cache/moved");
+    ASSERT_EQ(size("metadata_cache/sub"), -ENOENT);
+
+    // 符号链接不缓存，跟随后返回目标的元数据
+    uint64_t misses = cache.stats().misses;
+    ASSERT_EQ(size("metadata_cache/link.txt"), 7);
+    ASSERT_EQ(size("metadata_cache/link.txt"), 7);
+    ASSERT_EQ(cache.stats().misses, misses + 2);
+
+    // 内存文件系统没有 inotify：经 fd 的写入在显式失效后才可见
+    PathResolver memory;
+    ASSERT_EQ(memory.open(std::make_shared<MemoryFileSystem>(), "/"), 0);
+    ResolvedPath file = memory.resolve("m.txt");
+    int fd = file.open(O_WRONLY | O_CREAT, 0644);
+    ASSERT_GE(fd, 0);
+    struct statx stx;
+    ASSERT_EQ(cache.stat(file, stx), 0);
+    ASSERT_EQ(stx.stx_size, 0u);
+    ASSERT_EQ(write(fd, "data", 4), 4);
+    close(fd);
+    ASSERT_EQ(cache.stat(file, stx), 0);
+    ASSERT_EQ(stx.stx_size, 0u);
+    cache.invalidate(file);
+    ASSERT_EQ(cache.stat(file, stx), 0);
+    ASSERT_EQ(stx.stx_size, 4u);
+
+    // 最多两个监视：监视第三个目录时淘汰最久未使用的目录及其条目
+    ASSERT_EQ(size("metadata_cache/moved/x"), 0);
+    ASSERT_LE(cache.stats().watches, 2u);
+    ASSERT_GT(cache.stats().evictions, 0u);
+
+    system("rm -rf metadata_cache");
+}
+
+TEST(ChangeIndexTest, Test_IncrementalChanges) {
+    system("rm -rf change_index incoming && mkdir -p change_index/sub incoming/deep");
+    system("echo a > change_index/old.txt && echo b > change_index/sub/old2.txt");
+    system("touch change_index/a.txt change_index/b.txt change_index/c.txt "
+           "incoming/deep/f.txt");
+
+    // 文件时间戳取自粗粒度时钟，与起始时间拉开几个时钟周期
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    ChangeIndex index;
+    ASSERT_TRUE(index.configure(4, 64, 1024, 2));
+    char cwd[PATH_MAX];
+    ASSERT_NE(getcwd(cwd, sizeof(cwd)), nullptr);
+    PathResolver resolver;
+    ASSERT_EQ(resolver.open(FileSystem::instance(), cwd), 0);
+
+    // 每批两条，读完全部批次
+    bool deletions = false;
+    auto changes = [&index, &deletions](const ResolvedPath& dir, int64_t since,
+                                        bool recursive) {
+        ChangeQuery query;
+        query.dir = dir;
+        query.since = since;
+        query.recursive = recursive;
+        std::string out;
+        int rc;
+        while ((rc = index.read(query, out, 2)) > 0) {
+        }
+        EXPECT_EQ(rc, 0);
+        deletions = query.deletions;
+        return out;
+    };
+    ResolvedPath root = resolver.resolve("change_index");
+
+    std::string out = changes(root, 0, true);
+    ASSERT_NE(out.find("; old.txt\r\n"), std::string::npos);
+    ASSERT_NE(out.find("; sub\r\n"), std::string::npos);
+    ASSERT_NE(out.find("; sub/old2.txt\r\n"), std::string::npos);
+    ASSERT_FALSE(deletions);
+    ASSERT_EQ(index.stats().builds, 1u);
+
+    // 修改、删除与移入的目录（其下的文件时间较早，也按移入时间列出）
+    int64_t since = ChangeIndex::now();
+    system("echo c >> change_index/sub/old2.txt && rm change_index/old.txt");
+    system("mv incoming change_index/moved");
+    out = changes(root, since, true);
+    ASSERT_NE(out.find("; sub/old2.txt\r\n"), std::string::npos);
+    ASSERT_NE(out.find("type=deleted; old.txt\r\n"), std::string::npos);
+    ASSERT_NE(out.find("; moved/deep/f.txt\r\n"), std::string::npos);
+    ASSERT_EQ(out.find("a.txt"), std::string::npos);
+    ASSERT_EQ(out.find("; sub\r\n"), std::string::npos);
+    ASSERT_TRUE(deletions);
+
+    out = changes(root, since, false);
+    ASSERT_NE(out.find("; moved\r\n"), std::string::npos);
+    ASSERT_EQ(out.find("old2.txt"), std::string::npos);
+
+    // 子目录复用同一索引
+    out = changes(resolver.resolve("change_index/sub"), since, true);
+    ASSERT_NE(out.find("; old2.txt\r\n"), std::string::npos);
+    ASSERT_EQ(index.stats().builds, 1u);
+    ASSERT_GT(index.stats().events, 0u);
+
+    // 移出的目录连同其下的条目与监视一起删除；墓碑超出上限后删除不再完整
+    size_t watches = index.stats().watches;
+    system("mv change_index/moved moved_out && rm change_index/a.txt change_index/b.txt");
+    out = changes(root, since, true);
+    ASSERT_EQ(out.find("f.txt"), std::string::npos);
+    ASSERT_NE(out.find("type=deleted; b.txt\r\n"), std::string::npos);
+    ASSERT_FALSE(deletions);
+    ASSERT_EQ(index.stats().watches, watches - 2);
+
+    ChangeQuery file;
+    file.dir = resolver.resolve("change_index/c.txt");
+    std::string ignored;
+    ASSERT_EQ(index.read(file, ignored, 2), -ENOTDIR);
+    ChangeQuery missing;
+    missing.dir = resolver.resolve("change_index/nowhere");
+    ASSERT_EQ(index.read(missing, ignored, 2), -ENOENT);
+
+    // 内存文件系统没有 inotify，完整遍历
+    PathResolver memory;
+    ASSERT_EQ(memory.open(std::make_shared<MemoryFileSystem>(), "/"), 0);
+    ASSERT_EQ(memory.resolve("dir").mkdir(0755), 0);
+    int fd = memory.resolve("dir/m.txt").open(O_WRONLY | O_CREAT, 0644);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    out = changes(memory.resolve("/"), 0, true);
+    ASSERT_NE(out.find("; dir/m.txt\r\n"), std::string::npos);
+    ASSERT_FALSE(deletions);
+    ASSERT_GT(index.stats().fallbacks, 0u);
+
+    system("rm -rf change_index moved_out");
+}
+
+TEST(ListingCacheTest, Test_InvalidateAndEvict) {
+    system("rm -rf listing_cache_a listing_cache_b");
+    system("mkdir listing_cache_a listing_cache_b");
+    system("touch listing_cache_a/one.txt");
+
+    ListingCache cache;
+    ASSERT_TRUE(cache.configure(1024 * 1024, 1, 64 * 1024, 0));
+    char cwd[PATH_MAX];
+    ASSERT_NE(getcwd(cwd, sizeof(cwd)), nullptr);
+    PathResolver resolver;
+    ASSERT_EQ(resolver.open(FileSystem::instance(), cwd), 0);
+    ResolvedPath dirA = resolver.resolve("listing_cache_a");
+    ResolvedPath dirB = resolver.resolve("listing_cache_b");
+
+    // 按 list_transfer 的顺序：打开目录、建立监视、读取、插入
+    auto fill = [&cache, &resolver](const std::string& path, bool modify) {
+        DirectoryReader reader;
+        EXPECT_EQ(reader.open(resolver.resolve(path), ListFormat::LIST), 0);
+        ListingCache::Ticket ticket = cache.watch(reader.fd());
+        std::string listing;
+        while (reader.read(listing, 65536) > 0) {
+        }
+        if (modify) {
+            system(("touch " + path + "/late.txt").c_str());
+        }
+        cache.insert(ticket, ListFormat::LIST, false,
+                     std::make_shared<const std::string>(listing));
+        return listing;
+    };
+
+    ASSERT_EQ(cache.lookup(dirA, ListFormat::LIST, false), nullptr);
+    std::string listing = fill("listing_cache_a", false);
+    auto cached = cache.lookup(dirA, ListFormat::LIST, false);
+    ASSERT_NE(cached, nullptr);
+    ASSERT_EQ(*cached, listing);
+    ASSERT_EQ(cache.lookup(dirA, ListFormat::MLSD, false), nullptr);
+
+    // 目录项变化后失效
+    system("touch listing_cache_a/two.txt");
+    ASSERT_EQ(cache.lookup(dirA, ListFormat::LIST, false), nullptr);
+
+    // 读取期间发生修改的结果不插入
+    fill("listing_cache_a", true);
+    ASSERT_EQ(cache.lookup(dirA, ListFormat::LIST, false), nullptr);
+    fill("listing_cache_a", false);
+    ASSERT_NE(cache.lookup(dirA, ListFormat::LIST, false), nullptr);
+
+    // 只允许一个监视：缓存第二个目录时淘汰第一个
+    fill("listing_cache_b", false);
+    ASSERT_NE(cache.lookup(dirB, ListFormat::LIST, false), nullptr);
+    ASSERT_EQ(cache.lookup(dirA, ListFormat::LIST, false), nullptr);
+
+    ListingCache::Stats stats = cache.stats();
+    ASSERT_EQ(stats.hits, 3u);
+    ASSERT_EQ(stats.invalidations, 1u);
+    ASSERT_EQ(stats.evictions, 1u);
+    ASSERT_EQ(stats.watches, 1u);
+
+    system("rm -rf listing_cache_a listing_cache_b");
+}
+
+// 测试限制根目录的路径解析：".." 与符号链接都不能越过根目录
+TEST(PathResolverTest, Test_ConfinedRoot) {
+    system("rm -rf resolver_root && mkdir -p resolver_root/sub");
+    system("echo 'inside' > resolver_root/sub/file.txt");
+    system("ln -s /etc resolver_root/escape");
+    system("ln -s ../../.. resolver_root/sub/up");
+    char real[PATH_MAX];
+    ASSERT_NE(realpath("resolver_root", real), nullptr);
+
+    auto fs = std::make_shared<LocalFileSystem>();
+    ASSERT_EQ(fs->open(real), 0);
+    PathResolver resolver;
+    ASSERT_EQ(resolver.open(fs, "/"), 0);
+    ASSERT_TRUE(resolver.confined());
+    ASSERT_EQ(resolver.cwd(), "/");
+    ASSERT_EQ(resolver.resolve("../../sub/./file.txt").path(), "/sub/file.txt");
+
+    // 相对路径基于工作目录
+    ASSERT_EQ(resolver.change_directory("sub"), 0);
+    ASSERT_EQ(resolver.cwd(), "/sub");
+    ASSERT_EQ(resolver.change_directory("file.txt"), -ENOTDIR);
+    struct statx stx;
+    ASSERT_EQ(resolver.resolve("file.txt").stat(stx), 0);
+    ASSERT_EQ(stx.stx_size, 7u);
+
+    // 符号链接在根目录内解析：/etc 对应 resolver_root/etc，".." 停在根目录
+    ASSERT_EQ(resolver.resolve("/escape/hostname").open(O_RDONLY), -ENOENT);
+    int fd = resolver.resolve("up/sub/file.txt").open(O_RDONLY);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // 修改操作
+    ASSERT_EQ(resolver.resolve("made").mkdir(0755), 0);
+    ASSERT_EQ(resolver.resolve("made").mkdir(0755), -EEXIST);
+    ASSERT_EQ(resolver.resolve("made").unlink(), -EISDIR);
+    ASSERT_EQ(resolver.resolve("made").rmdir(), 0);
+    ASSERT_EQ(resolver.resolve("/").rmdir(), -EBUSY);
+    ASSERT_EQ(resolver.resolve("file.txt").unlink(), 0);
+
+    system("rm -rf resolver_root");
+}
+
+// 测试内存文件系统：文件读写、目录操作，以及 LIST/MLSD 按游标分页
+TEST(MemoryFileSystemTest, Test_FilesAndListing) {
+    PathResolver resolver;
+    ASSERT_EQ(resolver.open(std::make_shared<MemoryFileSystem>(), "/"), 0);
+    ASSERT_TRUE(resolver.confined());
+    ASSERT_EQ(resolver.resolve("dir").mkdir(0755), 0);
+    ASSERT_EQ(resolver.resolve("dir").mkdir(0755), -EEXIST);
+    ASSERT_EQ(resolver.resolve("missing/x").mkdir(0755), -ENOENT);
+    ASSERT_EQ(resolver.change_directory("dir"), 0);
+
+    // 打开的文件是真实的 fd，O_TRUNC 与普通文件一致
+    int fd = resolver.resolve("a.txt").open(O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(pwrite(fd, "hello", 5, 0), 5);
+    close(fd);
+    struct statx stx;
+    ASSERT_EQ(resolver.resolve("/dir/a.txt").stat(stx), 0);
+    ASSERT_EQ(stx.stx_size, 5u);
+    ASSERT_EQ(stx.stx_mode, S_IFREG | 0644);
+    fd = resolver.resolve("a.txt").open(O_RDONLY);
+    char buf[8] = {};
+    ASSERT_EQ(pread(fd, buf, sizeof(buf), 0), 5);
+    ASSERT_EQ(std::string(buf), "hello");
+    close(fd);
+    ASSERT_EQ(resolver.resolve("a.txt").open(O_RDONLY | O_CREAT | O_EXCL, 0644),
+              -EEXIST);
+    ASSERT_EQ(resolver.resolve("..").open(O_RDONLY), -EISDIR);
+    ASSERT_EQ(resolver.change_directory("a.txt"), -ENOTDIR);
+
+    for (const char* name : {"b.txt", ".hidden", "sub"}) {
+        fd = resolver.resolve(name).open(O_WRONLY | O_CREAT, 0600);
+        ASSERT_GE(fd, 0);
+        close(fd);
+    }
+    ASSERT_EQ(resolver.resolve("sub").unlink(), 0);
+    ASSERT_EQ(resolver.resolve("sub").mkdir(0700), 0);
+
+    // LIST 跳过隐藏文件；按创建顺序分页，删除目录项后游标仍然有效
+    DirectoryReader reader;
+    ASSERT_EQ(reader.open(resolver.resolve("."), ListFormat::LIST), 0);
+    std::string listing;
+    ASSERT_EQ(reader.read(listing, 65536), 0);
+    ASSERT_NE(listing.find(" a.txt\r\n"), std::string::npos);
+    ASSERT_EQ(listing.find(".hidden"), std::string::npos);
+    ASSERT_NE(listing.find(" b.txt\r\ndrwx------ "), std::string::npos);
+    ASSERT_EQ(listing.substr(listing.size() - 6), " sub\r\n");
+
+    DirectoryReader paged;
+    ASSERT_EQ(paged.open(resolver.resolve("."), ListFormat::MLSD), 0);
+    std::string page;
+    size_t remaining = 2;
+    ASSERT_EQ(paged.read(page, 65536, &remaining), 1);
+    ASSERT_NE(page.find("; a.txt"), std::string::npos);
+    ASSERT_NE(page.find("; b.txt"), std::string::npos);
+    ASSERT_EQ(resolver.resolve("a.txt").unlink(), 0);
+    DirectoryReader next;
+    ASSERT_EQ(next.open(resolver.resolve("."), ListFormat::MLSD), 0);
+    ASSERT_EQ(next.seek(paged.position()), 0);
+    page.clear();
+    ASSERT_EQ(next.read(page, 65536), 0);
+    ASSERT_EQ(page.find("b.txt"), std::string::npos);
+    ASSERT_NE(page.find("; .hidden"), std::string::npos);
+    ASSERT_NE(page.find("type=dir;"), std::string::npos);
+
+    // LIST 一个文件；删除非空目录失败
+    DirectoryReader file;
+    ASSERT_EQ(file.open(resolver.resolve("b.txt"), ListFormat::LIST), 0);
+    ASSERT_FALSE(file.directory());
+    listing.clear();
+    ASSERT_EQ(file.read(listing, 65536), 0);
+    ASSERT_NE(listing.find(" /dir/b.txt\r\n"), std::string::npos);
+    ASSERT_EQ(resolver.resolve("/dir").rmdir(), -ENOTEMPTY);
+    ASSERT_EQ(resolver.resolve("sub").rmdir(), 0);
+
+    // 改名替换已有文件；目录不能移动到自身之下
+    ASSERT_EQ(resolver.resolve("b.txt").rename(resolver.resolve(".hidden")), 0);
+    ASSERT_EQ(resolver.resolve("b.txt").stat(stx), -ENOENT);
+    ASSERT_EQ(resolver.resolve(".hidden").stat(stx), 0);
+    ASSERT_EQ(resolver.resolve("/dir").rename(resolver.resolve("/dir/x")), -EINVAL);
+    ASSERT_EQ(resolver.resolve("missing").rename(resolver.resolve("x")), -ENOENT);
+}
+
+TEST(PageCacheTest, Test_CacheWindow) {
+    PageCachePolicy policy(PageCachePolicy::FADVISE, 100, 10);
+
+    // 读取：小于阈值不启用；启用后每满一个窗口丢弃一次已读区间
+    CacheWindow small(policy);
+    ASSERT_FALSE(small.engage(99));
+    ASSERT_TRUE(small.advance_read(50).empty());
+    CacheWindow reader(policy);
+    ASSERT_TRUE(reader.engage(100));
+    ASSERT_TRUE(reader.advance_read(5).empty());
+    CacheRange range = reader.advance_read(12);
+    ASSERT_EQ(range.offset, 0);
+    ASSERT_EQ(range.length, 12);
+    ASSERT_TRUE(reader.advance_read(20).empty());
+    ASSERT_EQ(reader.advance_read(22).offset, 12);
+
+    // 写入：达到阈值后启用，启动本窗口回写并丢弃上一窗口
+    CacheWindow writer(policy);
+    ASSERT_TRUE(writer.advance_write(90).start.empty());
+    CacheWindow::WriteBehind first = writer.advance_write(100);
+    ASSERT_EQ(first.start.length, 100);
+    ASSERT_TRUE(first.drop.empty());
+    CacheWindow::WriteBehind second = writer.advance_write(110);
+    ASSERT_EQ(second.start.offset, 100);
+    ASSERT_EQ(second.start.length, 10);
+    ASSERT_EQ(second.drop.offset, 0);
+    ASSERT_EQ(second.drop.length, 100);
+    CacheRange rest = writer.finish_write(115);
+    ASSERT_EQ(rest.offset, 100);
+    ASSERT_EQ(rest.length, 15);
+
+    // DIRECT 降级为 FADVISE 后读取恢复丢弃窗口
+    CacheWindow direct(PageCachePolicy(PageCachePolicy::DIRECT, 0, 10));
+    ASSERT_TRUE(direct.engage(0));
+    ASSERT_TRUE(direct.direct());
+    ASSERT_TRUE(direct.advance_read(10).empty());
+    direct.fall_back_to_fadvise();
+    ASSERT_FALSE(direct.direct());
+    ASSERT_EQ(direct.advance_read(20).length, 20);
+
+    ASSERT_EQ(PageCachePolicy::parse_mode("direct", PageCachePolicy::NONE),
+              PageCachePolicy::DIRECT);
+    ASSERT_EQ(PageCachePolicy::parse_mode("bogus", PageCachePolicy::FADVISE),
+              PageCachePolicy::FADVISE);
+}
+
+// 通过 io_uring 打开文件到固定槽位并读取到注册缓冲区
+static Task<void> uringReadFile(IoUring& ring,
+                                ResolvedPath path,
+                                std::shared_ptr<IoUring::Buffer> buffer,
+                                int slot,
+                                int* result) {
+    UringOp opening = ring.openat(slot, path, O_RDONLY, 0, true);
+    UringOp reading = ring.read_fixed(slot, buffer, buffer->size, 0);
+    int opened = co_await opening;
+    int read = co_await reading;
+    *result = opened < 0 ? opened : read;
+}
+
+TEST(IoUringTest, Test_ReadFixed) {
+    ACE_Reactor reactor;
+    IoUring ring;
+    if (ring.open(&reactor, 8, 2, 4096, 1) == -1) {
+        GTEST_SKIP() << "io_uring unavailable";
+    }
+
+    // 缓冲区和槽位按配置数量租用，耗尽后返回空
+    std::shared_ptr<IoUring::Buffer> first = ring.acquire_buffer();
+    std::shared_ptr<IoUring::Buffer> second = ring.acquire_buffer();
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(ring.acquire_buffer(), nullptr);
+    second.reset();
+    ASSERT_NE(ring.acquire_buffer(), nullptr);
+    int slot = ring.acquire_file_slot();
+    ASSERT_EQ(slot, 0);
+    ASSERT_EQ(ring.acquire_file_slot(), -1);
+
+    const std::string path = "uring_test.txt";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "hello io_uring";
+    }
+    char cwd[PATH_MAX];
+    ASSERT_NE(getcwd(cwd, sizeof(cwd)), nullptr);
+    PathResolver resolver;
+    ASSERT_EQ(resolver.open(FileSystem::instance(), cwd), 0);
+    int result = 0;
+    Task<void> task = uringReadFile(
+            ring, resolver.resolve(path), first, slot, &result);
+    task.start();
+    pollfd pfd = {ring.get_handle(), POLLIN, 0};
+    while (task.active() && ::poll(&pfd, 1, 1000) == 1) {
+        ring.handle_input(ring.get_handle());
+    }
+    ASSERT_FALSE(task.active());
+    ASSERT_EQ(result, 14);
+    ASSERT_EQ(std::string(first->data, result), "hello io_uring");
+
+    ring.close();
+    std::remove(path.c_str());
+}
+
 //性能测试
 //并发测试
 TEST_F(FTPServerTest, Performance_ConcurrentConnections) {